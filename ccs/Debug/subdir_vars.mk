@@ -8,12 +8,20 @@ CMD_SRCS += \
 
 C_SRCS += \
 ../adc_ctrl.c \
+../bemf_pll.c \
 ../brake.c \
+../capture.c \
+../foc.c \
 ../hall_ctrl.c \
+../hp_cal.c \
 ../irrigation.c \
+../isr_prof.c \
 ../main.c \
 ../pwm_ctrl.c \
+../qei_ctrl.c \
+../scope.c \
 ../startup_ccs.c \
+../telemetry.c \
 ../trapmod.c \
 ../ui.c \
 ../ui_ethernet.c \
@@ -23,12 +31,20 @@ C_SRCS += \
 
 OBJS += \
 ./adc_ctrl.obj \
+./bemf_pll.obj \
 ./brake.obj \
+./capture.obj \
+./foc.obj \
 ./hall_ctrl.obj \
+./hp_cal.obj \
 ./irrigation.obj \
+./isr_prof.obj \
 ./main.obj \
 ./pwm_ctrl.obj \
+./qei_ctrl.obj \
+./scope.obj \
 ./startup_ccs.obj \
+./telemetry.obj \
 ./trapmod.obj \
 ./ui.obj \
 ./ui_ethernet.obj \
@@ -38,12 +54,20 @@ OBJS += \
 
 C_DEPS += \
 ./adc_ctrl.pp \
+./bemf_pll.pp \
 ./brake.pp \
+./capture.pp \
+./foc.pp \
 ./hall_ctrl.pp \
+./hp_cal.pp \
 ./irrigation.pp \
+./isr_prof.pp \
 ./main.pp \
 ./pwm_ctrl.pp \
+./qei_ctrl.pp \
+./scope.pp \
 ./startup_ccs.pp \
+./telemetry.pp \
 ./trapmod.pp \
 ./ui.pp \
 ./ui_ethernet.pp \
@@ -53,12 +77,20 @@ C_DEPS += \
 
 C_DEPS__QUOTED += \
 "adc_ctrl.pp" \
+"bemf_pll.pp" \
 "brake.pp" \
+"capture.pp" \
+"foc.pp" \
 "hall_ctrl.pp" \
+"hp_cal.pp" \
 "irrigation.pp" \
+"isr_prof.pp" \
 "main.pp" \
 "pwm_ctrl.pp" \
+"qei_ctrl.pp" \
+"scope.pp" \
 "startup_ccs.pp" \
+"telemetry.pp" \
 "trapmod.pp" \
 "ui.pp" \
 "ui_ethernet.pp" \
@@ -68,12 +100,20 @@ C_DEPS__QUOTED += \
 
 OBJS__QUOTED += \
 "adc_ctrl.obj" \
+"bemf_pll.obj" \
 "brake.obj" \
+"capture.obj" \
+"foc.obj" \
 "hall_ctrl.obj" \
+"hp_cal.obj" \
 "irrigation.obj" \
+"isr_prof.obj" \
 "main.obj" \
 "pwm_ctrl.obj" \
+"qei_ctrl.obj" \
+"scope.obj" \
 "startup_ccs.obj" \
+"telemetry.obj" \
 "trapmod.obj" \
 "ui.obj" \
 "ui_ethernet.obj" \
@@ -83,12 +123,20 @@ OBJS__QUOTED += \
 
 C_SRCS__QUOTED += \
 "../adc_ctrl.c" \
+"../bemf_pll.c" \
 "../brake.c" \
+"../capture.c" \
+"../foc.c" \
 "../hall_ctrl.c" \
+"../hp_cal.c" \
 "../irrigation.c" \
+"../isr_prof.c" \
 "../main.c" \
 "../pwm_ctrl.c" \
+"../qei_ctrl.c" \
+"../scope.c" \
 "../startup_ccs.c" \
+"../telemetry.c" \
 "../trapmod.c" \
 "../ui.c" \
 "../ui_ethernet.c" \
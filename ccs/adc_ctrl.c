@@ -29,15 +29,22 @@
 #include "inc/hw_types.h"
 #include "driverlib/adc.h"
 #include "driverlib/interrupt.h"
+#include "driverlib/pwm.h"
 #include "driverlib/sysctl.h"
 #include "driverlib/timer.h"
 #include "adc_ctrl.h"
+#include "bemf_pll.h"
+#include "capture.h"
 #include "main.h"
 #include "pins.h"
 #include "pwm_ctrl.h"
+#include "scope.h"
 #include "trapmod.h"
 #include "ui.h"
 #include "faults.h"
+#include "foc.h"
+#include "hall_ctrl.h"
+#include "isr_prof.h"
 
 //*****************************************************************************
 //
@@ -96,7 +103,7 @@ static unsigned long g_ulADC0Time;
 //*****************************************************************************
 //
 //! The bit number of the flag in #g_ulADCFlags that indicates that the
-//! next edge should be ignored by the Back EMF speed calculation code.  This
+//! Back EMF phase-locked loop should be restarted at the next edge.  This
 //! is used at startup since there is no previous edge time to be used to
 //! calculate the time between edges.
 //
@@ -130,6 +137,24 @@ static unsigned long g_ulADC0Time;
 //*****************************************************************************
 #define FLAG_BEMF_EDGE_BIT      3
 
+//*****************************************************************************
+//
+//! The bit number of the flag in #g_ulADCFlags that indicates that
+//! #g_usBEMFPrevious holds a Back EMF sample from the present commutation
+//! state.
+//
+//*****************************************************************************
+#define FLAG_BEMF_PREV_BIT      4
+
+//*****************************************************************************
+//
+//! The bit number of the flag in #g_ulADCFlags that indicates that the Back
+//! EMF has been seen passing through the zero-crossing threshold in the
+//! present commutation state, and #g_ulBEMFCrossing holds the time.
+//
+//*****************************************************************************
+#define FLAG_BEMF_CROSS_BIT     5
+
 
 //*****************************************************************************
 //
@@ -202,6 +227,16 @@ short g_psPhaseCurrent[3];
 static unsigned char g_ucPhaseCurrentIndex = 0;
 unsigned short g_ucPhaseCurrentIndexLog;
 
+//*****************************************************************************
+//
+//! The zero current offsets of the phase A and phase B current readings, used
+//! by field-oriented control, specified in milliamperes.  These are passed
+//! through an IIR filter with a coefficient of .9375 while the motor drive is
+//! not running.
+//
+//*****************************************************************************
+static short g_psFOCCurrentOffset[2];
+
 //*****************************************************************************
 //
 //! The index for the phase current previously processed in the ADC sequence
@@ -255,13 +290,6 @@ static unsigned char g_ucBEMFState = 0;
 //*****************************************************************************
 static unsigned long g_ulBEMFSpeedPrevious = 0;
 
-//*****************************************************************************
-//
-//! The time at which the last Back EMF edge occurred.
-//
-//*****************************************************************************
-static unsigned long g_ulBEMFEdgePrevious = 0;
-
 //*****************************************************************************
 //
 //! The rotor speed as measured by the BEMF processing code.
@@ -341,6 +369,46 @@ unsigned long g_ulPhaseBEMFCountMax = 0;
 //*****************************************************************************
 static unsigned char g_ucBEMFSkipCount = 3;
 
+//*****************************************************************************
+//
+//! The hysteresis applied to the Back EMF zero-crossing threshold, specified
+//! in ADC counts.  The Back EMF must move this far past the threshold before
+//! the zero-crossing is accepted.
+//
+//*****************************************************************************
+unsigned short g_usBEMFHysteresis = 10;
+
+//*****************************************************************************
+//
+//! The latency from the Back EMF sample to the ADC interrupt time stamp,
+//! specified in system clocks.  This is the conversion time of the sample
+//! sequence plus the interrupt entry latency (about 3.5 us).
+//
+//*****************************************************************************
+unsigned short g_usBEMFLatency = 175;
+
+//*****************************************************************************
+//
+//! The previous Back EMF sample in the present commutation state.
+//
+//*****************************************************************************
+static unsigned short g_usBEMFPrevious;
+
+//*****************************************************************************
+//
+//! The time stamp of the previous Back EMF sample.
+//
+//*****************************************************************************
+static unsigned long g_ulBEMFPreviousTime;
+
+//*****************************************************************************
+//
+//! The interpolated time at which the Back EMF passed through the
+//! zero-crossing threshold in the present commutation state.
+//
+//*****************************************************************************
+static unsigned long g_ulBEMFCrossing;
+
 //static unsigned short g_ucDevent = 0;
 
 //*****************************************************************************
@@ -421,14 +489,17 @@ static unsigned char g_ucBEMFSkipCount = 3;
 static void
 ADC0IntIdle(void)
 {
-    volatile unsigned long ulTemp;
-
     //
     // Read the samples from the ADC FIFO.
     //
     g_pusADC0DataRaw[0] = HWREG(ADC0_BASE + ADC_O_SSFIFO0);
     g_pusADC0DataRaw[1] = HWREG(ADC0_BASE + ADC_O_SSFIFO0);
 
+    //
+    // Record the samples, or replace them with recorded ones.
+    //
+    CaptureADC(&g_ulADC0Time, g_pusADC0DataRaw, 2);
+
     //
     // Reset the sequence if an overflow, underflow, or if the fifo is
     // NOT empty after reading what should have been all of the data.
@@ -450,7 +521,7 @@ ADC0IntIdle(void)
             //
             // Read the next sample.
             //
-            ulTemp = HWREG(ADC0_BASE + ADC_O_SSFIFO0);
+            HWREG(ADC0_BASE + ADC_O_SSFIFO0);
         }
 
         //
@@ -501,8 +572,12 @@ ADC0IntTrap(void)
     unsigned long ulIPhase;
     static unsigned char ucNextHallValue[] =
         {5, 2, 3, 4, 6, 1, 1, 6, 2, 5, 4, 3};
+    static const unsigned char pucHallSector[8] =
+        {0, 1, 3, 2, 5, 0, 4, 0};
     static unsigned long ulCount = 0;
     static long adcCount = 0;
+    unsigned long ulSample, ulThreshold, ulCrossing;
+    tBoolean bFalling;
 
     //
     // Reset/Reconfigure the sequence if a change in PWM output drive
@@ -607,6 +682,13 @@ ADC0IntTrap(void)
         // Reset the Back EMF edge flags for next detection.
         //
         HWREGBITW(&g_ulADCFlags, FLAG_BEMF_EDGE_BIT) = 0;
+
+        //
+        // The Back EMF is now read from a different phase, so there is no
+        // previous sample or crossing to interpolate from.
+        //
+        HWREGBITW(&g_ulADCFlags, FLAG_BEMF_PREV_BIT) = 0;
+        HWREGBITW(&g_ulADCFlags, FLAG_BEMF_CROSS_BIT) = 0;
         
         //
         // Reset the Back EMF detection skip counter.
@@ -639,6 +721,11 @@ ADC0IntTrap(void)
     g_pusADC0DataRaw[2] = HWREG(ADC0_BASE + ADC_O_SSFIFO0);
     g_pusADC0DataRaw[3] = HWREG(ADC0_BASE + ADC_O_SSFIFO0);
 
+    //
+    // Record the samples, or replace them with recorded ones.
+    //
+    CaptureADC(&g_ulADC0Time, g_pusADC0DataRaw, 4);
+
     //
     // Reset the sequence if an overflow, underflow, or if the fifo is
     // NOT empty after reading what should have been all of the data.
@@ -676,6 +763,14 @@ ADC0IntTrap(void)
         return;
     }
 
+    //
+    // Pass the samples to the scope while it is capturing.
+    //
+    if(g_ulScopeState >= SCOPE_STATE_ARMED)
+    {
+        ScopeSample(g_pusADC0DataRaw, g_ucBEMFState);
+    }
+
     //
     // Save the raw data, filtering as needed.
     //
@@ -790,9 +885,11 @@ ADC0IntTrap(void)
         }
 
         //
-        // Reset the Back EMF Commutation Period Average.
+        // Reset the Back EMF Commutation Period, and restart the
+        // phase-locked loop when the motor drive is next started.
         //
         g_ulBEMFPeriod = 0;
+        HWREGBITW(&g_ulADCFlags, FLAG_SKIP_BIT) = 1;
 
         //
         // If the motor is NOT running, there is nothing more to do here.
@@ -853,6 +950,75 @@ ADC0IntTrap(void)
         g_ucPreviousPhaseCurrentIndex = g_ucPhaseCurrentIndex;
     }
 
+    //
+    // Once the motor is running closed loop, run the current controller with
+    // the unfiltered motor current from this sample.
+    //
+    if(!MainIsStartup())
+    {
+        lTemp = (g_pusADC0DataRaw[1]*125/64*25)- 20000;
+        MainCurrentControl(lTemp - g_sMotorCurrentOffset);
+    }
+
+    //
+    // Determine the direction in which the Back EMF passes through the
+    // zero-crossing threshold (one half of the bus voltage) in this state.
+    //
+    switch(g_ucBEMFState)
+    {
+        case 0:
+        case 2:
+        case 4:
+        case 7:
+        case 9:
+        case 11:
+            bFalling = true;
+            break;
+
+        default:
+            bFalling = false;
+            break;
+    }
+    ulThreshold = g_usBusVoltageCount / 2;
+    ulSample = g_pusBEMFVoltageCount[0];
+
+    //
+    // See if the Back EMF passed through the threshold between the previous
+    // sample and this one.  If so, estimate the time at which it crossed by
+    // linear interpolation between the two samples, and correct it for the
+    // latency from the ADC sample to the interrupt time stamp.  This is done
+    // while skipping samples too, since the crossing may occur early in the
+    // commutation at high speed.
+    //
+    if(HWREGBITW(&g_ulADCFlags, FLAG_BEMF_PREV_BIT) &&
+       ((bFalling && (g_usBEMFPrevious >= ulThreshold) &&
+         (ulSample < ulThreshold)) ||
+        (!bFalling && (g_usBEMFPrevious <= ulThreshold) &&
+         (ulSample > ulThreshold))))
+    {
+        ulTime = g_ulADC0Time - g_ulBEMFPreviousTime;
+        if(bFalling)
+        {
+            ulTemp = ((ulTime * (g_usBEMFPrevious - ulThreshold)) /
+                      (g_usBEMFPrevious - ulSample));
+        }
+        else
+        {
+            ulTemp = ((ulTime * (ulThreshold - g_usBEMFPrevious)) /
+                      (ulSample - g_usBEMFPrevious));
+        }
+        g_ulBEMFCrossing = (g_ulBEMFPreviousTime + ulTemp -
+                            g_usBEMFLatency);
+        HWREGBITW(&g_ulADCFlags, FLAG_BEMF_CROSS_BIT) = 1;
+    }
+
+    //
+    // Save this sample for the next interpolation.
+    //
+    g_usBEMFPrevious = ulSample;
+    g_ulBEMFPreviousTime = g_ulADC0Time;
+    HWREGBITW(&g_ulADCFlags, FLAG_BEMF_PREV_BIT) = 1;
+
     //
     // If Back EMF trigger point has been found, there is nothing
     // more to do until the PWM drive signals change.
@@ -873,150 +1039,246 @@ ADC0IntTrap(void)
     }
 
     //
-    // Check for Back EMF Trigger Point.
+    // Check for Back EMF Trigger Point, which is the Back EMF having moved
+    // past the threshold by the hysteresis.  There is nothing more to do
+    // until it is detected.
     //
-    switch(g_ucBEMFState)
+    if(!((bFalling && ((ulSample + g_usBEMFHysteresis) < ulThreshold)) ||
+         (!bFalling && (ulSample > (ulThreshold + g_usBEMFHysteresis)))))
     {
-        case 0:
-        case 2:
-        case 4:
-        case 7:
-        case 9:
-        case 11:
-            if(g_pusBEMFVoltageCount[0] < (g_usBusVoltageCount / 2 - 10))
-            {
-                HWREGBITW(&g_ulADCFlags, FLAG_BEMF_EDGE_BIT) = 1;
-                g_ulBEMFNextHall = ucNextHallValue[g_ucBEMFState];
-            }
-            break;
-
-        case 1:
-        case 3:
-        case 5:
-        case 6:
-        case 8:
-        case 10:
-            if(g_pusBEMFVoltageCount[0] > g_usBusVoltageCount / 2 + 10)
-            {
-                HWREGBITW(&g_ulADCFlags, FLAG_BEMF_EDGE_BIT) = 1;
-                g_ulBEMFNextHall = ucNextHallValue[g_ucBEMFState];
-            }
-            break;
+        return;
     }
+    HWREGBITW(&g_ulADCFlags, FLAG_BEMF_EDGE_BIT) = 1;
+    g_ulBEMFNextHall = ucNextHallValue[g_ucBEMFState];
+
     //
-    // If we detected an edge, start a timer to trigger a commutation.
+    // Use the interpolated crossing time if the crossing was seen.
+    // Otherwise, the Back EMF was already past the threshold at the first
+    // sample in this state, so assume that the crossing occurred one half of
+    // a PWM period before this sample.
     //
-    if(HWREGBITW(&g_ulADCFlags, FLAG_BEMF_EDGE_BIT) == 1)
+    if(HWREGBITW(&g_ulADCFlags, FLAG_BEMF_CROSS_BIT))
     {
-        if(MainIsRunning() && !MainIsStartup())
-        {
-            //
-            // Calculate the period of this commutation.
-            //
-            ulTime = g_ulADC0Time - g_ulBEMFEdgePrevious;
-
-            //
-            // Accomodate jitter by adjusting the period based on
-            // the average speed.
-            //
-            ulTemp = (((3 * g_ulBEMFPeriod) - ulTime) / 2);
+        ulCrossing = g_ulBEMFCrossing;
+    }
+    else
+    {
+        ulCrossing = (g_ulADC0Time - g_usBEMFLatency -
+                      (((g_ulPWMWidth * PWM_CLOCK_WIDTH) /
+                        SYSTEM_CLOCK_WIDTH) / 2));
+    }
 
-            //
-            // Assume that the BEMF detection occurs at the half-way point
-            // between a commutation
-            //
-            ulTemp = (ulTemp / 2);
+    //
+    // Punch the watchdog timer.
+    //
+    MainPunchWatchdog();
 
-            //
-            // Account for latency from BEMF sample time to the TIMER
-            // program/enable time.
-            // ~3.5us (3500ns) from BEMF sample to ADC sequence interrupt.
-            // ~350 processor clocks of latency from start of interrupt to
-            // here.
-            //
-            //ulTemp = (ulTemp - (3500 / SYSTEM_CLOCK_WIDTH));
-            //ulTemp = (ulTemp - 350);
+    //
+    // Set the flag to indicate that we have seen an edge.
+    //
+    HWREGBITW(&g_ulADCFlags, FLAG_EDGE_BIT) = 1;
 
-            //
-            // Allow for the fact that the zero-crossing may have occurred
-            // at any point between the current sample and the previous
-            // sample.  For now, assume one half the PWM period.
-            //
-            ulTemp = (ulTemp -
-                (((g_ulPWMWidth * PWM_CLOCK_WIDTH) / SYSTEM_CLOCK_WIDTH) / 2));
+    //
+    // If the rotor has been stopped, restart the phase-locked loop, which
+    // then measures the commutation period from the next two zero-crossings.
+    //
+    if(HWREGBITW(&g_ulADCFlags, FLAG_SKIP_BIT))
+    {
+        HWREGBITW(&g_ulADCFlags, FLAG_SKIP_BIT) = 0;
+        BEMFPLLReset(0);
+    }
 
-            //
-            // Program and enable the timer.
-            //
-            HWREG(TIMER0_BASE + TIMER_O_TAILR) = ulTemp;
-            HWREG(TIMER0_BASE + TIMER_O_CTL) |=
-                (TIMER_A & (TIMER_CTL_TAEN | TIMER_CTL_TBEN));
-        }
-        g_ulBEMFEdgePrevious = g_ulADC0Time;
+    //
+    // Update the phase-locked loop with this zero-crossing, and take the
+    // rotor speed and commutation period from it.
+    //
+    BEMFPLLUpdate(ulCrossing, pucHallSector[g_ulBEMFNextHall & 7]);
+    g_ulBEMFSpeedPrevious = ulCrossing;
+    if(!BEMFPLLValid())
+    {
+        return;
     }
+    g_ulBEMFRotorSpeed = BEMFPLLSpeed();
+    g_ulBEMFPeriod = BEMFPLLPeriod();
 
     //
-    // Compute the new speed from the time between edges.
+    // Once in closed-loop mode, start a timer to trigger the commutation at
+    // the time predicted by the phase-locked loop.
     //
-    if((HWREGBITW(&g_ulADCFlags, FLAG_BEMF_EDGE_BIT) == 1) &&
-       ((g_ucBEMFState == 0) || (g_ucBEMFState == 11)))
+    if(MainIsRunning() && !MainIsStartup())
     {
         //
-        // Punch the watchdog timer.
+        // Account for the time that has already elapsed, which includes the
+        // interrupt latency and the processing above.  If the commutation is
+        // already overdue, commutate as soon as possible.
         //
-        MainPunchWatchdog();
+        ulTemp = BEMFPLLCommutation() - UIGetTicks();
+        if((long)ulTemp <= 0)
+        {
+            ulTemp = 1;
+        }
+
+        //
+        // Program and enable the timer.
+        //
+        HWREG(TIMER0_BASE + TIMER_O_TAILR) = ulTemp;
+        HWREG(TIMER0_BASE + TIMER_O_CTL) |=
+            (TIMER_A & (TIMER_CTL_TAEN | TIMER_CTL_TBEN));
+    }
+}
+
+//*****************************************************************************
+//
+//! Handles the ADC sample sequence for field-oriented control mode.
+//!
+//! This functions processes the ADC sequence zero for field-oriented control
+//! mode.  The sequence has been programmed to read the phase A and phase B
+//! currents, along with bus voltage and ambient temperature, at the center of
+//! the low-side on time when all three low-side shunts carry their phase
+//! current.  While the motor drive is running, the phase currents are passed
+//! to the current controllers.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+ADC0IntFOC(void)
+{
+    static unsigned long ulCount = 0;
+    long lCurrentA, lCurrentB;
 
+    //
+    // Read the samples from the ADC FIFO.
+    //
+    g_pusADC0DataRaw[0] = HWREG(ADC0_BASE + ADC_O_SSFIFO0);
+    g_pusADC0DataRaw[1] = HWREG(ADC0_BASE + ADC_O_SSFIFO0);
+    g_pusADC0DataRaw[2] = HWREG(ADC0_BASE + ADC_O_SSFIFO0);
+    g_pusADC0DataRaw[3] = HWREG(ADC0_BASE + ADC_O_SSFIFO0);
+
+    //
+    // Record the samples, or replace them with recorded ones.
+    //
+    CaptureADC(&g_ulADC0Time, g_pusADC0DataRaw, 4);
+
+    //
+    // Reset the sequence if an overflow, underflow, or if the fifo is
+    // NOT empty after reading what should have been all of the data.
+    //
+    if((HWREG(ADC0_BASE + ADC_O_OSTAT) & ADC_OSTAT_OV0) ||
+       (HWREG(ADC0_BASE + ADC_O_USTAT) & ADC_USTAT_UV0) ||
+       (!(HWREG(ADC0_BASE + ADC_O_SSFSTAT0) & ADC_SSFSTAT0_EMPTY)))
+    {
         //
-        // Set the flag to indicate that we have seen an edge.
-        // 
-        HWREGBITW(&g_ulADCFlags, FLAG_EDGE_BIT) = 1;
+        // Disable the sequence.
+        //
+        HWREG(ADC0_BASE + ADC_O_ACTSS) &= ~ADC_ACTSS_ASEN0;
 
         //
-        // See if this edge should be skipped.
+        // Drain the Sequence FIFO.
         //
-        if(HWREGBITW(&g_ulADCFlags, FLAG_SKIP_BIT))
+        while(!(HWREG(ADC0_BASE + ADC_O_SSFSTAT0) & ADC_SSFSTAT0_EMPTY))
         {
             //
-            // This edge should be skipped, but an edge time now exists so the
-            // next edge should not be skipped.
+            // Read the next sample.
             //
-            HWREGBITW(&g_ulADCFlags, FLAG_SKIP_BIT) = 0;
+            HWREG(ADC0_BASE + ADC_O_SSFIFO0);
+        }
 
-            //
-            // Save the time of the current edge.
-            //
-            g_ulBEMFSpeedPrevious = g_ulADC0Time;
+        //
+        // Clear any overflow/underflow conditions that might exist.
+        //
+        HWREG(ADC0_BASE + ADC_O_OSTAT) = ADC_OSTAT_OV0;
+        HWREG(ADC0_BASE + ADC_O_USTAT) = ADC_USTAT_UV0;
 
-            //
-            // There is nothing further to be done.
-            //
-            return;
-        }
-            
         //
-        // Compute the time between this edge and the previous edge.
+        // Renable the sequence and return.
         //
-        ulTime = g_ulADC0Time - g_ulBEMFSpeedPrevious;
+        HWREG(ADC0_BASE + ADC_O_ACTSS) |= ADC_ACTSS_ASEN0;
+        return;
+    }
 
+    //
+    // Pass the samples to the scope while it is capturing.  The Hall state
+    // changes where trapezoid modulation would commutate.
+    //
+    if(g_ulScopeState >= SCOPE_STATE_ARMED)
+    {
+        ScopeSample(g_pusADC0DataRaw, g_ulHallValue);
+    }
+
+    //
+    // Filter and convert the Bus Voltage ADC count to a millivolt value.
+    //
+    BUS_VOLTAGE_CALC(g_pusADC0DataRaw[2]);
+
+    //
+    // Convert the phase current readings to milliamps.
+    // (3R/1024 -1.2)/(4*0.015) * 1000
+    //
+    lCurrentA = (g_pusADC0DataRaw[0] * 125 / 64 * 25) - 20000;
+    lCurrentB = (g_pusADC0DataRaw[1] * 125 / 64 * 25) - 20000;
+
+    //
+    // See if the motor drive is running.
+    //
+    if(!MainIsRunning())
+    {
         //
-        // Save the time of the current edge.
+        // Since the motor drive is not running, there is no current through
+        // the motor, so track the zero current offsets of the readings.
         //
-        g_ulBEMFSpeedPrevious = g_ulADC0Time;
+        g_psFOCCurrentOffset[0] =
+            (short)((((long)g_psFOCCurrentOffset[0] * 15) + lCurrentA) / 16);
+        g_psFOCCurrentOffset[1] =
+            (short)((((long)g_psFOCCurrentOffset[1] * 15) + lCurrentB) / 16);
+        g_psPhaseCurrent[0] = 0;
+        g_psPhaseCurrent[1] = 0;
+        g_psPhaseCurrent[2] = 0;
+        g_sMotorCurrent = 0;
+        g_ulMotorPower = 0;
 
         //
-        // Compute the new speed from the time between edges, running it
-        // through a low pass filter with a coefficient of .875.
+        // Once the offsets have settled, indicate a motor current offset
+        // fault if either is out of range.
         //
-        ulTemp = (SYSTEM_CLOCK * 60U);
-        ulTemp = (ulTemp / ulTime);
-        ulTemp = (ulTemp / (g_sParameters.ucNumPoles / 2));
-        g_ulBEMFRotorSpeed = (((g_ulBEMFRotorSpeed * 7) + ulTemp) / 8);
+        if(ulCount < NUM_CURRENT_READING_INIT)
+        {
+            ulCount++;
+        }
+        else if((g_psFOCCurrentOffset[0] > ADC_CURRENT_OFFSET_HLIMIT) ||
+                (g_psFOCCurrentOffset[0] < ADC_CURRENT_OFFSET_LLIMIT) ||
+                (g_psFOCCurrentOffset[1] > ADC_CURRENT_OFFSET_HLIMIT) ||
+                (g_psFOCCurrentOffset[1] < ADC_CURRENT_OFFSET_LLIMIT))
+        {
+            MainSetFault(FAULT_CURRENT_OFFSET);
+        }
 
         //
-        // Accumulate average Commutation Period.
+        // If the motor is NOT running, there is nothing more to do here.
         //
-        g_ulBEMFPeriod = (((g_ulBEMFPeriod * 3) + (ulTime / 6)) / 4);
+        return;
     }
+
+    //
+    // Remove the offsets.  The shunt current flows out of the motor phase,
+    // so it is negated to give the current into the motor.
+    //
+    lCurrentA = g_psFOCCurrentOffset[0] - lCurrentA;
+    lCurrentB = g_psFOCCurrentOffset[1] - lCurrentB;
+    g_psPhaseCurrent[0] = (short)lCurrentA;
+    g_psPhaseCurrent[1] = (short)lCurrentB;
+    g_psPhaseCurrent[2] = (short)(-lCurrentA - lCurrentB);
+
+    //
+    // Run the current controllers.
+    //
+    FOCCurrentControl(lCurrentA, lCurrentB, g_ulADC0Time);
+
+    //
+    // The motor current is the magnitude of the torque producing current.
+    //
+    g_sMotorCurrent = ((g_sFOCCurrentQ < 0) ? -g_sFOCCurrentQ :
+                       g_sFOCCurrentQ);
 }
 
 //*****************************************************************************
@@ -1034,6 +1296,11 @@ ADC0IntTrap(void)
 void
 ADC0IntHandler(void)
 {
+    //
+    // Mark the start of this handler for the profiler.
+    //
+    ISRProfileStart(ISR_PROFILE_ADC);
+
     //
     // Get the time for this interrupt.
     //
@@ -1048,6 +1315,16 @@ ADC0IntHandler(void)
     // Process the sequence based on the ADC mode.
     //
     g_pfnADC0Handler();
+
+    //
+    // Trigger the next replayed Hall sensor edge, if it is due.
+    //
+    CaptureReplayTick();
+
+    //
+    // Mark the end of this handler for the profiler.
+    //
+    ISRProfileEnd(ISR_PROFILE_ADC);
 }
 
 //*****************************************************************************
@@ -1071,6 +1348,12 @@ ADCConfigure(void)
     ADCIntDisable(ADC0_BASE, 0);
     ADCSequenceDisable(ADC0_BASE, 0);
 
+    //
+    // Stop the scope, since the samples that it captures change with the
+    // sequence.
+    //
+    ScopeStop();
+
     //
     // Ensure that this sequence is the highest priority sequence
     // (in the event that other ADC sequences are being used
@@ -1078,6 +1361,22 @@ ADCConfigure(void)
     //
     ADCSequenceConfigure(ADC0_BASE, 0, ADC_TRIGGER_PWM0, 0);
 
+    //
+    // Field-oriented control samples the phase currents at the center of the
+    // low-side on time (when the PWM counter is zero); the other modes sample
+    // at the center of the high-side on time (when the counter is at load).
+    //
+    if(g_sParameters.ucModulationType == MOD_TYPE_FOC)
+    {
+        PWMGenIntTrigDisable(PWM_BASE, PWM_GEN_0, PWM_TR_CNT_LOAD);
+        PWMGenIntTrigEnable(PWM_BASE, PWM_GEN_0, PWM_TR_CNT_ZERO);
+    }
+    else
+    {
+        PWMGenIntTrigDisable(PWM_BASE, PWM_GEN_0, PWM_TR_CNT_ZERO);
+        PWMGenIntTrigEnable(PWM_BASE, PWM_GEN_0, PWM_TR_CNT_LOAD);
+    }
+
     //
     // If modulation type is sensorless, there is only one ADC
     // configuration available.
@@ -1122,6 +1421,27 @@ ADCConfigure(void)
 
     }
 
+    //
+    // If modulation type is field-oriented control, read two of the phase
+    // currents (the third is their negated sum).
+    //
+    else if(g_sParameters.ucModulationType == MOD_TYPE_FOC)
+    {
+        //
+        // Program the interrupt handler.
+        //
+        g_pfnADC0Handler = ADC0IntFOC;
+
+        //
+        // Program the sequence.
+        //
+        ADCSequenceStepConfigure(ADC0_BASE, 0, 0, PIN_IPHASEA);
+        ADCSequenceStepConfigure(ADC0_BASE, 0, 1, PIN_IPHASEB);
+        ADCSequenceStepConfigure(ADC0_BASE, 0, 2, PIN_VSENSE);
+        ADCSequenceStepConfigure(ADC0_BASE, 0, 3,
+                                 ADC_CTL_END | ADC_CTL_IE | ADC_CTL_TS);
+    }
+
     //
     // Here, there is some type of mistake, so just configure the ADC
     // sequences for "idle" mode.
@@ -43,6 +43,8 @@ extern short g_sMotorCurrent;
 extern unsigned long g_ulBEMFRotorSpeed;
 extern unsigned long g_ulBEMFHallValue;
 extern unsigned long g_ulBEMFNextHall;
+extern unsigned short g_usBEMFHysteresis;
+extern unsigned short g_usBEMFLatency;
 extern unsigned long g_ulBusVoltage;
 extern short g_sAmbientTemp;
 extern unsigned long g_ulLinearHallValue;
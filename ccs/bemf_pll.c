@@ -0,0 +1,418 @@
+//*****************************************************************************
+//
+// bemf_pll.c - Phase-locked loop rotor estimator for sensorless operation.
+//
+//*****************************************************************************
+
+#include "inc/hw_types.h"
+#include "bemf_pll.h"
+#include "main.h"
+#include "ui.h"
+
+//*****************************************************************************
+//
+//! \page bemf_pll_intro Introduction
+//!
+//! When running sensorless, the Back EMF zero-crossing of the undriven phase
+//! is detected once per commutation, which is six times per electrical
+//! revolution.  The phase-locked loop tracks the time of these events with a
+//! predicted time for the next zero-crossing and an estimate of the time
+//! between zero-crossings (the commutation period, which is the inverse of
+//! the rotor speed).
+//!
+//! At each zero-crossing, the difference between the measured and predicted
+//! times is the phase error.  A fraction of the phase error corrects the
+//! estimated time of the zero-crossing, and a smaller fraction of it
+//! corrects the commutation period; this is a second order (type II) loop,
+//! which tracks a constant speed with no phase error.  The next commutation
+//! is then due one half of a commutation period (30 electrical degrees)
+//! after the estimated zero-crossing, and the next zero-crossing is predicted
+//! one commutation period after it.  Since the speed is updated at every
+//! zero-crossing and the period is not passed through a long filter, the
+//! estimate follows acceleration far more closely than a once per
+//! revolution measurement.
+//!
+//! If a zero-crossing is not detected, the following one arrives a whole
+//! commutation period later.  Each zero-crossing is identified by its
+//! position in the commutation sequence, so the prediction is moved forward
+//! by the missed periods rather than treating them as a phase error.
+//!
+//! The loop is considered to be locked once the phase error has remained
+//! within #BEMF_PLL_LOCK_ERROR for #BEMF_PLL_LOCK_COUNT zero-crossings, and
+//! loses lock when the phase error exceeds #BEMF_PLL_UNLOCK_ERROR.  While it
+//! is not locked, the measured zero-crossing times are used directly and the
+//! commutation period is corrected more aggressively, so that the loop
+//! acquires quickly after startup or a disturbance.
+//!
+//! The code for the phase-locked loop is contained in <tt>bemf_pll.c</tt>,
+//! with <tt>bemf_pll.h</tt> containing the definitions for the variables and
+//! functions exported to the remainder of the application.
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! \defgroup bemf_pll_api Definitions
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! The number of fractional bits in the commutation period estimate.
+//
+//*****************************************************************************
+#define BEMF_PLL_FRAC_BITS      8
+
+//*****************************************************************************
+//
+//! The divisor applied to the phase error to correct the estimated
+//! zero-crossing time while locked.
+//
+//*****************************************************************************
+#define BEMF_PLL_PHASE_DIV      2
+
+//*****************************************************************************
+//
+//! The divisor applied to the phase error to correct the commutation period
+//! while locked.
+//
+//*****************************************************************************
+#define BEMF_PLL_FREQ_DIV       8
+
+//*****************************************************************************
+//
+//! The divisor applied to the phase error to correct the commutation period
+//! while acquiring lock.
+//
+//*****************************************************************************
+#define BEMF_PLL_ACQUIRE_DIV    2
+
+//*****************************************************************************
+//
+//! The phase error within which the loop is considered to be tracking, as a
+//! divisor of the commutation period (60 / 8 = 7.5 electrical degrees).
+//
+//*****************************************************************************
+#define BEMF_PLL_LOCK_ERROR     8
+
+//*****************************************************************************
+//
+//! The phase error beyond which the loop loses lock, as a divisor of the
+//! commutation period (60 / 3 = 20 electrical degrees).
+//
+//*****************************************************************************
+#define BEMF_PLL_UNLOCK_ERROR   3
+
+//*****************************************************************************
+//
+//! The number of consecutive zero-crossings within #BEMF_PLL_LOCK_ERROR that
+//! are required to acquire lock (two electrical revolutions).
+//
+//*****************************************************************************
+#define BEMF_PLL_LOCK_COUNT     12
+
+//*****************************************************************************
+//
+//! The maximum number of consecutive zero-crossings that may be missed before
+//! the loop is restarted.
+//
+//*****************************************************************************
+#define BEMF_PLL_MAX_MISSED     2
+
+//*****************************************************************************
+//
+//! The phase error at the most recent zero-crossing, specified in tenths of
+//! an electrical degree.  A positive error means that the zero-crossing
+//! occurred later than predicted.
+//
+//*****************************************************************************
+short g_sBEMFPLLError = 0;
+
+//*****************************************************************************
+//
+//! Indicates whether the phase-locked loop is locked (1) or acquiring (0).
+//
+//*****************************************************************************
+unsigned char g_ucBEMFPLLLock = 0;
+
+//*****************************************************************************
+//
+//! The number of zero-crossings that have been seen since the loop was
+//! reset, saturating at two.
+//
+//*****************************************************************************
+static unsigned long g_ulBEMFPLLCount;
+
+//*****************************************************************************
+//
+//! The number of consecutive zero-crossings with a phase error within
+//! #BEMF_PLL_LOCK_ERROR.
+//
+//*****************************************************************************
+static unsigned long g_ulBEMFPLLGood;
+
+//*****************************************************************************
+//
+//! The estimated commutation period, in system clocks with
+//! #BEMF_PLL_FRAC_BITS fractional bits.
+//
+//*****************************************************************************
+static unsigned long g_ulBEMFPLLPeriod;
+
+//*****************************************************************************
+//
+//! The estimated time of the most recent zero-crossing, in system clocks.
+//
+//*****************************************************************************
+static unsigned long g_ulBEMFPLLCrossing;
+
+//*****************************************************************************
+//
+//! The position in the commutation sequence of the most recent
+//! zero-crossing.
+//
+//*****************************************************************************
+static unsigned long g_ulBEMFPLLSector;
+
+//*****************************************************************************
+//
+//! Resets the phase-locked loop.
+//!
+//! \param ulPeriod is the expected commutation period in system clocks, or
+//! zero if it is not known.
+//!
+//! This function restarts the acquisition of the Back EMF zero-crossings.
+//! If the commutation period is not known, it is measured from the first two
+//! zero-crossings.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+BEMFPLLReset(unsigned long ulPeriod)
+{
+    g_ulBEMFPLLPeriod = ulPeriod << BEMF_PLL_FRAC_BITS;
+    g_ulBEMFPLLCount = 0;
+    g_ulBEMFPLLGood = 0;
+    g_ucBEMFPLLLock = 0;
+    g_sBEMFPLLError = 0;
+}
+
+//*****************************************************************************
+//
+//! Updates the phase-locked loop with a Back EMF zero-crossing.
+//!
+//! \param ulCrossing is the time of the zero-crossing, in system clocks.
+//! \param ulSector is the position of the commutation that follows the
+//! zero-crossing in the forward commutation sequence, from 0 to 5.
+//!
+//! This function is called from the ADC interrupt handler each time that a
+//! Back EMF zero-crossing is detected.  It updates the estimated time of the
+//! zero-crossing, the commutation period, and the lock status.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+BEMFPLLUpdate(unsigned long ulCrossing, unsigned long ulSector)
+{
+    unsigned long ulPeriod, ulSteps;
+    long lError;
+
+    //
+    // Determine the number of commutations since the previous zero-crossing,
+    // which is more than one if zero-crossings were not detected (such as
+    // during the open-loop startup).  Restart if the zero-crossing is from
+    // the same commutation, or too many were missed.
+    //
+    if(MainIsReverse())
+    {
+        ulSteps = (g_ulBEMFPLLSector + 6 - ulSector) % 6;
+    }
+    else
+    {
+        ulSteps = (ulSector + 6 - g_ulBEMFPLLSector) % 6;
+    }
+    g_ulBEMFPLLSector = ulSector;
+    if((ulSteps == 0) || (ulSteps > (BEMF_PLL_MAX_MISSED + 1)))
+    {
+        g_ulBEMFPLLCount = 0;
+        g_ulBEMFPLLGood = 0;
+        g_ucBEMFPLLLock = 0;
+    }
+
+    //
+    // The first zero-crossing only provides a starting time.  If the
+    // commutation period was not known at reset, the second zero-crossing
+    // provides it.
+    //
+    if((g_ulBEMFPLLCount == 0) ||
+       ((g_ulBEMFPLLCount == 1) && (g_ulBEMFPLLPeriod == 0)))
+    {
+        if(g_ulBEMFPLLCount == 1)
+        {
+            g_ulBEMFPLLPeriod = (((ulCrossing - g_ulBEMFPLLCrossing) <<
+                                  BEMF_PLL_FRAC_BITS) / ulSteps);
+        }
+        g_ulBEMFPLLCrossing = ulCrossing;
+        g_ulBEMFPLLCount++;
+        return;
+    }
+    g_ulBEMFPLLCount = 2;
+
+    //
+    // Compute the phase error against the predicted time of this
+    // zero-crossing.
+    //
+    ulPeriod = g_ulBEMFPLLPeriod >> BEMF_PLL_FRAC_BITS;
+    ulCrossing -= g_ulBEMFPLLCrossing + (ulSteps * ulPeriod);
+    lError = (long)ulCrossing;
+
+    //
+    // Limit the effect of a zero-crossing that is more than half a period
+    // from the prediction.
+    //
+    if(lError > (long)(ulPeriod / 2))
+    {
+        lError = (long)(ulPeriod / 2);
+    }
+    else if(lError < -(long)(ulPeriod / 2))
+    {
+        lError = -(long)(ulPeriod / 2);
+    }
+
+    //
+    // Save the phase error for the user interface, in tenths of an
+    // electrical degree.
+    //
+    g_sBEMFPLLError = (short)((lError * 600) / (long)ulPeriod);
+
+    //
+    // Update the lock status.
+    //
+    if((lError > (long)(ulPeriod / BEMF_PLL_UNLOCK_ERROR)) ||
+       (lError < -(long)(ulPeriod / BEMF_PLL_UNLOCK_ERROR)))
+    {
+        g_ulBEMFPLLGood = 0;
+        g_ucBEMFPLLLock = 0;
+    }
+    else if((lError <= (long)(ulPeriod / BEMF_PLL_LOCK_ERROR)) &&
+            (lError >= -(long)(ulPeriod / BEMF_PLL_LOCK_ERROR)))
+    {
+        if(g_ulBEMFPLLGood < BEMF_PLL_LOCK_COUNT)
+        {
+            g_ulBEMFPLLGood++;
+        }
+        else
+        {
+            g_ucBEMFPLLLock = 1;
+        }
+    }
+    else
+    {
+        g_ulBEMFPLLGood = 0;
+    }
+
+    //
+    // Correct the estimated zero-crossing time and the commutation period.
+    // While acquiring, the measured time is used directly.
+    //
+    ulCrossing = g_ulBEMFPLLCrossing + (ulSteps * ulPeriod);
+    if(g_ucBEMFPLLLock)
+    {
+        g_ulBEMFPLLCrossing = ulCrossing + (lError / BEMF_PLL_PHASE_DIV);
+        lError = ((lError * (1 << BEMF_PLL_FRAC_BITS)) / BEMF_PLL_FREQ_DIV);
+    }
+    else
+    {
+        g_ulBEMFPLLCrossing = ulCrossing + lError;
+        lError = ((lError * (1 << BEMF_PLL_FRAC_BITS)) / BEMF_PLL_ACQUIRE_DIV);
+    }
+
+    //
+    // Do not allow the commutation period to collapse to zero.
+    //
+    if((lError < 0) && ((unsigned long)-lError >= (g_ulBEMFPLLPeriod / 2)))
+    {
+        g_ulBEMFPLLPeriod /= 2;
+    }
+    else
+    {
+        g_ulBEMFPLLPeriod += lError;
+    }
+}
+
+//*****************************************************************************
+//
+//! Determines if the phase-locked loop has a speed estimate.
+//!
+//! \return Returns non-zero if the commutation period has been estimated.
+//
+//*****************************************************************************
+unsigned long
+BEMFPLLValid(void)
+{
+    return((g_ulBEMFPLLCount == 2) ? 1 : 0);
+}
+
+//*****************************************************************************
+//
+//! Gets the estimated commutation period.
+//!
+//! \return Returns the estimated time between Back EMF zero-crossings, in
+//! system clocks.
+//
+//*****************************************************************************
+unsigned long
+BEMFPLLPeriod(void)
+{
+    return(g_ulBEMFPLLPeriod >> BEMF_PLL_FRAC_BITS);
+}
+
+//*****************************************************************************
+//
+//! Gets the estimated rotor speed.
+//!
+//! \return Returns the estimated rotor speed, in RPM.
+//
+//*****************************************************************************
+unsigned long
+BEMFPLLSpeed(void)
+{
+    unsigned long ulTemp;
+
+    //
+    // There are six commutations per electrical revolution, and one
+    // electrical revolution per pole pair.
+    //
+    ulTemp = ((g_ulBEMFPLLPeriod * (g_sParameters.ucNumPoles / 2)) >>
+              BEMF_PLL_FRAC_BITS);
+    if(ulTemp == 0)
+    {
+        return(0);
+    }
+    return((SYSTEM_CLOCK * 10U) / ulTemp);
+}
+
+//*****************************************************************************
+//
+//! Gets the predicted time of the next commutation.
+//!
+//! \return Returns the time at which the next commutation is due, which is
+//! one half of a commutation period after the most recent zero-crossing, in
+//! system clocks.
+//
+//*****************************************************************************
+unsigned long
+BEMFPLLCommutation(void)
+{
+    return(g_ulBEMFPLLCrossing + (BEMFPLLPeriod() / 2));
+}
+
+//*****************************************************************************
+//
+// Close the Doxygen group.
+//! @}
+//
+//*****************************************************************************
@@ -0,0 +1,24 @@
+//*****************************************************************************
+//
+// bemf_pll.h - Prototypes for the sensorless phase-locked loop routines.
+//
+//*****************************************************************************
+
+#ifndef __BEMF_PLL_H__
+#define __BEMF_PLL_H__
+
+//*****************************************************************************
+//
+// Prototypes for the exported variables and functions.
+//
+//*****************************************************************************
+extern short g_sBEMFPLLError;
+extern unsigned char g_ucBEMFPLLLock;
+extern void BEMFPLLReset(unsigned long ulPeriod);
+extern void BEMFPLLUpdate(unsigned long ulCrossing, unsigned long ulSector);
+extern unsigned long BEMFPLLValid(void);
+extern unsigned long BEMFPLLPeriod(void);
+extern unsigned long BEMFPLLSpeed(void);
+extern unsigned long BEMFPLLCommutation(void);
+
+#endif // __BEMF_PLL_H__
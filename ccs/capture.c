@@ -0,0 +1,847 @@
+//*****************************************************************************
+//
+// capture.c - Input stream capture and replay routines.
+//
+//*****************************************************************************
+
+#include "inc/hw_ints.h"
+#include "inc/hw_nvic.h"
+#include "inc/hw_types.h"
+#include "driverlib/interrupt.h"
+#include "capture.h"
+#include "ui.h"
+
+//*****************************************************************************
+//
+//! \page capture_intro Introduction
+//!
+//! The capture module records the raw inputs that the motor control code
+//! consumes, so that a fault seen on a drive can be reproduced by feeding the
+//! same inputs back through the same interrupt handlers.  Three input streams
+//! are recorded, in the order in which they are consumed:
+//!
+//! - the raw samples of each ADC sequence zero interrupt, along with the time
+//!   of the interrupt;
+//! - the Hall sensor inputs and the time of each Hall sensor edge;
+//! - the handpiece stream frames assembled by the UART receive processor.
+//!
+//! The records are kept in a ring buffer, so that recording can be left
+//! running and the buffer holds the most recent inputs.  Recording is stopped
+//! as soon as a fault or warning is raised, so the buffer then holds the
+//! inputs that led up to it.  The recorded stream is read out, or a stream to
+//! be replayed is loaded, with the #CMD_CAPTURE command.
+//!
+//! During replay, each ADC interrupt handler takes its samples and time from
+//! the next ADC record in place of those read from the hardware.  Hall sensor
+//! edges and handpiece frames are delivered in their recorded position
+//! between the ADC records: a Hall sensor edge triggers the GPIO port B
+//! interrupt, in which the recorded inputs and time replace the live ones,
+//! and a frame is handed to the handpiece receive code in place of any live
+//! frame.  Live Hall sensor edges are ignored.  Replay stops when the ADC
+//! records run out.
+//!
+//! The ADC samples, and so everything computed from them, are replayed
+//! exactly in the host simulation build, which starts from the same state and
+//! schedules the interrupts identically.  A Hall sensor edge carries its
+//! recorded time, but is delivered at the end of the ADC interrupt that
+//! preceded it, so code that samples the Hall speed between the two (such as
+//! the millisecond tick) may see the new value up to one ADC period early.
+//! On the target, the inputs are fed back in the same sequence, but the
+//! interrupt timing is that of the live hardware.
+//!
+//! The code for capture and replay is contained in <tt>capture.c</tt>, with
+//! <tt>capture.h</tt> containing the definitions for the variables and
+//! functions exported to the remainder of the application.
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! \defgroup capture_api Definitions
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! The size of the capture buffer, in bytes.  This must be a power of two.
+//
+//*****************************************************************************
+#ifndef CAPTURE_BUFFER_SIZE
+#define CAPTURE_BUFFER_SIZE     32768
+#endif
+
+//*****************************************************************************
+//
+//! A position in the capture stream, used to step through the records of one
+//! type during replay.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The offset of the record header in the capture buffer.
+    //
+    unsigned long ulOffset;
+
+    //
+    //! The time of the record before this one.
+    //
+    unsigned long ulTime;
+}
+tCaptureCursor;
+
+//*****************************************************************************
+//
+//! The current capture mode, which is one of the \b CAPTURE_MODE_xxx values.
+//
+//*****************************************************************************
+unsigned long g_ulCaptureMode = CAPTURE_MODE_OFF;
+
+//*****************************************************************************
+//
+//! The buffer that holds the capture stream.
+//
+//*****************************************************************************
+static unsigned char g_pucCaptureBuffer[CAPTURE_BUFFER_SIZE];
+
+//*****************************************************************************
+//
+//! The offset at which the next byte is written to the capture buffer.  This
+//! and #g_ulCaptureTail count bytes from the start of the capture, and are
+//! reduced modulo the buffer size to index the buffer.
+//
+//*****************************************************************************
+static unsigned long g_ulCaptureHead;
+
+//*****************************************************************************
+//
+//! The offset of the oldest record in the capture buffer.
+//
+//*****************************************************************************
+static unsigned long g_ulCaptureTail;
+
+//*****************************************************************************
+//
+//! The time that the oldest record in the capture buffer is relative to.
+//
+//*****************************************************************************
+static unsigned long g_ulCaptureTailTime;
+
+//*****************************************************************************
+//
+//! The time of the newest record in the capture buffer.
+//
+//*****************************************************************************
+static unsigned long g_ulCaptureTime;
+
+//*****************************************************************************
+//
+//! The replay positions of the ADC, Hall sensor and handpiece frame records.
+//
+//*****************************************************************************
+static tCaptureCursor g_sCaptureADC;
+static tCaptureCursor g_sCaptureHall;
+static tCaptureCursor g_sCaptureFrame;
+
+//*****************************************************************************
+//
+//! A flag that is true when a replayed Hall sensor edge has triggered the GPIO
+//! port B interrupt and has not yet been taken by the handler.
+//
+//*****************************************************************************
+static tBoolean g_bCaptureHallPending;
+
+//*****************************************************************************
+//
+//! Returns a byte from the capture buffer.
+//!
+//! \param ulOffset is the offset of the byte.
+//!
+//! \return The byte at the given offset.
+//
+//*****************************************************************************
+static unsigned long
+CaptureByte(unsigned long ulOffset)
+{
+    return(g_pucCaptureBuffer[ulOffset & (CAPTURE_BUFFER_SIZE - 1)]);
+}
+
+//*****************************************************************************
+//
+//! Returns the time of the record at a given offset in the capture buffer.
+//!
+//! \param ulOffset is the offset of the record header.
+//! \param ulTime is the time of the previous record.
+//!
+//! \return The time of the record.
+//
+//*****************************************************************************
+static unsigned long
+CaptureRecordTime(unsigned long ulOffset, unsigned long ulTime)
+{
+    //
+    // A time record gives the absolute time in its payload.
+    //
+    if(CaptureByte(ulOffset) == CAPTURE_REC_TIME)
+    {
+        return(CaptureByte(ulOffset + 4) | (CaptureByte(ulOffset + 5) << 8) |
+               (CaptureByte(ulOffset + 6) << 16) |
+               (CaptureByte(ulOffset + 7) << 24));
+    }
+
+    //
+    // Any other record gives the time since the previous record.
+    //
+    return(ulTime + (CaptureByte(ulOffset + 2) |
+                     (CaptureByte(ulOffset + 3) << 8)));
+}
+
+//*****************************************************************************
+//
+//! Writes a record to the capture buffer.
+//!
+//! \param ulType is the record type; must be one of the \b CAPTURE_REC_xxx
+//! values.
+//! \param ulTime is the time of the record.
+//! \param pucData is a pointer to the payload of the record.
+//! \param ulLength is the number of bytes in the payload.
+//!
+//! The oldest records are discarded to make room for the new one.  This is
+//! called with interrupts disabled, so that records written by interrupt
+//! handlers of different priorities do not interleave.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+CaptureAppend(unsigned long ulType, unsigned long ulTime,
+              const unsigned char *pucData, unsigned long ulLength)
+{
+    unsigned long ulDelta, ulIdx;
+
+    //
+    // If the time since the previous record does not fit in the header, write
+    // a time record first.
+    //
+    ulDelta = ulTime - g_ulCaptureTime;
+    if((ulType != CAPTURE_REC_TIME) && (ulDelta > 0xffff))
+    {
+        unsigned char pucTime[4];
+
+        pucTime[0] = ulTime & 0xff;
+        pucTime[1] = (ulTime >> 8) & 0xff;
+        pucTime[2] = (ulTime >> 16) & 0xff;
+        pucTime[3] = (ulTime >> 24) & 0xff;
+        CaptureAppend(CAPTURE_REC_TIME, ulTime, pucTime, 4);
+        ulDelta = 0;
+    }
+
+    //
+    // Discard the oldest records until the new one fits.
+    //
+    while((g_ulCaptureHead - g_ulCaptureTail + CAPTURE_HEADER_SIZE +
+           ulLength) > CAPTURE_BUFFER_SIZE)
+    {
+        g_ulCaptureTailTime = CaptureRecordTime(g_ulCaptureTail,
+                                                g_ulCaptureTailTime);
+        g_ulCaptureTail += CAPTURE_HEADER_SIZE +
+                           CaptureByte(g_ulCaptureTail + 1);
+    }
+
+    //
+    // Write the record header.  The time in a time record's header is unused.
+    //
+    if(ulType == CAPTURE_REC_TIME)
+    {
+        ulDelta = 0;
+    }
+    g_pucCaptureBuffer[g_ulCaptureHead++ & (CAPTURE_BUFFER_SIZE - 1)] = ulType;
+    g_pucCaptureBuffer[g_ulCaptureHead++ & (CAPTURE_BUFFER_SIZE - 1)] =
+        ulLength;
+    g_pucCaptureBuffer[g_ulCaptureHead++ & (CAPTURE_BUFFER_SIZE - 1)] =
+        ulDelta & 0xff;
+    g_pucCaptureBuffer[g_ulCaptureHead++ & (CAPTURE_BUFFER_SIZE - 1)] =
+        ulDelta >> 8;
+
+    //
+    // Write the record payload.
+    //
+    for(ulIdx = 0; ulIdx < ulLength; ulIdx++)
+    {
+        g_pucCaptureBuffer[g_ulCaptureHead++ & (CAPTURE_BUFFER_SIZE - 1)] =
+            pucData[ulIdx];
+    }
+
+    //
+    // Save the time of this record.
+    //
+    g_ulCaptureTime = ulTime;
+}
+
+//*****************************************************************************
+//
+//! Writes a record to the capture buffer with interrupts disabled.
+//!
+//! \param ulType is the record type; must be one of the \b CAPTURE_REC_xxx
+//! values.
+//! \param ulTime is the time of the record.
+//! \param pucData is a pointer to the payload of the record.
+//! \param ulLength is the number of bytes in the payload.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+CaptureRecord(unsigned long ulType, unsigned long ulTime,
+              const unsigned char *pucData, unsigned long ulLength)
+{
+    tBoolean bDisabled;
+
+    bDisabled = IntMasterDisable();
+    if(g_ulCaptureMode == CAPTURE_MODE_RECORD)
+    {
+        CaptureAppend(ulType, ulTime, pucData, ulLength);
+    }
+    if(!bDisabled)
+    {
+        IntMasterEnable();
+    }
+}
+
+//*****************************************************************************
+//
+//! Finds the next record of a given type during replay.
+//!
+//! \param psCursor is the replay position to search from.
+//! \param ulType is the record type to find.
+//! \param pulTime is a pointer to the variable that receives the time of the
+//! record.
+//!
+//! The replay position is moved past any records of other types, and is left
+//! at the header of the record found.
+//!
+//! \return Returns \b true if a record was found and \b false if the end of
+//! the capture stream was reached.
+//
+//*****************************************************************************
+static tBoolean
+CaptureFind(tCaptureCursor *psCursor, unsigned long ulType,
+            unsigned long *pulTime)
+{
+    unsigned long ulTime;
+
+    //
+    // Loop through the remaining records.
+    //
+    while(psCursor->ulOffset != g_ulCaptureHead)
+    {
+        //
+        // Stop if this record is of the requested type.
+        //
+        ulTime = CaptureRecordTime(psCursor->ulOffset, psCursor->ulTime);
+        if(CaptureByte(psCursor->ulOffset) == ulType)
+        {
+            *pulTime = ulTime;
+            return(true);
+        }
+
+        //
+        // Skip this record.
+        //
+        psCursor->ulTime = ulTime;
+        psCursor->ulOffset += (CAPTURE_HEADER_SIZE +
+                               CaptureByte(psCursor->ulOffset + 1));
+    }
+
+    //
+    // The end of the capture stream was reached.
+    //
+    return(false);
+}
+
+//*****************************************************************************
+//
+//! Moves a replay position past the record found by CaptureFind().
+//!
+//! \param psCursor is the replay position.
+//! \param ulTime is the time of the record.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+CaptureConsume(tCaptureCursor *psCursor, unsigned long ulTime)
+{
+    psCursor->ulTime = ulTime;
+    psCursor->ulOffset += (CAPTURE_HEADER_SIZE +
+                           CaptureByte(psCursor->ulOffset + 1));
+}
+
+//*****************************************************************************
+//
+//! Determines if a record is due to be replayed.
+//!
+//! \param psCursor is the replay position of the record.
+//!
+//! A Hall sensor or handpiece frame record is due once all of the ADC records
+//! before it have been replayed.
+//!
+//! \return Returns \b true if the record is due.
+//
+//*****************************************************************************
+static tBoolean
+CaptureDue(tCaptureCursor *psCursor)
+{
+    return((long)(psCursor->ulOffset - g_sCaptureADC.ulOffset) < 0);
+}
+
+//*****************************************************************************
+//
+//! Records or replays the samples from an ADC interrupt.
+//!
+//! \param pulTime is a pointer to the time of the interrupt.
+//! \param pusData is a pointer to the samples read from the ADC.
+//! \param ulCount is the number of samples.
+//!
+//! This function is called by the ADC interrupt handler once it has read the
+//! samples from the ADC.  When recording, the samples and time are written to
+//! the capture stream.  When replaying, they are replaced by those from the
+//! next ADC record.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+CaptureADC(unsigned long *pulTime, unsigned short *pusData,
+           unsigned long ulCount)
+{
+    unsigned long ulTime, ulIdx;
+
+    //
+    // Record the samples.
+    //
+    if(g_ulCaptureMode == CAPTURE_MODE_RECORD)
+    {
+        CaptureRecord(CAPTURE_REC_ADC, *pulTime, (unsigned char *)pusData,
+                      ulCount * 2);
+    }
+
+    //
+    // Otherwise, replace the samples with the next recorded ones.
+    //
+    else if(g_ulCaptureMode == CAPTURE_MODE_REPLAY)
+    {
+        //
+        // Replay is complete when there are no more ADC records.
+        //
+        if(!CaptureFind(&g_sCaptureADC, CAPTURE_REC_ADC, &ulTime))
+        {
+            CaptureStop();
+            return;
+        }
+
+        //
+        // Copy the recorded samples and time.
+        //
+        for(ulIdx = 0;
+            (ulIdx < ulCount) &&
+            ((ulIdx * 2) < CaptureByte(g_sCaptureADC.ulOffset + 1));
+            ulIdx++)
+        {
+            pusData[ulIdx] =
+                (CaptureByte(g_sCaptureADC.ulOffset + CAPTURE_HEADER_SIZE +
+                             (ulIdx * 2)) |
+                 (CaptureByte(g_sCaptureADC.ulOffset + CAPTURE_HEADER_SIZE +
+                              (ulIdx * 2) + 1) << 8));
+        }
+        *pulTime = ulTime;
+
+        //
+        // Move on to the next ADC record, so that the Hall sensor and frame
+        // records before it become due.
+        //
+        CaptureConsume(&g_sCaptureADC, ulTime);
+        CaptureFind(&g_sCaptureADC, CAPTURE_REC_ADC, &ulTime);
+    }
+}
+
+//*****************************************************************************
+//
+//! Records or replays a Hall sensor edge.
+//!
+//! \param pulTime is a pointer to the time of the edge.
+//! \param pulValue is a pointer to the state of the Hall sensor inputs.
+//!
+//! This function is called by the GPIO port B interrupt handler once it has
+//! read the Hall sensor inputs.  When recording, the inputs and time are
+//! written to the capture stream.  When replaying, they are replaced by those
+//! from the Hall sensor record that triggered the interrupt.
+//!
+//! \return Returns \b false if the edge should be ignored, which is the case
+//! for a live edge during replay, and \b true otherwise.
+//
+//*****************************************************************************
+tBoolean
+CaptureHall(unsigned long *pulTime, unsigned long *pulValue)
+{
+    unsigned long ulTime;
+    unsigned char ucValue;
+
+    //
+    // Record the edge.
+    //
+    if(g_ulCaptureMode == CAPTURE_MODE_RECORD)
+    {
+        ucValue = *pulValue;
+        CaptureRecord(CAPTURE_REC_HALL, *pulTime, &ucValue, 1);
+    }
+
+    //
+    // Otherwise, see if the edge is being replayed.
+    //
+    else if(g_ulCaptureMode == CAPTURE_MODE_REPLAY)
+    {
+        //
+        // Ignore a live edge.
+        //
+        if(!g_bCaptureHallPending)
+        {
+            return(false);
+        }
+        g_bCaptureHallPending = false;
+
+        //
+        // Replace the inputs and time with the recorded ones.
+        //
+        if(CaptureFind(&g_sCaptureHall, CAPTURE_REC_HALL, &ulTime))
+        {
+            *pulValue = CaptureByte(g_sCaptureHall.ulOffset +
+                                    CAPTURE_HEADER_SIZE);
+            *pulTime = ulTime;
+            CaptureConsume(&g_sCaptureHall, ulTime);
+        }
+    }
+
+    //
+    // Process the edge.
+    //
+    return(true);
+}
+
+//*****************************************************************************
+//
+//! Records or replays a handpiece stream frame.
+//!
+//! \param pucFrame is a pointer to the frame buffer.
+//! \param pulLength is a pointer to the length of the frame.
+//! \param ulMaxLength is the size of the frame buffer.
+//! \param bReceived is \b true if a live frame was received into the buffer.
+//!
+//! This function is called by the handpiece receive code when it checks for
+//! a stream frame.  When recording, a received frame is written to the
+//! capture stream.  When replaying, the live frame is dropped and the next
+//! recorded frame is placed in the buffer once it is due.
+//!
+//! \return Returns \b true if there is a frame in the buffer to process.
+//
+//*****************************************************************************
+tBoolean
+CaptureFrame(unsigned char *pucFrame, unsigned long *pulLength,
+             unsigned long ulMaxLength, tBoolean bReceived)
+{
+    unsigned long ulTime, ulIdx;
+
+    //
+    // Record the frame.
+    //
+    if(g_ulCaptureMode == CAPTURE_MODE_RECORD)
+    {
+        if(bReceived)
+        {
+            CaptureRecord(CAPTURE_REC_FRAME, UIGetTicks(), pucFrame,
+                          *pulLength);
+        }
+    }
+
+    //
+    // Otherwise, substitute the next recorded frame if it is due.
+    //
+    else if(g_ulCaptureMode == CAPTURE_MODE_REPLAY)
+    {
+        if(!CaptureFind(&g_sCaptureFrame, CAPTURE_REC_FRAME, &ulTime) ||
+           !CaptureDue(&g_sCaptureFrame))
+        {
+            return(false);
+        }
+        *pulLength = CaptureByte(g_sCaptureFrame.ulOffset + 1);
+        if(*pulLength > ulMaxLength)
+        {
+            *pulLength = ulMaxLength;
+        }
+        for(ulIdx = 0; ulIdx < *pulLength; ulIdx++)
+        {
+            pucFrame[ulIdx] = CaptureByte(g_sCaptureFrame.ulOffset +
+                                          CAPTURE_HEADER_SIZE + ulIdx);
+        }
+        CaptureConsume(&g_sCaptureFrame, ulTime);
+        return(true);
+    }
+
+    //
+    // Pass the live frame through.
+    //
+    return(bReceived);
+}
+
+//*****************************************************************************
+//
+//! Triggers the replay of Hall sensor edges.
+//!
+//! This function is called at the end of the ADC interrupt handler.  If the
+//! next recorded Hall sensor edge is due, the GPIO port B interrupt is
+//! triggered to process it.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+CaptureReplayTick(void)
+{
+    unsigned long ulTime;
+
+    //
+    // Nothing to do unless replaying, and the previous edge has been taken.
+    //
+    if((g_ulCaptureMode != CAPTURE_MODE_REPLAY) || g_bCaptureHallPending)
+    {
+        return;
+    }
+
+    //
+    // Trigger the Hall sensor interrupt if the next edge is due.
+    //
+    if(CaptureFind(&g_sCaptureHall, CAPTURE_REC_HALL, &ulTime) &&
+       CaptureDue(&g_sCaptureHall))
+    {
+        g_bCaptureHallPending = true;
+        HWREG(NVIC_SW_TRIG) = INT_GPIOB - 16;
+    }
+}
+
+//*****************************************************************************
+//
+//! Starts recording or replaying the input streams.
+//!
+//! \param ulMode is the capture mode to start; must be #CAPTURE_MODE_RECORD
+//! or #CAPTURE_MODE_REPLAY.
+//!
+//! Starting to record discards the contents of the capture buffer.  Replay
+//! starts from the oldest record in the capture buffer.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+CaptureStart(unsigned long ulMode)
+{
+    tBoolean bDisabled;
+
+    bDisabled = IntMasterDisable();
+
+    //
+    // Empty the capture buffer if recording.
+    //
+    if(ulMode == CAPTURE_MODE_RECORD)
+    {
+        g_ulCaptureHead = 0;
+        g_ulCaptureTail = 0;
+        g_ulCaptureTailTime = UIGetTicks();
+        g_ulCaptureTime = g_ulCaptureTailTime;
+    }
+
+    //
+    // Start each of the replay positions at the oldest record if replaying.
+    //
+    else if(ulMode == CAPTURE_MODE_REPLAY)
+    {
+        g_sCaptureADC.ulOffset = g_ulCaptureTail;
+        g_sCaptureADC.ulTime = g_ulCaptureTailTime;
+        g_sCaptureHall = g_sCaptureADC;
+        g_sCaptureFrame = g_sCaptureADC;
+        g_bCaptureHallPending = false;
+    }
+
+    //
+    // Set the new mode.
+    //
+    g_ulCaptureMode = ulMode;
+
+    if(!bDisabled)
+    {
+        IntMasterEnable();
+    }
+}
+
+//*****************************************************************************
+//
+//! Stops recording or replaying the input streams.
+//!
+//! The contents of the capture buffer are left intact, so that they can be
+//! read or replayed.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+CaptureStop(void)
+{
+    g_ulCaptureMode = CAPTURE_MODE_OFF;
+}
+
+//*****************************************************************************
+//
+//! Returns the length of the capture stream.
+//!
+//! The capture stream, as returned by CaptureRead(), starts with a time
+//! record giving the time that the oldest record is relative to, followed by
+//! the records in the capture buffer.
+//!
+//! \return The number of bytes in the capture stream, or zero if the capture
+//! buffer is empty.
+//
+//*****************************************************************************
+unsigned long
+CaptureLength(void)
+{
+    if(g_ulCaptureHead == g_ulCaptureTail)
+    {
+        return(0);
+    }
+    return(CAPTURE_HEADER_SIZE + 4 + g_ulCaptureHead - g_ulCaptureTail);
+}
+
+//*****************************************************************************
+//
+//! Reads from the capture stream.
+//!
+//! \param ulOffset is the offset into the capture stream to read from.
+//! \param pucData is a pointer to the buffer that receives the data.
+//! \param ulCount is the number of bytes to read.
+//!
+//! This function should only be called while capture is stopped.
+//!
+//! \return The number of bytes read, which is less than requested if the end
+//! of the capture stream is reached.
+//
+//*****************************************************************************
+unsigned long
+CaptureRead(unsigned long ulOffset, unsigned char *pucData,
+            unsigned long ulCount)
+{
+    unsigned long ulIdx, ulLength;
+
+    //
+    // Loop through the bytes to be read.
+    //
+    ulLength = CaptureLength();
+    for(ulIdx = 0; (ulIdx < ulCount) && (ulOffset < ulLength);
+        ulIdx++, ulOffset++)
+    {
+        //
+        // The stream starts with a time record giving the base time of the
+        // oldest record in the buffer.
+        //
+        if(ulOffset < 4)
+        {
+            pucData[ulIdx] = (ulOffset == 1) ? 4 : 0;
+        }
+        else if(ulOffset < 8)
+        {
+            pucData[ulIdx] = (g_ulCaptureTailTime >> ((ulOffset - 4) * 8)) &
+                             0xff;
+        }
+
+        //
+        // The remainder of the stream comes from the buffer.
+        //
+        else
+        {
+            pucData[ulIdx] = CaptureByte(g_ulCaptureTail + ulOffset - 8);
+        }
+    }
+
+    //
+    // Return the number of bytes read.
+    //
+    return(ulIdx);
+}
+
+//*****************************************************************************
+//
+//! Writes to the capture stream, to load a stream for replay.
+//!
+//! \param ulOffset is the offset into the capture stream to write to.
+//! \param pucData is a pointer to the data to write.
+//! \param ulCount is the number of bytes to write.
+//!
+//! A stream is loaded by writing it in order, starting at offset zero; a
+//! write at offset zero discards the contents of the capture buffer.  Capture
+//! is stopped by this function.
+//!
+//! \return The number of bytes written, which is zero if the offset is not
+//! the end of the stream loaded so far and less than requested if the
+//! capture buffer is full.
+//
+//*****************************************************************************
+unsigned long
+CaptureWrite(unsigned long ulOffset, const unsigned char *pucData,
+             unsigned long ulCount)
+{
+    unsigned long ulIdx;
+
+    //
+    // Stop any capture in progress.
+    //
+    CaptureStop();
+
+    //
+    // Start a new stream if writing at the start.
+    //
+    if(ulOffset == 0)
+    {
+        g_ulCaptureHead = 0;
+        g_ulCaptureTail = 0;
+        g_ulCaptureTailTime = 0;
+    }
+
+    //
+    // Only sequential writes are supported.
+    //
+    if(ulOffset != g_ulCaptureHead)
+    {
+        return(0);
+    }
+
+    //
+    // Copy the data into the buffer while there is room.
+    //
+    for(ulIdx = 0;
+        (ulIdx < ulCount) && (g_ulCaptureHead < CAPTURE_BUFFER_SIZE);
+        ulIdx++)
+    {
+        g_pucCaptureBuffer[g_ulCaptureHead++] = pucData[ulIdx];
+    }
+
+    //
+    // Return the number of bytes written.
+    //
+    return(ulIdx);
+}
+
+//*****************************************************************************
+//
+// Close the Doxygen group.
+//! @}
+//
+//*****************************************************************************
@@ -0,0 +1,93 @@
+//*****************************************************************************
+//
+// capture.h - Prototypes for the input stream capture and replay routines.
+//
+//*****************************************************************************
+
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+//*****************************************************************************
+//
+//! \addtogroup capture_api
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! The input streams are neither recorded nor replayed.
+//
+//*****************************************************************************
+#define CAPTURE_MODE_OFF        0
+
+//*****************************************************************************
+//
+//! The input streams are being recorded into the capture buffer.
+//
+//*****************************************************************************
+#define CAPTURE_MODE_RECORD     1
+
+//*****************************************************************************
+//
+//! The input streams are being replayed from the capture buffer.
+//
+//*****************************************************************************
+#define CAPTURE_MODE_REPLAY     2
+
+//*****************************************************************************
+//
+//! The record types in the capture stream.  Each record starts with a four
+//! byte header: the record type, the number of payload bytes that follow the
+//! header, and the 16-bit time since the previous record in system clocks.
+//!
+//! - #CAPTURE_REC_TIME sets the absolute time, in the 32-bit payload, for
+//!   when the time since the previous record does not fit in 16 bits.
+//! - #CAPTURE_REC_ADC holds the raw samples read from ADC sequence zero.
+//! - #CAPTURE_REC_HALL holds the state of the Hall sensor inputs at an edge.
+//! - #CAPTURE_REC_FRAME holds a handpiece stream frame, including its header
+//!   and checksum.
+//
+//*****************************************************************************
+#define CAPTURE_REC_TIME        0
+#define CAPTURE_REC_ADC         1
+#define CAPTURE_REC_HALL        2
+#define CAPTURE_REC_FRAME       3
+
+//*****************************************************************************
+//
+//! The size of a capture record header.
+//
+//*****************************************************************************
+#define CAPTURE_HEADER_SIZE     4
+
+//*****************************************************************************
+//
+// Close the Doxygen group.
+//! @}
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+// Prototypes for the exported variables and functions.
+//
+//*****************************************************************************
+extern unsigned long g_ulCaptureMode;
+extern void CaptureADC(unsigned long *pulTime, unsigned short *pusData,
+                       unsigned long ulCount);
+extern tBoolean CaptureHall(unsigned long *pulTime, unsigned long *pulValue);
+extern tBoolean CaptureFrame(unsigned char *pucFrame, unsigned long *pulLength,
+                             unsigned long ulMaxLength, tBoolean bReceived);
+extern void CaptureReplayTick(void);
+extern void CaptureStart(unsigned long ulMode);
+extern void CaptureStop(void);
+extern unsigned long CaptureLength(void);
+extern unsigned long CaptureRead(unsigned long ulOffset,
+                                 unsigned char *pucData,
+                                 unsigned long ulCount);
+extern unsigned long CaptureWrite(unsigned long ulOffset,
+                                  const unsigned char *pucData,
+                                  unsigned long ulCount);
+
+#endif // __CAPTURE_H__
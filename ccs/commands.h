@@ -64,6 +64,27 @@
 //*****************************************************************************
 #define TAG_RDONLY       0xfb
 
+//*****************************************************************************
+//
+//! The value of the <tt>{tag}</tt> byte for a batched real-time data packet,
+//! which carries consecutive millisecond samples of the enabled real-time
+//! data items.
+//!
+//! \verbatim
+//!     TAG_DATA_BATCH {length} {count} {time} {sample} [{sample} ...]
+//!         {checksum}
+//! \endverbatim
+//!
+//! - <tt>{count}</tt> is the number of samples in the packet.
+//! - <tt>{time}</tt> is the millisecond at which the first sample was taken,
+//!   counted from the start of the batched stream, as a 32-bit value.  The
+//!   following samples were taken in the following milliseconds.
+//! - <tt>{sample}</tt> is the value of each enabled real-time data item, in
+//!   the same order as in a #TAG_DATA packet.
+//
+//*****************************************************************************
+#define TAG_DATA_BATCH   0xfa
+
 //*****************************************************************************
 //
 //! This command is used to determine the type of motor driven by the board.
@@ -419,6 +440,255 @@
 //*****************************************************************************
 #define CMD_STOP_DATA_STREAM    0x24
 
+//*****************************************************************************
+//
+//! Resets the interrupt handler execution profile.  The minimum, maximum,
+//! mean and call count reported by the \b DATA_ISR_PROFILE_xxx real-time data
+//! items are cleared, so that a new measurement can be started.
+//!
+//! <i>Command:</i>
+//! \verbatim
+//!     TAG_CMD 0x04 CMD_RESET_ISR_PROFILE {checksum}
+//! \endverbatim
+//!
+//! <i>Response:</i>
+//! \verbatim
+//!     TAG_STATUS 0x04 CMD_RESET_ISR_PROFILE {checksum}
+//! \endverbatim
+//
+//*****************************************************************************
+#define CMD_RESET_ISR_PROFILE   0x25
+
+//*****************************************************************************
+//
+//! Controls the capture and replay of the motor control inputs.  The
+//! operation to perform is given by {op}, which is one of the
+//! \b CAPTURE_OP_xxx values, followed by any data for the operation.
+//!
+//! <i>Command:</i>
+//! \verbatim
+//!     TAG_CMD {length} CMD_CAPTURE {op} [{data} ...] {checksum}
+//! \endverbatim
+//!
+//! <i>Response:</i>
+//! \verbatim
+//!     TAG_STATUS {length} CMD_CAPTURE [{data} ...] {checksum}
+//! \endverbatim
+//!
+//! - <tt>{op}</tt> is the operation to perform.
+//! - <tt>{data}</tt> is the data for the operation, or returned by it, as
+//!   described for each of the \b CAPTURE_OP_xxx values.
+//
+//*****************************************************************************
+#define CMD_CAPTURE             0x26
+
+//*****************************************************************************
+//
+//! Starts the batched real-time data output stream, which samples the
+//! real-time data items that have been added to the output stream every
+//! millisecond, and sends the samples in #TAG_DATA_BATCH packets.  This
+//! replaces the stream started by #CMD_START_DATA_STREAM, and is stopped by
+//! #CMD_STOP_DATA_STREAM.
+//!
+//! <i>Command:</i>
+//! \verbatim
+//!     TAG_CMD 0x05 CMD_START_DATA_BATCH {samples} {checksum}
+//! \endverbatim
+//!
+//! <i>Response:</i>
+//! \verbatim
+//!     TAG_STATUS 0x05 CMD_START_DATA_BATCH {samples} {checksum}
+//! \endverbatim
+//!
+//! - <tt>{samples}</tt> is the number of samples to send in each packet, or
+//!   zero for as many as fit.  The response gives the number that will be
+//!   sent, which is zero if no real-time data items are enabled.
+//
+//*****************************************************************************
+#define CMD_START_DATA_BATCH    0x27
+
+//*****************************************************************************
+//
+//! Starts the batched real-time data output stream, as #CMD_START_DATA_BATCH
+//! does, but sends the #TAG_DATA_BATCH packets as UDP datagrams to the given
+//! host and port instead of on the TCP connection, which is then left for
+//! commands and their responses.  The stream is stopped by
+//! #CMD_STOP_DATA_STREAM, or replaced by starting either of the other
+//! streams.
+//!
+//! <i>Command:</i>
+//! \verbatim
+//!     TAG_CMD 0x0b CMD_START_DATA_UDP {samples} {port} {ip} {checksum}
+//! \endverbatim
+//!
+//! <i>Response:</i>
+//! \verbatim
+//!     TAG_STATUS 0x05 CMD_START_DATA_UDP {samples} {checksum}
+//! \endverbatim
+//!
+//! - <tt>{samples}</tt> is the number of samples to send in each packet, or
+//!   zero for as many as fit.  The response gives the number that will be
+//!   sent, which is zero if no real-time data items are enabled or the port
+//!   is zero.
+//! - <tt>{port}</tt> is the UDP port to send to, as a 16-bit value.
+//! - <tt>{ip}</tt> is the IP address to send to, most significant octet
+//!   first, or zero for the host of the TCP connection.
+//!
+//! Each datagram holds a 32-bit sequence number, which starts at zero and
+//! counts every packet taken from the capture, followed by one complete
+//! #TAG_DATA_BATCH packet:
+//!
+//! \verbatim
+//!     {sequence} TAG_DATA_BATCH {length} {count} {time} {sample} ...
+//!         {checksum}
+//! \endverbatim
+//!
+//! A datagram that is lost, or could not be sent, is not sent again; the host
+//! finds the loss from a gap in the sequence numbers, and the samples lost
+//! from the gap in <tt>{time}</tt>.
+//
+//*****************************************************************************
+#define CMD_START_DATA_UDP      0x28
+
+//*****************************************************************************
+//
+//! Controls the scope, which captures the raw ADC samples of each PWM period
+//! around a trigger.  The operation to perform is given by {op}, which is one
+//! of the \b SCOPE_OP_xxx values, followed by any data for the operation.
+//!
+//! <i>Command:</i>
+//! \verbatim
+//!     TAG_CMD {length} CMD_SCOPE {op} [{data} ...] {checksum}
+//! \endverbatim
+//!
+//! <i>Response:</i>
+//! \verbatim
+//!     TAG_STATUS {length} CMD_SCOPE [{data} ...] {checksum}
+//! \endverbatim
+//!
+//! - <tt>{op}</tt> is the operation to perform.
+//! - <tt>{data}</tt> is the data for the operation, or returned by it, as
+//!   described for each of the \b SCOPE_OP_xxx values.
+//
+//*****************************************************************************
+#define CMD_SCOPE               0x29
+
+//*****************************************************************************
+//
+//! The #CMD_CAPTURE operation to read the capture status.  There is no data
+//! for the command; the response data is the capture mode (0 for off, 1 for
+//! recording and 2 for replaying) followed by the length of the capture
+//! stream as a 32-bit value.
+//
+//*****************************************************************************
+#define CAPTURE_OP_STATUS       0x00
+
+//*****************************************************************************
+//
+//! The #CMD_CAPTURE operation to start recording the inputs.  There is no data
+//! for the command or the response.  Recording stops on its own when a fault
+//! or warning is raised.
+//
+//*****************************************************************************
+#define CAPTURE_OP_RECORD       0x01
+
+//*****************************************************************************
+//
+//! The #CMD_CAPTURE operation to start replaying the inputs from the capture
+//! stream.  There is no data for the command or the response.
+//
+//*****************************************************************************
+#define CAPTURE_OP_REPLAY       0x02
+
+//*****************************************************************************
+//
+//! The #CMD_CAPTURE operation to stop recording or replaying.  There is no data
+//! for the command or the response.
+//
+//*****************************************************************************
+#define CAPTURE_OP_STOP         0x03
+
+//*****************************************************************************
+//
+//! The #CMD_CAPTURE operation to read the capture stream.  The command data is
+//! the 32-bit offset to read from followed by the 8-bit number of bytes to
+//! read; the response data is the bytes read, which is fewer than requested
+//! at the end of the stream.
+//
+//*****************************************************************************
+#define CAPTURE_OP_READ         0x04
+
+//*****************************************************************************
+//
+//! The #CMD_CAPTURE operation to load a capture stream for replay.  The
+//! command data is the 32-bit offset to write to followed by the bytes to
+//! write; the response data is the 8-bit number of bytes written.  A stream
+//! must be written in order from offset zero.
+//
+//*****************************************************************************
+#define CAPTURE_OP_WRITE        0x05
+
+//*****************************************************************************
+//
+//! The #CMD_SCOPE operation to read the scope status.  There is no data for
+//! the command; the response data is the scope state (one of the
+//! \b SCOPE_STATE_xxx values), the 8-bit bit mask of the captured channels,
+//! the 16-bit number of records in the capture (zero until it is done) and
+//! the 16-bit number of those records from before the trigger.
+//
+//*****************************************************************************
+#define SCOPE_OP_STATUS         0x00
+
+//*****************************************************************************
+//
+//! The #CMD_SCOPE operation to arm the scope, discarding any previous
+//! capture.  The command data is:
+//!
+//! - the 8-bit bit mask of the channels to capture, where bit zero to three
+//!   are the Back EMF, phase current, bus voltage and ambient temperature
+//!   samples (the phase A current, phase B current, bus voltage and ambient
+//!   temperature samples under field-oriented control);
+//! - the 8-bit number of PWM periods for each record;
+//! - the 8-bit trigger source, which is one of the \b SCOPE_TRIG_xxx values;
+//! - the 8-bit channel for a level trigger;
+//! - the 32-bit level for a level trigger, or the fault flags for a fault
+//!   trigger;
+//! - the 16-bit number of records to keep from before the trigger.
+//!
+//! The response data is the 16-bit number of records that the capture will
+//! hold, which is zero if the scope could not be armed.  The scope can not be
+//! armed under sine modulation.
+//
+//*****************************************************************************
+#define SCOPE_OP_ARM            0x01
+
+//*****************************************************************************
+//
+//! The #CMD_SCOPE operation to trigger the scope by hand, whatever its
+//! trigger source.  There is no data for the command or the response.
+//
+//*****************************************************************************
+#define SCOPE_OP_TRIGGER        0x02
+
+//*****************************************************************************
+//
+//! The #CMD_SCOPE operation to stop the scope and discard its capture.  There
+//! is no data for the command or the response.
+//
+//*****************************************************************************
+#define SCOPE_OP_STOP           0x03
+
+//*****************************************************************************
+//
+//! The #CMD_SCOPE operation to read the capture.  The command data is the
+//! 32-bit offset to read from followed by the 8-bit number of bytes to read;
+//! the response data is the bytes read, which is fewer than requested at the
+//! end of the capture.  The capture is the records in order from the oldest,
+//! each holding the captured channels in order as 16-bit values.
+//
+//*****************************************************************************
+#define SCOPE_OP_READ           0x04
+
 //*****************************************************************************
 //
 //! Starts the motor running based on the current parameter set, if it is
@@ -539,7 +809,10 @@
 
 //*****************************************************************************
 //
-//! Specifies the target position of the motor.
+//! Specifies the target position of the motor.  This is a 16-bit value
+//! providing the mechanical angle in tenths of a degree, from 0 to 3599.  In
+//! position control mode, a running motor drive moves to and then holds the
+//! target position; a change of the target position starts a new move.
 //
 //*****************************************************************************
 #define PARAM_TARGET_POS        0x08
@@ -547,7 +820,10 @@
 //*****************************************************************************
 //
 //! Contains the current position of the motor.  This is a read-only value
-//! and matches the corresponding real-time data item.
+//! and matches the corresponding real-time data item.  It is a 16-bit value
+//! providing the mechanical angle in tenths of a degree, measured from the
+//! encoder index if an encoder is present, or else from the position at
+//! which the Hall sensors were first seen.
 //
 //*****************************************************************************
 #define PARAM_CURRENT_POS       0x09
@@ -732,7 +1008,10 @@
 
 //*****************************************************************************
 //
-//! Specifies whether DC bus voltage compensation should be performed.
+//! Specifies whether DC bus voltage compensation should be performed.  When
+//! enabled, the drive voltage is converted into a duty cycle at the measured
+//! DC bus voltage; otherwise, at the bus voltage when the motor drive
+//! started.  This is an 8-bit boolean value.
 //
 //*****************************************************************************
 #define PARAM_USE_BUS_COMP      0x20
@@ -746,7 +1025,10 @@
 
 //*****************************************************************************
 //
-//! Specifies the motor control mode.
+//! Specifies the motor control mode.  This is an 8-bit value; one of
+//! CONTROL_TYPE_NORMAL, CONTROL_TYPE_OVERRIDE, CONTROL_TYPE_POWER or
+//! CONTROL_TYPE_POSITION.  The control mode can only be changed while the
+//! motor is stopped.
 //
 //*****************************************************************************
 #define PARAM_CONTROL_MODE      0x22
@@ -1004,7 +1286,8 @@
 
 //*****************************************************************************
 //
-//! Specifies the target power supplied to the motor when operating.
+//! Specifies the target power supplied to the motor when operating in power
+//! control mode.  This is a 32-bit value in milliwatts.
 //
 //*****************************************************************************
 #define PARAM_TARGET_POWER      0x44
@@ -1132,6 +1415,184 @@
 
 #define PARAM_HP_RESET          0x54
 
+//*****************************************************************************
+//
+//! Specifies the P coefficient for the PI controllers used to adjust the d
+//! and q axis motor currents to track to the requested currents when using
+//! field-oriented control.  This is a 16.16 fixed-point value in millivolts
+//! per milliamp.
+//
+//*****************************************************************************
+#define PARAM_FOC_CURRENT_P     0x55
+
+//*****************************************************************************
+//
+//! Specifies the I coefficient for the PI controllers used to adjust the d
+//! and q axis motor currents to track to the requested currents when using
+//! field-oriented control.  This is a 16.16 fixed-point value in millivolts
+//! per milliamp per PWM period.
+//
+//*****************************************************************************
+#define PARAM_FOC_CURRENT_I     0x68
+
+//*****************************************************************************
+//
+//! Specifies the closed-loop bandwidth of the motor current controller, which
+//! runs on each ADC sample beneath the speed controller.  This is a 16-bit
+//! value specifying the bandwidth in Hz.
+//
+//*****************************************************************************
+#define PARAM_CURRENT_BW        0x57
+
+//*****************************************************************************
+//
+//! Specifies the line-to-line resistance of the motor, used to compute the
+//! gains of the motor current controller.  This is a 16-bit value specifying
+//! the resistance in milliohms.
+//
+//*****************************************************************************
+#define PARAM_MOTOR_RESISTANCE  0x58
+
+//*****************************************************************************
+//
+//! Specifies the line-to-line inductance of the motor, used to compute the
+//! gains of the motor current controller.  This is a 16-bit value specifying
+//! the inductance in microhenries.
+//
+//*****************************************************************************
+#define PARAM_MOTOR_INDUCTANCE  0x59
+
+//*****************************************************************************
+//
+//! Specifies the hysteresis applied to the Back EMF zero-crossing threshold
+//! when running sensorless.  The Back EMF must move this far past one half of
+//! the bus voltage before a zero-crossing is accepted.  This is a 16-bit
+//! value specifying the hysteresis in ADC counts.
+//
+//*****************************************************************************
+#define PARAM_BEMF_HYSTERESIS   0x5A
+
+//*****************************************************************************
+//
+//! Specifies the latency from the Back EMF sample to the ADC interrupt when
+//! running sensorless, which is removed from the interpolated zero-crossing
+//! time.  This is a 16-bit value specifying the latency in system clocks.
+//
+//*****************************************************************************
+#define PARAM_BEMF_LATENCY      0x5B
+
+//*****************************************************************************
+//
+//! Specifies the number of breakpoints in use in the speed controller gain
+//! schedule.  The P, I and anti-windup coefficients of the speed controller
+//! are interpolated between the breakpoints that bracket the target speed.
+//! When zero, the #PARAM_SPEED_P and #PARAM_SPEED_I coefficients are used at
+//! all speeds.  This is an 8-bit value.
+//
+//*****************************************************************************
+#define PARAM_GAIN_POINTS       0x5C
+
+//*****************************************************************************
+//
+//! Selects the breakpoint of the speed controller gain schedule that is
+//! accessed by #PARAM_GAIN_SPEED, #PARAM_GAIN_P, #PARAM_GAIN_I and
+//! #PARAM_GAIN_AW.  This is an 8-bit value.
+//
+//*****************************************************************************
+#define PARAM_GAIN_INDEX        0x5D
+
+//*****************************************************************************
+//
+//! Specifies the speed of the selected gain schedule breakpoint.  The
+//! breakpoints must be in ascending order of speed.  This is a 16-bit value
+//! specifying the speed in RPM.
+//
+//*****************************************************************************
+#define PARAM_GAIN_SPEED        0x5E
+
+//*****************************************************************************
+//
+//! Specifies the P coefficient of the speed controller at the selected gain
+//! schedule breakpoint.  This is a 32-bit 16.16 fixed-point value.
+//
+//*****************************************************************************
+#define PARAM_GAIN_P            0x5F
+
+//*****************************************************************************
+//
+//! Specifies the I coefficient of the speed controller at the selected gain
+//! schedule breakpoint.  This is a 32-bit 16.16 fixed-point value.
+//
+//*****************************************************************************
+#define PARAM_GAIN_I            0x60
+
+//*****************************************************************************
+//
+//! Specifies the anti-windup coefficient of the speed controller at the
+//! selected gain schedule breakpoint.  This is the fraction of the excess
+//! output, when the output saturates, that is carried into the next update.
+//! This is a 32-bit 16.16 fixed-point value.
+//
+//*****************************************************************************
+#define PARAM_GAIN_AW           0x61
+
+//*****************************************************************************
+//
+//! Specifies the speed constant of the motor, used by the velocity
+//! feed-forward term of the speed controller.  This is a 16-bit value in RPM
+//! per volt; zero disables the velocity feed-forward term.
+//
+//*****************************************************************************
+#define PARAM_MOTOR_KV          0x62
+
+//*****************************************************************************
+//
+//! Specifies the acceleration feed-forward gain of the speed controller.
+//! This is a 16-bit value in milliamperes per 1000 RPM per second of
+//! commanded acceleration; zero disables the acceleration feed-forward term.
+//
+//*****************************************************************************
+#define PARAM_SPEED_FF_ACCEL    0x63
+
+//*****************************************************************************
+//
+//! Specifies the number of lines of the quadrature encoder, which provides
+//! four counts per line.  This is a 16-bit value; it is used when
+//! #PARAM_ENCODER_PRESENT is set.
+//
+//*****************************************************************************
+#define PARAM_ENCODER_LINES     0x64
+
+//*****************************************************************************
+//
+//! Specifies the jerk rate of the S-curve speed trajectory that shapes the
+//! target speed.  This is a 16-bit value giving the change in the
+//! acceleration rate, in RPM per second, each millisecond; zero ramps the
+//! speed at a constant acceleration or deceleration rate instead.
+//
+//*****************************************************************************
+#define PARAM_SPEED_JERK        0x65
+
+//*****************************************************************************
+//
+//! Specifies the baud rate that the handpiece link is moved to when a
+//! handpiece that supports it is connected.  This is an 8-bit value; 0 is
+//! 115,200 baud, 1 is 460,800 baud, and 2 is 921,600 baud.  The default is
+//! 0, which, along with a stream rate of zero, does not send the link
+//! settings to the handpiece at all.
+//
+//*****************************************************************************
+#define PARAM_HP_BAUD           0x66
+
+//*****************************************************************************
+//
+//! Specifies the rate at which a handpiece that supports it streams the
+//! trigger.  This is a 16-bit value in frames per second; zero, the default,
+//! leaves the handpiece at its own default rate.
+//
+//*****************************************************************************
+#define PARAM_HP_STREAM_RATE    0x67
+
 //*****************************************************************************
 //
 //! This real-time data item provides the current through phase A of the motor.
@@ -1170,7 +1631,8 @@
 
 //*****************************************************************************
 //
-//! This real-time data item provides the position of the motor.
+//! This real-time data item provides the position of the motor.  This is a
+//! 16-bit value providing the mechanical angle in tenths of a degree.
 //
 //*****************************************************************************
 #define DATA_MOTOR_POSITION     0x05
@@ -1279,11 +1741,173 @@
 //*****************************************************************************
 #define DATA_ROTOR_SPEED_CMD    0x12
 
+//*****************************************************************************
+//
+//! This real-time data item provides the execution profile of the ADC
+//! sequence zero interrupt handler.  This is four 32-bit values: the minimum,
+//! maximum and mean execution time in system clocks, followed by the number
+//! of times the handler has run.  The minimum, maximum and count are since
+//! the last #CMD_RESET_ISR_PROFILE, while the mean is over the most recent
+//! user interface tick.  The minimum is 0xffffffff if the handler has not
+//! run.
+//
+//*****************************************************************************
+#define DATA_ISR_PROFILE_ADC    0x13
+
+//*****************************************************************************
+//
+//! This real-time data item provides the execution profile of the PWM
+//! generator zero interrupt handler, in the same format as
+//! #DATA_ISR_PROFILE_ADC.
+//
+//*****************************************************************************
+#define DATA_ISR_PROFILE_PWM    0x14
+
+//*****************************************************************************
+//
+//! This real-time data item provides the execution profile of the millisecond
+//! tick (PWM generator two) interrupt handler, in the same format as
+//! #DATA_ISR_PROFILE_ADC.
+//
+//*****************************************************************************
+#define DATA_ISR_PROFILE_MS_TICK 0x15
+
+//*****************************************************************************
+//
+//! This real-time data item provides the execution profile of the Hall
+//! sensor (GPIO port B) interrupt handler, in the same format as
+//! #DATA_ISR_PROFILE_ADC.
+//
+//*****************************************************************************
+#define DATA_ISR_PROFILE_HALL   0x16
+
+//*****************************************************************************
+//
+//! This real-time data item provides the execution profile of the Ethernet
+//! interrupt handler, which performs all of the TCP/IP processing, in the
+//! same format as #DATA_ISR_PROFILE_ADC.
+//
+//*****************************************************************************
+#define DATA_ISR_PROFILE_ETHERNET 0x17
+
+//*****************************************************************************
+//
+//! This real-time data item provides the d axis (flux producing) motor
+//! current when using field-oriented control.  This is a signed 16-bit value
+//! providing the current in milli-amperes.
+//
+//*****************************************************************************
+#define DATA_CURRENT_D          0x18
+
+//*****************************************************************************
+//
+//! This real-time data item provides the q axis (torque producing) motor
+//! current when using field-oriented control.  This is a signed 16-bit value
+//! providing the current in milli-amperes.
+//
+//*****************************************************************************
+#define DATA_CURRENT_Q          0x19
+
+//*****************************************************************************
+//
+//! This real-time data item provides the motor current reference produced by
+//! the speed controller for the current controller.  This is a signed 32-bit
+//! value providing the current in milli-amperes.
+//
+//*****************************************************************************
+#define DATA_CURRENT_REF        0x1a
+
+//*****************************************************************************
+//
+//! This real-time data item provides the phase error of the sensorless
+//! phase-locked loop at the most recent Back EMF zero-crossing.  This is a
+//! signed 16-bit value providing the error in tenths of an electrical degree,
+//! positive when the zero-crossing occurred later than predicted.
+//
+//*****************************************************************************
+#define DATA_BEMF_PLL_ERROR     0x1b
+
+//*****************************************************************************
+//
+//! This real-time data item provides the lock status of the sensorless
+//! phase-locked loop.  This is an 8-bit value that is 1 when the loop is
+//! locked to the Back EMF zero-crossings and 0 when it is acquiring.
+//
+//*****************************************************************************
+#define DATA_BEMF_PLL_LOCK      0x1c
+
+//*****************************************************************************
+//
+//! This real-time data item provides the average motor input power.  This is
+//! a 32-bit value providing the power in milliwatts.
+//
+//*****************************************************************************
+#define DATA_MOTOR_POWER        0x1d
+
+//*****************************************************************************
+//
+//! This real-time data item provides the position of the rotor as measured by
+//! the quadrature encoder.  This is a signed 32-bit value providing the
+//! position in encoder counts, referenced to the index once it has been
+//! seen.
+//
+//*****************************************************************************
+#define DATA_ENCODER_POSITION   0x1e
+
+//*****************************************************************************
+//
+//! This real-time data item provides the speed of the rotor as measured by
+//! the quadrature encoder.  This is a signed 32-bit value providing the speed
+//! in RPM, which is negative when the encoder counts down.
+//
+//*****************************************************************************
+#define DATA_ENCODER_SPEED      0x1f
+
+//*****************************************************************************
+//
+//! This real-time data item provides the position of the handpiece trigger,
+//! decoded from its hall sensors.  This is a 16-bit value from zero when
+//! released to 65535 when fully pressed.
+//
+//*****************************************************************************
+#define DATA_THROTTLE_POSITION  0x20
+
+//*****************************************************************************
+//
+//! This real-time data item provides the age of the latest trigger reading
+//! when it was used to set the motor speed, from when the handpiece started
+//! to send it.  This is a 32-bit value in microseconds.
+//
+//*****************************************************************************
+#define DATA_HP_STREAM_AGE      0x21
+
+//*****************************************************************************
+//
+//! This real-time data item provides the number of handpiece stream frames
+//! that were sent but not used, whether lost on the link or replaced by a
+//! newer frame before they were taken, as counted from their sequence
+//! numbers.  This is a 32-bit value, and is only counted for handpieces that
+//! number their stream frames.
+//
+//*****************************************************************************
+#define DATA_HP_STREAM_DROPS    0x22
+
+//*****************************************************************************
+//
+//! This real-time data item provides the time between the trigger readings
+//! in consecutive handpiece stream frames, as timed by the handpiece.  This
+//! is a 32-bit value in microseconds, and is only measured for handpieces
+//! that timestamp their stream frames.
+//
+//*****************************************************************************
+#define DATA_HP_STREAM_PERIOD   0x23
+
+//*****************************************************************************
 //
 //! The number of real-time data items.
 //
 //*****************************************************************************
-#define DATA_NUM_ITEMS          0x13
+#define DATA_NUM_ITEMS          0x24
 
 //*****************************************************************************
 //
@@ -0,0 +1,687 @@
+//*****************************************************************************
+//
+// foc.c - Field-oriented control of the motor phase currents.
+//
+//*****************************************************************************
+
+#include "inc/hw_types.h"
+#include "driverlib/interrupt.h"
+#include "utils/sine.h"
+#include "adc_ctrl.h"
+#include "foc.h"
+#include "main.h"
+#include "pwm_ctrl.h"
+#include "ui.h"
+
+//*****************************************************************************
+//
+//! \page foc_intro Introduction
+//!
+//! Field-oriented control drives the motor with sinusoidal phase currents
+//! whose vector is held in quadrature with the rotor flux, so that all of the
+//! phase current produces torque and the torque ripple of six-step
+//! commutation is removed.
+//!
+//! The phase A and phase B currents are sampled by ADC sequence zero at the
+//! center of the low-side on time and passed to FOCCurrentControl() from the
+//! ADC interrupt handler.  They are transformed into the stationary
+//! alpha/beta frame (Clarke transform) and then into the rotating d/q frame
+//! (Park transform) using the estimated rotor angle.  A pair of PI
+//! controllers drive the d axis current to zero and the q axis current to the
+//! torque demand, producing the d/q voltages.  These are limited to the
+//! voltage that the inverter can produce from the bus voltage, transformed
+//! back to the stationary frame (inverse Park and Clarke transforms), and
+//! applied to the PWM outputs with min-max zero sequence injection, which
+//! produces the same phase-to-phase voltages as space vector modulation.
+//!
+//! The rotor angle is interpolated from the digital Hall sensors.  Each Hall
+//! edge marks a known boundary between two 60 degree sectors; between edges
+//! the angle is advanced from that boundary at the rate measured over the
+//! last electrical revolution (or over the last sector until a full
+//! revolution has been seen), and is never advanced past the end of the
+//! sector.  The angle used for the inverse Park transform is further advanced
+//! by the time that elapses before the new duty cycles reach the motor.
+//!
+//! The magnitude of the q axis current reference is the motor current
+//! reference (g_lCurrentRef) produced by the speed controller in the
+//! millisecond tick, the same reference used by the trapezoid current
+//! controller.
+//!
+//! All of the arithmetic is 16.16 fixed point using MainLongMul() and the
+//! sine() table, so this mode runs at the same cost on every tool chain.
+//!
+//! The code for field-oriented control is contained in <tt>foc.c</tt>, with
+//! <tt>foc.h</tt> containing the definitions for the variables and functions
+//! exported to the remainder of the application.
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! \defgroup foc_api Definitions
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! An electrical angle of 60 degrees, as a 0.32 fraction of a revolution.
+//
+//*****************************************************************************
+#define FOC_ANGLE_60            0x2aaaaaab
+
+//*****************************************************************************
+//
+//! An electrical angle of 30 degrees, as a 0.32 fraction of a revolution.
+//
+//*****************************************************************************
+#define FOC_ANGLE_30            0x15555555
+
+//*****************************************************************************
+//
+//! The value in the Hall state to angle tables for an invalid Hall state.
+//
+//*****************************************************************************
+#define FOC_ANGLE_INVALID       0xffffffff
+
+//*****************************************************************************
+//
+//! The value of 1/sqrt(3), in 16.16 fixed-point format.
+//
+//*****************************************************************************
+#define FOC_ONE_OVER_SQRT3      37837
+
+//*****************************************************************************
+//
+//! The value of sqrt(3), in 16.16 fixed-point format.
+//
+//*****************************************************************************
+#define FOC_SQRT3               113512
+
+//*****************************************************************************
+//
+//! The maximum phase voltage vector magnitude, as a fraction of the bus
+//! voltage in 16.16 fixed-point format.  The inverter can produce 1/sqrt(3)
+//! of the bus voltage with zero sequence injection; this leaves some margin
+//! for the minimum pulse width and the dead time.
+//
+//*****************************************************************************
+#define FOC_VOLTAGE_MAX         34734
+
+//*****************************************************************************
+//
+//! The delay from the current sample to the midpoint of the PWM period in
+//! which the resulting duty cycles are applied, in half PWM periods.
+//
+//*****************************************************************************
+#define FOC_DELAY_HALF_PERIODS  5
+
+//*****************************************************************************
+//
+//! The d axis rotor angle at the center of the sector for each Hall state
+//! with 120 degree sensor spacing.
+//
+//*****************************************************************************
+static const unsigned long g_pulFOCHallAngle120[8] =
+{
+    FOC_ANGLE_INVALID, 0x55555555, 0xaaaaaaab, 0x80000000,
+    0x00000000, 0x2aaaaaab, 0xd5555555, FOC_ANGLE_INVALID
+};
+
+//*****************************************************************************
+//
+//! The d axis rotor angle at the center of the sector for each Hall state
+//! with 60 degree sensor spacing.
+//
+//*****************************************************************************
+static const unsigned long g_pulFOCHallAngle60[8] =
+{
+    0xaaaaaaab, 0x80000000, FOC_ANGLE_INVALID, 0x55555555,
+    0xd5555555, FOC_ANGLE_INVALID, 0x00000000, 0x2aaaaaab
+};
+
+//*****************************************************************************
+//
+//! The proportional gain of the d and q axis current controllers, in 16.16
+//! fixed-point format millivolts per milliamp.
+//
+//*****************************************************************************
+long g_lFOCCurrentP = 41170;
+
+//*****************************************************************************
+//
+//! The integral gain of the d and q axis current controllers, in 16.16
+//! fixed-point format millivolts per milliamp per current sample.
+//
+//*****************************************************************************
+long g_lFOCCurrentI = 4954;
+
+//*****************************************************************************
+//
+//! The filtered d axis (flux producing) current, in milliamps.
+//
+//*****************************************************************************
+short g_sFOCCurrentD;
+
+//*****************************************************************************
+//
+//! The filtered q axis (torque producing) current, in milliamps.
+//
+//*****************************************************************************
+short g_sFOCCurrentQ;
+
+//*****************************************************************************
+//
+//! The integrator of the d axis current controller, in millivolts.
+//
+//*****************************************************************************
+static long g_lFOCIntegratorD;
+
+//*****************************************************************************
+//
+//! The integrator of the q axis current controller, in millivolts.
+//
+//*****************************************************************************
+static long g_lFOCIntegratorQ;
+
+//*****************************************************************************
+//
+//! A boolean that is true if the current controllers are bypassed and no
+//! voltage is applied across the motor, shorting its windings to brake it.
+//
+//*****************************************************************************
+static tBoolean g_bFOCBrake;
+
+//*****************************************************************************
+//
+//! The delay from the current sample to the application of the resulting
+//! duty cycles, in system clocks.
+//
+//*****************************************************************************
+static unsigned long g_ulFOCDelay;
+
+//*****************************************************************************
+//
+//! The rotor angle at the center of the sector for the current Hall state.
+//
+//*****************************************************************************
+static unsigned long g_ulFOCSectorAngle;
+
+//*****************************************************************************
+//
+//! The rotor angle at the most recent Hall edge, from which the angle is
+//! interpolated.
+//
+//*****************************************************************************
+static unsigned long g_ulFOCEdgeAngle;
+
+//*****************************************************************************
+//
+//! The time of the most recent Hall edge, in system clocks.
+//
+//*****************************************************************************
+static unsigned long g_ulFOCEdgeTime;
+
+//*****************************************************************************
+//
+//! The expected duration of the current sector, in system clocks.
+//
+//*****************************************************************************
+static unsigned long g_ulFOCSectorTime;
+
+//*****************************************************************************
+//
+//! The rate of rotation of the rotor, in 0.32 fractions of a revolution per
+//! system clock.  This is zero when the rotor speed is not known.
+//
+//*****************************************************************************
+static unsigned long g_ulFOCAngleRate;
+
+//*****************************************************************************
+//
+//! The direction of rotation of the rotor; non-zero when the rotor angle is
+//! decreasing.
+//
+//*****************************************************************************
+static unsigned long g_ulFOCReverse;
+
+//*****************************************************************************
+//
+//! The times of the last six Hall edges in the current direction of
+//! rotation, used to measure the rotor speed over an electrical revolution.
+//
+//*****************************************************************************
+static unsigned long g_pulFOCEdgeTimes[6];
+
+//*****************************************************************************
+//
+//! The index into g_pulFOCEdgeTimes of the oldest edge time.
+//
+//*****************************************************************************
+static unsigned long g_ulFOCEdgeIndex;
+
+//*****************************************************************************
+//
+//! The number of consecutive Hall edges seen in the current direction of
+//! rotation, saturating at the size of g_pulFOCEdgeTimes.
+//
+//*****************************************************************************
+static unsigned long g_ulFOCEdgeCount;
+
+//*****************************************************************************
+//
+//! Handles an edge on the Hall sensor inputs.
+//!
+//! \param ulHall is the new state of the Hall sensor inputs.
+//! \param ulTime is the time of the edge, in system clocks.
+//!
+//! This function is called from the Hall sensor interrupt handler when the
+//! modulation type is field-oriented control.  It determines the direction
+//! of rotation from the change of sector, places the interpolated rotor angle
+//! at the boundary between the two sectors, and measures the rotor speed from
+//! the times of the previous edges.  If the new sector is not adjacent to the
+//! previous one, the speed is treated as unknown and the rotor angle is held
+//! at the center of the new sector until the following edge.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+FOCHallEdge(unsigned long ulHall, unsigned long ulTime)
+{
+    unsigned long ulAngle, ulPeriod, ulReverse;
+    long lDelta;
+
+    //
+    // Get the rotor angle at the center of the new sector.
+    //
+    if(HWREGBITH(&(g_sParameters.usFlags), FLAG_SENSOR_SPACE_BIT) ==
+       FLAG_SENSOR_SPACE_60)
+    {
+        ulAngle = g_pulFOCHallAngle60[ulHall & 7];
+    }
+    else
+    {
+        ulAngle = g_pulFOCHallAngle120[ulHall & 7];
+    }
+
+    //
+    // Ignore invalid Hall states; the previous estimate is the best there is.
+    //
+    if(ulAngle == FOC_ANGLE_INVALID)
+    {
+        return;
+    }
+
+    //
+    // Determine the direction of rotation from the change in sector angle.
+    // Anything other than a move to an adjacent sector (a missed edge, or the
+    // first edge after a reset) leaves the direction unknown.
+    //
+    lDelta = (long)(ulAngle - g_ulFOCSectorAngle);
+    if(g_ulFOCSectorAngle == FOC_ANGLE_INVALID)
+    {
+        ulReverse = 2;
+    }
+    else if((lDelta > 0) && (lDelta < 0x40000000))
+    {
+        ulReverse = 0;
+    }
+    else if((lDelta < 0) && (lDelta > -0x40000000))
+    {
+        ulReverse = 1;
+    }
+    else
+    {
+        ulReverse = 2;
+    }
+
+    //
+    // Restart the edge history if the direction has changed or is unknown.
+    //
+    if(ulReverse != g_ulFOCReverse)
+    {
+        g_ulFOCEdgeCount = 0;
+    }
+
+    //
+    // Determine the duration of a sector, averaged over the last electrical
+    // revolution if there has been one in this direction, otherwise from the
+    // previous edge.
+    //
+    if(g_ulFOCEdgeCount == 6)
+    {
+        ulPeriod = (ulTime - g_pulFOCEdgeTimes[g_ulFOCEdgeIndex]) / 6;
+    }
+    else if(g_ulFOCEdgeCount != 0)
+    {
+        ulPeriod = (ulTime -
+                    g_pulFOCEdgeTimes[(g_ulFOCEdgeIndex + 5) % 6]);
+    }
+    else
+    {
+        ulPeriod = 0;
+    }
+
+    //
+    // Save this edge time in the history, replacing the oldest.
+    //
+    g_pulFOCEdgeTimes[g_ulFOCEdgeIndex] = ulTime;
+    g_ulFOCEdgeIndex = (g_ulFOCEdgeIndex + 1) % 6;
+    if(g_ulFOCEdgeCount < 6)
+    {
+        g_ulFOCEdgeCount++;
+    }
+
+    //
+    // Update the angle estimate.  Interrupts are disabled so that the current
+    // controller never sees a partially updated estimate.
+    //
+    IntMasterDisable();
+    g_ulFOCSectorAngle = ulAngle;
+    g_ulFOCEdgeTime = ulTime;
+    g_ulFOCReverse = ulReverse;
+    if((ulReverse == 2) || (ulPeriod == 0))
+    {
+        //
+        // The speed is not known, so hold the angle at the sector center.
+        //
+        g_ulFOCEdgeAngle = ulAngle;
+        g_ulFOCSectorTime = 0;
+        g_ulFOCAngleRate = 0;
+    }
+    else
+    {
+        //
+        // Start from the sector boundary that was just crossed.
+        //
+        g_ulFOCEdgeAngle = ulReverse ? (ulAngle + FOC_ANGLE_30) :
+                                       (ulAngle - FOC_ANGLE_30);
+        g_ulFOCSectorTime = ulPeriod;
+        g_ulFOCAngleRate = FOC_ANGLE_60 / ulPeriod;
+    }
+    IntMasterEnable();
+}
+
+//*****************************************************************************
+//
+//! Runs the current controllers.
+//!
+//! \param lCurrentA is the current into the motor in phase A, in milliamps.
+//! \param lCurrentB is the current into the motor in phase B, in milliamps.
+//! \param ulTime is the time at which the currents were sampled, in system
+//! clocks.
+//!
+//! This function is called from the ADC interrupt handler with each new
+//! sample of the phase currents while the motor is running.  It computes the
+//! d/q currents at the interpolated rotor angle, runs the d and q axis PI
+//! controllers, and sets the PWM duty cycles for the resulting voltage
+//! vector.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+FOCCurrentControl(long lCurrentA, long lCurrentB, unsigned long ulTime)
+{
+    unsigned long ulAngle, ulAdvance, ulDelta, ulScale, ulReverse;
+    long lAlpha, lBeta, lD, lQ, lSin, lCos, lError, lVMax, lVd, lVq;
+    long lVA, lVB, lVC, lMin, lMax;
+
+    //
+    // Interpolate the rotor angle at the time of the current sample from the
+    // most recent Hall edge, without passing the end of the sector.  An edge
+    // that is time stamped after the sample (when the Hall interrupt
+    // pre-empts this one) places the angle at the sector boundary.
+    // Interrupts are disabled so that a Hall edge can not change the estimate
+    // part way through.
+    //
+    IntMasterDisable();
+    ulAngle = g_ulFOCEdgeAngle;
+    ulReverse = g_ulFOCReverse;
+    ulDelta = ulTime - g_ulFOCEdgeTime;
+    if((long)ulDelta < 0)
+    {
+        ulAdvance = 0;
+    }
+    else if(ulDelta >= g_ulFOCSectorTime)
+    {
+        ulAdvance = g_ulFOCAngleRate ? FOC_ANGLE_60 : 0;
+    }
+    else
+    {
+        ulAdvance = g_ulFOCAngleRate * ulDelta;
+    }
+    ulDelta = g_ulFOCAngleRate * g_ulFOCDelay;
+    IntMasterEnable();
+    ulAngle = ulReverse ? (ulAngle - ulAdvance) : (ulAngle + ulAdvance);
+
+    //
+    // Transform the phase currents into the stationary alpha/beta frame
+    // (Clarke transform).  The phase currents sum to zero, so phase C is not
+    // needed.
+    //
+    lAlpha = lCurrentA;
+    lBeta = MainLongMul(lCurrentA + (2 * lCurrentB), FOC_ONE_OVER_SQRT3);
+
+    //
+    // Transform the currents into the rotating d/q frame (Park transform).
+    //
+    lSin = sine(ulAngle);
+    lCos = cosine(ulAngle);
+    lD = MainLongMul(lAlpha, lCos) + MainLongMul(lBeta, lSin);
+    lQ = MainLongMul(lBeta, lCos) - MainLongMul(lAlpha, lSin);
+
+    //
+    // Pass the d/q currents through a single-pole IIR low pass filter for
+    // reporting.
+    //
+    g_sFOCCurrentD = ((g_sFOCCurrentD * 15) + lD) / 16;
+    g_sFOCCurrentQ = ((g_sFOCCurrentQ * 15) + lQ) / 16;
+
+    //
+    // While braking, apply no voltage across the motor, and clear the current
+    // controllers so that they start afresh when the motor is driven again.
+    //
+    if(g_bFOCBrake)
+    {
+        g_lFOCIntegratorD = 0;
+        g_lFOCIntegratorQ = 0;
+        g_ulMotorPower = (g_ulMotorPower * 15) / 16;
+        PWMSetDutyCycle(32768, 32768, 32768);
+        return;
+    }
+
+    //
+    // Determine the largest voltage vector that the inverter can produce at
+    // the present bus voltage, in millivolts.
+    //
+    lVMax = (g_ulBusVoltage * FOC_VOLTAGE_MAX) / 65536;
+
+    //
+    // Run the d axis current controller, driving the d axis current to zero.
+    //
+    lError = -lD;
+    g_lFOCIntegratorD += MainLongMul(g_lFOCCurrentI, lError);
+    if(g_lFOCIntegratorD > lVMax)
+    {
+        g_lFOCIntegratorD = lVMax;
+    }
+    else if(g_lFOCIntegratorD < -lVMax)
+    {
+        g_lFOCIntegratorD = -lVMax;
+    }
+    lVd = MainLongMul(g_lFOCCurrentP, lError) + g_lFOCIntegratorD;
+    if(lVd > lVMax)
+    {
+        lVd = lVMax;
+    }
+    else if(lVd < -lVMax)
+    {
+        lVd = -lVMax;
+    }
+
+    //
+    // The q axis gets the voltage left over by the d axis, so that the
+    // current vector stays aligned with the rotor at high speed.
+    //
+    lVMax = MainSqrt((lVMax * lVMax) - (lVd * lVd));
+
+    //
+    // Run the q axis current controller.  The reference is negated when the
+    // motor is being driven in reverse.
+    //
+    lError = (MainIsReverse() ? -g_lCurrentRef : g_lCurrentRef) - lQ;
+    g_lFOCIntegratorQ += MainLongMul(g_lFOCCurrentI, lError);
+    if(g_lFOCIntegratorQ > lVMax)
+    {
+        g_lFOCIntegratorQ = lVMax;
+    }
+    else if(g_lFOCIntegratorQ < -lVMax)
+    {
+        g_lFOCIntegratorQ = -lVMax;
+    }
+    lVq = MainLongMul(g_lFOCCurrentP, lError) + g_lFOCIntegratorQ;
+    if(lVq > lVMax)
+    {
+        lVq = lVMax;
+    }
+    else if(lVq < -lVMax)
+    {
+        lVq = -lVMax;
+    }
+
+    //
+    // Compute the motor input power from the d/q voltages and currents, in
+    // milliwatts, and average it the same way as the trapezoid drive does so
+    // that the power controller sees the same measurement in either mode.
+    //
+    lError = ((lVd * lD) + (lVq * lQ)) / 1000;
+    lError = (lError > 0) ? ((lError * 3) / 2) : 0;
+    g_ulMotorPower = (((g_ulMotorPower * 15) + lError) / 16);
+
+    //
+    // Advance the angle by the rotation that occurs before the new duty
+    // cycles are applied, up to one sector.
+    //
+    if(ulDelta > FOC_ANGLE_60)
+    {
+        ulDelta = FOC_ANGLE_60;
+    }
+    ulAngle = ulReverse ? (ulAngle - ulDelta) : (ulAngle + ulDelta);
+
+    //
+    // Transform the d/q voltages into the stationary alpha/beta frame
+    // (inverse Park transform), then into the phase voltages (inverse Clarke
+    // transform).
+    //
+    lSin = sine(ulAngle);
+    lCos = cosine(ulAngle);
+    lAlpha = MainLongMul(lVd, lCos) - MainLongMul(lVq, lSin);
+    lBeta = MainLongMul(lVd, lSin) + MainLongMul(lVq, lCos);
+    lVA = lAlpha;
+    lVB = (MainLongMul(lBeta, FOC_SQRT3) - lAlpha) / 2;
+    lVC = -lVA - lVB;
+
+    //
+    // Center the phase voltages between the bus rails by subtracting the
+    // average of the largest and smallest; this zero sequence injection
+    // gives the same line voltages as space vector modulation.
+    //
+    lMin = (lVA < lVB) ? lVA : lVB;
+    lMin = (lVC < lMin) ? lVC : lMin;
+    lMax = (lVA > lVB) ? lVA : lVB;
+    lMax = (lVC > lMax) ? lVC : lMax;
+    lError = (lMax + lMin) / 2;
+    lVA -= lError;
+    lVB -= lError;
+    lVC -= lError;
+
+    //
+    // Convert the phase voltages into duty cycles, with zero volts being a
+    // 50% duty cycle.  The scale is 2^30 over the bus voltage so that the
+    // product, shifted down by 14, is the 16.16 fraction of the bus voltage.
+    //
+    ulScale = (g_ulBusVoltage != 0) ? (0x40000000 / g_ulBusVoltage) : 0;
+    PWMSetDutyCycle(32768 + ((lVA * (long)ulScale) >> 14),
+                    32768 + ((lVB * (long)ulScale) >> 14),
+                    32768 + ((lVC * (long)ulScale) >> 14));
+}
+
+//*****************************************************************************
+//
+//! Resets the field-oriented controller.
+//!
+//! This function clears the current controllers and the rotor angle
+//! estimate, and sets the PWM outputs to a 50% duty cycle (zero phase
+//! voltage).  It must be called before the motor is started.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+FOCReset(void)
+{
+    //
+    // Clear the current controllers and the reported currents.
+    //
+    g_lFOCIntegratorD = 0;
+    g_lFOCIntegratorQ = 0;
+    g_sFOCCurrentD = 0;
+    g_sFOCCurrentQ = 0;
+    g_bFOCBrake = false;
+
+    //
+    // Compute the delay from a current sample to the application of the
+    // resulting duty cycles at the present PWM frequency.
+    //
+    g_ulFOCDelay = ((SYSTEM_CLOCK / 2) * FOC_DELAY_HALF_PERIODS) /
+                   g_ulPWMFrequency;
+
+    //
+    // Forget the rotor angle estimate; the next Hall edge (or the initial
+    // read of the Hall state) will place the angle at the sector center.
+    //
+    IntMasterDisable();
+    g_ulFOCSectorAngle = FOC_ANGLE_INVALID;
+    g_ulFOCEdgeAngle = 0;
+    g_ulFOCEdgeTime = 0;
+    g_ulFOCSectorTime = 0;
+    g_ulFOCAngleRate = 0;
+    g_ulFOCReverse = 2;
+    g_ulFOCEdgeCount = 0;
+    IntMasterEnable();
+
+    //
+    // Start with no voltage across the motor.
+    //
+    PWMSetDutyCycle(32768, 32768, 32768);
+}
+
+//*****************************************************************************
+//
+//! Brakes the motor.
+//!
+//! \param bBrake is a boolean that is true to brake the motor, or false to
+//! drive it with the current controllers again.
+//!
+//! This function bypasses the current controllers and applies no voltage
+//! across the motor, shorting its windings so that the Back EMF drives a
+//! current that brakes the motor.  This is not regulated, so it must only be
+//! used at low speed.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+FOCBrake(tBoolean bBrake)
+{
+    g_bFOCBrake = bBrake;
+}
+
+//*****************************************************************************
+//
+// Close the Doxygen group.
+//! @}
+//
+//*****************************************************************************
@@ -0,0 +1,25 @@
+//*****************************************************************************
+//
+// foc.h - Prototypes for the field-oriented control routines.
+//
+//*****************************************************************************
+
+#ifndef __FOC_H__
+#define __FOC_H__
+
+//*****************************************************************************
+//
+// Prototypes for the exported variables and functions.
+//
+//*****************************************************************************
+extern long g_lFOCCurrentP;
+extern long g_lFOCCurrentI;
+extern short g_sFOCCurrentD;
+extern short g_sFOCCurrentQ;
+extern void FOCHallEdge(unsigned long ulHall, unsigned long ulTime);
+extern void FOCCurrentControl(long lCurrentA, long lCurrentB,
+                              unsigned long ulTime);
+extern void FOCReset(void);
+extern void FOCBrake(tBoolean bBrake);
+
+#endif // __FOC_H__
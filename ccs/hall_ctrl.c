@@ -27,7 +27,10 @@
 #include "inc/hw_types.h"
 #include "driverlib/gpio.h"
 #include "driverlib/interrupt.h"
+#include "capture.h"
+#include "foc.h"
 #include "hall_ctrl.h"
+#include "isr_prof.h"
 #include "main.h"
 #include "pins.h"
 #include "trapmod.h"
@@ -51,6 +54,22 @@
 //! The Hall state value is stored at each interrupt.   The time between the
 //! interrupt edges is measured to determine the speed of the motor.
 //!
+//! Every edge is used for the speed measurement, not just one per electrical
+//! revolution.  Each Hall state is mapped to one of the six sectors of the
+//! electrical revolution, and each edge that continues the sector sequence
+//! advances an accumulated rotor angle by the width of the sector that was
+//! just crossed.  The Hall sensors are rarely placed exactly 120 degrees
+//! apart, so the sector widths are learned at run time by comparing the time
+//! spent in each sector against the time for the full revolution.
+//!
+//! The rotor speed is recomputed every millisecond, from the angle covered
+//! between the last edge before the previous computation and the latest
+//! edge.  At high speed this measures many edges over the full millisecond;
+//! at low speed it is the time spent in a single sector.  Between edges at
+//! low speed, the speed is limited to that at which the rotor could still be
+//! in its current sector, so that a stalling rotor is seen as slowing down
+//! before the next edge arrives.
+//!
 //! The code for calculating the motor speed and updating the Hall state value
 //! is contained in <tt>hall_ctrl.c</tt>, with <tt>hall_ctrl.h</tt> containing
 //! the definitions for the variable and functions exported to the remainder
@@ -71,19 +90,139 @@
 
 //*****************************************************************************
 //
-//! A bit-mapped flag of Hall edges to skip before starting a speed
-//! calculations for a given Hall edge.
+//! The nominal width of a Hall sector, in 0.16 fixed-point electrical
+//! revolutions (one sixth of a revolution).
+//
+//*****************************************************************************
+#define HALL_SECTOR_NOMINAL     10923
+
+//*****************************************************************************
+//
+//! The time, in system clocks, without a Hall edge after which the rotor is
+//! considered to be stopped.
+//
+//*****************************************************************************
+#define HALL_STOP_TIME          (SYSTEM_CLOCK / 5)
+
+//*****************************************************************************
+//
+//! The longest electrical period, in system clocks, over which the sector
+//! widths are learned.  The sector skew calibration is not updated below the
+//! corresponding speed.
+//
+//*****************************************************************************
+#define HALL_CAL_MAX_PERIOD     (1 << 22)
+
+//*****************************************************************************
+//
+//! Maps a Hall state to the index of its sector in the forward commutation
+//! sequence (5, 1, 3, 2, 6, 4).  The invalid Hall states (0 and 7) map to
+//! 0xff.
+//
+//*****************************************************************************
+static const unsigned char g_pucHallSector[8] =
+{
+    0xff, 1, 3, 2, 5, 0, 4, 0xff
+};
+
+//*****************************************************************************
+//
+//! The sector that the rotor is in, or 0xff if it is not yet known.
+//
+//*****************************************************************************
+static unsigned long g_ulHallSector = 0xff;
+
+//*****************************************************************************
+//
+//! The direction of the previous sector step; 1 for forward and 5 for
+//! reverse (modulo six), or 0 if there has not been a step since the
+//! estimator was restarted.
+//
+//*****************************************************************************
+static unsigned long g_ulHallStep = 0;
+
+//*****************************************************************************
+//
+//! The time at which the most recent Hall edge was seen.
 //
 //*****************************************************************************
-static unsigned char g_ucSkipFlag = 0xff;
+static unsigned long g_ulHallEdgeTime;
 
 //*****************************************************************************
 //
-//! This is the time at which the previous edge was seen and is used to
-//! determine the time between edges.
+//! The rotor angle accumulated over the valid Hall edges, in 0.16
+//! fixed-point electrical revolutions.  Each edge adds the calibrated width
+//! of the sector that was just left; only differences of this value are
+//! meaningful.
 //
 //*****************************************************************************
-static unsigned long g_ulOldTime[8];
+static unsigned long g_ulHallAngle = 0;
+
+//*****************************************************************************
+//
+//! A count of the restarts of the speed estimator, which occur whenever an
+//! edge does not continue the sector sequence in the same direction.
+//
+//*****************************************************************************
+static unsigned long g_ulHallRestart = 0;
+
+//*****************************************************************************
+//
+//! The time spent in each sector during the most recent electrical
+//! revolution, in system clocks.
+//
+//*****************************************************************************
+static unsigned long g_pulHallInterval[6];
+
+//*****************************************************************************
+//
+//! The number of consecutive sector intervals that have been measured since
+//! the estimator was restarted, saturating at six.
+//
+//*****************************************************************************
+static unsigned long g_ulHallIntervals = 0;
+
+//*****************************************************************************
+//
+//! The learned width of each sector as a fraction of the electrical period,
+//! filtered by a single-pole IIR filter and scaled by 64 (that is, in 0.22
+//! fixed-point electrical revolutions).
+//
+//*****************************************************************************
+static unsigned long g_pulHallSectorRaw[6];
+
+//*****************************************************************************
+//
+//! The calibrated width of each sector, in 0.16 fixed-point electrical
+//! revolutions.  This is the learned width normalized so that the six
+//! sectors add up to a full electrical revolution, and accounts for the
+//! placement error of the Hall sensors.
+//
+//*****************************************************************************
+static unsigned short g_pusHallSectorCal[6];
+
+//*****************************************************************************
+//
+//! The accumulated angle and the edge time at which the rotor speed was
+//! last computed by the millisecond tick.
+//
+//*****************************************************************************
+static unsigned long g_ulHallTickAngle;
+static unsigned long g_ulHallTickTime;
+
+//*****************************************************************************
+//
+//! The value of the estimator restart count seen by the millisecond tick.
+//
+//*****************************************************************************
+static unsigned long g_ulHallTickRestart = 0;
+
+//*****************************************************************************
+//
+//! Non-zero if the millisecond tick has declared the rotor to be stopped.
+//
+//*****************************************************************************
+static unsigned char g_ucHallTickStopped = 0;
 
 //*****************************************************************************
 //
@@ -92,6 +231,16 @@ static unsigned long g_ulOldTime[8];
 //*****************************************************************************
 unsigned long g_ulHallRotorSpeed = 0;
 
+//*****************************************************************************
+//
+//! The position of the motor's rotor, as counted from the Hall edges.  This
+//! is incremented for each step to the next sector and decremented for each
+//! step to the previous sector, so that there are 3 * ucNumPoles counts per
+//! mechanical revolution.  It does not wrap at the end of a revolution.
+//
+//*****************************************************************************
+long g_lHallPosition = 0;
+
 //*****************************************************************************
 //
 //! The current Hall Sensor value.
@@ -103,49 +252,134 @@ unsigned short g_ulHallValuePrev = 0;
 
 //*****************************************************************************
 //
-//! Updates the current rotor speed.
+//! Restarts the Hall speed estimator.
+//!
+//! This function discards the sector history so that the next speed
+//! measurement starts afresh from the next Hall edge.  The learned sector
+//! calibration is retained.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+HallRestart(void)
+{
+    g_ulHallStep = 0;
+    g_ulHallIntervals = 0;
+    g_ulHallRestart++;
+}
+
+//*****************************************************************************
+//
+//! Processes a Hall edge for the speed estimator.
 //!
-//! \param ulNewSpeed is the newly measured speed.
+//! \param ulSector is the sector that the rotor has just entered.
+//! \param ulTime is the time at which the edge occurred.
 //!
-//! This function takes a newly measured rotor speed and uses it to update
-//! the current rotor speed.  If the new speed is different from the
-//! current speed by too large a margin, the new speed measurement is
-//! discarded (a noise filter).  If the new speed is accepted, it is passed
-//! through a single-pole IIR low pass filter with a coefficient of 0.75.
+//! This function advances the accumulated rotor angle by the calibrated
+//! width of the sector that was just left, provided that the edge continues
+//! the sector sequence in the same direction as the previous edge.  Any
+//! other edge (an invalid Hall state, a skipped sector, or a reversal)
+//! restarts the estimator.
+//!
+//! Once a full electrical revolution of consecutive sector intervals has
+//! been measured, the width of the sector just left is compared against the
+//! period of that revolution to learn the skew of the Hall sensors.
 //!
 //! \return None.
 //
 //*****************************************************************************
 static void
-HallSpeedNewValue(unsigned long ulNewSpeed)
+HallEdge(unsigned long ulSector, unsigned long ulTime)
 {
-    unsigned short usDelta;
+    unsigned long ulStep, ulDelta, ulPeriod, ulFrac, ulIdx;
+
+    //
+    // Restart on an invalid Hall state.
+    //
+    if(ulSector == 0xff)
+    {
+        g_ulHallSector = 0xff;
+        g_ulHallEdgeTime = ulTime;
+        HallRestart();
+        return;
+    }
 
     //
-    // Compute the difference in the speed.
+    // Determine the direction of the step from the previous sector, and
+    // count it in the rotor position.  A reversal or a missed sector
+    // restarts the estimator.
     //
-    if(ulNewSpeed > g_ulHallRotorSpeed)
+    ulStep = 0;
+    if(g_ulHallSector != 0xff)
+    {
+        ulStep = (ulSector + 6 - g_ulHallSector) % 6;
+        if(ulStep == 1)
+        {
+            g_lHallPosition++;
+        }
+        else if(ulStep == 5)
+        {
+            g_lHallPosition--;
+        }
+        if(((ulStep != 1) && (ulStep != 5)) ||
+           (g_ulHallStep && (ulStep != g_ulHallStep)))
+        {
+            ulStep = 0;
+        }
+    }
+    if(ulStep == 0)
     {
-        usDelta = ulNewSpeed - g_ulHallRotorSpeed;
+        g_ulHallSector = ulSector;
+        g_ulHallEdgeTime = ulTime;
+        HallRestart();
+        return;
     }
-    else
+
+    //
+    // The rotor has crossed the full width of the previous sector, so save
+    // the time spent in it.
+    //
+    ulDelta = ulTime - g_ulHallEdgeTime;
+    g_pulHallInterval[g_ulHallSector] = ulDelta;
+    if(g_ulHallIntervals < 6)
     {
-        usDelta = g_ulHallRotorSpeed - ulNewSpeed;
+        g_ulHallIntervals++;
     }
 
     //
-    // If the speed difference is too large then return without updating the
-    // motor speed.
+    // Once the last six intervals are known, learn the width of the previous
+    // sector as a fraction of the electrical period.  A width that is far
+    // from nominal comes from a rapid change in speed rather than from the
+    // placement of the sensors, and is ignored.
     //
-    if(usDelta > (g_sParameters.ulMaxSpeed / 2))
+    if(g_ulHallIntervals == 6)
     {
-        return;
+        for(ulIdx = 0, ulPeriod = 0; ulIdx < 6; ulIdx++)
+        {
+            ulPeriod += g_pulHallInterval[ulIdx];
+        }
+        if(ulPeriod < HALL_CAL_MAX_PERIOD)
+        {
+            ulFrac = (ulDelta << 10) / (ulPeriod >> 6);
+            if((ulFrac > (HALL_SECTOR_NOMINAL / 2)) &&
+               (ulFrac < ((HALL_SECTOR_NOMINAL * 3) / 2)))
+            {
+                g_pulHallSectorRaw[g_ulHallSector] +=
+                    (ulFrac - (g_pulHallSectorRaw[g_ulHallSector] >> 6));
+            }
+        }
     }
 
     //
-    // Pass the new rotor speed reading through the low pass filter.
+    // Advance the rotor angle by the width of the previous sector.  The edge
+    // time is written last since the millisecond tick uses it to detect an
+    // update that it interrupted.
     //
-    g_ulHallRotorSpeed = ((g_ulHallRotorSpeed * 3) + ulNewSpeed) / 4;
+    g_ulHallAngle += g_pusHallSectorCal[g_ulHallSector];
+    g_ulHallStep = ulStep;
+    g_ulHallSector = ulSector;
+    g_ulHallEdgeTime = ulTime;
 }
 
 //*****************************************************************************
@@ -162,7 +396,12 @@ HallSpeedNewValue(unsigned long ulNewSpeed)
 void
 GPIOBIntHandler(void)
 {
-    unsigned long ulTime, ulNewTime, ulTemp;
+    unsigned long ulNewTime, ulTemp;
+
+    //
+    // Mark the start of this handler for the profiler.
+    //
+    ISRProfileStart(ISR_PROFILE_HALL);
 
     //
     // Get the time of this edge.
@@ -186,6 +425,18 @@ GPIOBIntHandler(void)
     g_ulHallValue = GPIOPinRead(PIN_HALLA_PORT,
             (PIN_HALLC_PIN | PIN_HALLB_PIN | PIN_HALLA_PIN)) >> 4;
 
+    //
+    // Record the edge, or replace it with a recorded one.  A live edge is
+    // ignored while replaying.
+    //
+    ulTemp = g_ulHallValue;
+    if(!CaptureHall(&ulNewTime, &ulTemp))
+    {
+        ISRProfileEnd(ISR_PROFILE_HALL);
+        return;
+    }
+    g_ulHallValue = ulTemp;
+
     //
     // Invert the Hall Sensor value, if necessary.
     //
@@ -196,72 +447,54 @@ GPIOBIntHandler(void)
     }
 
     //
-    // Update the output waveform if running Trapezoid modulation.
+    // Update the output waveform if running Trapezoid modulation, or the
+    // rotor angle estimate if running field-oriented control.
     //
     if(g_sParameters.ucModulationType == MOD_TYPE_TRAPEZOID)
     {
         TrapModulate(g_ulHallValue);
     }
+    else if(g_sParameters.ucModulationType == MOD_TYPE_FOC)
+    {
+        FOCHallEdge(g_ulHallValue, ulNewTime);
+    }
 
     //
-    // See if this edge should be skipped.
+    // Pass the edge to the speed estimator, unless it is a glitch that left
+    // the Hall state unchanged.
     //
-    if(HWREGBITW(&g_ucSkipFlag, g_ulHallValue))
+    if(g_ulHallValue != g_ulHallValuePrev)
     {
-        //
-        // This edge should be skipped, but an edge time now exists so the
-        // next edge should not be skipped.
-        //
-        HWREGBITW(&g_ucSkipFlag, g_ulHallValue) = 0;
-
-        //
-        // Save the time of the current edge.
-        //
-        g_ulOldTime[g_ulHallValue] = ulNewTime;
-
-        //
-        // There is nothing further to be done.
-        //
-        return;
-    }
-    
-    //check if this is the wrong trigger
-    if(g_ulHallValue == g_ulHallValuePrev)
-    {  	
-    	HallSpeedNewValue(0);
-    }
-    else
-    {
-	    //update the previous hall value
-	    g_ulHallValuePrev=g_ulHallValue;
-	
-	    //
-	    // Compute the time between this edge and the previous edge.
-	    //
-	    ulTime = ulNewTime - g_ulOldTime[g_ulHallValue];
-	
-	    //
-	    // Save the time of the current edge.
-	    //
-	    g_ulOldTime[g_ulHallValue] = ulNewTime;
-	
-	    //
-	    // Compute the new speed from the time between edges.
-	    //
-	    ulTemp = (SYSTEM_CLOCK * 60U);
-	    ulTemp = (ulTemp / ulTime);
-	    ulTemp = (ulTemp / (g_sParameters.ucNumPoles / 2));
-	    HallSpeedNewValue(ulTemp);
+        g_ulHallValuePrev = g_ulHallValue;
+        HallEdge(g_pucHallSector[g_ulHallValue & 7], ulNewTime);
     }
+
+    //
+    // Mark the end of this handler for the profiler.
+    //
+    ISRProfileEnd(ISR_PROFILE_HALL);
 }
 
 //*****************************************************************************
 //
-//! Handles the Hall System Tick.
+//! Handles the Hall millisecond tick.
 //!
-//! This function is called by the system tick handler.  It's primary
-//! purpose is to reset the motor speed to 0 if no Hall interrupt edges have
-//! been detected for some period of time.
+//! This function is called by the millisecond tick when the rotor speed is
+//! measured by the Hall sensors, and computes a new rotor speed every
+//! millisecond.
+//!
+//! When one or more edges have been seen since the previous computation, the
+//! speed is the calibrated angle covered between the last edge before the
+//! previous computation and the latest edge, divided by the time between
+//! those edges.  At high speed this spans many sectors over the full
+//! millisecond (the M/T method); at low speed it is the width of the single
+//! sector just crossed over the time spent in it.
+//!
+//! When no edge has been seen, the speed is held, but limited to the
+//! highest speed at which the rotor could still be within the current
+//! sector.  This extrapolates a decelerating rotor between edges, and
+//! brings the speed to zero once no edge has been seen for
+//! HALL_STOP_TIME.
 //!
 //! \return None.
 //
@@ -269,15 +502,111 @@ GPIOBIntHandler(void)
 void
 HallTickHandler(void)
 {
+    unsigned long ulAngle, ulTime, ulRestart, ulSector, ulDelta, ulIdx;
+    unsigned long ulSum, ulScale;
+
     //
-    // If the motor is NOT running, then force a skip of the speed
-    // calculation code for the next time that the motor is running,
-    // and also force the Rotor Speed to 0.
+    // If the motor is NOT running, then restart the estimator and force the
+    // Rotor Speed to 0.
     //
     if(!MainIsRunning())
     {
-        g_ucSkipFlag = 0xff;
+        g_ulHallSector = 0xff;
+        HallRestart();
         g_ulHallRotorSpeed = 0;
+        return;
+    }
+
+    //
+    // Normalize the learned sector widths so that they cover exactly one
+    // electrical revolution.  This also removes the common bias introduced
+    // while the rotor is accelerating.
+    //
+    for(ulIdx = 0, ulSum = 0; ulIdx < 6; ulIdx++)
+    {
+        ulSum += g_pulHallSectorRaw[ulIdx];
+    }
+    for(ulIdx = 0; ulIdx < 6; ulIdx++)
+    {
+        g_pusHallSectorCal[ulIdx] = ((g_pulHallSectorRaw[ulIdx] << 11) /
+                                     (ulSum >> 5));
+    }
+
+    //
+    // Read a consistent snapshot of the edge state, since the Hall edge
+    // interrupt may preempt this handler.
+    //
+    do
+    {
+        ulTime = g_ulHallEdgeTime;
+        ulAngle = g_ulHallAngle;
+        ulRestart = g_ulHallRestart;
+        ulSector = g_ulHallSector;
+    }
+    while((ulTime != g_ulHallEdgeTime) || (ulRestart != g_ulHallRestart));
+
+    //
+    // After a restart, measure from the latest edge.
+    //
+    if(ulRestart != g_ulHallTickRestart)
+    {
+        g_ulHallTickRestart = ulRestart;
+        g_ulHallTickAngle = ulAngle;
+        g_ulHallTickTime = ulTime;
+        g_ucHallTickStopped = 0;
+    }
+
+    //
+    // The scale from the angle covered per system clock to RPM.
+    //
+    ulScale = (SYSTEM_CLOCK * 60U) / (g_sParameters.ucNumPoles / 2);
+
+    //
+    // See if the rotor has moved since the previous computation.
+    //
+    if(ulAngle != g_ulHallTickAngle)
+    {
+        //
+        // Compute the speed from the angle covered between the edges.  The
+        // first edge after a stop only provides the starting point.
+        //
+        ulDelta = ulTime - g_ulHallTickTime;
+        if(!g_ucHallTickStopped && (ulDelta != 0))
+        {
+            g_ulHallRotorSpeed = MainLongMul(ulAngle - g_ulHallTickAngle,
+                                             ((ulScale + (ulDelta / 2)) /
+                                              ulDelta));
+        }
+        g_ulHallTickAngle = ulAngle;
+        g_ulHallTickTime = ulTime;
+        g_ucHallTickStopped = 0;
+        return;
+    }
+
+    //
+    // There has been no edge, so see how long the rotor has been in the
+    // current sector.
+    //
+    ulDelta = UIGetTicks() - ulTime;
+    if(ulDelta > HALL_STOP_TIME)
+    {
+        g_ucHallTickStopped = 1;
+        g_ulHallRotorSpeed = 0;
+        return;
+    }
+    if((ulDelta == 0) || (ulSector == 0xff))
+    {
+        return;
+    }
+
+    //
+    // Limit the speed to that at which the rotor would have crossed the
+    // current sector by now.
+    //
+    ulScale = MainLongMul(g_pusHallSectorCal[ulSector], ulScale / ulDelta);
+    if(g_ulHallRotorSpeed > ulScale)
+    {
+        g_ulHallRotorSpeed = ulScale;
     }
 }
 
@@ -294,6 +623,17 @@ HallTickHandler(void)
 void
 HallInit(void)
 {
+    unsigned long ulIdx;
+
+    //
+    // Start with sectors of equal width.
+    //
+    for(ulIdx = 0; ulIdx < 6; ulIdx++)
+    {
+        g_pulHallSectorRaw[ulIdx] = HALL_SECTOR_NOMINAL << 6;
+        g_pusHallSectorCal[ulIdx] = HALL_SECTOR_NOMINAL;
+    }
+
     //
     // Configure the Hall effect GPIO pins as inputs.
     //
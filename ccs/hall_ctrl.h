@@ -32,6 +32,7 @@
 //
 //*****************************************************************************
 extern unsigned long g_ulHallRotorSpeed;
+extern long g_lHallPosition;
 extern unsigned short g_ulHallValue;
 extern void GPIOBIntHandler(void);
 extern void HallTickHandler(void);
@@ -0,0 +1,572 @@
+//*****************************************************************************
+//
+// hp_cal.c - Per handpiece storage of the trigger calibration in flash.
+//
+//*****************************************************************************
+
+#include "inc/hw_types.h"
+#include "driverlib/flash.h"
+#include "main.h"
+#include "ui.h"
+#include "hp_cal.h"
+
+//*****************************************************************************
+//
+//! \page hp_cal_intro Introduction
+//!
+//! The trigger hall sensors of each handpiece have their own response, which
+//! is learned by the user interface from the range of readings seen while the
+//! trigger is used.  So that a handpiece does not have to relearn its trigger
+//! every time it is connected, the learned calibration and the polarity of
+//! its sensors are kept in flash, keyed by the serial number that is read
+//! from the handpiece EEPROM.  When a handpiece is connected its calibration
+//! is available immediately, and it continues to be refined during use.
+//!
+//! The calibrations are kept in a table of #HPCAL_NUM_ENTRIES entries, with
+//! the most recently saved handpiece first; when a handpiece that is not in
+//! the table is saved, the least recently saved handpiece is dropped from the
+//! end.  The whole table is written to flash as a single block of
+//! #HPCAL_SIZE bytes in the same fault tolerant, wear leveled manner as the
+//! parameter block (see <tt>utils/flash_pb.c</tt>): each block has a sequence
+//! number and a checksum, and each save goes into the next free block of the
+//! ring between #HPCAL_START and #HPCAL_END, erasing a kilobyte of flash only
+//! when it is reached.  A RAM copy of the latest table is used for lookups.
+//!
+//! The flash cannot be read while it is being programmed or erased, which
+//! stalls the processor, so the table must only be saved while the motor is
+//! stopped; the user interface queues the calibration and saves it once the
+//! motor and the handpiece link are idle, no more than once a minute.  A
+//! save that would not change the table does not write to flash.  The table
+//! in flash is only read through HWREGB() and HWREG(), so that the simulation
+//! build can run the store against its simulated flash.
+//!
+//! The code for the handpiece calibration store is contained in
+//! <tt>hp_cal.c</tt>, with <tt>hp_cal.h</tt> containing the definitions for
+//! the functions exported to the remainder of the application.
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! \defgroup hp_cal_api Definitions
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! The number of handpieces whose calibration is kept in flash.
+//
+//*****************************************************************************
+#define HPCAL_NUM_ENTRIES       10
+
+//*****************************************************************************
+//
+//! The version of the layout of the calibration table.  A table in flash with
+//! a different version is ignored.
+//
+//*****************************************************************************
+#define HPCAL_VERSION           0
+
+//*****************************************************************************
+//
+//! The offsets of the sequence number and the version of a calibration table
+//! in flash (see the tHPCalBlock structure).
+//
+//*****************************************************************************
+#define HPCAL_O_SEQUENCE        0
+#define HPCAL_O_VERSION         2
+
+//*****************************************************************************
+//
+//! The calibration of a single handpiece.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The serial number of the handpiece, or #HPCAL_SERIAL_NONE if this
+    //! entry is unused.
+    //
+    unsigned long ulSerial;
+
+    //
+    //! The calibration of the trigger hall sensors of the handpiece.
+    //
+    tThrottleCal sCal;
+
+    //
+    //! The polarity of the trigger hall sensors of the handpiece; one if the
+    //! readings are inverted.
+    //
+    unsigned char ucPolarity;
+
+    //
+    //! Padding to a multiple of four bytes.
+    //
+    unsigned char pucReserved[3];
+}
+tHPCalEntry;
+
+//*****************************************************************************
+//
+//! The calibration table, as it is stored in flash.  This must be exactly
+//! #HPCAL_SIZE bytes.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The sequence number of this block, used to find the most recent block
+    //! in flash.
+    //
+    unsigned char ucSequence;
+
+    //
+    //! The checksum of this block.  The sum of all of the bytes of the block
+    //! is zero.
+    //
+    unsigned char ucChecksum;
+
+    //
+    //! The version of this block.
+    //
+    unsigned char ucVersion;
+
+    //
+    //! Padding to a multiple of four bytes.
+    //
+    unsigned char ucReserved;
+
+    //
+    //! The calibration of each handpiece, with the most recently saved first.
+    //
+    tHPCalEntry psEntry[HPCAL_NUM_ENTRIES];
+
+    //
+    //! Padding to #HPCAL_SIZE bytes.
+    //
+    unsigned char pucReserved[HPCAL_SIZE - 4 -
+                              (HPCAL_NUM_ENTRIES * sizeof(tHPCalEntry))];
+}
+tHPCalBlock;
+
+//*****************************************************************************
+//
+//! The RAM copy of a calibration table, which is also viewed as the words
+//! that are programmed into flash and the bytes that are checksummed.
+//
+//*****************************************************************************
+typedef union
+{
+    tHPCalBlock sBlock;
+    unsigned long pulWords[HPCAL_SIZE / 4];
+    unsigned char pucBytes[HPCAL_SIZE];
+}
+tHPCalBuffer;
+
+//*****************************************************************************
+//
+//! The RAM copy of the most recent calibration table.
+//
+//*****************************************************************************
+static tHPCalBuffer g_uHPCal;
+
+//*****************************************************************************
+//
+//! The address of the most recent calibration table in flash, or zero if
+//! there is not one.
+//
+//*****************************************************************************
+static unsigned long g_ulHPCalCurrent;
+
+//*****************************************************************************
+//
+//! Determines if the calibration table at the given address is valid.
+//!
+//! \param ulAddress is the address of the calibration table to check.
+//!
+//! This function will compute the checksum of a calibration table in flash,
+//! and check its version, to determine if it is valid.
+//!
+//! \return Returns one if the calibration table is valid and zero if it is
+//! not.
+//
+//*****************************************************************************
+static unsigned long
+HPCalIsValid(unsigned long ulAddress)
+{
+    unsigned long ulIdx, ulSum;
+
+    //
+    // Loop through the bytes in the block, computing the checksum.
+    //
+    for(ulIdx = 0, ulSum = 0; ulIdx < HPCAL_SIZE; ulIdx++)
+    {
+        ulSum += HWREGB(ulAddress + ulIdx);
+    }
+
+    //
+    // The checksum should be zero, and the block should not be erased flash
+    // (which is all ones).
+    //
+    if(((ulSum & 255) != 0) || (ulSum == (HPCAL_SIZE * 255)))
+    {
+        return(0);
+    }
+
+    //
+    // The block is only usable if it has the current layout.
+    //
+    return(HWREGB(ulAddress + HPCAL_O_VERSION) == HPCAL_VERSION);
+}
+
+//*****************************************************************************
+//
+//! Finds the calibration of a handpiece in the calibration table.
+//!
+//! \param ulSerial is the serial number of the handpiece.
+//!
+//! \return Returns the index of the entry for the handpiece, or
+//! #HPCAL_NUM_ENTRIES if it is not in the table.
+//
+//*****************************************************************************
+static unsigned long
+HPCalFind(unsigned long ulSerial)
+{
+    unsigned long ulIdx;
+
+    //
+    // Loop through the entries of the table, stopping at the one for this
+    // handpiece.
+    //
+    for(ulIdx = 0; ulIdx < HPCAL_NUM_ENTRIES; ulIdx++)
+    {
+        if(g_uHPCal.sBlock.psEntry[ulIdx].ulSerial == ulSerial)
+        {
+            break;
+        }
+    }
+
+    //
+    // Return the index of the entry.
+    //
+    return(ulIdx);
+}
+
+//*****************************************************************************
+//
+//! Writes the RAM copy of the calibration table to flash.
+//!
+//! This function sets the sequence number and checksum of the calibration
+//! table, and writes it into the next free block of flash following the most
+//! recent one, erasing the flash when the start of an erase block is reached.
+//! If the write fails, the previous table in flash remains the most recent.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+HPCalWrite(void)
+{
+    unsigned long ulNew, ulIdx, ulSum;
+
+    //
+    // Set the sequence number to one greater than the most recent table, and
+    // try to write the table immediately after it.
+    //
+    if(g_ulHPCalCurrent)
+    {
+        g_uHPCal.sBlock.ucSequence =
+            HWREGB(g_ulHPCalCurrent + HPCAL_O_SEQUENCE) + 1;
+        ulNew = g_ulHPCalCurrent + HPCAL_SIZE;
+        if(ulNew == HPCAL_END)
+        {
+            ulNew = HPCAL_START;
+        }
+    }
+    else
+    {
+        g_uHPCal.sBlock.ucSequence = 0;
+        ulNew = HPCAL_START;
+    }
+
+    //
+    // Compute the checksum of the table so that the sum of its bytes is
+    // zero.
+    //
+    g_uHPCal.sBlock.ucChecksum = 0;
+    for(ulIdx = 0, ulSum = 0; ulIdx < HPCAL_SIZE; ulIdx++)
+    {
+        ulSum -= g_uHPCal.pucBytes[ulIdx];
+    }
+    g_uHPCal.sBlock.ucChecksum = ulSum;
+
+    //
+    // Look for an erased block of flash in which to store the table.
+    //
+    while(1)
+    {
+        //
+        // Erase the flash if this is the start of an erase block.
+        //
+        if((ulNew & 1023) == 0)
+        {
+            FlashErase(ulNew);
+        }
+
+        //
+        // Stop looking if this block is all ones.
+        //
+        for(ulIdx = 0; ulIdx < HPCAL_SIZE; ulIdx++)
+        {
+            if(HWREGB(ulNew + ulIdx) != 0xff)
+            {
+                break;
+            }
+        }
+        if(ulIdx == HPCAL_SIZE)
+        {
+            break;
+        }
+
+        //
+        // Move to the next block, giving up if every block has been tried.
+        //
+        ulNew += HPCAL_SIZE;
+        if(ulNew == HPCAL_END)
+        {
+            ulNew = HPCAL_START;
+        }
+        if((g_ulHPCalCurrent && (ulNew == g_ulHPCalCurrent)) ||
+           (!g_ulHPCalCurrent && (ulNew == HPCAL_START)))
+        {
+            return;
+        }
+    }
+
+    //
+    // Write the table to flash, and make it the most recent table if it was
+    // programmed correctly.
+    //
+    FlashProgram(g_uHPCal.pulWords, ulNew, HPCAL_SIZE);
+    for(ulIdx = 0; ulIdx < HPCAL_SIZE; ulIdx++)
+    {
+        if(HWREGB(ulNew + ulIdx) != g_uHPCal.pucBytes[ulIdx])
+        {
+            return;
+        }
+    }
+    g_ulHPCalCurrent = ulNew;
+}
+
+//*****************************************************************************
+//
+//! Initializes the handpiece calibration store.
+//!
+//! This function finds the most recent calibration table in flash and loads
+//! it into RAM, or starts with an empty table if there is not one.  The flash
+//! controller timing must already have been set by FlashPBInit().
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+HPCalInit(void)
+{
+    unsigned long ulAddress, ulCurrent, ulIdx;
+    unsigned char ucOne, ucTwo;
+
+    //
+    // Simulate a hard fault if the table is not HPCAL_SIZE bytes.
+    //
+    if(sizeof(tHPCalBlock) != HPCAL_SIZE)
+    {
+        FaultISR();
+    }
+
+    //
+    // Find the valid table with the most recent sequence number, allowing
+    // for the sequence number wrapping.
+    //
+    for(ulAddress = HPCAL_START, ulCurrent = 0; ulAddress < HPCAL_END;
+        ulAddress += HPCAL_SIZE)
+    {
+        if(!HPCalIsValid(ulAddress))
+        {
+            continue;
+        }
+        if(ulCurrent != 0)
+        {
+            ucOne = HWREGB(ulCurrent + HPCAL_O_SEQUENCE);
+            ucTwo = HWREGB(ulAddress + HPCAL_O_SEQUENCE);
+            if(((ucOne > ucTwo) && ((ucOne - ucTwo) < 128)) ||
+               ((ucTwo > ucOne) && ((ucTwo - ucOne) > 128)))
+            {
+                continue;
+            }
+        }
+        ulCurrent = ulAddress;
+    }
+    g_ulHPCalCurrent = ulCurrent;
+
+    //
+    // Copy the most recent table into RAM, or start with an empty table.
+    //
+    if(ulCurrent)
+    {
+        for(ulIdx = 0; ulIdx < (HPCAL_SIZE / 4); ulIdx++)
+        {
+            g_uHPCal.pulWords[ulIdx] = HWREG(ulCurrent + (ulIdx * 4));
+        }
+    }
+    else
+    {
+        for(ulIdx = 0; ulIdx < (HPCAL_SIZE / 4); ulIdx++)
+        {
+            g_uHPCal.pulWords[ulIdx] = 0xffffffff;
+        }
+        g_uHPCal.sBlock.ucVersion = HPCAL_VERSION;
+    }
+}
+
+//*****************************************************************************
+//
+//! Gets the stored calibration of a handpiece.
+//!
+//! \param ulSerial is the serial number of the handpiece.
+//! \param psCal is a pointer to the calibration to be filled in.
+//! \param pucPolarity is a pointer to the polarity to be filled in.
+//!
+//! This function looks for the handpiece in the calibration table, and if it
+//! is found returns its calibration and the polarity of its trigger hall
+//! sensors.
+//!
+//! \return Returns \b true if the handpiece was found, and \b false if it was
+//! not (in which case the calibration and polarity are not modified).
+//
+//*****************************************************************************
+tBoolean
+HPCalLoad(unsigned long ulSerial, tThrottleCal *psCal,
+          unsigned char *pucPolarity)
+{
+    unsigned long ulIdx;
+
+    //
+    // Find the handpiece, failing if it is not in the table.
+    //
+    if(ulSerial == HPCAL_SERIAL_NONE)
+    {
+        return(false);
+    }
+    ulIdx = HPCalFind(ulSerial);
+    if(ulIdx == HPCAL_NUM_ENTRIES)
+    {
+        return(false);
+    }
+
+    //
+    // Return the calibration of the handpiece.
+    //
+    *psCal = g_uHPCal.sBlock.psEntry[ulIdx].sCal;
+    *pucPolarity = g_uHPCal.sBlock.psEntry[ulIdx].ucPolarity;
+    return(true);
+}
+
+//*****************************************************************************
+//
+//! Saves the calibration of a handpiece.
+//!
+//! \param ulSerial is the serial number of the handpiece.
+//! \param psCal is a pointer to the calibration of the handpiece.
+//! \param ucPolarity is the polarity of its trigger hall sensors.
+//!
+//! This function stores the calibration of the handpiece at the front of the
+//! calibration table, dropping the least recently saved handpiece if the
+//! handpiece is not already in the table, and writes the table to flash.
+//! Nothing is written if the stored calibration is already the same.
+//!
+//! This stalls the processor while the flash is programmed (and, one time in
+//! four, erased), so it must not be called while the motor is running.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+HPCalSave(unsigned long ulSerial, const tThrottleCal *psCal,
+          unsigned char ucPolarity)
+{
+    unsigned long ulIdx, ulHall;
+    tHPCalEntry *psEntry;
+
+    //
+    // A handpiece without a serial number can not be stored.
+    //
+    if(ulSerial == HPCAL_SERIAL_NONE)
+    {
+        return;
+    }
+
+    //
+    // Find the handpiece in the table.
+    //
+    ulIdx = HPCalFind(ulSerial);
+
+    //
+    // If the handpiece is in the table, return without writing if its
+    // calibration has not changed.
+    //
+    if(ulIdx != HPCAL_NUM_ENTRIES)
+    {
+        psEntry = &(g_uHPCal.sBlock.psEntry[ulIdx]);
+        for(ulHall = 0; ulHall < UI_NUM_HALLS; ulHall++)
+        {
+            if((psEntry->sCal.pusHallRest[ulHall] !=
+                psCal->pusHallRest[ulHall]) ||
+               (psEntry->sCal.pusHallPeak[ulHall] !=
+                psCal->pusHallPeak[ulHall]))
+            {
+                break;
+            }
+        }
+        if((ulHall == UI_NUM_HALLS) && (psEntry->ucPolarity == ucPolarity))
+        {
+            return;
+        }
+    }
+    else
+    {
+        //
+        // The handpiece is not in the table, so the last entry is replaced.
+        //
+        ulIdx = HPCAL_NUM_ENTRIES - 1;
+    }
+
+    //
+    // Move the entries in front of this one back by one, and put this
+    // handpiece at the front.
+    //
+    for(; ulIdx > 0; ulIdx--)
+    {
+        g_uHPCal.sBlock.psEntry[ulIdx] = g_uHPCal.sBlock.psEntry[ulIdx - 1];
+    }
+    psEntry = &(g_uHPCal.sBlock.psEntry[0]);
+    psEntry->ulSerial = ulSerial;
+    psEntry->sCal = *psCal;
+    psEntry->ucPolarity = ucPolarity;
+    psEntry->pucReserved[0] = 0;
+    psEntry->pucReserved[1] = 0;
+    psEntry->pucReserved[2] = 0;
+
+    //
+    // Write the table to flash.
+    //
+    HPCalWrite();
+}
+
+//*****************************************************************************
+//
+// Close the Doxygen group.
+//! @}
+//
+//*****************************************************************************
@@ -0,0 +1,29 @@
+//*****************************************************************************
+//
+// hp_cal.h - Prototypes for the handpiece calibration store.
+//
+//*****************************************************************************
+
+#ifndef __HP_CAL_H__
+#define __HP_CAL_H__
+
+//*****************************************************************************
+//
+//! The serial number of a handpiece that can not be stored, which is also
+//! what is read from an unprogrammed handpiece EEPROM.
+//
+//*****************************************************************************
+#define HPCAL_SERIAL_NONE       0xffffffff
+
+//*****************************************************************************
+//
+// Prototypes for the exported functions.
+//
+//*****************************************************************************
+extern void HPCalInit(void);
+extern tBoolean HPCalLoad(unsigned long ulSerial, tThrottleCal *psCal,
+                          unsigned char *pucPolarity);
+extern void HPCalSave(unsigned long ulSerial, const tThrottleCal *psCal,
+                      unsigned char ucPolarity);
+
+#endif // __HP_CAL_H__
@@ -237,7 +237,7 @@ int IrrGetLevel(int level)
 	//compare the result unless level is zero
 	if ( !level )
 	{
-		if (level != rev & 0x1FF ) 
+		if (level != (rev & 0x1FF) ) 
 		{
 		    return -1;
 		}
@@ -0,0 +1,269 @@
+//*****************************************************************************
+//
+// isr_prof.c - Interrupt handler execution profiler.
+//
+//*****************************************************************************
+
+#include "inc/hw_ints.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_timer.h"
+#include "inc/hw_types.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/timer.h"
+#include "isr_prof.h"
+
+//*****************************************************************************
+//
+//! \page isr_prof_intro Introduction
+//!
+//! The interrupt handler profiler measures how many system clocks each of the
+//! motor control interrupt handlers takes to execute, so that the headroom
+//! left at a given PWM frequency and update rate can be determined on the
+//! running drive.
+//!
+//! A free-running 32-bit timer (Timer3) counts down at the system clock rate.
+//! Each profiled handler calls ISRProfileStart() on entry and ISRProfileEnd()
+//! on every exit; the difference between the two timer readings is the time
+//! spent in the handler.  The time spent in any profiled handler that
+//! pre-empts another is accumulated and subtracted from the pre-empted
+//! handler, so the times reported for the handlers do not overlap.  Time
+//! spent in an unprofiled handler (such as the Timer1A tick) is charged to
+//! the profiled handler that it pre-empted.
+//!
+//! The minimum, maximum and call count are kept from the last reset, while
+//! the mean is recomputed from the calls made during each user interface
+//! tick by ISRProfileTick().  Each handler's profile is reported as a
+//! real-time data item, and the profile is cleared with the
+//! #CMD_RESET_ISR_PROFILE command.
+//!
+//! The code for the profiler is contained in <tt>isr_prof.c</tt>, with
+//! <tt>isr_prof.h</tt> containing the definitions for the variables and
+//! functions exported to the remainder of the application.
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! \defgroup isr_prof_api Definitions
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! The base address of the timer used to time the interrupt handlers.
+//
+//*****************************************************************************
+#define ISR_PROFILE_TIMER       TIMER3_BASE
+
+//*****************************************************************************
+//
+//! The execution profile of each of the profiled interrupt handlers.
+//
+//*****************************************************************************
+tISRProfile g_psISRProfile[ISR_PROFILE_NUM];
+
+//*****************************************************************************
+//
+//! The total time spent in all of the profiled interrupt handlers.  This is
+//! used to remove the time spent in nested handlers from the time of the
+//! handler that they pre-empted.
+//
+//*****************************************************************************
+static unsigned long g_ulISRProfileNested;
+
+//*****************************************************************************
+//
+//! Marks the entry to a profiled interrupt handler.
+//!
+//! \param ulISR is the handler being entered; must be one of the
+//! \b ISR_PROFILE_xxx values.
+//!
+//! This function must be called at the start of the interrupt handler.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+ISRProfileStart(unsigned long ulISR)
+{
+    tISRProfile *psProfile = &(g_psISRProfile[ulISR]);
+
+    //
+    // Save the nested handler time and the current time.  The timer is read
+    // last so that the profiler's own time is not charged to the handler.
+    //
+    psProfile->ulNested = g_ulISRProfileNested;
+    psProfile->ulStart = HWREG(ISR_PROFILE_TIMER + TIMER_O_TAR);
+}
+
+//*****************************************************************************
+//
+//! Marks the exit from a profiled interrupt handler.
+//!
+//! \param ulISR is the handler being exited; must be one of the
+//! \b ISR_PROFILE_xxx values.
+//!
+//! This function must be called immediately before each return from the
+//! interrupt handler.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+ISRProfileEnd(unsigned long ulISR)
+{
+    tISRProfile *psProfile = &(g_psISRProfile[ulISR]);
+    unsigned long ulTime;
+
+    //
+    // Compute the time since the handler was entered (the timer counts
+    // down), less the time spent in any profiled handler that pre-empted it.
+    //
+    ulTime = psProfile->ulStart - HWREG(ISR_PROFILE_TIMER + TIMER_O_TAR);
+    ulTime -= g_ulISRProfileNested - psProfile->ulNested;
+
+    //
+    // Charge this time to any handler that this one pre-empted.
+    //
+    g_ulISRProfileNested += ulTime;
+
+    //
+    // Update the profile of this handler.
+    //
+    if(ulTime < psProfile->ulMin)
+    {
+        psProfile->ulMin = ulTime;
+    }
+    if(ulTime > psProfile->ulMax)
+    {
+        psProfile->ulMax = ulTime;
+    }
+    psProfile->ulCount++;
+    psProfile->ulSum += ulTime;
+    psProfile->ulSamples++;
+}
+
+//*****************************************************************************
+//
+//! Updates the mean execution time of the profiled interrupt handlers.
+//!
+//! This function is called by the user interface tick to compute the mean
+//! execution time of each handler over the calls made since the previous
+//! tick.  The mean of a handler that was not called during the tick is left
+//! unchanged.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+ISRProfileTick(void)
+{
+    unsigned long ulIdx, ulSum, ulSamples;
+
+    //
+    // Loop through the profiled handlers.
+    //
+    for(ulIdx = 0; ulIdx < ISR_PROFILE_NUM; ulIdx++)
+    {
+        //
+        // Take the totals for this tick and restart them.  Interrupts are
+        // disabled so that a call to the handler can not fall between the
+        // two.
+        //
+        IntMasterDisable();
+        ulSum = g_psISRProfile[ulIdx].ulSum;
+        ulSamples = g_psISRProfile[ulIdx].ulSamples;
+        g_psISRProfile[ulIdx].ulSum = 0;
+        g_psISRProfile[ulIdx].ulSamples = 0;
+        IntMasterEnable();
+
+        //
+        // Compute the new mean if the handler was called.
+        //
+        if(ulSamples != 0)
+        {
+            g_psISRProfile[ulIdx].ulMean = ulSum / ulSamples;
+        }
+    }
+}
+
+//*****************************************************************************
+//
+//! Resets the execution profile of all the interrupt handlers.
+//!
+//! This function clears the minimum, maximum, mean and call count of each of
+//! the profiled handlers.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+ISRProfileReset(void)
+{
+    unsigned long ulIdx;
+
+    //
+    // Loop through the profiled handlers.
+    //
+    for(ulIdx = 0; ulIdx < ISR_PROFILE_NUM; ulIdx++)
+    {
+        //
+        // Clear the profile of this handler.  Interrupts are disabled so that
+        // the handler can not update it part way through.
+        //
+        IntMasterDisable();
+        g_psISRProfile[ulIdx].ulMin = 0xffffffff;
+        g_psISRProfile[ulIdx].ulMax = 0;
+        g_psISRProfile[ulIdx].ulMean = 0;
+        g_psISRProfile[ulIdx].ulCount = 0;
+        g_psISRProfile[ulIdx].ulSum = 0;
+        g_psISRProfile[ulIdx].ulSamples = 0;
+        IntMasterEnable();
+    }
+}
+
+//*****************************************************************************
+//
+//! Initializes the interrupt handler profiler.
+//!
+//! This function starts the profile timer and resets the profile of each of
+//! the handlers.  It must be called before any of the profiled interrupts are
+//! enabled.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+ISRProfileInit(void)
+{
+    //
+    // Enable the profile timer, in both run and sleep mode (the handlers never
+    // run while the processor is sleeping, but it saves having to account for
+    // a stopped timer).
+    //
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER3);
+    SysCtlPeripheralSleepEnable(SYSCTL_PERIPH_TIMER3);
+
+    //
+    // Configure the profile timer to count down through its full 32-bit range,
+    // with no interrupt.
+    //
+    TimerConfigure(ISR_PROFILE_TIMER, TIMER_CFG_32_BIT_PER);
+    TimerLoadSet(ISR_PROFILE_TIMER, TIMER_A, 0xffffffff);
+    TimerEnable(ISR_PROFILE_TIMER, TIMER_A);
+
+    //
+    // Start with an empty profile.
+    //
+    g_ulISRProfileNested = 0;
+    ISRProfileReset();
+}
+
+//*****************************************************************************
+//
+// Close the Doxygen group.
+//! @}
+//
+//*****************************************************************************
@@ -0,0 +1,105 @@
+//*****************************************************************************
+//
+// isr_prof.h - Prototypes for the interrupt handler execution profiler.
+//
+//*****************************************************************************
+
+#ifndef __ISR_PROF_H__
+#define __ISR_PROF_H__
+
+//*****************************************************************************
+//
+//! \addtogroup isr_prof_api
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! The interrupt handlers that are profiled.  These are used to index the
+//! g_psISRProfile array.
+//
+//*****************************************************************************
+#define ISR_PROFILE_ADC         0
+#define ISR_PROFILE_PWM         1
+#define ISR_PROFILE_MS_TICK     2
+#define ISR_PROFILE_HALL        3
+#define ISR_PROFILE_ETHERNET    4
+#define ISR_PROFILE_NUM         5
+
+//*****************************************************************************
+//
+//! The execution profile of one interrupt handler.  The first four members
+//! are reported, in this order, as the real-time data item for the handler;
+//! the remainder are working values used by the profiler.  All times are in
+//! system clocks and exclude the time spent in any other profiled handler
+//! that pre-empted this one.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The shortest execution time seen since the last reset, or 0xffffffff
+    //! if the handler has not run since then.
+    //
+    unsigned long ulMin;
+
+    //
+    //! The longest execution time seen since the last reset.
+    //
+    unsigned long ulMax;
+
+    //
+    //! The average execution time over the most recent user interface tick.
+    //
+    unsigned long ulMean;
+
+    //
+    //! The number of times the handler has run since the last reset.
+    //
+    unsigned long ulCount;
+
+    //
+    //! The total execution time during the current user interface tick.
+    //
+    unsigned long ulSum;
+
+    //
+    //! The number of times the handler has run during the current user
+    //! interface tick.
+    //
+    unsigned long ulSamples;
+
+    //
+    //! The profile timer value when the handler was entered.
+    //
+    unsigned long ulStart;
+
+    //
+    //! The value of the nested handler time accumulator when the handler was
+    //! entered.
+    //
+    unsigned long ulNested;
+}
+tISRProfile;
+
+//*****************************************************************************
+//
+// Close the Doxygen group.
+//! @}
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+// Prototypes for the exported variables and functions.
+//
+//*****************************************************************************
+extern tISRProfile g_psISRProfile[ISR_PROFILE_NUM];
+extern void ISRProfileStart(unsigned long ulISR);
+extern void ISRProfileEnd(unsigned long ulISR);
+extern void ISRProfileTick(void);
+extern void ISRProfileReset(void);
+extern void ISRProfileInit(void);
+
+#endif // __ISR_PROF_H__
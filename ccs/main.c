@@ -38,14 +38,20 @@
 #include "pins.h"
 #include "adc_ctrl.h"
 #include "brake.h"
+#include "capture.h"
 #include "commands.h"
 #include "faults.h"
+#include "foc.h"
 #include "hall_ctrl.h"
+#include "isr_prof.h"
 #include "main.h"
 #include "pwm_ctrl.h"
+#include "qei_ctrl.h"
+#include "telemetry.h"
 #include "trapmod.h"
 #include "irrigation.h"
 #include "ui.h"
+#include "hp_cal.h"
 #include "ui_uart.h"
 #include "stdlib.h"
 
@@ -300,6 +306,58 @@
 //*****************************************************************************
 #define DUTY_CYCLE_MAX     62260
 
+//*****************************************************************************
+//
+//! The anti-windup coefficient of the speed controller when the gain schedule
+//! is not in use, as a 16.16 fixed-point value.
+//
+//*****************************************************************************
+#define SPEED_GAIN_AW_DEFAULT   10000
+
+//*****************************************************************************
+//
+//! The gain of the position controller close to the target position, which
+//! is the speed reference per unit of distance left to the target, in RPM
+//! per revolution.  This gives a position loop time constant of 60 / 1500
+//! seconds, or 40 ms, which is slow enough for the speed loop to follow.
+//
+//*****************************************************************************
+#define POSITION_GAIN           1500
+
+//*****************************************************************************
+//
+//! The number of milliseconds over which the position controller measures
+//! the rotor speed from the encoder.  This must be a power of two.
+//
+//*****************************************************************************
+#define POSITION_HISTORY        4
+
+//*****************************************************************************
+//
+//! The time between Hall edges, in milliseconds, below which the position
+//! controller uses the speed measured by the Hall sensor routines.
+//
+//*****************************************************************************
+#define POSITION_HALL_TIME      8
+
+//*****************************************************************************
+//
+//! The distance from the end of a move, in tenths of a degree, within which
+//! the position controller stops driving the rotor.  With the Hall sensors,
+//! which give a few counts per revolution, this is just the target sector.
+//
+//*****************************************************************************
+#define POSITION_DEADBAND       10
+
+//*****************************************************************************
+//
+//! The rotor speed, in RPM, below which trapezoid modulation brakes the
+//! motor by shorting its windings within the position deadband.  The braking
+//! current is not regulated, so a faster rotor is left to coast instead.
+//
+//*****************************************************************************
+#define POSITION_BRAKE_SPEED    1000
+
 //*****************************************************************************
 //
 //! The default error check limit.
@@ -435,11 +493,13 @@ static long g_lSpeedIntegratorWE = 0;
 
 //*****************************************************************************
 //
-//! The offset of accumulator for the integral term of the PI controller for the motor
-//! drive duty cycle.
+//! The P, I and anti-windup coefficients of the speed controller in effect,
+//! as interpolated from the gain schedule at the target speed.
 //
 //*****************************************************************************
-long g_lSpeedIntegratorOffset = 0;
+static long g_lSpeedGainP;
+static long g_lSpeedGainI;
+static long g_lSpeedGainAW;
 
 //*****************************************************************************
 //
@@ -451,6 +511,117 @@ long g_lSpeedIntegratorOffset = 0;
 //*****************************************************************************
 static long g_lSpeedIntegratorMax;
 
+//*****************************************************************************
+//
+//! The speed reference of the speed controller, specified in RPM.  This is
+//! the target speed shaped by the S-curve speed trajectory, or in power
+//! control mode the target speed reduced as required to hold the motor power
+//! at the target power.
+//
+//*****************************************************************************
+static unsigned long g_ulSpeedReference;
+
+//*****************************************************************************
+//
+//! The target of the power controller, specified in microwatts.  This ramps
+//! towards the target power at the power acceleration and deceleration rates.
+//
+//*****************************************************************************
+static unsigned long g_ulPowerTarget;
+
+//*****************************************************************************
+//
+//! The accumulator for the integral term of the power controller, which is
+//! the speed reference in 24.8 fixed-point RPM.
+//
+//*****************************************************************************
+static long g_lPowerIntegrator;
+
+//*****************************************************************************
+//
+//! The motor current reference produced by the speed controller for the
+//! current controller, specified in milliamperes.  This is only negative in
+//! position control mode, where it asks for torque against the direction of
+//! rotation to brake the motor or to hold it at the target position.
+//
+//*****************************************************************************
+long g_lCurrentRef = 0;
+
+//*****************************************************************************
+//
+//! A boolean that is true when the current controller is driving the motor
+//! with a negative current reference, which is applied by driving the phases
+//! in the opposite sense.
+//
+//*****************************************************************************
+static tBoolean g_bCurrentNegative = false;
+
+//*****************************************************************************
+//
+//! The closed-loop bandwidth of the motor current controller, specified in
+//! Hz.  The current controller gains are computed from this and the motor
+//! resistance and inductance.
+//
+//*****************************************************************************
+unsigned short g_usCurrentBandwidth = 500;
+
+//*****************************************************************************
+//
+//! The line-to-line resistance of the motor, specified in milliohms.
+//
+//*****************************************************************************
+unsigned short g_usMotorResistance = 1200;
+
+//*****************************************************************************
+//
+//! The line-to-line inductance of the motor, specified in microhenries.
+//
+//*****************************************************************************
+unsigned short g_usMotorInductance = 400;
+
+//*****************************************************************************
+//
+//! The P coefficient of the current controller, as a 16.16 fixed-point value
+//! in millivolts per milliamp.
+//
+//*****************************************************************************
+static long g_lCurrentP;
+
+//*****************************************************************************
+//
+//! The I coefficient of the current controller, as a 16.16 fixed-point value
+//! in millivolts per milliamp per current sample.
+//
+//*****************************************************************************
+static long g_lCurrentI;
+
+//*****************************************************************************
+//
+//! The accumulator for the integral term of the current controller, which is
+//! the motor drive voltage in millivolts.
+//
+//*****************************************************************************
+static long g_lCurrentIntegrator;
+
+//*****************************************************************************
+//
+//! The velocity feed-forward term of the current controller, which is the
+//! motor Back EMF at the measured rotor speed, specified in millivolts.  In
+//! position control mode this is negative while the rotor turns against the
+//! direction of rotation.
+//
+//*****************************************************************************
+static long g_lVoltageFF;
+
+//*****************************************************************************
+//
+//! The DC bus voltage latched when the motor drive started, specified in
+//! millivolts.  Drive voltages are converted into duty cycles at this voltage
+//! instead of the measured one when bus compensation is disabled.
+//
+//*****************************************************************************
+static unsigned long g_ulDriveBusVoltage;
+
 //*****************************************************************************
 //
 //! The current state of the motor drive state machine.  This state machine
@@ -468,6 +639,128 @@ unsigned long g_ulState = STATE_STOPPED;
 //*****************************************************************************
 unsigned long g_ulMeasuredSpeed = 0;
 
+//*****************************************************************************
+//
+//! The target position of the motor in position control mode.  This is
+//! specified in tenths of a degree of mechanical rotation, from 0 to 3599.
+//
+//*****************************************************************************
+unsigned short g_usTargetPosition = 0;
+
+//*****************************************************************************
+//
+//! The current position of the motor.  This is specified in tenths of a
+//! degree of mechanical rotation, from 0 to 3599, and is measured from the
+//! encoder index if an encoder is present, or else from the position at
+//! which the Hall sensors were first seen.
+//
+//*****************************************************************************
+unsigned short g_usMotorPosition = 0;
+
+//*****************************************************************************
+//
+//! The position at which the present move ends, in counts of the position
+//! sensor.  This is on the same scale as the rotor position returned by
+//! MainPositionGet(), so it does not wrap at the end of a revolution.
+//
+//*****************************************************************************
+static long g_lPositionTarget;
+
+//*****************************************************************************
+//
+//! The speed reference of the present move before it is limited by the
+//! distance to the target, in thousandths of an RPM.  This ramps up at the
+//! acceleration rate.
+//
+//*****************************************************************************
+static unsigned long g_ulPositionSpeed;
+
+//*****************************************************************************
+//
+//! The speed reference produced by the position controller, in RPM.  This is
+//! signed, being positive towards the direction of rotation.
+//
+//*****************************************************************************
+static long g_lPositionSpeedRef;
+
+//*****************************************************************************
+//
+//! The integrator of the speed controller in position control mode.  Unlike
+//! that of the speed controller in the other control modes, this may be
+//! negative.
+//
+//*****************************************************************************
+static long g_lPositionIntegrator;
+
+//*****************************************************************************
+//
+//! The rotor position at each of the last #POSITION_HISTORY milliseconds, in
+//! the same sense as MainPositionGet(), and the index of the latest entry.
+//
+//*****************************************************************************
+static long g_plPositionHistory[POSITION_HISTORY];
+static unsigned long g_ulPositionHistoryIdx;
+
+//*****************************************************************************
+//
+//! The direction in which the rotor last moved, either 1 or -1, and a
+//! boolean that is true if it moved in the same direction the time before.
+//
+//*****************************************************************************
+static long g_lPositionStep = 1;
+static tBoolean g_bPositionSteady;
+
+//*****************************************************************************
+//
+//! The number of milliseconds since the rotor position last changed, and the
+//! number of milliseconds between the two changes before that.  These give
+//! the rotor speed at low speed when the position comes from the Hall
+//! sensors.
+//
+//*****************************************************************************
+static unsigned long g_ulPositionStepTime;
+static unsigned long g_ulPositionStepInterval;
+
+//*****************************************************************************
+//
+//! The rotor speed used by the position controller, in RPM.  This is signed,
+//! in the same sense as MainPositionGet().
+//
+//*****************************************************************************
+static long g_lPositionRotorSpeed;
+
+//*****************************************************************************
+//
+//! A boolean that is true while the rotor is within #POSITION_DEADBAND of the
+//! end of the move, where the position controller stops driving it.
+//
+//*****************************************************************************
+static tBoolean g_bPositionHold;
+
+//*****************************************************************************
+//
+//! The speed of the S-curve speed trajectory, in thousandths of an RPM.
+//
+//*****************************************************************************
+static unsigned long g_ulTrajSpeed;
+
+//*****************************************************************************
+//
+//! The acceleration of the S-curve speed trajectory, in RPM per second.  This
+//! is negative while the trajectory is slowing down.
+//
+//*****************************************************************************
+static long g_lTrajAccel;
+
+//*****************************************************************************
+//
+//! The speed last given by the S-curve speed trajectory, in RPM as an 18.14
+//! fixed-point value like #g_ulSpeed.  When the motor drive speed differs
+//! from this, the trajectory is restarted from the motor drive speed.
+//
+//*****************************************************************************
+static unsigned long g_ulTrajLast;
+
 
 //*****************************************************************************
 //
@@ -517,13 +810,6 @@ unsigned long g_ulMeasuredSpeedPrev;
 unsigned int startupCnt=250;
 
 
-//*****************************************************************************
-//
-//! The flag for integral offset updated
-//
-//*****************************************************************************
-
-unsigned char g_ucIntegralOffsetUpdated = 0x00;
 
 //*****************************************************************************
 //
@@ -565,7 +851,7 @@ __error__(char *pcFilename, unsigned long ulLine)
 //
 //*****************************************************************************
 #if defined(ewarm) || defined(DOXYGEN)
-static long
+long
 MainLongMul(long lX, long lY)
 {
     //
@@ -586,7 +872,7 @@ MainLongMul(long lX, long lY)
 }
 #endif
 #if defined(gcc) || defined(sourcerygxx) || defined(codered)
-static long __attribute__((naked))
+long __attribute__((naked))
 MainLongMul(long lX, long lY)
 {
     //
@@ -622,7 +908,7 @@ MainLongMul(long lX, long lY)
 }
 #endif
 #if defined(ccs)
-static long
+long
 MainLongMul(long lX, long lY)
 {
     //
@@ -641,90 +927,387 @@ MainLongMul(long lX, long lY)
     return(lX * lY);
 }
 #endif
+#if defined(sim)
+long
+MainLongMul(long lX, long lY)
+{
+    //
+    // The host simulation build has no access to the target instruction, so
+    // form the 64-bit product of the two 32-bit values directly.
+    //
+    return((long)(((int64_t)lX * lY) >> 16));
+}
+#endif
 
 //*****************************************************************************
 //
-//! Handles the Back EMF Timer Interrupt.
+//! Computes the integer square root of a value.
 //!
-//! This function is called when the Back EMF timer expires.  This code will
-//! set the Back EMF Hall state value to the next value, as determined by
-//! the Back EMF processing code.  If the motor is running in the startup
-//! state, then open-loop commutation of the motor is performed by indexing
-//! through a predefined hall sequence.  The timer is then restarted based
-//! on the period calculated in the startup state machine.  If the motor is
-//! running in the normal run state, then the motor is commutated based on
-//! the values calculated in the Back EMF processing code.  The timer will
-//! be restarted when the next zero-crossing event has been detected.
+//! \param ulValue is the value whose square root is to be computed.
 //!
-//! \return None.
+//! This function computes the square root, rounded down, a bit at a time.
+//!
+//! \return Returns the square root of the value.
 //
 //*****************************************************************************
-void
-Timer0AIntHandler(void)
+unsigned long
+MainSqrt(unsigned long ulValue)
 {
+    unsigned long ulRoot, ulBit;
+
     //
-    // Clear the Timer interrupt.
+    // Start with the largest power of four that is not larger than the value.
     //
-    TimerIntClear(TIMER0_BASE, TIMER_TIMA_TIMEOUT);
-
-    if(g_sParameters.ucModulationType == MOD_TYPE_SENSORLESS)
+    ulRoot = 0;
+    ulBit = 0x40000000;
+    while(ulBit > ulValue)
     {
-        //
-        // Punch the watchdog timer.
-        //
-        MainPunchWatchdog();
+        ulBit >>= 2;
+    }
 
-        //
-        // If running in startup mode, we are operating open loop, so just
-        // commute the motor and restart the timer.
-        //
-        if(g_ulState & STATE_FLAG_STARTUP)
+    //
+    // Determine each bit of the root, from the most significant down.
+    //
+    while(ulBit != 0)
+    {
+        if(ulValue >= (ulRoot + ulBit))
         {
-            static unsigned char ucHallSequence[6] = {5, 1, 3, 2, 6, 4};
-
-            //
-            // Commute the motor.
-            //
-            TrapModulate(ucHallSequence[g_ucStartupHallIndex]);
-
-            //
-            // Increment/Decrement the startup hall index for next time.
-            //
-            if((g_ulState & STATE_FLAG_FORWARD) == STATE_FLAG_BACKWARD)
-            {
-                g_ucStartupHallIndex--;
-                if(g_ucStartupHallIndex > 5)
-                {
-                    g_ucStartupHallIndex = 5;
-                }
-            }
-            else
-            {
-                g_ucStartupHallIndex++;
-                if(g_ucStartupHallIndex >5)
-                {
-                    g_ucStartupHallIndex = 0;
-                }
-            }
-
-            //
-            // Restart the timer for the next commutation.
-            //
-            HWREG(TIMER0_BASE + TIMER_O_TAILR) = g_ulStartupPeriod;
-            HWREG(TIMER0_BASE + TIMER_O_CTL) |=
-                (TIMER_A & (TIMER_CTL_TAEN | TIMER_CTL_TBEN));
+            ulValue -= ulRoot + ulBit;
+            ulRoot = (ulRoot >> 1) + ulBit;
         }
-        else if(g_ulState & STATE_FLAG_RUN)
+        else
         {
-            //
-            // Set the new Hall Sensor value.
-            //
-            g_ulBEMFHallValue = g_ulBEMFNextHall;
-
-            //
-            // If Motor is running and NOT startup mode, commute the motor.
-            //
-            TrapModulate(g_ulBEMFHallValue);
+            ulRoot >>= 1;
+        }
+        ulBit >>= 2;
+    }
+
+    //
+    // Return the square root.
+    //
+    return(ulRoot);
+}
+
+//*****************************************************************************
+//
+//! Gets the current for full scale torque demand.
+//!
+//! This function returns the motor current that corresponds to a full scale
+//! output from the speed controller.  This is the motor current limit for
+//! motor operation if one is set, otherwise the maximum motor current.
+//!
+//! \return Returns the full scale current, in milliamperes.
+//
+//*****************************************************************************
+static unsigned long
+MainCurrentLimit(void)
+{
+    if(g_sParameters.sTargetCurrent > 0)
+    {
+        return(g_sParameters.sTargetCurrent);
+    }
+    else
+    {
+        return(g_sParameters.sMaxCurrent);
+    }
+}
+
+//*****************************************************************************
+//
+//! Computes the speed controller feed-forward terms.
+//!
+//! \param ulSpeed is the rotor speed, specified in RPM.
+//! \param lAccel is the change in the motor drive speed over the last
+//! millisecond, in 18.14 fixed-point RPM.
+//!
+//! This function sets #g_lVoltageFF to the motor Back EMF at the given speed,
+//! found from the motor speed constant, so that the controllers only need to
+//! supply the remainder of the drive voltage.  The motor current needed to
+//! produce the commanded acceleration is found from the acceleration
+//! feed-forward gain.  Each term is disabled by setting its constant or gain
+//! to zero.
+//!
+//! \return Returns the acceleration feed-forward current, in milliamperes.
+//
+//*****************************************************************************
+static long
+MainSpeedFeedForward(unsigned long ulSpeed, long lAccel)
+{
+    //
+    // The Back EMF, in millivolts, is the speed divided by the speed
+    // constant.
+    //
+    if(g_sParameters.usMotorKv != 0)
+    {
+        g_lVoltageFF = (ulSpeed * 1000) / g_sParameters.usMotorKv;
+    }
+    else
+    {
+        g_lVoltageFF = 0;
+    }
+
+    //
+    // A change of one RPM per millisecond is 1000 RPM per second, so the
+    // acceleration current is the speed change (with its 14 fractional bits
+    // removed) times the gain.
+    //
+    return(MainLongMul(lAccel, (long)g_sParameters.usAccelFF << 2));
+}
+
+//*****************************************************************************
+//
+//! Gets the DC bus voltage at which to apply the drive voltage.
+//!
+//! This function returns the voltage at which drive voltages are converted
+//! into PWM duty cycles.  When bus compensation is enabled, this is the
+//! measured DC bus voltage, so that the drive voltage is held as the bus
+//! voltage changes.  Otherwise, it is the bus voltage when the motor drive
+//! started, so that the duty cycle does not follow the bus voltage.
+//!
+//! \return Returns the DC bus voltage, in millivolts.
+//
+//*****************************************************************************
+static unsigned long
+MainBusVoltage(void)
+{
+    if(HWREGBITH(&(g_sParameters.usFlags), FLAG_BUS_COMP_BIT) ==
+       FLAG_BUS_COMP_ON)
+    {
+        return(g_ulBusVoltage);
+    }
+    else
+    {
+        return(g_ulDriveBusVoltage);
+    }
+}
+
+//*****************************************************************************
+//
+//! Computes the current controller gains.
+//!
+//! This function computes the P and I coefficients of the current controller
+//! from the current loop bandwidth, the motor resistance and inductance, and
+//! the PWM frequency (the rate at which the current is sampled).  The
+//! proportional gain sets the bandwidth against the motor inductance, and the
+//! integral gain places the controller zero on the electrical pole of the
+//! motor (R/L) so that the closed loop responds as a single pole.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+MainSetCurrentGains(void)
+{
+    long lTemp;
+
+    //
+    // Kp = 2 * pi * bandwidth * L, in milliohms (mV/mA) as 16.16.  The
+    // constant 26986 is 2 * pi * 65536 / 1000000, as 16.16.
+    //
+    lTemp = (long)g_usCurrentBandwidth * (long)g_usMotorInductance;
+    g_lCurrentP = MainLongMul(lTemp, 26986);
+
+    //
+    // Ki = 2 * pi * bandwidth * R / Fpwm, per sample, as 16.16.  The constant
+    // is now 2 * pi * 65536 / 1000, which is applied as the constant above
+    // scaled up by 10 with the PWM frequency scaled down by 100.
+    //
+    lTemp = (long)g_usCurrentBandwidth * (long)g_usMotorResistance;
+    g_lCurrentI = ((MainLongMul(lTemp, 26986) * 10) /
+                   (long)(g_ulPWMFrequency / 100));
+}
+
+//*****************************************************************************
+//
+//! Runs the motor current controller.
+//!
+//! \param lCurrent is the measured motor current, in milliamperes.
+//!
+//! This function is called by the ADC interrupt handler with each new
+//! sample of the motor current while the motor drive is running in trapezoid
+//! or sensorless mode, after startup.  A PI controller adjusts the motor
+//! drive voltage to make the motor current track #g_lCurrentRef, on top of
+//! the Back EMF feed-forward in #g_lVoltageFF, and the voltage is converted
+//! into a duty cycle at the DC bus voltage given by MainBusVoltage().
+//!
+//! A negative current reference is applied by the trapezoid modulation
+//! driving the phases in the opposite sense (see TrapDrive()), so the
+//! controller regulates the magnitude of the current, against the Back EMF
+//! as seen by the reversed phases.  The integrator is cleared whenever the
+//! sign of the reference changes.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+MainCurrentControl(long lCurrent)
+{
+    unsigned long ulBusVoltage;
+    long lError, lVoltage, lVoltageMax, lVoltageFF, lRef;
+    tBoolean bNegative;
+
+    //
+    // Get the magnitude of the current reference and the Back EMF as seen by
+    // the phases being driven, restarting the integrator when the phases are
+    // reversed.
+    //
+    lRef = g_lCurrentRef;
+    lVoltageFF = g_lVoltageFF;
+    bNegative = (lRef < 0) ? true : false;
+    if(bNegative)
+    {
+        lRef = -lRef;
+        lVoltageFF = -lVoltageFF;
+    }
+    if(bNegative != g_bCurrentNegative)
+    {
+        g_bCurrentNegative = bNegative;
+        g_lCurrentIntegrator = 0;
+    }
+
+    //
+    // Determine the maximum drive voltage, in millivolts, and the part of it
+    // that is supplied by the feed-forward term.
+    //
+    ulBusVoltage = MainBusVoltage();
+    lVoltageMax = MainLongMul(ulBusVoltage, DUTY_CYCLE_MAX);
+    if(lVoltageFF > lVoltageMax)
+    {
+        lVoltageFF = lVoltageMax;
+    }
+    if(lVoltageFF < -lVoltageMax)
+    {
+        lVoltageFF = -lVoltageMax;
+    }
+
+    //
+    // Compute the error between the current reference and the measured
+    // current.
+    //
+    lError = lRef - lCurrent;
+
+    //
+    // Update the integrator, limiting it to the voltage that is available
+    // beyond the feed-forward term to avoid integrator windup.
+    //
+    g_lCurrentIntegrator += MainLongMul(g_lCurrentI, lError);
+    if(g_lCurrentIntegrator > (lVoltageMax - lVoltageFF))
+    {
+        g_lCurrentIntegrator = lVoltageMax - lVoltageFF;
+    }
+    if(g_lCurrentIntegrator < -lVoltageFF)
+    {
+        g_lCurrentIntegrator = -lVoltageFF;
+    }
+
+    //
+    // Perform the actual PI controller computation, adding the feed-forward
+    // term and limiting the output to the available voltage.
+    //
+    lVoltage = (MainLongMul(g_lCurrentP, lError) + g_lCurrentIntegrator +
+                lVoltageFF);
+    if(lVoltage > lVoltageMax)
+    {
+        lVoltage = lVoltageMax;
+    }
+    if(lVoltage < 0)
+    {
+        lVoltage = 0;
+    }
+
+    //
+    // Convert the voltage into a duty cycle and apply it.
+    //
+    if(ulBusVoltage != 0)
+    {
+        g_ulDutyCycle = ((unsigned long)lVoltage * 65536) / ulBusVoltage;
+        PWMSetDutyCycle(g_ulDutyCycle, g_ulDutyCycle, g_ulDutyCycle);
+    }
+}
+
+//*****************************************************************************
+//
+//! Handles the Back EMF Timer Interrupt.
+//!
+//! This function is called when the Back EMF timer expires.  This code will
+//! set the Back EMF Hall state value to the next value, as determined by
+//! the Back EMF processing code.  If the motor is running in the startup
+//! state, then open-loop commutation of the motor is performed by indexing
+//! through a predefined hall sequence.  The timer is then restarted based
+//! on the period calculated in the startup state machine.  If the motor is
+//! running in the normal run state, then the motor is commutated based on
+//! the values calculated in the Back EMF processing code.  The timer will
+//! be restarted when the next zero-crossing event has been detected.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+Timer0AIntHandler(void)
+{
+    //
+    // Clear the Timer interrupt.
+    //
+    TimerIntClear(TIMER0_BASE, TIMER_TIMA_TIMEOUT);
+
+    if(g_sParameters.ucModulationType == MOD_TYPE_SENSORLESS)
+    {
+        //
+        // Punch the watchdog timer.
+        //
+        MainPunchWatchdog();
+
+        //
+        // If running in startup mode, we are operating open loop, so just
+        // commute the motor and restart the timer.
+        //
+        if(g_ulState & STATE_FLAG_STARTUP)
+        {
+            static unsigned char ucHallSequence[6] = {5, 1, 3, 2, 6, 4};
+
+            //
+            // Commute the motor.
+            //
+            TrapModulate(ucHallSequence[g_ucStartupHallIndex]);
+
+            //
+            // Increment/Decrement the startup hall index for next time.
+            //
+            if((g_ulState & STATE_FLAG_FORWARD) == STATE_FLAG_BACKWARD)
+            {
+                g_ucStartupHallIndex--;
+                if(g_ucStartupHallIndex > 5)
+                {
+                    g_ucStartupHallIndex = 5;
+                }
+            }
+            else
+            {
+                g_ucStartupHallIndex++;
+                if(g_ucStartupHallIndex >5)
+                {
+                    g_ucStartupHallIndex = 0;
+                }
+            }
+
+            //
+            // Restart the timer for the next commutation.
+            //
+            HWREG(TIMER0_BASE + TIMER_O_TAILR) = g_ulStartupPeriod;
+            HWREG(TIMER0_BASE + TIMER_O_CTL) |=
+                (TIMER_A & (TIMER_CTL_TAEN | TIMER_CTL_TBEN));
+        }
+        else if(g_ulState & STATE_FLAG_RUN)
+        {
+            //
+            // Set the new Hall Sensor value.
+            //
+            g_ulBEMFHallValue = g_ulBEMFNextHall;
+
+            //
+            // If Motor is running and NOT startup mode, commute the motor.
+            //
+            TrapModulate(g_ulBEMFHallValue);
         }
     }
 }
@@ -797,11 +1380,10 @@ MainSetSpeed(void)
 //
 //! Changes the target power of the motor drive.
 //!
-//! This function changes the target power of the motor drive.  If
-//! required, the state machine will be transitioned to a new state in order to
-//! move the motor drive to the target power.
-//!
-//! \note This function is not yet implemented/used.
+//! This function changes the target power of the motor drive, which is
+//! clipped to the minimum and maximum power.  The target power is only used
+//! in power control mode, where the power controller ramps to it at the power
+//! acceleration and deceleration rates.
 //!
 //! \return None.
 //
@@ -810,7 +1392,7 @@ void
 MainSetPower(void)
 {
     //
-    // Clip the target speed to the minimum speed if it is too small.
+    // Clip the target power to the minimum power if it is too small.
     //
     if(g_sParameters.ulTargetPower < g_sParameters.ulMinPower)
     {
@@ -818,7 +1400,7 @@ MainSetPower(void)
     }
 
     //
-    // Clip the target speed to the maximum speed if it is too large.
+    // Clip the target power to the maximum power if it is too large.
     //
     if(g_sParameters.ulTargetPower > g_sParameters.ulMaxPower)
     {
@@ -828,108 +1410,767 @@ MainSetPower(void)
 
 //*****************************************************************************
 //
-//! Sets the direction of the motor drive.
+//! Resets the power controller.
 //!
-//! \param bForward is a boolean that is true if the motor drive should be
-//! run in the forward direction.
-//!
-//! This function changes the direction of the motor drive.  If required, the
-//! state machine will be transitioned to a new state in order to change the
-//! direction of the motor drive.
+//! This function starts the power controller with the power target at the
+//! target power and the speed reference at the target speed, so that the
+//! motor accelerates at the normal rate and the power controller only takes
+//! over once the motor power reaches the target power.  The power ramp rates
+//! then apply to later changes of the target power.
 //!
 //! \return None.
 //
 //*****************************************************************************
-void
-MainSetDirection(tBoolean bForward)
+static void
+MainPowerReset(void)
 {
-    //
-    // Temporarily disable the millisecond interrupt.
-    //
-    IntDisable(INT_PWM2);
+    g_ulSpeedReference = g_sParameters.ulTargetSpeed;
+    g_ulPowerTarget = g_sParameters.ulTargetPower * 1000;
+    g_lPowerIntegrator = g_ulSpeedReference << 8;
+}
+
+//*****************************************************************************
+//
+//! Adjusts the speed reference based on the motor power.
+//!
+//! This function ramps the power target towards the target power at the
+//! power acceleration and deceleration rates, then uses a PI controller to
+//! find the speed reference that holds the motor power at the power target.
+//! The speed reference is limited to the range between the minimum speed and
+//! the target speed, so the motor runs at the target speed whenever that
+//! takes less than the target power.
+//!
+//! \return Returns the new speed reference, specified in RPM.
+//
+//*****************************************************************************
+static unsigned long
+MainPowerController(void)
+{
+    unsigned long ulTarget, ulMin, ulMax;
+    long lError, lSpeed;
 
     //
-    // See if the motor should be running in the forward direction.
+    // Ramp the power target towards the target power.  The rates are in
+    // milliwatts per second, which is microwatts per millisecond.
     //
-    if(bForward)
+    ulTarget = g_sParameters.ulTargetPower * 1000;
+    if(g_ulPowerTarget < ulTarget)
     {
-        //
-        // See if the motor is presently running backward.
-        //
-        if(g_ulState == STATE_BACK_RUN)
+        g_ulPowerTarget += g_sParameters.usAccelPower;
+        if(g_ulPowerTarget > ulTarget)
         {
-            //
-            // If not already decelerating, then set the initial deceleration
-            // rate based on the configured parameter value.
-            //
-            if(g_ucMotorStatus != MOTOR_STATUS_DECEL)
-            {
-                g_ulDecelRate = g_sParameters.usDecel << 16;
-            }
+            g_ulPowerTarget = ulTarget;
+        }
+    }
+    else if(g_ulPowerTarget > ulTarget)
+    {
+        if((g_ulPowerTarget - ulTarget) > g_sParameters.usDecelPower)
+        {
+            g_ulPowerTarget -= g_sParameters.usDecelPower;
+        }
+        else
+        {
+            g_ulPowerTarget = ulTarget;
+        }
+    }
 
-            //
-            // Advance the state machine to the decelerate to reverse direction
-            // state.
+    //
+    // Determine the range of the speed reference.
+    //
+    ulMax = g_sParameters.ulTargetSpeed;
+    ulMin = ((g_sParameters.ulMinSpeed < ulMax) ? g_sParameters.ulMinSpeed :
+             ulMax);
+
+    //
+    // Compute the error between the power target and the motor power, in
+    // milliwatts.
+    //
+    lError = (long)(g_ulPowerTarget / 1000) - (long)g_ulMotorPower;
+
+    //
+    // Update the integrator, limiting it to the range of the speed reference
+    // to avoid integrator windup.
+    //
+    g_lPowerIntegrator += MainLongMul(g_sParameters.lPAdjI, lError * 256);
+    if(g_lPowerIntegrator > (long)(ulMax << 8))
+    {
+        g_lPowerIntegrator = ulMax << 8;
+    }
+    if(g_lPowerIntegrator < (long)(ulMin << 8))
+    {
+        g_lPowerIntegrator = ulMin << 8;
+    }
+
+    //
+    // Perform the actual PI controller computation, limiting the output to
+    // the range of the speed reference.
+    //
+    lSpeed = (MainLongMul(g_sParameters.lPAdjP, lError) +
+              (g_lPowerIntegrator / 256));
+    if(lSpeed > (long)ulMax)
+    {
+        lSpeed = ulMax;
+    }
+    if(lSpeed < (long)ulMin)
+    {
+        lSpeed = ulMin;
+    }
+
+    //
+    // Return the new speed reference.
+    //
+    return(lSpeed);
+}
+
+//*****************************************************************************
+//
+//! Gets the number of counts of the position sensor per revolution.
+//!
+//! This function returns the resolution of the rotor position.  The encoder
+//! provides four counts per line, while the Hall sensors provide six counts
+//! per electrical revolution, which is three counts per pole.
+//!
+//! Position control needs torque in both directions, which is only available
+//! from trapezoid modulation and field-oriented control, so there is no
+//! position to control when using sine wave modulation.
+//!
+//! \return Returns the number of counts per mechanical revolution, or zero if
+//! there is no position sensor.
+//
+//*****************************************************************************
+unsigned long
+MainPositionCounts(void)
+{
+    //
+    // Sine wave modulation can not brake the motor.
+    //
+    if(g_sParameters.ucModulationType == MOD_TYPE_SINE)
+    {
+        return(0);
+    }
+
+    //
+    // The encoder provides the position when it is present.
+    //
+    if((HWREGBITH(&(g_sParameters.usFlags), FLAG_ENCODER_BIT) ==
+        FLAG_ENCODER_PRESENT) && (g_sParameters.usEncoderLines != 0))
+    {
+        return(g_sParameters.usEncoderLines * 4);
+    }
+
+    //
+    // Otherwise, the Hall edges provide the position, provided that digital
+    // Hall sensors are being used.
+    //
+    if((g_sParameters.ucModulationType != MOD_TYPE_SENSORLESS) &&
+       (HWREGBITH(&(g_sParameters.usFlags), FLAG_SENSOR_TYPE_BIT) ==
+        FLAG_SENSOR_TYPE_GPIO))
+    {
+        return(g_sParameters.ucNumPoles * 3);
+    }
+
+    //
+    // There is no position sensor.
+    //
+    return(0);
+}
+
+//*****************************************************************************
+//
+//! Gets the position of the rotor.
+//!
+//! This function returns the rotor position from the same sensor that
+//! MainPositionCounts() describes.  The position does not wrap at the end of
+//! a revolution, and is signed so that it increases while the motor runs
+//! forward.
+//!
+//! \return Returns the rotor position, in counts of the position sensor.
+//
+//*****************************************************************************
+static long
+MainPositionGet(void)
+{
+    //
+    // Return the encoder position if the encoder is present, or else the
+    // Hall edge count.
+    //
+    if((HWREGBITH(&(g_sParameters.usFlags), FLAG_ENCODER_BIT) ==
+        FLAG_ENCODER_PRESENT) && (g_sParameters.usEncoderLines != 0))
+    {
+        return(g_lEncoderPosition);
+    }
+    return(g_lHallPosition);
+}
+
+//*****************************************************************************
+//
+//! Starts a move to the target position.
+//!
+//! This function finds the end of the move to #g_usTargetPosition, which is
+//! the nearest rotor position at the target angle, so the move goes forward
+//! or backward by no more than one half of a revolution.  A move from a
+//! running motor brakes to a stop first if it has to.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+MainPositionReset(void)
+{
+    unsigned long ulCounts;
+    long lPos, lTarget, lRemain;
+
+    //
+    // There is nothing to do if there is no position sensor.
+    //
+    ulCounts = MainPositionCounts();
+    if(ulCounts == 0)
+    {
+        return;
+    }
+
+    //
+    // Get the rotor position, in the direction of rotation.
+    //
+    lPos = MainPositionGet();
+    if(HWREGBITH(&(g_sParameters.usFlags), FLAG_DIR_BIT) ==
+       FLAG_DIR_BACKWARD)
+    {
+        lPos = -lPos;
+    }
+
+    //
+    // Convert the target position into counts, measured the same way.
+    //
+    lTarget = ((g_usTargetPosition * ulCounts) + 1800) / 3600;
+    if(HWREGBITH(&(g_sParameters.usFlags), FLAG_DIR_BIT) ==
+       FLAG_DIR_BACKWARD)
+    {
+        lTarget = -lTarget;
+    }
+
+    //
+    // Find the distance to the target, in the direction of rotation, modulo
+    // one revolution, and take the shorter way round.
+    //
+    lRemain = (lTarget - lPos) % (long)ulCounts;
+    if(lRemain < 0)
+    {
+        lRemain += ulCounts;
+    }
+    if(lRemain > (long)(ulCounts / 2))
+    {
+        lRemain -= ulCounts;
+    }
+
+    //
+    // Save the end of the move, in the same sense as MainPositionGet().
+    //
+    lTarget = lPos + lRemain;
+    if(HWREGBITH(&(g_sParameters.usFlags), FLAG_DIR_BIT) ==
+       FLAG_DIR_BACKWARD)
+    {
+        lTarget = -lTarget;
+    }
+    g_lPositionTarget = lTarget;
+
+    //
+    // Ramp the speed reference up from the measured speed.
+    //
+    g_ulPositionSpeed = g_ulMeasuredSpeed * 1000;
+}
+
+//*****************************************************************************
+//
+//! Adjusts the speed reference based on the rotor position.
+//!
+//! This function is the position loop of a position-velocity cascade, giving
+//! the speed reference for the speed controller from the distance left to
+//! the end of the move.  The speed reference is the speed from which the
+//! motor can just stop in that distance at the deceleration rate,
+//! sqrt(2 * a * d), limited to the target speed ramped up at the
+//! acceleration rate, giving a trapezoidal speed profile (or a triangular
+//! one for a short move).  Close to the target the speed reference is
+//! instead proportional to the distance (#POSITION_GAIN), so that the
+//! position loop has a finite gain about the target.  The speed reference
+//! is negative when the rotor is past the target, which brings it back.
+//! Within #POSITION_DEADBAND of the target the rotor is no longer driven, and
+//! a slow rotor is braked there instead; it is driven back if it is pushed
+//! out of the deadband.
+//!
+//! \return Returns the magnitude of the new speed reference, specified in
+//! RPM.
+//
+//*****************************************************************************
+static unsigned long
+MainPositionController(void)
+{
+    unsigned long ulCounts, ulRevs, ulRemain, ulSpeed, ulLinear;
+    long lRemain;
+
+    //
+    // Hold the motor if there is no position sensor.
+    //
+    ulCounts = MainPositionCounts();
+    if(ulCounts == 0)
+    {
+        g_lPositionSpeedRef = 0;
+        return(0);
+    }
+
+    //
+    // Get the distance left to the end of the move, in the direction of
+    // rotation.  This is negative if the rotor has overshot the target.
+    //
+    lRemain = g_lPositionTarget - MainPositionGet();
+    if(HWREGBITH(&(g_sParameters.usFlags), FLAG_DIR_BIT) ==
+       FLAG_DIR_BACKWARD)
+    {
+        lRemain = -lRemain;
+    }
+
+    //
+    // Stop driving the rotor once it is within the deadband about the end of
+    // the move.  The smallest drive the motor can be given moves it further
+    // than this, so regulating the speed here only drives it to and fro
+    // across the target.
+    //
+    ulRevs = (lRemain < 0) ? -lRemain : lRemain;
+    if(ulRevs <= ((ulCounts * POSITION_DEADBAND) / 3600))
+    {
+        g_bPositionHold = true;
+        g_lPositionSpeedRef = 0;
+        return(0);
+    }
+    g_bPositionHold = false;
+
+    //
+    // Convert the magnitude of the distance into revolutions, in 16.16
+    // fixed-point format, limiting it to sixteen revolutions.  The fraction
+    // is found eight bits at a time, since the remainder shifted up by
+    // sixteen bits at once overflows when there are more than 65536 counts
+    // per revolution (an encoder with more than 16384 lines).
+    //
+    if(ulRevs > (ulCounts * 16))
+    {
+        ulRevs = ulCounts * 16;
+    }
+    ulRemain = (ulRevs % ulCounts) << 8;
+    ulRevs = (((ulRevs / ulCounts) << 16) + ((ulRemain / ulCounts) << 8) +
+              (((ulRemain % ulCounts) << 8) / ulCounts));
+
+    //
+    // Find the speed from which the motor stops in this distance.  For a
+    // speed in RPM and a rate in RPM per second, this is
+    // sqrt(120 * a * revolutions).  Close to the target, limit it to the
+    // linear position loop.
+    //
+    ulSpeed = MainSqrt(MainLongMul(120 * g_sParameters.usDecel, ulRevs));
+    ulLinear = MainLongMul(POSITION_GAIN, ulRevs);
+    if(ulSpeed > ulLinear)
+    {
+        ulSpeed = ulLinear;
+    }
+
+    //
+    // Ramp the speed reference up towards the target speed at the
+    // acceleration rate, which is in RPM per second or thousandths of an RPM
+    // per millisecond, and limit the speed reference to it.
+    //
+    g_ulPositionSpeed += g_sParameters.usAccel;
+    if(g_ulPositionSpeed > (g_sParameters.ulTargetSpeed * 1000))
+    {
+        g_ulPositionSpeed = g_sParameters.ulTargetSpeed * 1000;
+    }
+    if(ulSpeed > (g_ulPositionSpeed / 1000))
+    {
+        ulSpeed = g_ulPositionSpeed / 1000;
+    }
+
+    //
+    // Save the signed speed reference and return its magnitude.
+    //
+    g_lPositionSpeedRef = (lRemain < 0) ? -(long)ulSpeed : (long)ulSpeed;
+    return(ulSpeed);
+}
+
+//*****************************************************************************
+//
+//! Updates the current position of the motor.
+//!
+//! This function converts the rotor position into the mechanical angle
+//! reported by #g_usMotorPosition, and finds the signed rotor speed used by
+//! the position controller.  With the encoder, this is the movement over the
+//! last #POSITION_HISTORY milliseconds, which responds faster at low speed
+//! than the encoder speed (measured over at least 256 counts).  The Hall
+//! sensors are too coarse for this.  Their speed estimate is used while the
+//! rotor turns steadily in one direction at speed, but it is not updated
+//! while the rotor rocks back and forth across one Hall edge, so at low
+//! speed the rotor speed is instead found from the time between the last
+//! two Hall edges, or the time since the last one if that is longer.  Either
+//! way, the speed is signed by the direction of the last Hall edge.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+MainPositionUpdate(void)
+{
+    unsigned long ulCounts, ulTime, ulSpeed;
+    long lPos, lDelta;
+
+    //
+    // There is no position to report without a position sensor.
+    //
+    ulCounts = MainPositionCounts();
+    if(ulCounts == 0)
+    {
+        return;
+    }
+
+    //
+    // Save the position in the history, noting the direction of the last
+    // movement of the rotor and the time between movements.
+    //
+    lPos = MainPositionGet();
+    lDelta = lPos - g_plPositionHistory[g_ulPositionHistoryIdx];
+    if(g_ulPositionStepTime < 1000)
+    {
+        g_ulPositionStepTime++;
+    }
+    if(lDelta != 0)
+    {
+        lDelta = (lDelta > 0) ? 1 : -1;
+        g_bPositionSteady = (lDelta == g_lPositionStep) ? true : false;
+        g_lPositionStep = lDelta;
+        g_ulPositionStepInterval = g_ulPositionStepTime;
+        g_ulPositionStepTime = 0;
+    }
+    g_ulPositionHistoryIdx = ((g_ulPositionHistoryIdx + 1) &
+                              (POSITION_HISTORY - 1));
+    lDelta = lPos - g_plPositionHistory[g_ulPositionHistoryIdx];
+    g_plPositionHistory[g_ulPositionHistoryIdx] = lPos;
+
+    //
+    // Find the signed rotor speed.
+    //
+    if((HWREGBITH(&(g_sParameters.usFlags), FLAG_ENCODER_BIT) ==
+        FLAG_ENCODER_PRESENT) && (g_sParameters.usEncoderLines != 0))
+    {
+        g_lPositionRotorSpeed = ((lDelta * 60000) /
+                                 (long)(ulCounts * POSITION_HISTORY));
+    }
+    else
+    {
+        ulTime = ((g_ulPositionStepTime > g_ulPositionStepInterval) ?
+                  g_ulPositionStepTime : g_ulPositionStepInterval);
+        ulSpeed = 60000 / (ulCounts * (ulTime ? ulTime : 1));
+        if(g_bPositionSteady && (ulTime < POSITION_HALL_TIME) &&
+           (g_ulMeasuredSpeed < (ulSpeed * 2)))
+        {
+            ulSpeed = g_ulMeasuredSpeed;
+        }
+        g_lPositionRotorSpeed = g_lPositionStep * (long)ulSpeed;
+    }
+
+    //
+    // Find the position within the revolution and convert it into tenths of
+    // a degree.
+    //
+    lPos %= (long)ulCounts;
+    if(lPos < 0)
+    {
+        lPos += ulCounts;
+    }
+    g_usMotorPosition = (lPos * 3600) / ulCounts;
+}
+
+//*****************************************************************************
+//
+//! Sets the target position of the motor drive.
+//!
+//! This function is called when the target position is changed.  A target
+//! of a revolution or more is wrapped into one revolution.  In position
+//! control mode, a running motor drive starts a move to the new target
+//! position; otherwise the new target is used by the next move.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+MainSetPosition(void)
+{
+    //
+    // Wrap the target position into one revolution, since a move goes to
+    // the nearest rotor position at the target angle in any case.
+    //
+    g_usTargetPosition %= 3600;
+
+    //
+    // Start a move to the new target position if the motor drive is running
+    // in position control mode.
+    //
+    IntDisable(INT_PWM2);
+    if((g_sParameters.ucControlType == CONTROL_TYPE_POSITION) &&
+       (g_ulState & STATE_FLAG_RUN))
+    {
+        MainPositionReset();
+    }
+    IntEnable(INT_PWM2);
+}
+
+//*****************************************************************************
+//
+//! Sets the direction of the motor drive.
+//!
+//! \param bForward is a boolean that is true if the motor drive should be
+//! run in the forward direction.
+//!
+//! This function changes the direction of the motor drive.  If required, the
+//! state machine will be transitioned to a new state in order to change the
+//! direction of the motor drive.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+MainSetDirection(tBoolean bForward)
+{
+    //
+    // Temporarily disable the millisecond interrupt.
+    //
+    IntDisable(INT_PWM2);
+
+    //
+    // See if the motor should be running in the forward direction.
+    //
+    if(bForward)
+    {
+        //
+        // See if the motor is presently running backward.
+        //
+        if(g_ulState == STATE_BACK_RUN)
+        {
+            //
+            // If not already decelerating, then set the initial deceleration
+            // rate based on the configured parameter value.
+            //
+            if(g_ucMotorStatus != MOTOR_STATUS_DECEL)
+            {
+                g_ulDecelRate = g_sParameters.usDecel << 16;
+            }
+
+            //
+            // Advance the state machine to the decelerate to reverse direction
+            // state.
             //
             g_ulState = STATE_BACK_REV;
         }
-
-        //
-        // See if the motor is presently running forward but in the process of
-        // reversing to the backward direction.
-        //
-        if(g_ulState == STATE_REV)
+
+        //
+        // See if the motor is presently running forward but in the process of
+        // reversing to the backward direction.
+        //
+        if(g_ulState == STATE_REV)
+        {
+            //
+            // Leave the motor drive running in the forward direction.
+            //
+            g_ulState = STATE_RUN;
+        }
+    }
+
+    //
+    // Otherwise the motor should be running in the backward direction.
+    //
+    else
+    {
+        //
+        // See if the motor is presently running forward.
+        //
+        if(g_ulState == STATE_RUN)
+        {
+            //
+            // If not already decelerating, then set the initial deceleration
+            // rate based on the configured parameter value.
+            //
+            if(g_ucMotorStatus != MOTOR_STATUS_DECEL)
+            {
+                g_ulDecelRate = g_sParameters.usDecel << 16;
+            }
+
+            //
+            // Advance the state machine to the decelerate to reverse direction
+            // state.
+            //
+            g_ulState = STATE_REV;
+        }
+
+        //
+        // See if the motor is presently running backward but in the process of
+        // reversing to the forward direction.
+        //
+        if(g_ulState == STATE_BACK_REV)
+        {
+            //
+            // Leave the motor drive running in the backward direction.
+            //
+            g_ulState = STATE_BACK_RUN;
+        }
+    }
+
+    //
+    // Re-enable the millisecond interrupt.
+    //
+    IntEnable(INT_PWM2);
+}
+
+//*****************************************************************************
+//
+//! Computes the speed controller coefficients from the gain schedule.
+//!
+//! This function interpolates the P, I and anti-windup coefficients of the
+//! speed controller between the two breakpoints of the gain schedule that
+//! bracket the speed reference.  Below the first breakpoint and above the last,
+//! the coefficients of that breakpoint are used.  If the gain schedule is not
+//! in use, the lFAdjP and lFAdjI coefficients are used at all speeds.
+//!
+//! Whenever the I coefficient changes, the integrator is rescaled so that the
+//! integral term of the controller output is unchanged, which makes any change
+//! of gain bumpless.  The integrator limit is recomputed at the same time so
+//! that the integral term alone can just reach the maximum duty cycle.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+MainSpeedGains(void)
+{
+    unsigned long ulIdx, ulPoints, ulSpeed, ulFrac;
+    long lP, lI, lAW, lTemp;
+
+    //
+    // Get the number of breakpoints in the gain schedule.
+    //
+    ulPoints = g_sParameters.ucGainPoints;
+    if(ulPoints > NUM_GAIN_POINTS)
+    {
+        ulPoints = NUM_GAIN_POINTS;
+    }
+
+    //
+    // See if the gain schedule is in use.
+    //
+    if(ulPoints == 0)
+    {
+        //
+        // Use the fixed coefficients.
+        //
+        lP = g_sParameters.lFAdjP;
+        lI = g_sParameters.lFAdjI;
+        lAW = SPEED_GAIN_AW_DEFAULT;
+    }
+    else
+    {
+        //
+        // Find the first breakpoint above the speed reference.
+        //
+        ulSpeed = g_ulSpeedReference;
+        for(ulIdx = 0; ulIdx < ulPoints; ulIdx++)
+        {
+            if(ulSpeed < g_sParameters.pusGainSpeed[ulIdx])
+            {
+                break;
+            }
+        }
+
+        //
+        // See if the target speed is outside the gain schedule.
+        //
+        if((ulIdx == 0) || (ulIdx == ulPoints))
+        {
+            //
+            // Use the coefficients of the nearest breakpoint.
+            //
+            if(ulIdx != 0)
+            {
+                ulIdx--;
+            }
+            lP = g_sParameters.plGainP[ulIdx];
+            lI = g_sParameters.plGainI[ulIdx];
+            lAW = g_sParameters.plGainAW[ulIdx];
+        }
+        else
         {
             //
-            // Leave the motor drive running in the forward direction.
+            // Interpolate between the breakpoints on either side of the
+            // target speed, using the position of the target speed between
+            // them as a 0.16 fixed-point fraction.
             //
-            g_ulState = STATE_RUN;
+            ulFrac = (((ulSpeed - g_sParameters.pusGainSpeed[ulIdx - 1]) <<
+                       16) /
+                      (g_sParameters.pusGainSpeed[ulIdx] -
+                       g_sParameters.pusGainSpeed[ulIdx - 1]));
+            lP = (g_sParameters.plGainP[ulIdx - 1] +
+                  MainLongMul(g_sParameters.plGainP[ulIdx] -
+                              g_sParameters.plGainP[ulIdx - 1], ulFrac));
+            lI = (g_sParameters.plGainI[ulIdx - 1] +
+                  MainLongMul(g_sParameters.plGainI[ulIdx] -
+                              g_sParameters.plGainI[ulIdx - 1], ulFrac));
+            lAW = (g_sParameters.plGainAW[ulIdx - 1] +
+                   MainLongMul(g_sParameters.plGainAW[ulIdx] -
+                               g_sParameters.plGainAW[ulIdx - 1], ulFrac));
         }
     }
 
     //
-    // Otherwise the motor should be running in the backward direction.
+    // See if the I coefficient has changed.
     //
-    else
+    if(lI != g_lSpeedGainI)
     {
-        //
-        // See if the motor is presently running forward.
-        //
-        if(g_ulState == STATE_RUN)
+        if(lI <= 0)
         {
             //
-            // If not already decelerating, then set the initial deceleration
-            // rate based on the configured parameter value.
+            // Since the I coefficient is zero, the integrator and integrator
+            // maximum are also zero.
             //
-            if(g_ucMotorStatus != MOTOR_STATUS_DECEL)
-            {
-                g_ulDecelRate = g_sParameters.usDecel << 16;
-            }
+            g_lSpeedIntegratorMax = 0;
+            g_lSpeedIntegrator = 0;
+        }
+        else
+        {
+            //
+            // Compute the integral term with the old I coefficient, which is
+            // no larger than the maximum duty cycle.
+            //
+            lTemp = MainLongMul(g_lSpeedGainI, g_lSpeedIntegrator);
 
             //
-            // Advance the state machine to the decelerate to reverse direction
-            // state.
+            // Compute the maximum value of the integrator, for which the
+            // integral term is the maximum duty cycle.
             //
-            g_ulState = STATE_REV;
-        }
+            g_lSpeedIntegratorMax = ((lI > 1) ?
+                                     (((DUTY_CYCLE_MAX << 15) / lI) << 1) :
+                                     0x7fffffff);
 
-        //
-        // See if the motor is presently running backward but in the process of
-        // reversing to the forward direction.
-        //
-        if(g_ulState == STATE_BACK_REV)
-        {
             //
-            // Leave the motor drive running in the backward direction.
+            // Rescale the integrator so that "old integrator * old I = new
+            // integrator * new I", which leaves the output unchanged.
             //
-            g_ulState = STATE_BACK_RUN;
+            g_lSpeedIntegrator = (((lTemp << 15) / lI) << 1);
+            if(g_lSpeedIntegrator > g_lSpeedIntegratorMax)
+            {
+                g_lSpeedIntegrator = g_lSpeedIntegratorMax;
+            }
         }
+        g_lSpeedGainI = lI;
     }
 
     //
-    // Re-enable the millisecond interrupt.
+    // Save the new P and anti-windup coefficients.
     //
-    IntEnable(INT_PWM2);
+    g_lSpeedGainP = lP;
+    g_lSpeedGainAW = lAW;
 }
 
 //*****************************************************************************
@@ -939,10 +2180,10 @@ MainSetDirection(tBoolean bForward)
 //! \param lNewFAdjI is the new value of the I coefficient.
 //!
 //! This function updates the value of the I coefficient of the duty cycle PI
-//! controller.  In addition to updating the I coefficient, it recomputes the
-//! maximum value of the integrator and the current value of the integrator in
-//! terms of the new I coefficient (eliminating any instantaneous jump in the
-//! output of the PI controller).
+//! controller, which is used when the gain schedule is not in use.  The
+//! controller coefficients are then recomputed, which rescales the integrator
+//! in terms of the new I coefficient (eliminating any instantaneous jump in
+//! the output of the PI controller).
 //!
 //! \return None.
 //
@@ -956,47 +2197,21 @@ MainUpdateFAdjI(long lNewFAdjI)
     IntDisable(INT_PWM2);
 
     //
-    // See if the new I coefficient is zero.
+    // Save the new I coefficient.
     //
-    if(lNewFAdjI == 0)
-    {
-        //
-        // Since the I coefficient is zero, the integrator and integrator
-        // maximum are also zero.
-        //
-        g_lSpeedIntegratorMax = 0;
-        g_lSpeedIntegrator = 0;
-    }
-    else
-    {
-        //
-        // Compute the maximum value of the integrator.  This is the value that
-        // results in the maximum output duty cycle (i.e. integrator max * I =
-        // max speed).
-        //
-        g_lSpeedIntegratorMax = 65536*100;
-
-        //
-        // Adjust the current value of the integrator to account for the new
-        // value of the I coefficient.  This satisfies the equation "old
-        // integrator * old I = new integrator * new I", so that the output
-        // doesn't immediately change (in a drastic way) as a result of the
-        // change in the I coefficient.
-        //
-        g_lSpeedIntegrator = ((g_lSpeedIntegrator / lNewFAdjI) *
-                                  g_sParameters.lFAdjI);
-    }
+    g_sParameters.lFAdjI = lNewFAdjI;
 
     //
-    // Save the new I coefficient.
+    // Recompute the controller coefficients.
     //
-    g_sParameters.lFAdjI = lNewFAdjI;
+    MainSpeedGains();
 
     //
     // Re-enable the millisecond interrupt.
     //
     IntEnable(INT_PWM2);
 }
+
 //*****************************************************************************
 //
 //! Handles the waveform update software interrupt.
@@ -1128,6 +2343,23 @@ MainPrechargeHandler(void)
         return;
     }
 
+    //
+    // Reset the current controller and compute its gains.
+    //
+    g_lCurrentRef = 0;
+    g_lCurrentIntegrator = 0;
+    g_lVoltageFF = 0;
+    g_ulDriveBusVoltage = g_ulBusVoltage;
+    MainSetCurrentGains();
+
+    //
+    // Reset the power controller, and start a move to the target position.
+    //
+    MainPowerReset();
+    g_lPositionIntegrator = 0;
+    g_bPositionHold = false;
+    MainPositionReset();
+
     if(g_sParameters.ucModulationType == MOD_TYPE_SENSORLESS)
     {
         //
@@ -1161,12 +2393,20 @@ MainPrechargeHandler(void)
 
     //
     // If trapezoid drive, kick start the motor by running a Hall interrupt.
-    // Otherwise, enable all the PWM outputs for other drive modes.
+    // For field-oriented control, reset the current controllers, enable all
+    // the PWM outputs, and run a Hall interrupt to find the starting rotor
+    // angle.  Otherwise, enable all the PWM outputs for other drive modes.
     //
     if(g_sParameters.ucModulationType == MOD_TYPE_TRAPEZOID)
     {
         GPIOBIntHandler();
     }
+    else if(g_sParameters.ucModulationType == MOD_TYPE_FOC)
+    {
+        FOCReset();
+        PWMOutputOn();
+        GPIOBIntHandler();
+    }
     else
     {
         PWMOutputOn();
@@ -1345,8 +2585,29 @@ MainStartupHandler(void)
             {
                 g_ulStartupState++;
                 g_ulStateCount = 10;
-                g_lSpeedIntegrator =
-                    (g_ulDutyCycle * 65536) / g_sParameters.lFAdjI ;
+
+                //
+                // Preload the current controller with the open-loop drive
+                // voltage less the feed-forward term, and the speed
+                // controller with the torque demand for the present motor
+                // current, so that the transfer into closed-loop mode is
+                // bumpless.
+                //
+                MainSpeedFeedForward(g_ulMeasuredSpeed, 0);
+                g_lCurrentIntegrator = (MainLongMul(g_ulDutyCycle,
+                                                    MainBusVoltage()) -
+                                        g_lVoltageFF);
+                g_lCurrentRef = (g_sMotorCurrent > 0) ? g_sMotorCurrent : 0;
+                ulTemp = MainCurrentLimit();
+                ulTemp = ulTemp ? ((g_lCurrentRef * 65536) / ulTemp) : 0;
+                if(ulTemp > DUTY_CYCLE_MAX)
+                {
+                    ulTemp = DUTY_CYCLE_MAX;
+                }
+                MainPowerReset();
+                MainSpeedGains();
+                g_lSpeedIntegrator = (g_lSpeedGainI > 0) ?
+                                     ((ulTemp * 65536) / g_lSpeedGainI) : 0;
                 g_ulAccelRate = g_sParameters.usAccel << 16;
                 g_ulDecelRate = g_sParameters.usDecel << 16;
 
@@ -1498,186 +2759,427 @@ MainCheckFaults(void)
     }
     else
     {
-    	currentLowLimitCnt = 0;
+    	currentLowLimitCnt = 0;
+    }
+
+    if( currentLowLimitCnt > MAIN_ERROR_CURRENT_LIMIT)
+    {
+    	//
+    	// Emergency stop the motor drive.
+    	//
+    	MainEmergencyStop();
+
+    	//
+    	// Indicate a motor undercurrent fault.
+    	//
+    	MainSetFault(FAULT_CURRENT_LOW);
+    }
+
+    //
+    // See if the motor current is above the maximum value.
+    //
+    if((g_sParameters.sMaxCurrent != 0) &&
+       (g_sMotorCurrent > g_sParameters.sMaxCurrent))
+    {
+    	currentHighLimitCnt++;
+    }
+    else
+    {
+    	currentHighLimitCnt = 0;
+    }
+
+    if( currentHighLimitCnt > MAIN_ERROR_CURRENT_LIMIT)
+    {
+        //
+        // Emergency stop the motor drive.
+        //
+        MainEmergencyStop();
+
+        //
+        // Indicate a motor overcurrent fault.
+        //
+        MainSetFault(FAULT_CURRENT_HIGH);
+    }
+}
+
+//*****************************************************************************
+//
+//! Adjusts the motor drive duty cycle based on the rotor speed.
+//!
+//! This function uses a PI controller to adjust the motor drive duty cycle
+//! in order to get the rotor speed to match the target speed.
+//!
+//! \return Returns the new motor drive duty cycle.
+//
+//*****************************************************************************
+unsigned long
+MainSpeedController(void)
+{
+    long lTempP, lTempI, lError;
+
+    //
+    // Compute the error between the current drive speed and the rotor speed.
+    // (-MaxSpeed < lError < MaxSpeed)
+    //
+    lError = (long)(g_ulSpeed >> 14) - (long)g_ulMeasuredSpeed;
+
+    //
+    // Add the error to the integrator accumulator, limiting the value of the
+    // accumulator.
+    //
+    g_lSpeedIntegrator += lError;
+    if(g_lSpeedIntegrator > g_lSpeedIntegratorMax)
+    {
+        g_lSpeedIntegrator = g_lSpeedIntegratorMax;
+    }
+    if(g_lSpeedIntegrator < 0)
+    {
+        g_lSpeedIntegrator = 0;
+    }
+
+    //
+    // Perform the actual PI controller computation.
+    //
+    lTempP = MainLongMul(g_sParameters.lFAdjP, lError);
+    lTempI = MainLongMul(g_sParameters.lFAdjI, g_lSpeedIntegrator);
+    lError = lTempP + lTempI;
+
+    //
+    // Limit the output of the PI controller based on the maximum speed
+    // parameter (and don't allow it to go below zero).
+    //
+    if(lError < 0)
+    {
+        lError = 100;
+    }
+    if(lError > 65536)
+    {
+        lError = 65536;
+    }
+
+    //
+    // Return the output of the PI controller.
+    //
+    return(lError);
+}
+
+//*****************************************************************************
+//
+//! Adjusts the speed controller output based on the rotor speed.
+//!
+//! This function uses a PI controller, with coefficients taken from the gain
+//! schedule at the speed reference, to get the rotor speed to match the speed
+//! reference.  When the output saturates, the excess is fed back into the
+//! integral term through the anti-windup coefficient.
+//!
+//! \return Returns the new speed controller output, as a 16.16 fixed-point
+//! fraction of full scale.
+//
+//*****************************************************************************
+unsigned long
+SpeedControllerPIU(void)
+{
+    long lTempP, lTempI,lError;
+
+    //
+    // Update the controller coefficients for the speed reference.
+    //
+    MainSpeedGains();
+
+    //
+    // Compute the error between the speed reference and the rotor speed.
+    // (-MaxSpeed < lError < MaxSpeed)
+    //
+    lError = g_ulSpeedReference - g_ulMeasuredSpeed;
+
+    g_lSpeedIntegrator += lError;
+    
+    if(g_lSpeedIntegrator > g_lSpeedIntegratorMax)
+    {
+        g_lSpeedIntegrator = g_lSpeedIntegratorMax;
+    }
+    if(g_lSpeedIntegrator < 0)
+    {
+        g_lSpeedIntegrator = 0;
+    }
+    
+    //
+    // Perform the actual PI controller computation.
+    //
+    lTempP = MainLongMul(g_lSpeedGainP, lError);
+    lTempI = MainLongMul(g_lSpeedGainI, g_lSpeedIntegrator);
+    g_lSpeedIntegratorWE = MainLongMul(g_lSpeedGainAW, g_lSpeedIntegratorWE);
+    lTempI += g_lSpeedIntegratorWE;
+
+    lError = lTempP + lTempI;
+
+
+    //
+    // Limit the output of the PI controller based on the maximum speed
+    // parameter (and don't allow it to go below zero).
+    //
+    if(lError < 0)
+    {
+        lError = 0;
+    }
+    if(lError > DUTY_CYCLE_MAX) //95% duty cycle
+    {
+        g_lSpeedIntegratorWE = DUTY_CYCLE_MAX - lError;
+        lError = DUTY_CYCLE_MAX;
+    }
+
+    //
+    // Return the output of the PI controller.
+    //
+    return(lError);
+}
+
+//*****************************************************************************
+//
+//! Runs the speed controller in position control mode.
+//!
+//! This function is the speed loop of the position-velocity cascade.  It is
+//! a PI controller with the same coefficients as the speed controller, but
+//! the speed reference from MainPositionController(), the measured rotor
+//! speed and the resulting torque demand are all signed, so that it can
+//! brake the motor and hold it at the target position against a load in
+//! either direction.  Within the deadband about the target it demands no
+//! torque, so that the minimum drive does not push the rotor to and fro
+//! across the target.
+//!
+//! \return Returns the motor current reference, specified in milliamperes.
+//! This is negative for torque against the direction of rotation.
+//
+//*****************************************************************************
+static long
+MainPositionSpeedControl(void)
+{
+    long lSpeed, lError, lOut;
+
+    //
+    // Update the controller coefficients for the speed reference.
+    //
+    MainSpeedGains();
+
+    //
+    // Get the rotor speed in the direction of rotation.
+    //
+    lSpeed = g_lPositionRotorSpeed;
+    if(HWREGBITH(&(g_sParameters.usFlags), FLAG_DIR_BIT) ==
+       FLAG_DIR_BACKWARD)
+    {
+        lSpeed = -lSpeed;
+    }
+
+    //
+    // The current controller compensates for the Back EMF at this speed,
+    // which is negative while the rotor turns backward.
+    //
+    MainSpeedFeedForward((lSpeed < 0) ? -lSpeed : lSpeed, 0);
+    if(lSpeed < 0)
+    {
+        g_lVoltageFF = -g_lVoltageFF;
     }
 
-    if( currentLowLimitCnt > MAIN_ERROR_CURRENT_LIMIT)
+    //
+    // Stop driving the rotor within the deadband about the target, clearing
+    // the integrator so that it does not wind up while the rotor is not
+    // driven.
+    //
+    if(g_bPositionHold)
     {
-    	//
-    	// Emergency stop the motor drive.
-    	//
-    	MainEmergencyStop();
-
-    	//
-    	// Indicate a motor undercurrent fault.
-    	//
-    	MainSetFault(FAULT_CURRENT_LOW);
+        g_lPositionIntegrator = 0;
+        return(0);
     }
 
     //
-    // See if the motor current is above the maximum value.
+    // Compute the error between the speed reference and the rotor speed,
+    // and integrate it, limiting the integral term to the maximum duty cycle
+    // in either direction.
     //
-    if((g_sParameters.sMaxCurrent != 0) &&
-       (g_sMotorCurrent > g_sParameters.sMaxCurrent))
+    lError = g_lPositionSpeedRef - lSpeed;
+    g_lPositionIntegrator += lError;
+    if(g_lPositionIntegrator > g_lSpeedIntegratorMax)
     {
-    	currentHighLimitCnt++;
+        g_lPositionIntegrator = g_lSpeedIntegratorMax;
     }
-    else
+    if(g_lPositionIntegrator < -g_lSpeedIntegratorMax)
     {
-    	currentHighLimitCnt = 0;
+        g_lPositionIntegrator = -g_lSpeedIntegratorMax;
     }
 
-    if( currentHighLimitCnt > MAIN_ERROR_CURRENT_LIMIT)
+    //
+    // Perform the PI controller computation, limiting the output to the
+    // maximum duty cycle in either direction.
+    //
+    lOut = (MainLongMul(g_lSpeedGainP, lError) +
+            MainLongMul(g_lSpeedGainI, g_lPositionIntegrator));
+    if(lOut > DUTY_CYCLE_MAX)
     {
-        //
-        // Emergency stop the motor drive.
-        //
-        MainEmergencyStop();
-
-        //
-        // Indicate a motor overcurrent fault.
-        //
-        MainSetFault(FAULT_CURRENT_HIGH);
+        lOut = DUTY_CYCLE_MAX;
     }
+    if(lOut < -DUTY_CYCLE_MAX)
+    {
+        lOut = -DUTY_CYCLE_MAX;
+    }
+
+    //
+    // Scale the torque demand into the motor current reference.
+    //
+    return((lOut * (long)MainCurrentLimit()) / 65536);
 }
 
 //*****************************************************************************
 //
-//! Adjusts the motor drive duty cycle based on the rotor speed.
+//! Shapes the target speed into an S-curve speed trajectory.
 //!
-//! This function uses a PI controller to adjust the motor drive duty cycle
-//! in order to get the rotor speed to match the target speed.
+//! \param ulTarget is the target speed of the motor drive, specified in RPM.
 //!
-//! \return Returns the new motor drive duty cycle.
+//! This function moves the speed of the trajectory towards the target speed
+//! with an acceleration that changes by no more than the jerk rate each
+//! millisecond, and that is limited to the acceleration rate when speeding
+//! up or the deceleration rate when slowing down.  The acceleration is wound
+//! back down as the speed nears the target speed, so that it reaches zero
+//! as the target speed is reached.  Since this is recomputed from the
+//! present speed and acceleration every millisecond, a new target speed
+//! can be given at any time, including part way through a ramp.
+//!
+//! The speed of the trajectory is used as the speed reference of the speed
+//! controller, and as the target speed of MainSpeedHandler(), which still
+//! applies the current and bus voltage based reductions of the acceleration
+//! and deceleration rates; if the motor drive speed falls behind the
+//! trajectory, the trajectory is restarted from the motor drive speed.
+//!
+//! \return Returns the speed of the trajectory, specified in RPM.
 //
 //*****************************************************************************
-unsigned long
-MainSpeedController(void)
+static unsigned long
+MainSpeedTrajectory(unsigned long ulTarget)
 {
-    long lTempP, lTempI, lError;
+    unsigned long ulLimit, ulRemain, ulRate, ulTime;
+    long lDir;
 
     //
-    // Compute the error between the current drive speed and the rotor speed.
-    // (-MaxSpeed < lError < MaxSpeed)
+    // Restart the trajectory from the motor drive speed if it is not
+    // following the trajectory.
     //
-    lError = (long)(g_ulSpeed >> 14) - (long)g_ulMeasuredSpeed;
+    if(g_ulSpeed != g_ulTrajLast)
+    {
+        g_ulTrajSpeed = (((g_ulSpeed >> 14) * 1000) +
+                         (((g_ulSpeed & 0x3FFF) * 1000) >> 14));
+    }
 
     //
-    // Add the error to the integrator accumulator, limiting the value of the
-    // accumulator.
+    // Pass the target speed straight through if the jerk rate is zero.
     //
-    g_lSpeedIntegrator += lError;
-    if(g_lSpeedIntegrator > g_lSpeedIntegratorMax)
-    {
-        g_lSpeedIntegrator = g_lSpeedIntegratorMax;
-    }
-    if(g_lSpeedIntegrator < 0)
+    if(g_sParameters.usJerk == 0)
     {
-        g_lSpeedIntegrator = 0;
+        g_lTrajAccel = 0;
+        g_ulTrajLast = ulTarget << 14;
+        return(ulTarget);
     }
 
     //
-    // Perform the actual PI controller computation.
+    // Convert the target speed into thousandths of an RPM, limiting it to
+    // the maximum speed.
     //
-    lTempP = MainLongMul(g_sParameters.lFAdjP, lError);
-    lTempI = MainLongMul(g_sParameters.lFAdjI, g_lSpeedIntegrator);
-    lError = lTempP + lTempI;
+    if(ulTarget > g_sParameters.ulMaxSpeed)
+    {
+        ulTarget = g_sParameters.ulMaxSpeed;
+    }
+    ulTarget *= 1000;
 
     //
-    // Limit the output of the PI controller based on the maximum speed
-    // parameter (and don't allow it to go below zero).
+    // Find the direction in which the speed must change, along with the
+    // distance to the target speed and the acceleration limit in that
+    // direction.
     //
-    if(lError < 0)
+    if(ulTarget > g_ulTrajSpeed)
     {
-        lError = 100;
+        lDir = 1;
+        ulRemain = ulTarget - g_ulTrajSpeed;
+        ulLimit = g_sParameters.usAccel;
     }
-    if(lError > 65536)
+    else if(ulTarget < g_ulTrajSpeed)
     {
-        lError = 65536;
+        lDir = -1;
+        ulRemain = g_ulTrajSpeed - ulTarget;
+        ulLimit = g_sParameters.usDecel;
+    }
+    else
+    {
+        lDir = 0;
+        ulRemain = 0;
+        ulLimit = 0;
     }
 
     //
-    // Return the output of the PI controller.
+    // Get the magnitude of the acceleration if it is towards the target
+    // speed, or zero if it is not.
     //
-    return(lError);
-}
+    ulRate = (((g_lTrajAccel * lDir) > 0) ? (g_lTrajAccel * lDir) : 0);
 
-unsigned long
-SpeedControllerPIU(void)
-{
-    long lTempP, lTempI,lError;
-    long Ka =10000;
     //
-    // Compute the error between the current drive speed and the rotor speed.
-    // (-MaxSpeed < lError < MaxSpeed)
+    // The speed covered while winding the acceleration back down to zero at
+    // the jerk rate is (a * t) / 2, where t = a / j milliseconds, with the
+    // acceleration in RPM per second giving the speed in thousandths of an
+    // RPM.  Start winding the acceleration down once this reaches the
+    // distance to the target speed; otherwise wind it up towards the limit.
+    // An acceleration away from the target speed (after the target speed
+    // has been changed part way through a ramp) is always wound down.
     //
-    lError = g_sParameters.ulTargetSpeed- g_ulMeasuredSpeed;
-
-    g_lSpeedIntegrator += lError;
-    
-    if(g_lSpeedIntegrator > g_lSpeedIntegratorMax)
+    ulTime = ulRate / g_sParameters.usJerk;
+    if((ulRate != 0) && ((ulTime + 1) >= ((ulRemain * 2) / ulRate)))
     {
-        g_lSpeedIntegrator = g_lSpeedIntegratorMax;
-    }
-    if(g_lSpeedIntegrator < 0)
-    {
-        g_lSpeedIntegrator = 0;
+        g_lTrajAccel -= lDir * g_sParameters.usJerk;
+        if((g_lTrajAccel * lDir) < 0)
+        {
+            g_lTrajAccel = 0;
+        }
     }
-    
-    //
-    // Perform the actual PI controller computation.
-    //
-    lTempP = MainLongMul(g_sParameters.lFAdjP, lError);
-    lTempI = MainLongMul(g_lFAdjI, g_lSpeedIntegrator);
-    g_lSpeedIntegratorWE = MainLongMul(Ka, g_lSpeedIntegratorWE);
-
-    // Calculate integral gain change offset to make sure a smooth transition
-    if(g_ucIntegralGainChanged)
+    else if(ulRate < ulLimit)
     {
-    	if(!g_ucIntegralOffsetUpdated)
-    	{
-    		g_lSpeedIntegratorOffset = lTempI - MainLongMul(g_lFAdjIPrev, g_lSpeedIntegrator);
-    		g_ucIntegralOffsetUpdated = 0x01;
-    	}
+        g_lTrajAccel += lDir * g_sParameters.usJerk;
+        if((g_lTrajAccel * lDir) > (long)ulLimit)
+        {
+            g_lTrajAccel = lDir * ulLimit;
+        }
     }
     else
     {
-        // update previous integral term
-        g_lFAdjIPrev = g_lFAdjI;
-
-    }
-    if(g_lSpeedIntegratorOffset == 0 && g_ucIntegralGainChanged)
-    {
-    	g_lSpeedIntegratorOffset = 0;
+        g_lTrajAccel = lDir * ulLimit;
     }
 
-    lTempI -= g_lSpeedIntegratorOffset;
-    lTempI += g_lSpeedIntegratorWE;
-
-    lError = lTempP + lTempI;
-
-
     //
-    // Limit the output of the PI controller based on the maximum speed
-    // parameter (and don't allow it to go below zero).
+    // Advance the speed by the acceleration, which in RPM per second is the
+    // change in thousandths of an RPM over a millisecond, stopping at zero.
+    // Once the target speed is reached (or passed), the trajectory stops
+    // there.
     //
-    if(lError < 0)
+    if((g_lTrajAccel < 0) && (g_ulTrajSpeed < (unsigned long)-g_lTrajAccel))
     {
-        lError = 0;
+        g_ulTrajSpeed = 0;
     }
-    if(lError > DUTY_CYCLE_MAX) //95% duty cycle
+    else
     {
-        g_lSpeedIntegratorWE = DUTY_CYCLE_MAX - lError;
-        lError = DUTY_CYCLE_MAX;
+        g_ulTrajSpeed += g_lTrajAccel;
+    }
+    if((lDir == 0) ||
+       ((lDir > 0) && ((long)(ulTarget - g_ulTrajSpeed) <= 0)) ||
+       ((lDir < 0) && ((long)(g_ulTrajSpeed - ulTarget) <= 0)))
+    {
+        g_ulTrajSpeed = ulTarget;
+        g_lTrajAccel = 0;
     }
 
     //
-    // Return the output of the PI controller.
+    // Return the speed of the trajectory, rounded to the nearest RPM, noting
+    // it in 18.14 fixed-point format to compare with the motor drive speed.
     //
-    return(lError);
+    g_ulTrajLast = ((g_ulTrajSpeed + 500) / 1000) << 14;
+    return(g_ulTrajLast >> 14);
 }
 
-
 //*****************************************************************************
 //
 //! Adjusts the motor drive speed based on the target speed.
@@ -2031,8 +3533,14 @@ MainSpeedHandler(unsigned long ulTarget)
 void
 MainMillisecondTick(void)
 {
-    unsigned long ulTarget;
-    static unsigned short cnt=0;
+    unsigned long ulTarget, ulBusVoltage;
+    long lAccel;
+    tBoolean bBrake;
+
+    //
+    // Mark the start of this handler for the profiler.
+    //
+    ISRProfileStart(ISR_PROFILE_MS_TICK);
 
     //
     // Update the state of the dynamic brake.
@@ -2044,6 +3552,11 @@ MainMillisecondTick(void)
     //
     MainCheckFaults();
 
+    //
+    // Sample the real-time data items for the batched real-time data stream.
+    //
+    TelemetryTick();
+
     //
     // Set the measured speed based on the encoder/sensor settings.
     //
@@ -2059,27 +3572,18 @@ MainMillisecondTick(void)
     else if(HWREGBITH(&(g_sParameters.usFlags), FLAG_SENSOR_TYPE_BIT) == 
             FLAG_SENSOR_TYPE_GPIO)
     {
-    	if( g_ulMeasuredSpeed == g_ulHallRotorSpeed )
-    	{    		
-    		cnt += 1;
-    	}    	
-    	else
-    	{
-    		cnt = 0;
-    	}	
-    	
-    	if(cnt > 20 )
-    	{
-    		g_ulHallRotorSpeed = 0;
-    	}
-    	
-    	g_ulMeasuredSpeed = g_ulHallRotorSpeed;
+        HallTickHandler();
+        g_ulMeasuredSpeed = g_ulHallRotorSpeed;
     }
     else
     {
         g_ulMeasuredSpeed = g_ulLinearRotorSpeed;
     }
 
+    //
+    // Update the motor position.
+    //
+    MainPositionUpdate();
 
     //
     // See if the motor drive is in precharge mode.
@@ -2094,6 +3598,7 @@ MainMillisecondTick(void)
         //
         // There is nothing further to be done for this state.
         //
+        ISRProfileEnd(ISR_PROFILE_MS_TICK);
         return;
     }
 
@@ -2110,6 +3615,7 @@ MainMillisecondTick(void)
         //
         // There is nothing further to be done for this state.
         //
+        ISRProfileEnd(ISR_PROFILE_MS_TICK);
         return;
     }
 
@@ -2132,16 +3638,31 @@ MainMillisecondTick(void)
         }
 
         //
-        // Otherwise, use the target speed specified from the UI.
+        // Otherwise, use the speed reference.
         //
         else
         {
-        	//
-        	// The target speed is the user supplied value,
-        	// converted to 18.14 fixed-point format.
-        	//
-        	ulTarget = (g_sParameters.ulTargetSpeed << 14);
-
+            //
+            // The speed reference is the user supplied target speed, reduced
+            // by the power controller in power control mode, given by the
+            // position controller in position control mode, or otherwise
+            // shaped into an S-curve trajectory, converted to 18.14
+            // fixed-point format.
+            //
+            if(g_sParameters.ucControlType == CONTROL_TYPE_POWER)
+            {
+                g_ulSpeedReference = MainPowerController();
+            }
+            else if(g_sParameters.ucControlType == CONTROL_TYPE_POSITION)
+            {
+                g_ulSpeedReference = MainPositionController();
+            }
+            else
+            {
+                g_ulSpeedReference =
+                    MainSpeedTrajectory(g_sParameters.ulTargetSpeed);
+            }
+            ulTarget = (g_ulSpeedReference << 14);
         }
 
         //
@@ -2172,9 +3693,18 @@ MainMillisecondTick(void)
 
         //
         // Handle the update to the motor drive speed based on the target
-        // speed.
+        // speed, noting the change in speed for the acceleration
+        // feed-forward term.  The motor drive is still accelerating or
+        // decelerating while the speed trajectory is.
         //
+        lAccel = g_ulSpeed;
         MainSpeedHandler(ulTarget);
+        lAccel = g_ulSpeed - lAccel;
+        if((g_ucMotorStatus == MOTOR_STATUS_RUN) && (g_lTrajAccel != 0))
+        {
+            g_ucMotorStatus = ((g_lTrajAccel > 0) ? MOTOR_STATUS_ACCEL :
+                               MOTOR_STATUS_DECEL);
+        }
 
         //
         // Compute the angle delta based on the new motor drive speed and the
@@ -2184,61 +3714,97 @@ MainMillisecondTick(void)
         g_ulAngleDelta *= (g_sParameters.ucNumPoles / 2);
 
         //
-        // Update the target Amplitude/Duty Cycle for the motor drive.
-        // First, check if current has exceeded maximum current value.  If
-        // it has, then just reduce the duty cycle to reduce current.
+        // Run the speed controller.  For sine wave modulation, its output is
+        // the drive amplitude, to which the feed-forward voltage (the Back
+        // EMF at the drive speed plus the resistive drop of the acceleration
+        // current) is added as a duty cycle at the DC bus voltage.
+        // Otherwise, its output is the torque demand, which is scaled into
+        // the reference for the current controller along with the
+        // acceleration current; the current controller adds the Back EMF at
+        // the measured speed and then sets the PWM duty cycles itself.
         //
-        if((g_sParameters.sTargetCurrent != 0) &&
-           (g_sMotorCurrent > g_sParameters.sTargetCurrent))
+        if(g_sParameters.ucModulationType == MOD_TYPE_SINE)
         {
-            static short sPreviousMotorCurrent = 0;
-
-            if(sPreviousMotorCurrent != g_sMotorCurrent)
+            lAccel = MainSpeedFeedForward(g_ulSpeed >> 14, lAccel);
+            lAccel = (g_lVoltageFF +
+                      ((lAccel * (long)g_usMotorResistance) / 1000));
+            ulBusVoltage = MainBusVoltage();
+            lAccel = ((ulBusVoltage >= 16) ?
+                      ((lAccel * 4096) / (long)(ulBusVoltage / 16)) : 0);
+            lAccel += (long)SpeedControllerPIU();
+            if(lAccel < 0)
             {
-                //
-                // Save the motor current value.
-                //
-                sPreviousMotorCurrent = g_sMotorCurrent;
-
-                //
-                // Get the difference between the target and motor current.
-                //
-                ulTarget = (g_sMotorCurrent - g_sParameters.sTargetCurrent);
-
-                //
-                // Compute the percentage over, in 16.16 fixed point format.
-                //
-                ulTarget = ((ulTarget * 65536) / g_sParameters.sTargetCurrent);
-
-                //
-                // Compute the equivalent percentage of the current duty cycle.
-                //
-                ulTarget = ((ulTarget * g_ulDutyCycle) / 65536);
-
-                //
-                // Reduce the duty cycle.
-                //
-                g_ulDutyCycle = g_ulDutyCycle - ulTarget;
+                lAccel = 0;
+            }
+            if(lAccel > DUTY_CYCLE_MAX)
+            {
+                lAccel = DUTY_CYCLE_MAX;
             }
+            g_ulDutyCycle = lAccel;
         }
-
-        //
-        // Here, we are under current, so just use the normal
-        // control algorithm to determine duty cycle.
-        //
-        else if((g_sParameters.sTargetCurrent == 0) ||
-           ((g_sParameters.sTargetCurrent != 0) &&
-            (g_sMotorCurrent <= g_sParameters.sTargetCurrent)))
+        else if((g_sParameters.ucControlType == CONTROL_TYPE_POSITION) &&
+                !(g_ulState & (STATE_FLAG_STOPPING | STATE_FLAG_REV)))
         {
-        	g_ulDutyCycle = SpeedControllerPIU();
+            //
+            // In position control mode, the signed speed controller gives a
+            // current reference that may be negative, to brake the motor or
+            // to hold it at the target position.  Trapezoid modulation
+            // applies a negative reference by driving the phases in the
+            // opposite sense, and lets the motor coast when no torque is
+            // demanded rather than driving it at the minimum pulse width.
+            // Within the deadband about the target, a slow motor is braked
+            // instead, since a coasting rotor with little friction would
+            // carry on out of the deadband, only to be driven back through
+            // it, and so on without end.
+            //
+            g_lCurrentRef = MainPositionSpeedControl();
+            bBrake = (g_bPositionHold &&
+                      (g_lPositionRotorSpeed < POSITION_BRAKE_SPEED) &&
+                      (g_lPositionRotorSpeed > -POSITION_BRAKE_SPEED));
+            if(g_sParameters.ucModulationType == MOD_TYPE_TRAPEZOID)
+            {
+                if(bBrake)
+                {
+                    TrapBrake(g_ulHallValue);
+                }
+                else
+                {
+                    TrapDrive(g_lCurrentRef, g_ulHallValue);
+                }
+            }
+            else
+            {
+                FOCBrake(bBrake);
+            }
         }
-        
-        if(g_sParameters.ucModulationType != MOD_TYPE_SINE)
+        else
         {
-            PWMSetDutyCycle(g_ulDutyCycle, g_ulDutyCycle, g_ulDutyCycle);
+            lAccel = MainSpeedFeedForward(g_ulMeasuredSpeed, lAccel);
+            lAccel += ((SpeedControllerPIU() * MainCurrentLimit()) / 65536);
+            if(lAccel < 0)
+            {
+                lAccel = 0;
+            }
+            if(lAccel > (long)MainCurrentLimit())
+            {
+                lAccel = MainCurrentLimit();
+            }
+            g_lCurrentRef = lAccel;
+            if(g_sParameters.ucModulationType == MOD_TYPE_TRAPEZOID)
+            {
+                TrapDrive(1, g_ulHallValue);
+            }
+            else
+            {
+                FOCBrake(false);
+            }
         }
-        
     }
+
+    //
+    // Mark the end of this handler for the profiler.
+    //
+    ISRProfileEnd(ISR_PROFILE_MS_TICK);
 }
 
 //*****************************************************************************
@@ -2248,7 +3814,8 @@ MainMillisecondTick(void)
 //! This function starts the motor drive.  If the motor is currently stopped,
 //! it will begin the process of starting the motor.  If the motor is currently
 //! stopping, it will cancel the stop operation and return the motor to the
-//! target speed.
+//! target speed.  The motor drive is not started in position control mode
+//! unless there is a position sensor.
 //!
 //! \return None.
 //
@@ -2265,6 +3832,16 @@ MainRun(void)
         return;
     }
 
+    //
+    // Do not allow the motor drive to start in position control mode without
+    // a position sensor, since there would be no position to control.
+    //
+    if((g_sParameters.ucControlType == CONTROL_TYPE_POSITION) &&
+       (MainPositionCounts() == 0))
+    {
+        return;
+    }
+
     //
     // Temporarily disable the millisecond interrupt.
     //
@@ -2282,6 +3859,7 @@ MainRun(void)
         //
     	g_ulAccelRate = g_sParameters.usAccel << 16;
     	g_ulDecelRate = g_sParameters.usDecel << 16;
+    	g_lTrajAccel = 0;
 
 
         //
@@ -2499,6 +4077,7 @@ MainEmergencyStop(void)
 
     g_ulAccelRate = g_sParameters.usAccel << 16;
     g_ulDecelRate = g_sParameters.usDecel << 16;
+    g_lTrajAccel = 0;
 
     g_lSpeedIntegrator = 0;
 
@@ -2640,6 +4219,15 @@ MainSetFault(unsigned long ulFaultFlag)
 		g_ulFaultFlags = ulFaultFlag;
 	}
 
+    //
+    // Stop recording the inputs, so that the capture buffer holds the inputs
+    // that led up to this fault.
+    //
+    if(g_ulCaptureMode == CAPTURE_MODE_RECORD)
+    {
+        CaptureStop();
+    }
+
 	//set the cutter fault output
 	if(g_ulFaultFlags & FAULT_MASK)
 	{
@@ -2727,34 +4315,79 @@ MainIsFaulted(void)
 
 //*****************************************************************************
 //
-//! Update operation time for handpiece.
+//! The number of seconds of operating time being written to the handpiece, or
+//! zero if there is no write in progress.
+//
+//*****************************************************************************
+static volatile unsigned long g_ulHPOpTimePending = 0;
+
+//*****************************************************************************
+//
+//! Completes the write of the operation time to the handpiece.
 //!
-//! This function will write the operation time to the handpiece
+//! This function is called when the handpiece has answered the write of the
+//! operation time, or has failed to.  The time written, which is held in
+//! g_ulHPOpTimePending, is only taken off the ticks count once it is in the
+//! handpiece.
 //!
 //! \return None.
 //
 //*****************************************************************************
+static void MainOpTimeWritten(void *pvCBData, int iLength)
+{
+	unsigned long llTimeTick = g_ulHPOpTimePending;
+
+	g_ulHPOpTimePending = 0;
+
+	//give up on a failed write, as when it could not be sent
+	if(iLength == -1)
+	{
+		g_ucUpdateOpTime = 0x00;
+		return;
+	}
+
+	//update operation time, and reset the ticks count to the remainder
+	g_ulHPOpTime += llTimeTick;
+	g_ulHPOpTicks = g_ulHPOpTicks - llTimeTick *200;
+}
+
+//*****************************************************************************
+//
+//! Update operation time for handpiece.
+//!
+//! This function will queue the write of the operation time to the handpiece,
+//! which is completed by MainOpTimeWritten().
+//!
+//! \return Returns -1 if the write could not be queued, and 1 otherwise.
+//
+//*****************************************************************************
 int MainUpdateOpTime(void)
 {
-	unsigned long llTimeTick;
+	unsigned long llTimeTick, ulOpTime;
 	char lsOPTime[20];
-	int i;
+	int i, iRet = 1;
 	unsigned char crc = 0;
 
+	//wait for a previous write to complete
+	if(g_ulHPOpTimePending)
+	{
+		return 1;
+	}
+
 	//update operation time,
 	if(( llTimeTick = g_ulHPOpTicks / 200 ) <= 60)
 	{
 		return 1;
 	}
 
-	g_ulHPOpTime += llTimeTick;
+	ulOpTime = g_ulHPOpTime + llTimeTick;
 
 	//set handpiece in debug mode
 	lsOPTime[0]=0xFF;
 	lsOPTime[1]=0x05;
 	lsOPTime[2]=0x81;
 	lsOPTime[3]=0x00;
-	if(ui_uart_ucmd(lsOPTime, 4) ==-1)
+	if(ui_uart_request(lsOPTime, 4, NULL, 0, NULL, NULL) ==-1)
 	{
 		return -1;
 	}
@@ -2769,17 +4402,21 @@ int MainUpdateOpTime(void)
 
 	//check checksum
 	for(i=0; i< 4; i++)
-		crc = crc8_add((g_ulHPOpTime >> (i * 8)) & 0xff , crc);
+		crc = crc8_add((ulOpTime >> (i * 8)) & 0xff , crc);
 
 	//copy the data over
-	memcpy(&(lsOPTime[4]),&g_ulHPOpTime, 4);
+	memcpy(&(lsOPTime[4]),&ulOpTime, 4);
 
 	lsOPTime[8] =crc;
 
 	//save the error code to eeprom in handpiece
-	if(ui_uart_ucmd(lsOPTime, 9) ==-1)
+	if(ui_uart_request(lsOPTime, 9, NULL, 0, MainOpTimeWritten, NULL) ==-1)
 	{
-		return -1;
+		iRet = -1;
+	}
+	else
+	{
+		g_ulHPOpTimePending = llTimeTick;
 	}
 
 	//set handpiece in streaming mode
@@ -2787,15 +4424,12 @@ int MainUpdateOpTime(void)
 	lsOPTime[1]=0x05;
 	lsOPTime[2]=0x00;
 	lsOPTime[3]=0x00;
-	if(ui_uart_ucmd(lsOPTime, 4)==-1)
+	if(ui_uart_request(lsOPTime, 4, NULL, 0, NULL, NULL)==-1)
 	{
-		return -1;
+		iRet = -1;
 	}
 
-	//reset the ticks count to the remainder
-	g_ulHPOpTicks = g_ulHPOpTicks - llTimeTick *200;
-
-	return 1;
+	return iRet;
 
 }
 
@@ -2830,7 +4464,7 @@ void MainUpdateFaults(void)
     	tStr[1]=0x05;
     	tStr[2]=0x81;
     	tStr[3]=0x00;
-    	ui_uart_ucmd(tStr, 4);
+    	ui_uart_request(tStr, 4, NULL, 0, NULL, NULL);
 
     	//write error code to handpiece
     	//prepare the header
@@ -2849,14 +4483,14 @@ void MainUpdateFaults(void)
     	tStr[8] =crc;
 
     	//save the error code to eeprom in handpiece
-    	ui_uart_ucmd(tStr, 9);
+    	ui_uart_request(tStr, 9, NULL, 0, NULL, NULL);
 
     	//set handpiece in streaming mode
     	tStr[0]=0xFF;
     	tStr[1]=0x05;
     	tStr[2]=0x00;
     	tStr[3]=0x00;
-    	ui_uart_ucmd(tStr, 4);
+    	ui_uart_request(tStr, 4, NULL, 0, NULL, NULL);
 
     }
     //update the error code
@@ -3081,6 +4715,12 @@ main(void)
     //
     SysCtlPeripheralClockGating(true);
 
+    //
+    // Start the interrupt handler profiler before any of the profiled
+    // interrupts can occur.
+    //
+    ISRProfileInit();
+
     //
     // Set the priorities of the interrupts used by the application.
     //
@@ -3090,6 +4730,7 @@ main(void)
     IntPrioritySet(INT_ADC0SS0,     0x60);
     IntPrioritySet(INT_PWM0,        0x80);
     IntPrioritySet(INT_PWM1,        0xa0);
+    IntPrioritySet(INT_QEI0,        0xb0);
     IntPrioritySet(INT_PWM2,        0xc0);
     IntPrioritySet(FAULT_SYSTICK,   0xd0);
     IntPrioritySet(INT_ETH,         0xe0);
@@ -3106,13 +4747,18 @@ main(void)
     FlashPBInit(FLASH_PB_START, FLASH_PB_END, FLASH_PB_SIZE);
 
     //
-    // Simulate a hard fault if the parameter block size is not 128 bytes.
+    // Simulate a hard fault if the parameter block size is not FLASH_PB_SIZE bytes.
     //
     if(sizeof(tDriveParameters) != FLASH_PB_SIZE)
     {
         FaultISR();
     }
 
+    //
+    // Initialize the store of the trigger calibration of each handpiece.
+    //
+    HPCalInit();
+
     //
     // Initialize the PWM driver.
     //
@@ -3123,6 +4769,11 @@ main(void)
     //
     ADCInit();
 
+    //
+    // Initialize the quadrature encoder.
+    //
+    EncoderInit();
+
     //
     // Initialize the user interface.
     //
@@ -3181,6 +4832,14 @@ main(void)
     		}
     	}
 
+    	// send the queued handpiece requests and complete them as their
+    	// replies arrive, without waiting for them
+    	ui_uart_process();
+
+    	// write the learned trigger calibration to flash once the motor has
+    	// stopped and the handpiece link is idle
+    	UIThrottleCalUpdate();
+
     	// check handpiece hall trigger and set speed accordingly,
     	// if handpiece need initialize, initialize it
     	if(g_ucHPInitDone)
@@ -100,7 +100,33 @@
 //! (see the ui.h file).
 //
 //*****************************************************************************
-#define FLASH_PB_SIZE           128
+#define FLASH_PB_SIZE           256
+
+//*****************************************************************************
+//
+//! The address of the first block of flash to be used for storing the trigger
+//! calibration of each handpiece.  This is the four kilobytes immediately
+//! below the parameter blocks.
+//
+//*****************************************************************************
+#define HPCAL_START             0x0003e000
+
+//*****************************************************************************
+//
+//! The address of the last block of flash to be used for storing the trigger
+//! calibration of each handpiece, which is the first address past its end.
+//
+//*****************************************************************************
+#define HPCAL_END               0x0003f000
+
+//*****************************************************************************
+//
+//! The size of the handpiece calibration block to save.  This must be a power
+//! of 2, and must match the size of the tHPCalBlock structure (see the
+//! hp_cal.c file).
+//
+//*****************************************************************************
+#define HPCAL_SIZE              256
 
 //*****************************************************************************
 //
@@ -138,14 +164,24 @@ extern unsigned long g_ulFaultFlags;
 extern unsigned char g_ucMotorStatus;
 extern unsigned long g_ulAngle;
 extern unsigned long g_ulMeasuredSpeed;
+extern unsigned short g_usTargetPosition;
+extern unsigned short g_usMotorPosition;
 extern unsigned long g_ulDutyCycle;
-extern long g_lSpeedIntegratorOffset;
-extern unsigned char g_ucIntegralOffsetUpdated;
+extern long g_lCurrentRef;
+extern unsigned short g_usCurrentBandwidth;
+extern unsigned short g_usMotorResistance;
+extern unsigned short g_usMotorInductance;
+extern long MainLongMul(long lX, long lY);
+extern unsigned long MainSqrt(unsigned long ulValue);
 extern void MainSetPWMFrequency(void);
 extern void MainSetSpeed(void);
 extern void MainSetPower(void);
+extern void MainSetPosition(void);
+extern unsigned long MainPositionCounts(void);
 extern void MainSetDirection(tBoolean bForward);
 extern void MainUpdateFAdjI(long lNewFAdjI);
+extern void MainSetCurrentGains(void);
+extern void MainCurrentControl(long lCurrent);
 extern void MainWaveformTick(void);
 extern void MainMillisecondTick(void);
 extern void MainRun(void);
@@ -119,14 +119,14 @@
 //! The GPIO port on which the quadrature encoder index pin resides.
 //
 //*****************************************************************************
-#define PIN_INDEX_PORT          GPIO_PORTB_BASE
+#define PIN_INDEX_PORT          GPIO_PORTD_BASE
 
 //*****************************************************************************
 //
 //! The GPIO pin on which the quadrature encoder index pin resides.
 //
 //*****************************************************************************
-#define PIN_INDEX_PIN           GPIO_PIN_2
+#define PIN_INDEX_PIN           GPIO_PIN_7
 
 //*****************************************************************************
 //
@@ -29,6 +29,7 @@
 #include "driverlib/gpio.h"
 #include "driverlib/interrupt.h"
 #include "driverlib/pwm.h"
+#include "isr_prof.h"
 #include "main.h"
 #include "pins.h"
 #include "pwm_ctrl.h"
@@ -620,10 +621,11 @@ PWMUpdateDutyCycle(void)
     PWMPulseWidthSet(PWM_BASE, PWM_OUT_5, ulWidthC);
 
     //
-    // If trapezoid (not sine), and slow decay, set the odd PWM at near
-    // 100% duty cycle.
+    // If trapezoid (not sine or field-oriented), and slow decay, set the odd
+    // PWM at near 100% duty cycle.
     //
     if((g_sParameters.ucModulationType != MOD_TYPE_SINE) &&
+       (g_sParameters.ucModulationType != MOD_TYPE_FOC) &&
        (HWREGBITH(&(g_sParameters.usFlags), FLAG_DECAY_BIT) ==
             FLAG_DECAY_SLOW))
     {
@@ -660,6 +662,11 @@ PWMUpdateDutyCycle(void)
 void
 PWM0IntHandler(void)
 {
+    //
+    // Mark the start of this handler for the profiler.
+    //
+    ISRProfileStart(ISR_PROFILE_PWM);
+
     //
     // Clear the PWM interrupt.  This is done twice since the clear will be
     // ignored by hardware if it occurs on the same cycle as another interrupt
@@ -787,6 +794,11 @@ PWM0IntHandler(void)
             PWMOutputState(PWM_BASE, PWM_OUT_5_BIT, true);
         }
     }
+
+    //
+    // Mark the end of this handler for the profiler.
+    //
+    ISRProfileEnd(ISR_PROFILE_PWM);
 }
 
 //*****************************************************************************
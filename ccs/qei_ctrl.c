@@ -0,0 +1,380 @@
+//*****************************************************************************
+//
+// qei_ctrl.c - Quadrature encoder position and speed feedback.
+//
+//*****************************************************************************
+
+#include "inc/hw_ints.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "driverlib/gpio.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/qei.h"
+#include "driverlib/sysctl.h"
+#include "main.h"
+#include "pins.h"
+#include "qei_ctrl.h"
+#include "ui.h"
+
+//*****************************************************************************
+//
+//! \page qei_ctrl_intro Introduction
+//!
+//! When an encoder is present, the rotor speed used by the speed controller
+//! is measured by the quadrature encoder interface (QEI) rather than by the
+//! Hall sensors or the Back EMF.  The QEI counts every edge of both encoder
+//! channels, so an encoder with N lines provides 4 * N counts per mechanical
+//! revolution, which is far finer than the twelve Hall edges per revolution
+//! of a four pole motor.
+//!
+//! The velocity timer of the QEI is set to a period of one millisecond, and
+//! its interrupt is used to sample the position counter.  The change in
+//! position over the millisecond is taken from the velocity capture (the
+//! number of edges counted in the period, signed by the direction), and is
+//! then corrected by the change in the position counter so that edges are
+//! never lost to a change of direction within the period.  The sum of these
+//! changes is a signed position accumulator that does not wrap at the end of
+//! a revolution.
+//!
+//! The position counter is reset by the index pulse.  The first index pulse
+//! seen after the encoder is configured references the accumulator to the
+//! index, so that a position of zero is at the index; until then, the
+//! position is relative to the position at which the encoder was
+//! configured.
+//!
+//! The speed is computed every millisecond from the history of the position
+//! accumulator, over the shortest window (from one up to #QEI_HISTORY - 1
+//! milliseconds) in which the rotor has moved by at least #QEI_MIN_COUNTS
+//! counts.  At high speed this is the change in position over the last
+//! millisecond; at low speed the window grows so that the speed retains a
+//! useful resolution, yet it is still updated every millisecond rather than
+//! only when an edge arrives.
+//!
+//! The code for the quadrature encoder is contained in <tt>qei_ctrl.c</tt>,
+//! with <tt>qei_ctrl.h</tt> containing the definitions for the variables and
+//! functions exported to the remainder of the application.
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! \defgroup qei_ctrl_api Definitions
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! The number of millisecond samples of the position accumulator that are
+//! kept for the speed computation.  This must be a power of two.
+//
+//*****************************************************************************
+#define QEI_HISTORY             64
+
+//*****************************************************************************
+//
+//! The minimum number of counts over which the speed is computed, unless the
+//! rotor has moved less than this over the entire history.
+//
+//*****************************************************************************
+#define QEI_MIN_COUNTS          256
+
+//*****************************************************************************
+//
+//! The current speed of the motor's rotor, as measured by the encoder.  This
+//! is specified in RPM, regardless of the direction of rotation.
+//
+//*****************************************************************************
+unsigned long g_ulRotorSpeed = 0;
+
+//*****************************************************************************
+//
+//! The current speed of the motor's rotor, as measured by the encoder.  This
+//! is specified in RPM, and is positive when the encoder counts up.
+//
+//*****************************************************************************
+long g_lEncoderSpeed = 0;
+
+//*****************************************************************************
+//
+//! The position of the motor's rotor, as measured by the encoder.  This is
+//! specified in encoder counts (four per line), and is referenced to the
+//! index once #g_ucEncoderIndexed is set.
+//
+//*****************************************************************************
+long g_lEncoderPosition = 0;
+
+//*****************************************************************************
+//
+//! A boolean that is true once an index pulse has been seen and
+//! #g_lEncoderPosition has been referenced to it.
+//
+//*****************************************************************************
+unsigned char g_ucEncoderIndexed = 0;
+
+//*****************************************************************************
+//
+//! The number of phase errors (simultaneous edges on both encoder channels)
+//! detected by the QEI.
+//
+//*****************************************************************************
+unsigned long g_ulEncoderErrors = 0;
+
+//*****************************************************************************
+//
+//! The number of encoder counts per mechanical revolution, as configured by
+//! EncoderConfigure().
+//
+//*****************************************************************************
+static unsigned long g_ulEncoderCounts;
+
+//*****************************************************************************
+//
+//! The value of the QEI position counter at the previous velocity timer
+//! interrupt.
+//
+//*****************************************************************************
+static unsigned long g_ulEncoderLastPos;
+
+//*****************************************************************************
+//
+//! The position accumulator at each of the last #QEI_HISTORY velocity timer
+//! interrupts, and the index of the latest entry.
+//
+//*****************************************************************************
+static long g_plEncoderHistory[QEI_HISTORY];
+static unsigned long g_ulEncoderHistoryIdx;
+
+//*****************************************************************************
+//
+//! Handles the QEI interrupt.
+//!
+//! This function is called when the velocity timer of the QEI expires, which
+//! is once every millisecond, or when a phase error is detected.  The
+//! position accumulator is updated with the movement over the millisecond,
+//! and a new rotor speed is computed.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+QEIIntHandler(void)
+{
+    unsigned long ulStatus, ulPos, ulIdx;
+    long lDelta, lError;
+
+    //
+    // Get and clear the QEI interrupts.  The raw status is used so that the
+    // index pulse is seen without having its own interrupt.
+    //
+    ulStatus = QEIIntStatus(QEI0_BASE, false);
+    QEIIntClear(QEI0_BASE, ulStatus);
+
+    //
+    // Count the phase errors.
+    //
+    if(ulStatus & QEI_INTERROR)
+    {
+        g_ulEncoderErrors++;
+    }
+
+    //
+    // There is nothing further to do if the velocity timer has not expired.
+    //
+    if(!(ulStatus & QEI_INTTIMER))
+    {
+        return;
+    }
+
+    //
+    // Get the position counter, and the edges counted over the millisecond
+    // signed by the direction of rotation.
+    //
+    ulPos = QEIPositionGet(QEI0_BASE);
+    lDelta = QEIVelocityGet(QEI0_BASE) * QEIDirectionGet(QEI0_BASE);
+
+    //
+    // See if this is the first index pulse.
+    //
+    if((ulStatus & QEI_INTINDEX) && !g_ucEncoderIndexed)
+    {
+        //
+        // The position counter has been reset by the index pulse, so the
+        // movement over the millisecond is given by the velocity capture
+        // alone.  Move the accumulator and its history so that the index is
+        // at zero, leaving the differences used for the speed unchanged.
+        //
+        lError = ulPos - (g_lEncoderPosition + lDelta);
+        for(ulIdx = 0; ulIdx < QEI_HISTORY; ulIdx++)
+        {
+            g_plEncoderHistory[ulIdx] += lError;
+        }
+        g_lEncoderPosition = ulPos;
+        g_ucEncoderIndexed = 1;
+    }
+    else
+    {
+        //
+        // Correct the velocity capture by the change in the position
+        // counter, modulo one revolution.
+        //
+        lError = ulPos - g_ulEncoderLastPos - lDelta;
+        lError %= (long)g_ulEncoderCounts;
+        if(lError > (long)(g_ulEncoderCounts / 2))
+        {
+            lError -= g_ulEncoderCounts;
+        }
+        else if(lError < -(long)(g_ulEncoderCounts / 2))
+        {
+            lError += g_ulEncoderCounts;
+        }
+        g_lEncoderPosition += lDelta + lError;
+    }
+    g_ulEncoderLastPos = ulPos;
+
+    //
+    // Save the position in the history.
+    //
+    g_ulEncoderHistoryIdx = (g_ulEncoderHistoryIdx + 1) & (QEI_HISTORY - 1);
+    g_plEncoderHistory[g_ulEncoderHistoryIdx] = g_lEncoderPosition;
+
+    //
+    // Find the shortest window over which the rotor has moved by at least
+    // QEI_MIN_COUNTS, or the whole history if it has not.
+    //
+    for(ulIdx = 1; ; ulIdx++)
+    {
+        lDelta = (g_lEncoderPosition -
+                  g_plEncoderHistory[(g_ulEncoderHistoryIdx - ulIdx) &
+                                     (QEI_HISTORY - 1)]);
+        if((lDelta >= QEI_MIN_COUNTS) || (lDelta <= -QEI_MIN_COUNTS) ||
+           (ulIdx == (QEI_HISTORY - 1)))
+        {
+            break;
+        }
+    }
+
+    //
+    // Convert the movement over the window into RPM.
+    //
+    g_lEncoderSpeed = (lDelta * 60000) / (long)(g_ulEncoderCounts * ulIdx);
+    g_ulRotorSpeed = ((g_lEncoderSpeed < 0) ? -g_lEncoderSpeed :
+                      g_lEncoderSpeed);
+}
+
+//*****************************************************************************
+//
+//! Initializes the quadrature encoder routines.
+//!
+//! This function will enable the QEI and configure the encoder channel and
+//! index pins for use by it.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+EncoderInit(void)
+{
+    //
+    // Enable the QEI.
+    //
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_QEI0);
+    SysCtlPeripheralSleepEnable(SYSCTL_PERIPH_QEI0);
+
+    //
+    // Configure the encoder channel and index pins for use by the QEI.
+    //
+    GPIOPinConfigure(GPIO_PC4_PHA0);
+    GPIOPinConfigure(GPIO_PC7_PHB0);
+    GPIOPinConfigure(GPIO_PD7_IDX0);
+    GPIOPinTypeQEI(PIN_ENCA_PORT, PIN_ENCA_PIN | PIN_ENCB_PIN);
+    GPIOPinTypeQEI(PIN_INDEX_PORT, PIN_INDEX_PIN);
+}
+
+//*****************************************************************************
+//
+//! Configure the quadrature encoder routines, based on motor drive
+//! parameters.
+//!
+//! This function will configure the QEI for the number of lines of the
+//! encoder and start the velocity timer if an encoder is present, or stop the
+//! QEI if it is not.  The position accumulator is reset to zero, and is
+//! referenced to the index again at the next index pulse.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+EncoderConfigure(void)
+{
+    unsigned long ulIdx;
+
+    //
+    // Stop the QEI and its interrupt.
+    //
+    IntDisable(INT_QEI0);
+    QEIIntDisable(QEI0_BASE, (QEI_INTERROR | QEI_INTDIR | QEI_INTTIMER |
+                              QEI_INTINDEX));
+    QEIVelocityDisable(QEI0_BASE);
+    QEIDisable(QEI0_BASE);
+
+    //
+    // Reset the position and speed.
+    //
+    g_lEncoderPosition = 0;
+    g_lEncoderSpeed = 0;
+    g_ulRotorSpeed = 0;
+    g_ucEncoderIndexed = 0;
+    g_ulEncoderLastPos = 0;
+    g_ulEncoderHistoryIdx = 0;
+    for(ulIdx = 0; ulIdx < QEI_HISTORY; ulIdx++)
+    {
+        g_plEncoderHistory[ulIdx] = 0;
+    }
+
+    //
+    // If there is no encoder, then the QEI is left stopped.
+    //
+    if((HWREGBITH(&(g_sParameters.usFlags), FLAG_ENCODER_BIT) ==
+        FLAG_ENCODER_ABSENT) || (g_sParameters.usEncoderLines == 0))
+    {
+        return;
+    }
+
+    //
+    // Configure the QEI to count both edges of both channels, resetting the
+    // position at the index pulse.
+    //
+    g_ulEncoderCounts = g_sParameters.usEncoderLines * 4;
+    QEIConfigure(QEI0_BASE, (QEI_CONFIG_CAPTURE_A_B | QEI_CONFIG_RESET_IDX |
+                             QEI_CONFIG_QUADRATURE | QEI_CONFIG_NO_SWAP),
+                 g_ulEncoderCounts - 1);
+    QEIPositionSet(QEI0_BASE, 0);
+
+    //
+    // Configure the velocity timer for a one millisecond period.
+    //
+    QEIVelocityConfigure(QEI0_BASE, QEI_VELDIV_1, SYSTEM_CLOCK / 1000);
+
+    //
+    // Clear any stale interrupts, then enable the velocity timer and phase
+    // error interrupts.
+    //
+    QEIIntClear(QEI0_BASE, (QEI_INTERROR | QEI_INTDIR | QEI_INTTIMER |
+                            QEI_INTINDEX));
+    QEIIntEnable(QEI0_BASE, QEI_INTERROR | QEI_INTTIMER);
+    IntEnable(INT_QEI0);
+
+    //
+    // Start the QEI.
+    //
+    QEIVelocityEnable(QEI0_BASE);
+    QEIEnable(QEI0_BASE);
+}
+
+//*****************************************************************************
+//
+// Close the Doxygen group.
+//! @}
+//
+//*****************************************************************************
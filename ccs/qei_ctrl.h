@@ -0,0 +1,24 @@
+//*****************************************************************************
+//
+// qei_ctrl.h - Prototypes for the quadrature encoder routines.
+//
+//*****************************************************************************
+
+#ifndef __QEI_CTRL_H__
+#define __QEI_CTRL_H__
+
+//*****************************************************************************
+//
+// Prototypes for the exported variables and functions.
+//
+//*****************************************************************************
+extern unsigned long g_ulRotorSpeed;
+extern long g_lEncoderSpeed;
+extern long g_lEncoderPosition;
+extern unsigned char g_ucEncoderIndexed;
+extern unsigned long g_ulEncoderErrors;
+extern void QEIIntHandler(void);
+extern void EncoderInit(void);
+extern void EncoderConfigure(void);
+
+#endif // __QEI_CTRL_H__
@@ -0,0 +1,543 @@
+//*****************************************************************************
+//
+// scope.c - Triggered ADC sample capture.
+//
+//*****************************************************************************
+
+#include "inc/hw_types.h"
+#include "main.h"
+#include "scope.h"
+#include "ui.h"
+
+//*****************************************************************************
+//
+//! \page scope_intro Introduction
+//!
+//! The scope captures the raw samples of ADC sequence zero, taken in each PWM
+//! period, around an event of interest.  Under trapezoid and sensorless
+//! modulation these are the Back EMF, phase current, bus voltage and ambient
+//! temperature readings; under field-oriented control they are the phase A
+//! current, phase B current, bus voltage and ambient temperature readings.
+//! The scope can not be armed under sine modulation, whose sequence reads
+//! only the bus voltage and ambient temperature, and it is stopped whenever
+//! the sequence is reconfigured.  Any of the four channels can be captured,
+//! and the samples can be decimated so that a capture spans more PWM
+//! periods.
+//!
+//! The scope is armed with the #CMD_SCOPE command, which gives the channels,
+//! the decimation, the trigger and the number of records to keep from before
+//! the trigger.  While armed, the samples are kept in a ring buffer, so that
+//! the buffer always holds the most recent records.  Once enough records have
+//! been taken to fill the part of the buffer before the trigger, the trigger
+//! is checked on every ADC sample (decimated or not); when it fires, the
+//! remainder of the buffer is filled and the capture is done.  The capture is
+//! then read out, in order from the oldest record, with #CMD_SCOPE.
+//!
+//! The trigger is a raw sample crossing a level, a fault flag being set, the
+//! motor drive changing state, or the drive commutating (a Hall edge under
+//! field-oriented control); a capture can also be triggered by hand whatever
+//! the trigger source.
+//!
+//! While the scope is not capturing, the ADC interrupt handler does no more
+//! than check #g_ulScopeState.
+//!
+//! The code for the scope is contained in <tt>scope.c</tt>, with
+//! <tt>scope.h</tt> containing the definitions for the variables and
+//! functions exported to the remainder of the application.
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! \defgroup scope_api Definitions
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! The size of the scope buffer, in samples.
+//
+//*****************************************************************************
+#ifndef SCOPE_BUFFER_SIZE
+#define SCOPE_BUFFER_SIZE       4096
+#endif
+
+//*****************************************************************************
+//
+//! The value of #g_ulScopeLast when there is no previous value to compare
+//! against.
+//
+//*****************************************************************************
+#define SCOPE_LAST_NONE         0xffffffff
+
+//*****************************************************************************
+//
+//! The state of the scope, which is one of the \b SCOPE_STATE_xxx values.
+//
+//*****************************************************************************
+volatile unsigned long g_ulScopeState = SCOPE_STATE_IDLE;
+
+//*****************************************************************************
+//
+//! The buffer that holds the capture, as records of the captured samples.
+//
+//*****************************************************************************
+static unsigned short g_pusScopeBuffer[SCOPE_BUFFER_SIZE];
+
+//*****************************************************************************
+//
+//! The bit mask of the captured channels, and the number of them, which is
+//! the number of samples in each record.
+//
+//*****************************************************************************
+static unsigned long g_ulScopeChannels;
+static unsigned long g_ulScopeNumChannels;
+
+//*****************************************************************************
+//
+//! The number of records that the buffer holds, and how many of them are
+//! from before the trigger.
+//
+//*****************************************************************************
+static unsigned long g_ulScopeNumRecords;
+static unsigned long g_ulScopePreTrigger;
+
+//*****************************************************************************
+//
+//! The number of ADC samples for each record, and the number still to be
+//! skipped before the next record is taken.
+//
+//*****************************************************************************
+static unsigned long g_ulScopeDecimate;
+static unsigned long g_ulScopeSkip;
+
+//*****************************************************************************
+//
+//! The trigger source, which is one of the \b SCOPE_TRIG_xxx values, along
+//! with the channel and value that it uses.
+//
+//*****************************************************************************
+static unsigned long g_ulScopeTrigger;
+static unsigned long g_ulScopeTriggerChannel;
+static unsigned long g_ulScopeTriggerValue;
+
+//*****************************************************************************
+//
+//! The value that the trigger source had at the previous ADC sample.
+//
+//*****************************************************************************
+static unsigned long g_ulScopeLast;
+
+//*****************************************************************************
+//
+//! A flag that is set to trigger the capture by hand.
+//
+//*****************************************************************************
+static volatile tBoolean g_bScopeManual;
+
+//*****************************************************************************
+//
+//! The number of records taken since the scope was armed, and the number at
+//! which the capture is done.  The records are kept in the buffer modulo the
+//! number of records that it holds.
+//
+//*****************************************************************************
+static unsigned long g_ulScopeWrite;
+static unsigned long g_ulScopeEnd;
+
+//*****************************************************************************
+//
+//! Checks the trigger against an ADC sample.
+//!
+//! \param pusData is a pointer to the raw ADC samples.
+//! \param ulPhase is the commutation state of the drive.
+//!
+//! This function updates the previous value of the trigger source, whether
+//! or not the trigger is able to fire yet.
+//!
+//! \return Returns \b true if the trigger has fired.
+//
+//*****************************************************************************
+static tBoolean
+ScopeTriggered(const unsigned short *pusData, unsigned long ulPhase)
+{
+    unsigned long ulValue, ulLast;
+
+    //
+    // Get the current value of the trigger source.
+    //
+    switch(g_ulScopeTrigger)
+    {
+        case SCOPE_TRIG_RISING:
+        case SCOPE_TRIG_FALLING:
+        {
+            ulValue = pusData[g_ulScopeTriggerChannel];
+            break;
+        }
+
+        case SCOPE_TRIG_FAULT:
+        {
+            return(g_bScopeManual ||
+                   ((g_ulFaultFlags & g_ulScopeTriggerValue) != 0));
+        }
+
+        case SCOPE_TRIG_STATE:
+        {
+            ulValue = g_ulState;
+            break;
+        }
+
+        case SCOPE_TRIG_COMMUTATE:
+        {
+            ulValue = ulPhase;
+            break;
+        }
+
+        default:
+        {
+            return(g_bScopeManual);
+        }
+    }
+
+    //
+    // Save the value for the next sample.
+    //
+    ulLast = g_ulScopeLast;
+    g_ulScopeLast = ulValue;
+
+    //
+    // A manual trigger fires at once, while an edge or change can not be seen
+    // on the first sample.
+    //
+    if(g_bScopeManual)
+    {
+        return(true);
+    }
+    if(ulLast == SCOPE_LAST_NONE)
+    {
+        return(false);
+    }
+
+    //
+    // See if the value has crossed the level, or changed.
+    //
+    if(g_ulScopeTrigger == SCOPE_TRIG_RISING)
+    {
+        return((ulLast < g_ulScopeTriggerValue) &&
+               (ulValue >= g_ulScopeTriggerValue));
+    }
+    if(g_ulScopeTrigger == SCOPE_TRIG_FALLING)
+    {
+        return((ulLast >= g_ulScopeTriggerValue) &&
+               (ulValue < g_ulScopeTriggerValue));
+    }
+    return(ulValue != ulLast);
+}
+
+//*****************************************************************************
+//
+//! Takes the raw samples of an ADC sequence zero interrupt.
+//!
+//! \param pusData is a pointer to the #SCOPE_NUM_CHANNELS raw ADC samples.
+//! \param ulPhase is the commutation state of the drive, or the Hall state
+//! under field-oriented control, which is used by the #SCOPE_TRIG_COMMUTATE
+//! trigger.
+//!
+//! This function checks the trigger and adds a record of the samples to the
+//! capture, as the decimation allows.  It must only be called from the ADC
+//! interrupt handler while #g_ulScopeState is #SCOPE_STATE_ARMED or
+//! #SCOPE_STATE_TRIGGERED.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+ScopeSample(const unsigned short *pusData, unsigned long ulPhase)
+{
+    unsigned long ulChannel;
+    unsigned short *pusRecord;
+    tBoolean bTrigger;
+
+    //
+    // Check the trigger, once the records from before it have been taken.
+    // The record of this sample is the first one after the trigger.
+    //
+    bTrigger = ScopeTriggered(pusData, ulPhase);
+    if((g_ulScopeState == SCOPE_STATE_ARMED) && bTrigger &&
+       (g_ulScopeWrite >= g_ulScopePreTrigger))
+    {
+        g_ulScopeEnd = (g_ulScopeWrite + g_ulScopeNumRecords -
+                        g_ulScopePreTrigger);
+        g_ulScopeSkip = 0;
+        g_bScopeManual = false;
+        g_ulScopeState = SCOPE_STATE_TRIGGERED;
+    }
+
+    //
+    // Skip this sample if it is decimated away.
+    //
+    if(g_ulScopeSkip)
+    {
+        g_ulScopeSkip--;
+        return;
+    }
+    g_ulScopeSkip = g_ulScopeDecimate - 1;
+
+    //
+    // Copy the captured channels into the next record.
+    //
+    pusRecord = (g_pusScopeBuffer +
+                 ((g_ulScopeWrite % g_ulScopeNumRecords) *
+                  g_ulScopeNumChannels));
+    for(ulChannel = 0; ulChannel < SCOPE_NUM_CHANNELS; ulChannel++)
+    {
+        if(g_ulScopeChannels & (1 << ulChannel))
+        {
+            *pusRecord++ = pusData[ulChannel];
+        }
+    }
+    g_ulScopeWrite++;
+
+    //
+    // The capture is done once the buffer has been filled after the trigger.
+    //
+    if((g_ulScopeState == SCOPE_STATE_TRIGGERED) &&
+       (g_ulScopeWrite == g_ulScopeEnd))
+    {
+        g_ulScopeState = SCOPE_STATE_DONE;
+    }
+}
+
+//*****************************************************************************
+//
+//! Arms the scope.
+//!
+//! \param ulChannels is the bit mask of the channels to capture.
+//! \param ulDecimate is the number of ADC samples for each record; zero is
+//! the same as one.
+//! \param ulTrigger is the trigger source, which is one of the
+//! \b SCOPE_TRIG_xxx values.
+//! \param ulTriggerChannel is the channel used by the #SCOPE_TRIG_RISING and
+//! #SCOPE_TRIG_FALLING triggers, which need not be captured.
+//! \param ulTriggerValue is the level used by the #SCOPE_TRIG_RISING and
+//! #SCOPE_TRIG_FALLING triggers, or the fault flags used by the
+//! #SCOPE_TRIG_FAULT trigger.
+//! \param ulPreTrigger is the number of records to keep from before the
+//! trigger, which is limited to one less than the buffer holds.
+//!
+//! This function discards any previous capture and starts a new one.  The
+//! scope is only armed under the modulations whose ADC interrupt handler
+//! passes the samples to ScopeSample().
+//!
+//! \return Returns the number of records in the capture, or zero if the
+//! arguments are not valid or the modulation is not supported, and the scope
+//! is left idle.
+//
+//*****************************************************************************
+unsigned long
+ScopeArm(unsigned long ulChannels, unsigned long ulDecimate,
+         unsigned long ulTrigger, unsigned long ulTriggerChannel,
+         unsigned long ulTriggerValue, unsigned long ulPreTrigger)
+{
+    unsigned long ulChannel;
+
+    //
+    // Stop any capture in progress, so that the ADC interrupt handler does
+    // not use the settings while they are changed.
+    //
+    g_ulScopeState = SCOPE_STATE_IDLE;
+
+    //
+    // Check the arguments.
+    //
+    ulChannels &= (1 << SCOPE_NUM_CHANNELS) - 1;
+    if((ulChannels == 0) || (ulTrigger > SCOPE_TRIG_COMMUTATE) ||
+       (ulTriggerChannel >= SCOPE_NUM_CHANNELS))
+    {
+        return(0);
+    }
+
+    //
+    // Refuse to arm under sine modulation, whose ADC interrupt handler does
+    // not take the samples that the scope captures.
+    //
+    if((g_sParameters.ucModulationType != MOD_TYPE_TRAPEZOID) &&
+       (g_sParameters.ucModulationType != MOD_TYPE_SENSORLESS) &&
+       (g_sParameters.ucModulationType != MOD_TYPE_FOC))
+    {
+        return(0);
+    }
+
+    //
+    // Size the records and the part of the buffer before the trigger.
+    //
+    g_ulScopeChannels = ulChannels;
+    for(ulChannel = 0, g_ulScopeNumChannels = 0;
+        ulChannel < SCOPE_NUM_CHANNELS; ulChannel++)
+    {
+        if(ulChannels & (1 << ulChannel))
+        {
+            g_ulScopeNumChannels++;
+        }
+    }
+    g_ulScopeNumRecords = SCOPE_BUFFER_SIZE / g_ulScopeNumChannels;
+    if(ulPreTrigger >= g_ulScopeNumRecords)
+    {
+        ulPreTrigger = g_ulScopeNumRecords - 1;
+    }
+    g_ulScopePreTrigger = ulPreTrigger;
+
+    //
+    // Save the decimation and trigger.
+    //
+    g_ulScopeDecimate = ulDecimate ? ulDecimate : 1;
+    g_ulScopeSkip = 0;
+    g_ulScopeTrigger = ulTrigger;
+    g_ulScopeTriggerChannel = ulTriggerChannel;
+    g_ulScopeTriggerValue = ulTriggerValue;
+    g_ulScopeLast = SCOPE_LAST_NONE;
+    g_bScopeManual = false;
+
+    //
+    // Start the capture.
+    //
+    g_ulScopeWrite = 0;
+    g_ulScopeState = SCOPE_STATE_ARMED;
+
+    //
+    // Return the number of records in the capture.
+    //
+    return(g_ulScopeNumRecords);
+}
+
+//*****************************************************************************
+//
+//! Triggers the scope by hand.
+//!
+//! This function triggers the capture at the next ADC sample, or as soon as
+//! the records from before the trigger have been taken, whatever the trigger
+//! source is.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+ScopeTrigger(void)
+{
+    g_bScopeManual = true;
+}
+
+//*****************************************************************************
+//
+//! Stops the scope, discarding any capture.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+ScopeStop(void)
+{
+    g_ulScopeState = SCOPE_STATE_IDLE;
+}
+
+//*****************************************************************************
+//
+//! Returns the number of records in the capture.
+//!
+//! \return The number of records that can be read, which is zero until the
+//! capture is done.
+//
+//*****************************************************************************
+unsigned long
+ScopeRecords(void)
+{
+    return((g_ulScopeState == SCOPE_STATE_DONE) ? g_ulScopeNumRecords : 0);
+}
+
+//*****************************************************************************
+//
+//! Returns the number of records in the capture from before the trigger.
+//!
+//! \return The number of records before the trigger; the following record
+//! holds the samples at which the trigger fired.
+//
+//*****************************************************************************
+unsigned long
+ScopePreTrigger(void)
+{
+    return(g_ulScopePreTrigger);
+}
+
+//*****************************************************************************
+//
+//! Returns the channels captured by the scope.
+//!
+//! \return The bit mask of the captured channels.
+//
+//*****************************************************************************
+unsigned long
+ScopeChannels(void)
+{
+    return(g_ulScopeChannels);
+}
+
+//*****************************************************************************
+//
+//! Reads from the capture.
+//!
+//! \param ulOffset is the byte offset to read from.
+//! \param pucData is a pointer to the buffer for the bytes read.
+//! \param ulCount is the number of bytes to read.
+//!
+//! The capture is read as its records in order from the oldest, each of which
+//! holds the captured channels in order as 16-bit values.
+//!
+//! \return The number of bytes read, which is fewer than requested at the end
+//! of the capture, and zero until the capture is done.
+//
+//*****************************************************************************
+unsigned long
+ScopeRead(unsigned long ulOffset, unsigned char *pucData,
+          unsigned long ulCount)
+{
+    unsigned long ulIdx, ulRecord, ulLength, ulSample;
+
+    //
+    // Limit the read to the end of the capture.
+    //
+    ulLength = ScopeRecords() * g_ulScopeNumChannels * 2;
+    if(ulOffset >= ulLength)
+    {
+        return(0);
+    }
+    if(ulCount > (ulLength - ulOffset))
+    {
+        ulCount = ulLength - ulOffset;
+    }
+
+    //
+    // Copy the bytes, starting from the oldest record, which follows the
+    // newest one in the buffer.
+    //
+    for(ulIdx = 0; ulIdx < ulCount; ulIdx++, ulOffset++)
+    {
+        ulRecord = (((ulOffset / 2) / g_ulScopeNumChannels) + g_ulScopeEnd) %
+                   g_ulScopeNumRecords;
+        ulSample = g_pusScopeBuffer[(ulRecord * g_ulScopeNumChannels) +
+                                    ((ulOffset / 2) % g_ulScopeNumChannels)];
+        pucData[ulIdx] = (ulOffset & 1) ? (ulSample >> 8) : ulSample;
+    }
+
+    //
+    // Return the number of bytes read.
+    //
+    return(ulCount);
+}
+
+//*****************************************************************************
+//
+// Close the Doxygen group.
+//! @}
+//
+//*****************************************************************************
@@ -0,0 +1,105 @@
+//*****************************************************************************
+//
+// scope.h - Prototypes for the triggered ADC sample capture.
+//
+//*****************************************************************************
+
+#ifndef __SCOPE_H__
+#define __SCOPE_H__
+
+//*****************************************************************************
+//
+//! \addtogroup scope_api
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! The scope is not capturing, and holds no capture.
+//
+//*****************************************************************************
+#define SCOPE_STATE_IDLE        0
+
+//*****************************************************************************
+//
+//! The scope has finished capturing, and the capture can be read.
+//
+//*****************************************************************************
+#define SCOPE_STATE_DONE        1
+
+//*****************************************************************************
+//
+//! The scope is capturing the samples before the trigger, and waiting for it.
+//! This and the following states are the ones in which the scope is
+//! capturing.
+//
+//*****************************************************************************
+#define SCOPE_STATE_ARMED       2
+
+//*****************************************************************************
+//
+//! The scope has triggered, and is capturing the samples after the trigger.
+//
+//*****************************************************************************
+#define SCOPE_STATE_TRIGGERED   3
+
+//*****************************************************************************
+//
+//! The trigger sources.
+//!
+//! - #SCOPE_TRIG_MANUAL triggers only on the #SCOPE_OP_TRIGGER operation.
+//! - #SCOPE_TRIG_RISING triggers when the raw sample of the trigger channel
+//!   rises from below the trigger value to or above it.
+//! - #SCOPE_TRIG_FALLING triggers when the raw sample of the trigger channel
+//!   falls from or above the trigger value to below it.
+//! - #SCOPE_TRIG_FAULT triggers when any of the fault flags in the trigger
+//!   value is set.
+//! - #SCOPE_TRIG_STATE triggers when the motor drive state changes.
+//! - #SCOPE_TRIG_COMMUTATE triggers when the drive commutates to another
+//!   phase pair.
+//
+//*****************************************************************************
+#define SCOPE_TRIG_MANUAL       0
+#define SCOPE_TRIG_RISING       1
+#define SCOPE_TRIG_FALLING      2
+#define SCOPE_TRIG_FAULT        3
+#define SCOPE_TRIG_STATE        4
+#define SCOPE_TRIG_COMMUTATE    5
+
+//*****************************************************************************
+//
+//! The number of raw ADC sequence zero samples that can be captured.
+//
+//*****************************************************************************
+#define SCOPE_NUM_CHANNELS      4
+
+//*****************************************************************************
+//
+// Close the Doxygen group.
+//! @}
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+// Prototypes for the exported variables and functions.
+//
+//*****************************************************************************
+extern volatile unsigned long g_ulScopeState;
+extern void ScopeSample(const unsigned short *pusData, unsigned long ulPhase);
+extern unsigned long ScopeArm(unsigned long ulChannels,
+                              unsigned long ulDecimate,
+                              unsigned long ulTrigger,
+                              unsigned long ulTriggerChannel,
+                              unsigned long ulTriggerValue,
+                              unsigned long ulPreTrigger);
+extern void ScopeTrigger(void);
+extern void ScopeStop(void);
+extern unsigned long ScopeChannels(void);
+extern unsigned long ScopeRecords(void);
+extern unsigned long ScopePreTrigger(void);
+extern unsigned long ScopeRead(unsigned long ulOffset, unsigned char *pucData,
+                               unsigned long ulCount);
+
+#endif // __SCOPE_H__
@@ -0,0 +1,211 @@
+//*****************************************************************************
+//
+// sim.h - Internal interfaces shared by the host simulation modules.
+//
+//*****************************************************************************
+
+#ifndef __SIM_H__
+#define __SIM_H__
+
+//*****************************************************************************
+//
+//! \addtogroup sim_api
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! The number of interrupt vectors tracked by the simulated NVIC.
+//
+//*****************************************************************************
+#define SIM_NUM_INTS            72
+
+//*****************************************************************************
+//
+//! The number of simulated GPIO ports (A through H).
+//
+//*****************************************************************************
+#define SIM_NUM_PORTS           8
+
+//*****************************************************************************
+//
+//! The simulated interrupt dispatch latency, in system clocks, from an ADC
+//! sequence trigger to its completion interrupt (one conversion per
+//! microsecond at the 1 MSPS rate configured by ADCInit()).
+//
+//*****************************************************************************
+#define SIM_ADC_CONVERSION      50
+
+//*****************************************************************************
+//
+//! The period of the PWM generators out of reset, in PWM clocks.  PWMInit()
+//! immediately replaces it with a 1 KHz period.
+//
+//*****************************************************************************
+#define SIM_PWM_RESET_PERIOD    50000
+
+//*****************************************************************************
+//
+//! A simulated PWM generator.  Period and compare updates are latched at the
+//! next zero of the (synchronized) time base, matching the
+//! PWM_GEN_MODE_SYNC configuration used by PWMInit().
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The active period, in PWM clocks.
+    //
+    unsigned long ulPeriod;
+
+    //
+    //! The period to be latched at the next zero.
+    //
+    unsigned long ulPeriodNext;
+
+    //
+    //! The active pulse widths of the A and B outputs, in PWM clocks.
+    //
+    unsigned long pulWidth[2];
+
+    //
+    //! The pulse widths to be latched at the next zero.
+    //
+    unsigned long pulWidthNext[2];
+
+    //
+    //! Non-zero if the dead-band generator is enabled; the B output is then
+    //! the delayed complement of the A output.
+    //
+    unsigned long ulDeadBand;
+
+    //
+    //! The dead-band rising and falling edge delays, in PWM clocks.
+    //
+    unsigned long ulRise;
+    unsigned long ulFall;
+
+    //
+    //! The interrupt and trigger enables (PWM_INT_CNT_* | PWM_TR_CNT_*).
+    //
+    unsigned long ulIntTrig;
+}
+tSimPWMGen;
+
+//*****************************************************************************
+//
+//! The simulated quadrature encoder interface.  It always counts both edges
+//! of both channels of the plant's encoder, and resets the position at the
+//! index pulse.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! Non-zero if the QEI is enabled.
+    //
+    unsigned long ulEnabled;
+
+    //
+    //! The maximum value of the position counter.
+    //
+    unsigned long ulMaxPos;
+
+    //
+    //! The position counter.
+    //
+    unsigned long ulPosition;
+
+    //
+    //! The direction of the latest edge, which is one or negative one.
+    //
+    long lDirection;
+
+    //
+    //! The plant's encoder count at the latest edge seen by the QEI.
+    //
+    long lCount;
+
+    //
+    //! Non-zero if the velocity timer is enabled, with the period of the
+    //! timer, in system clocks, and the time at which it next expires.
+    //
+    unsigned long ulVelEnabled;
+    unsigned long ulVelPeriod;
+    tSimTime ullVelExpire;
+
+    //
+    //! The edges counted in the current velocity period, and the count
+    //! latched at the end of the previous one.
+    //
+    unsigned long ulVelCount;
+    unsigned long ulVelLatched;
+
+    //
+    //! The raw interrupt status and the interrupt mask (QEI_INT*).
+    //
+    unsigned long ulIntStatus;
+    unsigned long ulIntMask;
+}
+tSimQEI;
+
+//*****************************************************************************
+//
+// Prototypes for the simulated hardware, in sim_hw.c.
+//
+//*****************************************************************************
+extern tSimTime g_ullSimTime;
+extern tSimPWMGen g_psSimPWMGen[3];
+extern unsigned long g_ulSimPWMIntEnable;
+extern unsigned long g_ulSimShootThrough;
+extern tSimQEI g_sSimQEI;
+extern void SimHwReset(void);
+extern void SimHwFlush(void);
+extern volatile unsigned long *SimRegCell(unsigned long ulAddr);
+extern void SimIntPend(unsigned long ulInterrupt);
+extern void SimIntEnableSet(unsigned long ulInterrupt, int iEnable);
+extern void SimIntPrioritySet(unsigned long ulInterrupt,
+                              unsigned long ulPriority);
+extern int SimIntMasterSet(int iEnable);
+extern void SimDispatch(void);
+extern void SimRun(tSimTime ullUntil);
+extern void SimDelay(tSimTime ullCycles);
+extern void SimTimerSync(unsigned long ulBase);
+extern unsigned long SimTimerValue(unsigned long ulBase);
+extern void SimSysTickSet(unsigned long ulPeriod, int iEnable,
+                          int iIntEnable);
+extern void SimADCTrigger(unsigned long ulSeq);
+extern void SimADCStepSet(unsigned long ulSeq, unsigned long ulStep,
+                          unsigned long ulConfig);
+extern void SimADCTriggerSet(unsigned long ulSeq, unsigned long ulTrigger);
+extern unsigned long SimADCFifoGet(unsigned long ulSeq);
+extern unsigned long SimADCFifoCount(unsigned long ulSeq);
+extern unsigned long SimADCRawStatus(void);
+extern void SimADCRawClear(unsigned long ulBits);
+extern void SimGPIOInput(unsigned long ulPort, unsigned long ulPins,
+                         unsigned long ulValue);
+extern unsigned long SimGPIOPort(unsigned long ulBase);
+extern unsigned long SimGPIORead(unsigned long ulPort);
+extern unsigned long g_pulSimGPIOData[SIM_NUM_PORTS];
+extern unsigned long g_pulSimGPIODir[SIM_NUM_PORTS];
+extern unsigned long g_pulSimGPIOIntMask[SIM_NUM_PORTS];
+extern unsigned long g_pulSimGPIOIntStatus[SIM_NUM_PORTS];
+extern unsigned long SimPWMOutputs(tSimTime ullTime);
+extern tSimTime SimPWMNextEdge(tSimTime ullTime);
+extern void SimQEIEnable(int iEnable);
+extern void SimQEIVelocityEnable(int iEnable);
+extern void SimQEIIntCheck(void);
+extern void SimUARTRxPut(unsigned char ucData);
+extern int SimUARTRxGet(void);
+extern unsigned long SimUARTRxCount(void);
+extern unsigned long g_ulSimUARTIntMask;
+extern void (*g_pfnSimUARTTx)(unsigned char ucData);
+extern long SimFlashErase(unsigned long ulAddr);
+extern long SimFlashProgram(const unsigned long *pulData, unsigned long ulAddr,
+                            unsigned long ulCount);
+
+// Close the Doxygen group.
+//! @}
+
+#endif // __SIM_H__
@@ -0,0 +1,804 @@
+//*****************************************************************************
+//
+// sim_driverlib.c - Host implementations of the peripheral driver library
+//                   functions used by the motor drive firmware.
+//
+// The target build links against the pre-built driverlib; the simulation
+// build links these functions instead.  Each one is implemented on top of
+// the simulated hardware in sim_hw.c, and only to the extent that the drive
+// firmware depends on its behavior.
+//
+//*****************************************************************************
+
+#include "inc/hw_adc.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_pwm.h"
+#include "inc/hw_timer.h"
+#include "inc/hw_types.h"
+#include "driverlib/adc.h"
+#include "driverlib/flash.h"
+#include "driverlib/gpio.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/pwm.h"
+#include "driverlib/qei.h"
+#include "driverlib/ssi.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/systick.h"
+#include "driverlib/timer.h"
+#include "driverlib/uart.h"
+#include "driverlib/watchdog.h"
+#include "main.h"
+#include "sim/sim.h"
+
+//*****************************************************************************
+//
+//! \page sim_driverlib_intro Introduction
+//!
+//! The driver library is replaced function for function.  Configuration that
+//! has no effect on the simulated behavior (pad drive strength, pin muxing,
+//! clock gating, and so on) is accepted and ignored.  The PWM generators are
+//! always counting, in up/down mode, with synchronous updates; the ADC, timer,
+//! GPIO, UART, flash and interrupt functions operate on the simulated
+//! peripherals.
+//!
+//! The code for the replacement driver library is contained in
+//! <tt>sim/sim_driverlib.c</tt>.
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! \defgroup sim_driverlib_api Definitions
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! Converts a PWM_GEN_n value into a generator index.
+//
+//*****************************************************************************
+#define SIM_PWM_GEN(ulGen)      ((((ulGen) >> 6) - 1) & 3)
+
+//*****************************************************************************
+//
+//! The last reload value written to the watchdog, for inspection by scenarios.
+//
+//*****************************************************************************
+unsigned long g_ulSimWatchdogReload;
+
+//*****************************************************************************
+//
+// System control.  The part always runs at SYSTEM_CLOCK.
+//
+//*****************************************************************************
+void
+SysCtlClockSet(unsigned long ulConfig)
+{
+}
+
+unsigned long
+SysCtlClockGet(void)
+{
+    return(SYSTEM_CLOCK);
+}
+
+void
+SysCtlLDOSet(unsigned long ulVoltage)
+{
+}
+
+void
+SysCtlADCSpeedSet(unsigned long ulSpeed)
+{
+}
+
+void
+SysCtlPeripheralEnable(unsigned long ulPeripheral)
+{
+}
+
+void
+SysCtlPeripheralSleepEnable(unsigned long ulPeripheral)
+{
+}
+
+void
+SysCtlPeripheralClockGating(tBoolean bEnable)
+{
+}
+
+//*****************************************************************************
+//
+// SysCtlDelay() is a three cycle loop on the target.
+//
+//*****************************************************************************
+void
+SysCtlDelay(unsigned long ulCount)
+{
+    SimDelay((tSimTime)ulCount * 3);
+}
+
+//*****************************************************************************
+//
+// The interrupt controller.
+//
+//*****************************************************************************
+tBoolean
+IntMasterEnable(void)
+{
+    return(SimIntMasterSet(1));
+}
+
+tBoolean
+IntMasterDisable(void)
+{
+    return(SimIntMasterSet(0));
+}
+
+void
+IntEnable(unsigned long ulInterrupt)
+{
+    SimIntEnableSet(ulInterrupt, 1);
+}
+
+void
+IntDisable(unsigned long ulInterrupt)
+{
+    SimIntEnableSet(ulInterrupt, 0);
+}
+
+void
+IntPrioritySet(unsigned long ulInterrupt, unsigned char ucPriority)
+{
+    SimIntPrioritySet(ulInterrupt, ucPriority);
+}
+
+//*****************************************************************************
+//
+// SysTick.
+//
+//*****************************************************************************
+void
+SysTickPeriodSet(unsigned long ulPeriod)
+{
+    SimSysTickSet(ulPeriod, -1, -1);
+}
+
+void
+SysTickEnable(void)
+{
+    SimSysTickSet(0, 1, -1);
+}
+
+void
+SysTickIntEnable(void)
+{
+    SimSysTickSet(0, -1, 1);
+}
+
+//*****************************************************************************
+//
+// The general purpose timers.  Only timer A in 32-bit mode is simulated.
+//
+//*****************************************************************************
+void
+TimerConfigure(unsigned long ulBase, unsigned long ulConfig)
+{
+    HWREG(ulBase + TIMER_O_CTL) &= ~(TIMER_CTL_TAEN | TIMER_CTL_TBEN);
+    HWREG(ulBase + TIMER_O_TAMR) = ulConfig & 0xff;
+}
+
+void
+TimerLoadSet(unsigned long ulBase, unsigned long ulTimer,
+             unsigned long ulValue)
+{
+    HWREG(ulBase + TIMER_O_TAILR) = ulValue;
+    SimHwFlush();
+}
+
+void
+TimerEnable(unsigned long ulBase, unsigned long ulTimer)
+{
+    HWREG(ulBase + TIMER_O_CTL) |= TIMER_CTL_TAEN;
+    SimHwFlush();
+}
+
+void
+TimerIntEnable(unsigned long ulBase, unsigned long ulIntFlags)
+{
+    HWREG(ulBase + TIMER_O_IMR) |= ulIntFlags;
+}
+
+unsigned long
+TimerIntStatus(unsigned long ulBase, tBoolean bMasked)
+{
+    if(bMasked)
+    {
+        return(HWREG(ulBase + TIMER_O_RIS) & HWREG(ulBase + TIMER_O_IMR));
+    }
+    return(HWREG(ulBase + TIMER_O_RIS));
+}
+
+void
+TimerIntClear(unsigned long ulBase, unsigned long ulIntFlags)
+{
+    HWREG(ulBase + TIMER_O_RIS) &= ~ulIntFlags;
+}
+
+unsigned long
+TimerValueGet(unsigned long ulBase, unsigned long ulTimer)
+{
+    return(SimTimerValue(ulBase));
+}
+
+//*****************************************************************************
+//
+// The watchdog.  It is never allowed to expire in the simulation.
+//
+//*****************************************************************************
+void
+WatchdogReloadSet(unsigned long ulBase, unsigned long ulLoadVal)
+{
+    g_ulSimWatchdogReload = ulLoadVal;
+}
+
+void
+WatchdogEnable(unsigned long ulBase)
+{
+}
+
+void
+WatchdogResetEnable(unsigned long ulBase)
+{
+}
+
+void
+WatchdogIntClear(unsigned long ulBase)
+{
+}
+
+//*****************************************************************************
+//
+// GPIO.
+//
+//*****************************************************************************
+void
+GPIOPinTypeGPIOInput(unsigned long ulPort, unsigned char ucPins)
+{
+    g_pulSimGPIODir[SimGPIOPort(ulPort)] &= ~ucPins;
+}
+
+void
+GPIOPinTypeGPIOOutput(unsigned long ulPort, unsigned char ucPins)
+{
+    g_pulSimGPIODir[SimGPIOPort(ulPort)] |= ucPins;
+}
+
+void
+GPIOPinTypeGPIOOutputOD(unsigned long ulPort, unsigned char ucPins)
+{
+    g_pulSimGPIODir[SimGPIOPort(ulPort)] |= ucPins;
+}
+
+void
+GPIOPinTypePWM(unsigned long ulPort, unsigned char ucPins)
+{
+}
+
+void
+GPIOPinTypeQEI(unsigned long ulPort, unsigned char ucPins)
+{
+}
+
+void
+GPIOPinTypeSSI(unsigned long ulPort, unsigned char ucPins)
+{
+}
+
+void
+GPIOPinTypeUART(unsigned long ulPort, unsigned char ucPins)
+{
+}
+
+void
+GPIOPinConfigure(unsigned long ulPinConfig)
+{
+}
+
+void
+GPIOPadConfigSet(unsigned long ulPort, unsigned char ucPins,
+                 unsigned long ulStrength, unsigned long ulPadType)
+{
+}
+
+void
+GPIOIntTypeSet(unsigned long ulPort, unsigned char ucPins,
+               unsigned long ulIntType)
+{
+}
+
+void
+GPIOPinIntEnable(unsigned long ulPort, unsigned char ucPins)
+{
+    g_pulSimGPIOIntMask[SimGPIOPort(ulPort)] |= ucPins;
+}
+
+void
+GPIOPinIntDisable(unsigned long ulPort, unsigned char ucPins)
+{
+    g_pulSimGPIOIntMask[SimGPIOPort(ulPort)] &= ~ucPins;
+}
+
+void
+GPIOPinIntClear(unsigned long ulPort, unsigned char ucPins)
+{
+    g_pulSimGPIOIntStatus[SimGPIOPort(ulPort)] &= ~ucPins;
+}
+
+void
+GPIOPinWrite(unsigned long ulPort, unsigned char ucPins, unsigned char ucVal)
+{
+    unsigned long ulIdx;
+
+    ulIdx = SimGPIOPort(ulPort);
+    g_pulSimGPIOData[ulIdx] = ((g_pulSimGPIOData[ulIdx] & ~ucPins) |
+                               (ucVal & ucPins));
+}
+
+long
+GPIOPinRead(unsigned long ulPort, unsigned char ucPins)
+{
+    return(SimGPIORead(SimGPIOPort(ulPort)) & ucPins);
+}
+
+//*****************************************************************************
+//
+// The PWM module.  The generators always count up/down with synchronous
+// updates, so the configuration, enable and synchronization calls have no
+// further effect.
+//
+//*****************************************************************************
+void
+PWMGenConfigure(unsigned long ulBase, unsigned long ulGen,
+                unsigned long ulConfig)
+{
+}
+
+void
+PWMGenEnable(unsigned long ulBase, unsigned long ulGen)
+{
+}
+
+void
+PWMSyncTimeBase(unsigned long ulBase, unsigned long ulGenBits)
+{
+}
+
+void
+PWMSyncUpdate(unsigned long ulBase, unsigned long ulGenBits)
+{
+}
+
+void
+PWMOutputFault(unsigned long ulBase, unsigned long ulPWMOutBits,
+               tBoolean bFaultSuppress)
+{
+}
+
+void
+PWMOutputInvert(unsigned long ulBase, unsigned long ulPWMOutBits,
+                tBoolean bInvert)
+{
+}
+
+void
+PWMGenPeriodSet(unsigned long ulBase, unsigned long ulGen,
+                unsigned long ulPeriod)
+{
+    g_psSimPWMGen[SIM_PWM_GEN(ulGen)].ulPeriodNext = ulPeriod & ~1;
+}
+
+void
+PWMPulseWidthSet(unsigned long ulBase, unsigned long ulPWMOut,
+                 unsigned long ulWidth)
+{
+    g_psSimPWMGen[SIM_PWM_GEN(ulPWMOut)].pulWidthNext[ulPWMOut & 1] = ulWidth;
+}
+
+void
+PWMDeadBandEnable(unsigned long ulBase, unsigned long ulGen,
+                  unsigned short usRise, unsigned short usFall)
+{
+    tSimPWMGen *psGen;
+
+    psGen = &g_psSimPWMGen[SIM_PWM_GEN(ulGen)];
+    psGen->ulDeadBand = 1;
+    psGen->ulRise = usRise;
+    psGen->ulFall = usFall;
+}
+
+void
+PWMDeadBandDisable(unsigned long ulBase, unsigned long ulGen)
+{
+    g_psSimPWMGen[SIM_PWM_GEN(ulGen)].ulDeadBand = 0;
+}
+
+void
+PWMOutputState(unsigned long ulBase, unsigned long ulPWMOutBits,
+               tBoolean bEnable)
+{
+    if(bEnable)
+    {
+        HWREG(ulBase + PWM_O_ENABLE) |= ulPWMOutBits;
+    }
+    else
+    {
+        HWREG(ulBase + PWM_O_ENABLE) &= ~ulPWMOutBits;
+    }
+}
+
+void
+PWMGenIntTrigEnable(unsigned long ulBase, unsigned long ulGen,
+                    unsigned long ulIntTrig)
+{
+    g_psSimPWMGen[SIM_PWM_GEN(ulGen)].ulIntTrig |= ulIntTrig;
+}
+
+void
+PWMGenIntTrigDisable(unsigned long ulBase, unsigned long ulGen,
+                     unsigned long ulIntTrig)
+{
+    g_psSimPWMGen[SIM_PWM_GEN(ulGen)].ulIntTrig &= ~ulIntTrig;
+}
+
+void
+PWMGenIntClear(unsigned long ulBase, unsigned long ulGen, unsigned long ulInts)
+{
+}
+
+void
+PWMIntEnable(unsigned long ulBase, unsigned long ulGenFault)
+{
+    g_ulSimPWMIntEnable |= ulGenFault;
+}
+
+//*****************************************************************************
+//
+// The ADC.
+//
+//*****************************************************************************
+void
+ADCSequenceConfigure(unsigned long ulBase, unsigned long ulSequenceNum,
+                     unsigned long ulTrigger, unsigned long ulPriority)
+{
+    SimADCTriggerSet(ulSequenceNum, ulTrigger);
+}
+
+void
+ADCSequenceStepConfigure(unsigned long ulBase, unsigned long ulSequenceNum,
+                         unsigned long ulStep, unsigned long ulConfig)
+{
+    SimADCStepSet(ulSequenceNum, ulStep, ulConfig);
+}
+
+void
+ADCSequenceEnable(unsigned long ulBase, unsigned long ulSequenceNum)
+{
+    HWREG(ulBase + ADC_O_ACTSS) |= (1 << ulSequenceNum);
+}
+
+void
+ADCSequenceDisable(unsigned long ulBase, unsigned long ulSequenceNum)
+{
+    HWREG(ulBase + ADC_O_ACTSS) &= ~(1 << ulSequenceNum);
+}
+
+void
+ADCIntEnable(unsigned long ulBase, unsigned long ulSequenceNum)
+{
+    SimADCRawClear(1 << ulSequenceNum);
+    HWREG(ulBase + ADC_O_IM) |= (1 << ulSequenceNum);
+}
+
+void
+ADCIntDisable(unsigned long ulBase, unsigned long ulSequenceNum)
+{
+    HWREG(ulBase + ADC_O_IM) &= ~(1 << ulSequenceNum);
+}
+
+unsigned long
+ADCIntStatus(unsigned long ulBase, unsigned long ulSequenceNum,
+             tBoolean bMasked)
+{
+    unsigned long ulStatus;
+
+    //
+    // A busy-wait on the raw status lets time advance, so that a conversion
+    // in progress can complete.
+    //
+    SimDelay(1);
+
+    ulStatus = SimADCRawStatus() & (1 << ulSequenceNum);
+    if(bMasked)
+    {
+        ulStatus &= HWREG(ulBase + ADC_O_IM);
+    }
+    return(ulStatus);
+}
+
+void
+ADCIntClear(unsigned long ulBase, unsigned long ulSequenceNum)
+{
+    SimADCRawClear(1 << ulSequenceNum);
+}
+
+void
+ADCProcessorTrigger(unsigned long ulBase, unsigned long ulSequenceNum)
+{
+    SimADCTrigger(ulSequenceNum);
+}
+
+long
+ADCSequenceDataGet(unsigned long ulBase, unsigned long ulSequenceNum,
+                   unsigned long *pulBuffer)
+{
+    long lCount;
+
+    lCount = 0;
+    while(SimADCFifoCount(ulSequenceNum))
+    {
+        *pulBuffer++ = SimADCFifoGet(ulSequenceNum);
+        lCount++;
+    }
+    return(lCount);
+}
+
+//*****************************************************************************
+//
+// The quadrature encoder interface.  Only QEI0 is simulated, counting both
+// edges of both channels of the plant's encoder and resetting the position
+// at the index pulse, with the velocity predivider fixed at one.
+//
+//*****************************************************************************
+void
+QEIConfigure(unsigned long ulBase, unsigned long ulConfig,
+             unsigned long ulMaxPosition)
+{
+    g_sSimQEI.ulMaxPos = ulMaxPosition;
+}
+
+void
+QEIEnable(unsigned long ulBase)
+{
+    SimQEIEnable(1);
+}
+
+void
+QEIDisable(unsigned long ulBase)
+{
+    SimQEIEnable(0);
+}
+
+unsigned long
+QEIPositionGet(unsigned long ulBase)
+{
+    return(g_sSimQEI.ulPosition);
+}
+
+void
+QEIPositionSet(unsigned long ulBase, unsigned long ulPosition)
+{
+    g_sSimQEI.ulPosition = ulPosition;
+}
+
+long
+QEIDirectionGet(unsigned long ulBase)
+{
+    return(g_sSimQEI.lDirection);
+}
+
+void
+QEIVelocityConfigure(unsigned long ulBase, unsigned long ulPreDiv,
+                     unsigned long ulPeriod)
+{
+    g_sSimQEI.ulVelPeriod = ulPeriod;
+}
+
+void
+QEIVelocityEnable(unsigned long ulBase)
+{
+    SimQEIVelocityEnable(1);
+}
+
+void
+QEIVelocityDisable(unsigned long ulBase)
+{
+    SimQEIVelocityEnable(0);
+}
+
+unsigned long
+QEIVelocityGet(unsigned long ulBase)
+{
+    return(g_sSimQEI.ulVelLatched);
+}
+
+void
+QEIIntEnable(unsigned long ulBase, unsigned long ulIntFlags)
+{
+    g_sSimQEI.ulIntMask |= ulIntFlags;
+    SimQEIIntCheck();
+}
+
+void
+QEIIntDisable(unsigned long ulBase, unsigned long ulIntFlags)
+{
+    g_sSimQEI.ulIntMask &= ~ulIntFlags;
+}
+
+unsigned long
+QEIIntStatus(unsigned long ulBase, tBoolean bMasked)
+{
+    if(bMasked)
+    {
+        return(g_sSimQEI.ulIntStatus & g_sSimQEI.ulIntMask);
+    }
+    return(g_sSimQEI.ulIntStatus);
+}
+
+void
+QEIIntClear(unsigned long ulBase, unsigned long ulIntFlags)
+{
+    g_sSimQEI.ulIntStatus &= ~ulIntFlags;
+}
+
+//*****************************************************************************
+//
+// The UART.  Received characters are supplied by the scenario through
+// SimUARTRxPut(); transmitted characters are passed to g_pfnSimUARTTx.  The
+// transmit FIFO never fills, so the transmit interrupt is never needed.
+//
+//*****************************************************************************
+void
+UARTConfigSetExpClk(unsigned long ulBase, unsigned long ulUARTClk,
+                    unsigned long ulBaud, unsigned long ulConfig)
+{
+}
+
+void
+UARTFIFOLevelSet(unsigned long ulBase, unsigned long ulTxLevel,
+                 unsigned long ulRxLevel)
+{
+}
+
+void
+UARTRxErrorClear(unsigned long ulBase)
+{
+}
+
+void
+UARTIntEnable(unsigned long ulBase, unsigned long ulIntFlags)
+{
+    g_ulSimUARTIntMask |= ulIntFlags;
+}
+
+void
+UARTIntDisable(unsigned long ulBase, unsigned long ulIntFlags)
+{
+    g_ulSimUARTIntMask &= ~ulIntFlags;
+}
+
+void
+UARTIntClear(unsigned long ulBase, unsigned long ulIntFlags)
+{
+}
+
+unsigned long
+UARTIntStatus(unsigned long ulBase, tBoolean bMasked)
+{
+    unsigned long ulStatus;
+
+    ulStatus = SimUARTRxCount() ? (UART_INT_RX | UART_INT_RT) : 0;
+    if(bMasked)
+    {
+        ulStatus &= g_ulSimUARTIntMask;
+    }
+    return(ulStatus);
+}
+
+tBoolean
+UARTSpaceAvail(unsigned long ulBase)
+{
+    return(true);
+}
+
+tBoolean
+UARTBusy(unsigned long ulBase)
+{
+    return(false);
+}
+
+tBoolean
+UARTCharsAvail(unsigned long ulBase)
+{
+    return(SimUARTRxCount() ? true : false);
+}
+
+long
+UARTCharGetNonBlocking(unsigned long ulBase)
+{
+    return(SimUARTRxGet());
+}
+
+tBoolean
+UARTCharPutNonBlocking(unsigned long ulBase, unsigned char ucData)
+{
+    if(g_pfnSimUARTTx)
+    {
+        g_pfnSimUARTTx(ucData);
+    }
+    return(true);
+}
+
+//*****************************************************************************
+//
+// The flash, of which only the handpiece calibration store is simulated.
+//
+//*****************************************************************************
+long
+FlashErase(unsigned long ulAddress)
+{
+    return(SimFlashErase(ulAddress));
+}
+
+long
+FlashProgram(unsigned long *pulData, unsigned long ulAddress,
+             unsigned long ulCount)
+{
+    return(SimFlashProgram(pulData, ulAddress, ulCount));
+}
+
+//*****************************************************************************
+//
+// The SSI port, which talks to the expanded I/O on the handpiece board.
+// Writes are discarded and nothing is ever received.  SpiWrite() waits for
+// SSIBusy() to become true, so it is reported as always busy.
+//
+//*****************************************************************************
+void
+SSIConfigSetExpClk(unsigned long ulBase, unsigned long ulSSIClk,
+                   unsigned long ulProtocol, unsigned long ulMode,
+                   unsigned long ulBitRate, unsigned long ulDataWidth)
+{
+}
+
+void
+SSIEnable(unsigned long ulBase)
+{
+}
+
+void
+SSIDisable(unsigned long ulBase)
+{
+}
+
+void
+SSIDataPut(unsigned long ulBase, unsigned long ulData)
+{
+}
+
+long
+SSIDataGetNonBlocking(unsigned long ulBase, unsigned long *pulData)
+{
+    return(0);
+}
+
+tBoolean
+SSIBusy(unsigned long ulBase)
+{
+    return(true);
+}
+
+// Close the Doxygen group.
+//! @}
@@ -0,0 +1,1850 @@
+//*****************************************************************************
+//
+// sim_hw.c - Simulated LM3S8971 register file, NVIC and peripheral timing.
+//
+//*****************************************************************************
+
+#include "inc/hw_adc.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_nvic.h"
+#include "inc/hw_pwm.h"
+#include "inc/hw_timer.h"
+#include "inc/hw_types.h"
+#include "driverlib/adc.h"
+#include "driverlib/pwm.h"
+#include "driverlib/qei.h"
+#include "main.h"
+#include "sim/sim.h"
+#include "sim/sim_motor.h"
+
+//*****************************************************************************
+//
+//! \page sim_hw_intro Introduction
+//!
+//! The host simulation build runs the unmodified drive control sources on a
+//! Linux host.  Every HWREG() and bit-band access made by those sources is
+//! redirected (by sim_hw.h) into this module, and every driverlib call is
+//! implemented in sim_driverlib.c on top of the state kept here.
+//!
+//! Simulated time is kept as a 64-bit count of 50 MHz system clocks in
+//! #g_ullSimTime.  SimRun() advances time from one hardware event to the
+//! next (PWM zero and load, ADC sequence completion, timer, SysTick and QEI
+//! velocity timer expiry, and Hall edges reported by the plant model),
+//! integrating the plant model across each interval and dispatching the
+//! interrupts raised at each event.  The encoder edges produced by the plant
+//! over each interval are counted by the QEI at the end of the interval.
+//!
+//! Interrupt handlers execute in zero simulated time and are never
+//! preempted; when several interrupts are pending they are taken in NVIC
+//! priority order.  This is deterministic, and is accurate as long as the
+//! handlers are short compared to the PWM period, which is the case on the
+//! target.
+//!
+//! The register file is sparse; an access to any address simply returns a
+//! storage cell for it.  The side effects of writing a register are applied
+//! at the next call into the simulated hardware (or at the end of the
+//! interrupt handler), which is before they could be observed by the
+//! hardware on the target.
+//!
+//! Bit-band accesses to SRAM variables are returned as a shadow cell holding
+//! the current value of the bit.  If the cell is modified, the bit is written
+//! back to the variable at the next call into the simulated hardware.
+//!
+//! The flash used by the handpiece calibration store is simulated as well,
+//! so that the store can be exercised; it is read through HWREG() like any
+//! other address, and erased and programmed by the driver library.
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! \defgroup sim_hw_api Definitions
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! The number of cells in the sparse register file.  This must be a power of
+//! two.
+//
+//*****************************************************************************
+#define SIM_NUM_REGS            1024
+
+//*****************************************************************************
+//
+//! The number of bit-band shadow cells.  A cell is recycled after this many
+//! further bit-band accesses.
+//
+//*****************************************************************************
+#define SIM_NUM_BITS            16
+
+//*****************************************************************************
+//
+//! The number of register accesses whose write side effects can be pending
+//! at once.
+//
+//*****************************************************************************
+#define SIM_NUM_TOUCHED         16
+
+//*****************************************************************************
+//
+//! The depth of the simulated UART receive FIFO.
+//
+//*****************************************************************************
+#define SIM_UART_RX_SIZE        256
+
+//*****************************************************************************
+//
+//! The range of simulated flash, which is the handpiece calibration store.
+//
+//*****************************************************************************
+#define SIM_FLASH_START         HPCAL_START
+#define SIM_FLASH_END           HPCAL_END
+
+//*****************************************************************************
+//
+//! A cell of the sparse register file.
+//
+//*****************************************************************************
+typedef struct
+{
+    unsigned long ulAddr;
+    unsigned long ulValue;
+    unsigned long ulUsed;
+}
+tSimReg;
+
+//*****************************************************************************
+//
+//! A bit-band shadow cell.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The byte of SRAM containing the bit.
+    //
+    volatile unsigned char *pucByte;
+
+    //
+    //! The bit within the byte.
+    //
+    unsigned long ulBit;
+
+    //
+    //! The bit value last synchronized with the variable.
+    //
+    unsigned long ulOrig;
+
+    //
+    //! The cells handed to the caller, one per access width.
+    //
+    unsigned long ulCellW;
+    unsigned short usCellH;
+    unsigned char ucCellB;
+
+    //
+    //! The access width (4, 2 or 1) of the cell handed out, or zero if unused.
+    //
+    unsigned long ulSize;
+}
+tSimBit;
+
+//*****************************************************************************
+//
+//! A simulated general purpose timer.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! Non-zero if the timer is counting.
+    //
+    unsigned long ulRunning;
+
+    //
+    //! The time at which the timer next reaches zero.
+    //
+    tSimTime ullExpire;
+
+    //
+    //! Non-zero if the interval load register was accessed since the last
+    //! synchronization.
+    //
+    unsigned long ulLoadTouched;
+}
+tSimTimer;
+
+//*****************************************************************************
+//
+//! A simulated ADC sample sequencer.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The trigger source (ADC_TRIGGER_*).
+    //
+    unsigned long ulTrigger;
+
+    //
+    //! The step configuration (ADC_CTL_*).
+    //
+    unsigned long pulStep[8];
+
+    //
+    //! The result FIFO.
+    //
+    unsigned long pulFifo[8];
+    unsigned long ulFifoRead;
+    unsigned long ulFifoCount;
+
+    //
+    //! The time at which the sequence in progress completes, or zero.
+    //
+    tSimTime ullDone;
+
+    //
+    //! Non-zero if the sequence in progress has a step with ADC_CTL_IE.
+    //
+    unsigned long ulIntPending;
+}
+tSimADCSeq;
+
+//*****************************************************************************
+//
+//! The current simulated time, in system clocks.
+//
+//*****************************************************************************
+tSimTime g_ullSimTime;
+
+//*****************************************************************************
+//
+//! The simulated PWM generators.
+//
+//*****************************************************************************
+tSimPWMGen g_psSimPWMGen[3];
+
+//*****************************************************************************
+//
+//! The PWM module interrupt enables (PWM_INT_GEN_*).
+//
+//*****************************************************************************
+unsigned long g_ulSimPWMIntEnable;
+
+//*****************************************************************************
+//
+//! The number of PWM periods in which both switches of an inverter leg were
+//! commanded on at the same time.
+//
+//*****************************************************************************
+unsigned long g_ulSimShootThrough;
+
+//*****************************************************************************
+//
+//! The simulated quadrature encoder interface.
+//
+//*****************************************************************************
+tSimQEI g_sSimQEI;
+
+//*****************************************************************************
+//
+//! The time at which the current PWM period started, and whether the load
+//! (center) event of the period has already been processed.
+//
+//*****************************************************************************
+static tSimTime g_ullSimPWMStart;
+static unsigned long g_ulSimPWMLoadDone;
+
+//*****************************************************************************
+//
+//! The simulated GPIO ports.
+//
+//*****************************************************************************
+unsigned long g_pulSimGPIOData[SIM_NUM_PORTS];
+unsigned long g_pulSimGPIODir[SIM_NUM_PORTS];
+unsigned long g_pulSimGPIOIntMask[SIM_NUM_PORTS];
+unsigned long g_pulSimGPIOIntStatus[SIM_NUM_PORTS];
+static unsigned long g_pulSimGPIOIn[SIM_NUM_PORTS];
+
+//*****************************************************************************
+//
+//! The base address and interrupt number of each GPIO port.
+//
+//*****************************************************************************
+static const unsigned long g_pulSimGPIOBase[SIM_NUM_PORTS] =
+{
+    GPIO_PORTA_BASE, GPIO_PORTB_BASE, GPIO_PORTC_BASE, GPIO_PORTD_BASE,
+    GPIO_PORTE_BASE, GPIO_PORTF_BASE, GPIO_PORTG_BASE, GPIO_PORTH_BASE
+};
+static const unsigned long g_pulSimGPIOInt[SIM_NUM_PORTS] =
+{
+    INT_GPIOA, INT_GPIOB, INT_GPIOC, INT_GPIOD,
+    INT_GPIOE, INT_GPIOF, INT_GPIOG, INT_GPIOH
+};
+
+//*****************************************************************************
+//
+//! The UART receive FIFO, interrupt mask and transmit hook.
+//
+//*****************************************************************************
+static unsigned char g_pucSimUARTRx[SIM_UART_RX_SIZE];
+static unsigned long g_ulSimUARTRxRead;
+static unsigned long g_ulSimUARTRxCount;
+unsigned long g_ulSimUARTIntMask;
+void (*g_pfnSimUARTTx)(unsigned char ucData);
+
+//*****************************************************************************
+//
+//! The simulated flash.
+//
+//*****************************************************************************
+static unsigned long g_pulSimFlash[(SIM_FLASH_END - SIM_FLASH_START) / 4];
+
+//*****************************************************************************
+//
+// The remaining simulated hardware state.
+//
+//*****************************************************************************
+static tSimReg g_psSimRegs[SIM_NUM_REGS];
+static tSimBit g_psSimBits[SIM_NUM_BITS];
+static unsigned long g_ulSimBitNext;
+static unsigned long g_pulSimTouched[SIM_NUM_TOUCHED];
+static unsigned long g_ulSimTouchedCount;
+static tSimTimer g_psSimTimer[2];
+static tSimADCSeq g_psSimADCSeq[4];
+static unsigned long g_ulSimADCRis;
+static unsigned char g_pucSimIntPending[SIM_NUM_INTS];
+static unsigned char g_pucSimIntEnabled[SIM_NUM_INTS];
+static unsigned char g_pucSimIntPriority[SIM_NUM_INTS];
+static int g_iSimIntMaster = 1;
+static int g_iSimInISR;
+static unsigned long g_ulSimSysTickPeriod;
+static int g_iSimSysTickInt;
+static tSimTime g_ullSimSysTickExpire;
+
+//*****************************************************************************
+//
+// The interrupt handlers of the application, as listed in startup_ccs.c.
+//
+//*****************************************************************************
+extern void SysTickIntHandler(void);
+extern void GPIOBIntHandler(void);
+extern void UARTIntHandler(void);
+extern void PWM0IntHandler(void);
+extern void MainWaveformTick(void);
+extern void MainMillisecondTick(void);
+extern void ADC0IntHandler(void);
+extern void WatchdogIntHandler(void);
+extern void Timer0AIntHandler(void);
+extern void Timer1AIntHandler(void);
+extern void QEIIntHandler(void);
+
+//*****************************************************************************
+//
+//! Returns the handler for an interrupt, or zero if the application does not
+//! install one.
+//
+//*****************************************************************************
+static void
+(*SimIntHandler(unsigned long ulInterrupt))(void)
+{
+    switch(ulInterrupt)
+    {
+        case FAULT_SYSTICK:
+            return(SysTickIntHandler);
+        case INT_GPIOB:
+            return(GPIOBIntHandler);
+        case INT_UART0:
+            return(UARTIntHandler);
+        case INT_PWM0:
+            return(PWM0IntHandler);
+        case INT_PWM1:
+            return(MainWaveformTick);
+        case INT_PWM2:
+            return(MainMillisecondTick);
+        case INT_ADC0SS0:
+            return(ADC0IntHandler);
+        case INT_WATCHDOG:
+            return(WatchdogIntHandler);
+        case INT_TIMER0A:
+            return(Timer0AIntHandler);
+        case INT_TIMER1A:
+            return(Timer1AIntHandler);
+        case INT_QEI0:
+            return(QEIIntHandler);
+        default:
+            return(0);
+    }
+}
+
+//*****************************************************************************
+//
+//! Returns the storage cell for a register, without any side effects.
+//!
+//! \param ulAddr is the address of the register.
+//!
+//! \return A pointer to the register's storage.
+//
+//*****************************************************************************
+volatile unsigned long *
+SimRegCell(unsigned long ulAddr)
+{
+    unsigned long ulIdx;
+
+    //
+    // Registers are 32-bit aligned; narrower accesses share the cell.
+    //
+    ulAddr &= 0xfffffffc;
+
+    //
+    // Find the cell for this address, or the empty slot where it belongs.
+    //
+    ulIdx = ((ulAddr >> 2) * 2654435761U) & (SIM_NUM_REGS - 1);
+    while(g_psSimRegs[ulIdx].ulUsed && (g_psSimRegs[ulIdx].ulAddr != ulAddr))
+    {
+        ulIdx = (ulIdx + 1) & (SIM_NUM_REGS - 1);
+    }
+
+    //
+    // Claim the slot if this is the first access to the register.
+    //
+    if(!g_psSimRegs[ulIdx].ulUsed)
+    {
+        g_psSimRegs[ulIdx].ulUsed = 1;
+        g_psSimRegs[ulIdx].ulAddr = ulAddr;
+        g_psSimRegs[ulIdx].ulValue = 0;
+    }
+
+    return(&g_psSimRegs[ulIdx].ulValue);
+}
+
+//*****************************************************************************
+//
+//! Records a register access whose write side effect must be applied at the
+//! next flush.
+//
+//*****************************************************************************
+static void
+SimRegTouch(unsigned long ulAddr)
+{
+    if(g_ulSimTouchedCount < SIM_NUM_TOUCHED)
+    {
+        g_pulSimTouched[g_ulSimTouchedCount++] = ulAddr;
+    }
+}
+
+//*****************************************************************************
+//
+//! Returns a simulated register for a 32-bit HWREG() access.
+//!
+//! \param ulAddr is the address of the register.
+//!
+//! Reads of the ADC FIFO and FIFO status registers are resolved here, since
+//! the value must be current when the caller dereferences the result.
+//!
+//! \return A pointer to the register's storage.
+//
+//*****************************************************************************
+volatile unsigned long *
+SimRegW(unsigned long ulAddr)
+{
+    volatile unsigned long *pulCell;
+    unsigned long ulSeq;
+
+    //
+    // Apply the side effects of any previous access.
+    //
+    SimHwFlush();
+
+    ulAddr &= 0xfffffffc;
+
+    //
+    // The simulated flash.
+    //
+    if((ulAddr >= SIM_FLASH_START) && (ulAddr < SIM_FLASH_END))
+    {
+        return(&g_pulSimFlash[(ulAddr - SIM_FLASH_START) / 4]);
+    }
+
+    pulCell = SimRegCell(ulAddr);
+
+    //
+    // The ADC sample sequencer FIFO and FIFO status registers.
+    //
+    if((ulAddr >= (ADC0_BASE + ADC_O_SSFIFO0)) &&
+       (ulAddr <= (ADC0_BASE + ADC_O_SSFSTAT3)) &&
+       (((ulAddr - (ADC0_BASE + ADC_O_SSFIFO0)) & 0x1b) == 0))
+    {
+        ulSeq = (ulAddr - (ADC0_BASE + ADC_O_SSFIFO0)) / 0x20;
+        if(ulAddr & 4)
+        {
+            *pulCell = ((SimADCFifoCount(ulSeq) == 0) ? ADC_SSFSTAT0_EMPTY :
+                        0);
+        }
+        else
+        {
+            *pulCell = SimADCFifoGet(ulSeq);
+        }
+        return(pulCell);
+    }
+
+    //
+    // The ADC overflow and underflow status registers.  Sequences are
+    // always drained by the handler that they interrupt, so neither
+    // condition can occur; the registers are write-one-to-clear, so the
+    // value written when the handler clears them must not be read back.
+    //
+    if((ulAddr == (ADC0_BASE + ADC_O_OSTAT)) ||
+       (ulAddr == (ADC0_BASE + ADC_O_USTAT)))
+    {
+        *pulCell = 0;
+        return(pulCell);
+    }
+
+    //
+    // Registers with write side effects.
+    //
+    if((ulAddr == NVIC_SW_TRIG) || (ulAddr == (ADC0_BASE + ADC_O_ISC)) ||
+       (ulAddr == (TIMER0_BASE + TIMER_O_CTL)) ||
+       (ulAddr == (TIMER1_BASE + TIMER_O_CTL)))
+    {
+        SimRegTouch(ulAddr);
+    }
+    if((ulAddr == (TIMER0_BASE + TIMER_O_TAILR)) ||
+       (ulAddr == (TIMER1_BASE + TIMER_O_TAILR)))
+    {
+        g_psSimTimer[(ulAddr >> 12) & 1].ulLoadTouched = 1;
+        SimRegTouch(ulAddr);
+    }
+
+    return(pulCell);
+}
+
+//*****************************************************************************
+//
+//! Returns a simulated register for a 16-bit HWREGH() access.
+//
+//*****************************************************************************
+volatile unsigned short *
+SimRegH(unsigned long ulAddr)
+{
+    return((volatile unsigned short *)SimRegW(ulAddr) + ((ulAddr >> 1) & 1));
+}
+
+//*****************************************************************************
+//
+//! Returns a simulated register for an 8-bit HWREGB() access.
+//
+//*****************************************************************************
+volatile unsigned char *
+SimRegB(unsigned long ulAddr)
+{
+    return((volatile unsigned char *)SimRegW(ulAddr) + (ulAddr & 3));
+}
+
+//*****************************************************************************
+//
+//! Allocates a bit-band shadow cell for a bit of an SRAM variable.
+//
+//*****************************************************************************
+static tSimBit *
+SimBitAlloc(volatile void *pvAddr, unsigned long ulBit, unsigned long ulSize)
+{
+    tSimBit *psBit;
+
+    //
+    // Write back any modified cells before handing out a new one.
+    //
+    SimHwFlush();
+
+    //
+    // Take the next cell in turn.
+    //
+    psBit = &g_psSimBits[g_ulSimBitNext];
+    g_ulSimBitNext = (g_ulSimBitNext + 1) % SIM_NUM_BITS;
+
+    //
+    // Capture the current value of the bit.
+    //
+    psBit->pucByte = (volatile unsigned char *)pvAddr + (ulBit / 8);
+    psBit->ulBit = ulBit % 8;
+    psBit->ulOrig = (*psBit->pucByte >> psBit->ulBit) & 1;
+    psBit->ulCellW = psBit->ulOrig;
+    psBit->usCellH = psBit->ulOrig;
+    psBit->ucCellB = psBit->ulOrig;
+    psBit->ulSize = ulSize;
+
+    return(psBit);
+}
+
+//*****************************************************************************
+//
+//! Returns a shadow cell for a word HWREGBITW() access.
+//
+//*****************************************************************************
+volatile unsigned long *
+SimBitW(volatile void *pvAddr, unsigned long ulBit)
+{
+    return(&SimBitAlloc(pvAddr, ulBit, 4)->ulCellW);
+}
+
+//*****************************************************************************
+//
+//! Returns a shadow cell for a half-word HWREGBITH() access.
+//
+//*****************************************************************************
+volatile unsigned short *
+SimBitH(volatile void *pvAddr, unsigned long ulBit)
+{
+    return(&SimBitAlloc(pvAddr, ulBit, 2)->usCellH);
+}
+
+//*****************************************************************************
+//
+//! Returns a shadow cell for a byte HWREGBITB() access.
+//
+//*****************************************************************************
+volatile unsigned char *
+SimBitB(volatile void *pvAddr, unsigned long ulBit)
+{
+    return(&SimBitAlloc(pvAddr, ulBit, 1)->ucCellB);
+}
+
+//*****************************************************************************
+//
+//! Applies pending bit-band writes and register write side effects.
+//!
+//! This function is called on every entry to the simulated hardware and at
+//! the end of every interrupt handler.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+SimHwFlush(void)
+{
+    unsigned long ulIdx, ulValue, ulAddr;
+    tSimBit *psBit;
+
+    //
+    // Write back any bit-band cells that were modified.
+    //
+    for(ulIdx = 0; ulIdx < SIM_NUM_BITS; ulIdx++)
+    {
+        psBit = &g_psSimBits[ulIdx];
+        if(psBit->ulSize == 0)
+        {
+            continue;
+        }
+        ulValue = ((psBit->ulSize == 4) ? psBit->ulCellW :
+                   ((psBit->ulSize == 2) ? psBit->usCellH :
+                    psBit->ucCellB)) & 1;
+        if(ulValue != psBit->ulOrig)
+        {
+            if(ulValue)
+            {
+                *psBit->pucByte |= (1 << psBit->ulBit);
+            }
+            else
+            {
+                *psBit->pucByte &= ~(1 << psBit->ulBit);
+            }
+            psBit->ulOrig = ulValue;
+        }
+    }
+
+    //
+    // Apply the side effects of register writes.
+    //
+    while(g_ulSimTouchedCount)
+    {
+        ulAddr = g_pulSimTouched[--g_ulSimTouchedCount];
+
+        if(ulAddr == NVIC_SW_TRIG)
+        {
+            SimIntPend((*SimRegCell(ulAddr) & NVIC_SW_TRIG_INTID_M) + 16);
+        }
+        else if(ulAddr == (ADC0_BASE + ADC_O_ISC))
+        {
+            g_ulSimADCRis &= ~(*SimRegCell(ulAddr) & 0xf);
+            *SimRegCell(ulAddr) = 0;
+        }
+        else
+        {
+            SimTimerSync(ulAddr & 0xfffff000);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+//! Marks an interrupt as pending.
+//
+//*****************************************************************************
+void
+SimIntPend(unsigned long ulInterrupt)
+{
+    if(ulInterrupt < SIM_NUM_INTS)
+    {
+        g_pucSimIntPending[ulInterrupt] = 1;
+    }
+}
+
+//*****************************************************************************
+//
+//! Enables or disables an interrupt in the NVIC.
+//
+//*****************************************************************************
+void
+SimIntEnableSet(unsigned long ulInterrupt, int iEnable)
+{
+    if(ulInterrupt < SIM_NUM_INTS)
+    {
+        g_pucSimIntEnabled[ulInterrupt] = iEnable ? 1 : 0;
+    }
+}
+
+//*****************************************************************************
+//
+//! Sets the priority of an interrupt.
+//
+//*****************************************************************************
+void
+SimIntPrioritySet(unsigned long ulInterrupt, unsigned long ulPriority)
+{
+    if(ulInterrupt < SIM_NUM_INTS)
+    {
+        g_pucSimIntPriority[ulInterrupt] = ulPriority & 0xe0;
+    }
+}
+
+//*****************************************************************************
+//
+//! Enables or disables interrupts at the processor, returning the previous
+//! disable state (as IntMasterDisable() does).
+//
+//*****************************************************************************
+int
+SimIntMasterSet(int iEnable)
+{
+    int iPrevious;
+
+    iPrevious = !g_iSimIntMaster;
+    g_iSimIntMaster = iEnable;
+    return(iPrevious);
+}
+
+//*****************************************************************************
+//
+//! Runs the handlers of all pending, enabled interrupts.
+//!
+//! Interrupts are taken one at a time, highest priority (lowest value) first
+//! with ties going to the lowest interrupt number, as the NVIC does.  Nothing
+//! is done if called from within a handler, since handlers do not nest in
+//! the simulation.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+SimDispatch(void)
+{
+    unsigned long ulIdx, ulBest;
+    void (*pfnHandler)(void);
+
+    if(g_iSimInISR)
+    {
+        return;
+    }
+
+    while(1)
+    {
+        SimHwFlush();
+
+        if(!g_iSimIntMaster)
+        {
+            return;
+        }
+
+        //
+        // Find the highest priority pending interrupt.
+        //
+        ulBest = SIM_NUM_INTS;
+        for(ulIdx = 0; ulIdx < SIM_NUM_INTS; ulIdx++)
+        {
+            if(g_pucSimIntPending[ulIdx] &&
+               (g_pucSimIntEnabled[ulIdx] || (ulIdx < 16)) &&
+               ((ulBest == SIM_NUM_INTS) ||
+                (g_pucSimIntPriority[ulIdx] < g_pucSimIntPriority[ulBest])))
+            {
+                ulBest = ulIdx;
+            }
+        }
+        if(ulBest == SIM_NUM_INTS)
+        {
+            return;
+        }
+
+        //
+        // Take the interrupt.
+        //
+        g_pucSimIntPending[ulBest] = 0;
+        pfnHandler = SimIntHandler(ulBest);
+        if(pfnHandler)
+        {
+            g_iSimInISR = 1;
+            pfnHandler();
+            SimHwFlush();
+            g_iSimInISR = 0;
+        }
+    }
+}
+
+//*****************************************************************************
+//
+//! Synchronizes a timer with its control and interval load registers.
+//!
+//! \param ulBase is the base address of the timer.
+//!
+//! This is called after the application writes the timer registers, either
+//! directly or through driverlib.  A write of the interval load register
+//! while the timer is enabled reloads the counter; setting the enable bit
+//! starts the timer from the interval load value.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+SimTimerSync(unsigned long ulBase)
+{
+    tSimTimer *psTimer;
+    unsigned long ulLoad;
+
+    if((ulBase != TIMER0_BASE) && (ulBase != TIMER1_BASE))
+    {
+        return;
+    }
+    psTimer = &g_psSimTimer[(ulBase >> 12) & 1];
+
+    //
+    // The timer counts from the interval load value down to zero.  The load
+    // value is 32 bits on the target.
+    //
+    ulLoad = *SimRegCell(ulBase + TIMER_O_TAILR) & 0xffffffff;
+
+    if(*SimRegCell(ulBase + TIMER_O_CTL) & TIMER_CTL_TAEN)
+    {
+        if(!psTimer->ulRunning || psTimer->ulLoadTouched)
+        {
+            psTimer->ulRunning = 1;
+            psTimer->ullExpire = g_ullSimTime + ulLoad;
+        }
+    }
+    else
+    {
+        psTimer->ulRunning = 0;
+    }
+    psTimer->ulLoadTouched = 0;
+}
+
+//*****************************************************************************
+//
+//! Returns the current count of a timer.
+//
+//*****************************************************************************
+unsigned long
+SimTimerValue(unsigned long ulBase)
+{
+    tSimTimer *psTimer;
+
+    SimHwFlush();
+    psTimer = &g_psSimTimer[(ulBase >> 12) & 1];
+    if(psTimer->ulRunning)
+    {
+        return((psTimer->ullExpire - g_ullSimTime) & 0xffffffff);
+    }
+    return(*SimRegCell(ulBase + TIMER_O_TAILR) & 0xffffffff);
+}
+
+//*****************************************************************************
+//
+//! Handles the expiry of a timer.
+//
+//*****************************************************************************
+static void
+SimTimerExpire(unsigned long ulBase)
+{
+    tSimTimer *psTimer;
+    unsigned long ulLoad;
+
+    psTimer = &g_psSimTimer[(ulBase >> 12) & 1];
+    ulLoad = *SimRegCell(ulBase + TIMER_O_TAILR) & 0xffffffff;
+
+    //
+    // Periodic timers reload; one-shot timers clear their enable bit.
+    //
+    if((*SimRegCell(ulBase + TIMER_O_TAMR) & 3) == TIMER_TAMR_TAMR_PERIOD)
+    {
+        psTimer->ullExpire += (ulLoad ? ulLoad : 1);
+    }
+    else
+    {
+        psTimer->ulRunning = 0;
+        *SimRegCell(ulBase + TIMER_O_CTL) &= ~TIMER_CTL_TAEN;
+    }
+
+    //
+    // Raise the time-out interrupt.
+    //
+    *SimRegCell(ulBase + TIMER_O_RIS) |= TIMER_RIS_TATORIS;
+    if(*SimRegCell(ulBase + TIMER_O_IMR) & TIMER_IMR_TATOIM)
+    {
+        SimIntPend((ulBase == TIMER0_BASE) ? INT_TIMER0A : INT_TIMER1A);
+    }
+}
+
+//*****************************************************************************
+//
+//! Configures the SysTick timer.
+//
+//*****************************************************************************
+void
+SimSysTickSet(unsigned long ulPeriod, int iEnable, int iIntEnable)
+{
+    if(ulPeriod)
+    {
+        g_ulSimSysTickPeriod = ulPeriod;
+    }
+    if(iEnable > 0)
+    {
+        g_ullSimSysTickExpire = g_ullSimTime + g_ulSimSysTickPeriod;
+    }
+    if(iIntEnable >= 0)
+    {
+        g_iSimSysTickInt = iIntEnable;
+    }
+}
+
+//*****************************************************************************
+//
+//! Sets the trigger source of an ADC sample sequence.
+//
+//*****************************************************************************
+void
+SimADCTriggerSet(unsigned long ulSeq, unsigned long ulTrigger)
+{
+    g_psSimADCSeq[ulSeq & 3].ulTrigger = ulTrigger;
+}
+
+//*****************************************************************************
+//
+//! Sets the configuration of a step of an ADC sample sequence.
+//
+//*****************************************************************************
+void
+SimADCStepSet(unsigned long ulSeq, unsigned long ulStep,
+              unsigned long ulConfig)
+{
+    g_psSimADCSeq[ulSeq & 3].pulStep[ulStep & 7] = ulConfig;
+}
+
+//*****************************************************************************
+//
+//! Triggers an ADC sample sequence.
+//!
+//! The samples are taken from the plant model at the time of the trigger.
+//! A processor triggered sequence completes immediately; a PWM triggered
+//! sequence completes (and interrupts) after one conversion time per step.
+//!
+//! \param ulSeq is the sample sequence number.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+SimADCTrigger(unsigned long ulSeq)
+{
+    tSimADCSeq *psSeq;
+    unsigned long ulStep, ulConfig;
+
+    psSeq = &g_psSimADCSeq[ulSeq & 3];
+
+    //
+    // Nothing happens if the sequence is not enabled.
+    //
+    if(!(*SimRegCell(ADC0_BASE + ADC_O_ACTSS) & (1 << ulSeq)))
+    {
+        return;
+    }
+
+    //
+    // Convert each step until the end of the sequence.  Samples that do not
+    // fit in the FIFO are lost.
+    //
+    psSeq->ulIntPending = 0;
+    for(ulStep = 0; ulStep < ((ulSeq == 0) ? 8 : ((ulSeq == 3) ? 1 : 4));
+        ulStep++)
+    {
+        ulConfig = psSeq->pulStep[ulStep];
+        if(psSeq->ulFifoCount < 8)
+        {
+            psSeq->pulFifo[(psSeq->ulFifoRead + psSeq->ulFifoCount) & 7] =
+                SimMotorADC(ulConfig);
+            psSeq->ulFifoCount++;
+        }
+        if(ulConfig & ADC_CTL_IE)
+        {
+            psSeq->ulIntPending = 1;
+        }
+        if(ulConfig & ADC_CTL_END)
+        {
+            break;
+        }
+    }
+
+    //
+    // Schedule the completion of the sequence.
+    //
+    if(psSeq->ulTrigger == ADC_TRIGGER_PROCESSOR)
+    {
+        psSeq->ullDone = 0;
+        if(psSeq->ulIntPending)
+        {
+            g_ulSimADCRis |= (1 << ulSeq);
+        }
+    }
+    else
+    {
+        psSeq->ullDone = g_ullSimTime + ((ulStep + 1) * SIM_ADC_CONVERSION);
+    }
+}
+
+//*****************************************************************************
+//
+//! Handles the completion of an ADC sample sequence.
+//
+//*****************************************************************************
+static void
+SimADCDone(unsigned long ulSeq)
+{
+    tSimADCSeq *psSeq;
+
+    psSeq = &g_psSimADCSeq[ulSeq];
+    psSeq->ullDone = 0;
+    if(psSeq->ulIntPending)
+    {
+        g_ulSimADCRis |= (1 << ulSeq);
+        if(*SimRegCell(ADC0_BASE + ADC_O_IM) & (1 << ulSeq))
+        {
+            SimIntPend(INT_ADC0SS0 + ulSeq);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+//! Reads the next sample from an ADC sequence FIFO.
+//
+//*****************************************************************************
+unsigned long
+SimADCFifoGet(unsigned long ulSeq)
+{
+    tSimADCSeq *psSeq;
+    unsigned long ulData;
+
+    psSeq = &g_psSimADCSeq[ulSeq & 3];
+    if(psSeq->ulFifoCount == 0)
+    {
+        return(0);
+    }
+    ulData = psSeq->pulFifo[psSeq->ulFifoRead];
+    psSeq->ulFifoRead = (psSeq->ulFifoRead + 1) & 7;
+    psSeq->ulFifoCount--;
+    return(ulData);
+}
+
+//*****************************************************************************
+//
+//! Returns the number of samples in an ADC sequence FIFO.
+//
+//*****************************************************************************
+unsigned long
+SimADCFifoCount(unsigned long ulSeq)
+{
+    return(g_psSimADCSeq[ulSeq & 3].ulFifoCount);
+}
+
+//*****************************************************************************
+//
+//! Returns the raw ADC interrupt status.
+//
+//*****************************************************************************
+unsigned long
+SimADCRawStatus(void)
+{
+    return(g_ulSimADCRis);
+}
+
+//*****************************************************************************
+//
+//! Clears ADC raw interrupt status bits.
+//
+//*****************************************************************************
+void
+SimADCRawClear(unsigned long ulBits)
+{
+    g_ulSimADCRis &= ~ulBits;
+}
+
+//*****************************************************************************
+//
+//! Returns the index of a GPIO port from its base address.
+//
+//*****************************************************************************
+unsigned long
+SimGPIOPort(unsigned long ulBase)
+{
+    unsigned long ulIdx;
+
+    for(ulIdx = 0; ulIdx < SIM_NUM_PORTS; ulIdx++)
+    {
+        if(g_pulSimGPIOBase[ulIdx] == ulBase)
+        {
+            return(ulIdx);
+        }
+    }
+    return(0);
+}
+
+//*****************************************************************************
+//
+//! Drives the external inputs of a GPIO port.
+//!
+//! \param ulPort is the port index (0 for port A).
+//! \param ulPins is the bit-packed set of pins being driven.
+//! \param ulValue is the value driven onto the pins.
+//!
+//! Any change on a pin with its interrupt enabled raises the port interrupt
+//! (all pins used by the application interrupt on both edges).
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+SimGPIOInput(unsigned long ulPort, unsigned long ulPins, unsigned long ulValue)
+{
+    unsigned long ulChanged;
+
+    ulChanged = (g_pulSimGPIOIn[ulPort] ^ ulValue) & ulPins;
+    g_pulSimGPIOIn[ulPort] = ((g_pulSimGPIOIn[ulPort] & ~ulPins) |
+                              (ulValue & ulPins));
+    if(ulChanged & g_pulSimGPIOIntMask[ulPort])
+    {
+        g_pulSimGPIOIntStatus[ulPort] |= ulChanged & g_pulSimGPIOIntMask[ulPort];
+        SimIntPend(g_pulSimGPIOInt[ulPort]);
+    }
+}
+
+//*****************************************************************************
+//
+//! Reads the pins of a GPIO port; outputs read back their driven value.
+//
+//*****************************************************************************
+unsigned long
+SimGPIORead(unsigned long ulPort)
+{
+    return((g_pulSimGPIOData[ulPort] & g_pulSimGPIODir[ulPort]) |
+           (g_pulSimGPIOIn[ulPort] & ~g_pulSimGPIODir[ulPort]));
+}
+
+//*****************************************************************************
+//
+//! Raises the QEI interrupt if any of its enabled sources are asserted.
+//
+//*****************************************************************************
+void
+SimQEIIntCheck(void)
+{
+    if(g_sSimQEI.ulIntStatus & g_sSimQEI.ulIntMask)
+    {
+        SimIntPend(INT_QEI0);
+    }
+}
+
+//*****************************************************************************
+//
+//! Enables or disables the QEI.  Once enabled, it counts the edges of the
+//! plant's encoder from its current position.
+//
+//*****************************************************************************
+void
+SimQEIEnable(int iEnable)
+{
+    g_sSimQEI.ulEnabled = iEnable;
+    g_sSimQEI.lCount = SimMotorEncoder();
+}
+
+//*****************************************************************************
+//
+//! Enables or disables the QEI velocity timer.  Once enabled, it starts a new
+//! period.
+//
+//*****************************************************************************
+void
+SimQEIVelocityEnable(int iEnable)
+{
+    g_sSimQEI.ulVelEnabled = iEnable;
+    g_sSimQEI.ullVelExpire = g_ullSimTime + g_sSimQEI.ulVelPeriod;
+    g_sSimQEI.ulVelCount = 0;
+}
+
+//*****************************************************************************
+//
+//! Counts the encoder edges that the plant has produced since the previous
+//! call.
+//!
+//! Each edge moves the position counter by one in the direction of rotation,
+//! wrapping at the maximum position.  Crossing the index resets the position
+//! to zero when moving forward (or to the maximum position when moving in
+//! reverse) and raises the index interrupt.
+//
+//*****************************************************************************
+static void
+SimQEIUpdate(void)
+{
+    unsigned long ulCounts;
+    long lCount, lStep;
+
+    if(!g_sSimQEI.ulEnabled)
+    {
+        return;
+    }
+
+    ulCounts = g_sSimMotorParams.ulEncoderLines * 4;
+    lCount = SimMotorEncoder();
+    while(g_sSimQEI.lCount != lCount)
+    {
+        //
+        // Take the next edge, noting a change in direction.
+        //
+        lStep = (lCount > g_sSimQEI.lCount) ? 1 : -1;
+        if(lStep != g_sSimQEI.lDirection)
+        {
+            g_sSimQEI.lDirection = lStep;
+            g_sSimQEI.ulIntStatus |= QEI_INTDIR;
+        }
+        g_sSimQEI.ulVelCount++;
+
+        //
+        // Move the position counter, resetting it at the index.
+        //
+        if((lStep > 0) &&
+           ((((g_sSimQEI.lCount + 1) % (long)ulCounts) + ulCounts) %
+            ulCounts) == 0)
+        {
+            g_sSimQEI.ulPosition = 0;
+            g_sSimQEI.ulIntStatus |= QEI_INTINDEX;
+        }
+        else if((lStep < 0) &&
+                (((g_sSimQEI.lCount % (long)ulCounts) + ulCounts) %
+                 ulCounts) == 0)
+        {
+            g_sSimQEI.ulPosition = g_sSimQEI.ulMaxPos;
+            g_sSimQEI.ulIntStatus |= QEI_INTINDEX;
+        }
+        else if(lStep > 0)
+        {
+            g_sSimQEI.ulPosition = ((g_sSimQEI.ulPosition >=
+                                     g_sSimQEI.ulMaxPos) ? 0 :
+                                    (g_sSimQEI.ulPosition + 1));
+        }
+        else
+        {
+            g_sSimQEI.ulPosition = ((g_sSimQEI.ulPosition == 0) ?
+                                    g_sSimQEI.ulMaxPos :
+                                    (g_sSimQEI.ulPosition - 1));
+        }
+        g_sSimQEI.lCount += lStep;
+    }
+    SimQEIIntCheck();
+}
+
+//*****************************************************************************
+//
+//! Handles the expiry of the QEI velocity timer.
+//
+//*****************************************************************************
+static void
+SimQEIVelocityExpire(void)
+{
+    g_sSimQEI.ullVelExpire += g_sSimQEI.ulVelPeriod;
+    g_sSimQEI.ulVelLatched = g_sSimQEI.ulVelCount;
+    g_sSimQEI.ulVelCount = 0;
+    g_sSimQEI.ulIntStatus |= QEI_INTTIMER;
+    SimQEIIntCheck();
+}
+
+//*****************************************************************************
+//
+//! Erases a kilobyte page of the simulated flash to all ones.
+//!
+//! \param ulAddr is the address of the page.
+//!
+//! \return Returns 0 on success, or -1 if the address is not the start of a
+//! page of simulated flash.
+//
+//*****************************************************************************
+long
+SimFlashErase(unsigned long ulAddr)
+{
+    unsigned long ulIdx;
+
+    if((ulAddr < SIM_FLASH_START) || (ulAddr >= SIM_FLASH_END) ||
+       (ulAddr & 1023))
+    {
+        return(-1);
+    }
+    for(ulIdx = 0; ulIdx < (1024 / 4); ulIdx++)
+    {
+        g_pulSimFlash[((ulAddr - SIM_FLASH_START) / 4) + ulIdx] = 0xffffffff;
+    }
+    return(0);
+}
+
+//*****************************************************************************
+//
+//! Programs words of the simulated flash.
+//!
+//! \param pulData is the data to program.
+//! \param ulAddr is the address at which to program it.
+//! \param ulCount is the number of bytes to program, a multiple of four.
+//!
+//! As with real flash, programming can only clear bits; a word that was not
+//! erased first ends up as the AND of the old and new values.
+//!
+//! \return Returns 0 on success, or -1 if the range is not word aligned or
+//! is not all simulated flash.
+//
+//*****************************************************************************
+long
+SimFlashProgram(const unsigned long *pulData, unsigned long ulAddr,
+                unsigned long ulCount)
+{
+    unsigned long ulIdx;
+
+    if((ulAddr < SIM_FLASH_START) || (ulAddr > SIM_FLASH_END) ||
+       (ulCount > (SIM_FLASH_END - ulAddr)) || ((ulAddr | ulCount) & 3))
+    {
+        return(-1);
+    }
+    for(ulIdx = 0; ulIdx < (ulCount / 4); ulIdx++)
+    {
+        g_pulSimFlash[((ulAddr - SIM_FLASH_START) / 4) + ulIdx] &=
+            pulData[ulIdx];
+    }
+    return(0);
+}
+
+//*****************************************************************************
+//
+//! Places a byte in the UART receive FIFO, raising the receive interrupt.
+//
+//*****************************************************************************
+void
+SimUARTRxPut(unsigned char ucData)
+{
+    if(g_ulSimUARTRxCount < SIM_UART_RX_SIZE)
+    {
+        g_pucSimUARTRx[(g_ulSimUARTRxRead + g_ulSimUARTRxCount) %
+                       SIM_UART_RX_SIZE] = ucData;
+        g_ulSimUARTRxCount++;
+    }
+    if(g_ulSimUARTIntMask & 0x50)
+    {
+        SimIntPend(INT_UART0);
+    }
+}
+
+//*****************************************************************************
+//
+//! Takes a byte from the UART receive FIFO, or returns -1 if it is empty.
+//
+//*****************************************************************************
+int
+SimUARTRxGet(void)
+{
+    int iData;
+
+    if(g_ulSimUARTRxCount == 0)
+    {
+        return(-1);
+    }
+    iData = g_pucSimUARTRx[g_ulSimUARTRxRead];
+    g_ulSimUARTRxRead = (g_ulSimUARTRxRead + 1) % SIM_UART_RX_SIZE;
+    g_ulSimUARTRxCount--;
+    return(iData);
+}
+
+//*****************************************************************************
+//
+//! Returns the number of bytes in the UART receive FIFO.
+//
+//*****************************************************************************
+unsigned long
+SimUARTRxCount(void)
+{
+    return(g_ulSimUARTRxCount);
+}
+
+//*****************************************************************************
+//
+//! Returns the state of a PWM output over one period.
+//!
+//! \param psGen is the generator.
+//! \param ulOut is 0 for the A output, 1 for the B output.
+//! \param ulOffset is the time since the start of the period, in clocks.
+//!
+//! The generators count up/down, so each output is high for a window of its
+//! pulse width centered on the load (mid-period) event.  With the dead-band
+//! generator enabled, the A output has its rising edge delayed and the B
+//! output is the complement of A with its rising edge delayed.
+//!
+//! \return Non-zero if the output is high.
+//
+//*****************************************************************************
+static unsigned long
+SimPWMLevel(tSimPWMGen *psGen, unsigned long ulOut, unsigned long ulOffset)
+{
+    long lOn, lOff, lOffset;
+
+    lOffset = (long)ulOffset;
+    if(psGen->ulDeadBand)
+    {
+        lOn = ((long)psGen->ulPeriod - (long)psGen->pulWidth[0] + 1) / 2;
+        lOff = ((long)psGen->ulPeriod + (long)psGen->pulWidth[0] + 1) / 2;
+        if(ulOut == 0)
+        {
+            return((lOffset >= (lOn + (long)psGen->ulRise)) &&
+                   (lOffset < lOff));
+        }
+        return((lOffset < lOn) ||
+               (lOffset >= (lOff + (long)psGen->ulFall)));
+    }
+    lOn = ((long)psGen->ulPeriod - (long)psGen->pulWidth[ulOut] + 1) / 2;
+    lOff = ((long)psGen->ulPeriod + (long)psGen->pulWidth[ulOut] + 1) / 2;
+    return((lOffset >= lOn) && (lOffset < lOff));
+}
+
+//*****************************************************************************
+//
+//! Returns the state of the six PWM outputs at a given time.
+//!
+//! \param ullTime is the time, which must lie within the current period.
+//!
+//! \return The PWM_OUT_n_BIT mask of outputs that are enabled and high.
+//
+//*****************************************************************************
+unsigned long
+SimPWMOutputs(tSimTime ullTime)
+{
+    unsigned long ulOffset, ulGen, ulOutputs;
+
+    ulOffset = (unsigned long)(ullTime - g_ullSimPWMStart);
+    ulOutputs = 0;
+    for(ulGen = 0; ulGen < 3; ulGen++)
+    {
+        if(SimPWMLevel(&g_psSimPWMGen[ulGen], 0, ulOffset))
+        {
+            ulOutputs |= (1 << (ulGen * 2));
+        }
+        if(SimPWMLevel(&g_psSimPWMGen[ulGen], 1, ulOffset))
+        {
+            ulOutputs |= (2 << (ulGen * 2));
+        }
+    }
+    return(ulOutputs & *SimRegCell(PWM_BASE + PWM_O_ENABLE));
+}
+
+//*****************************************************************************
+//
+//! Returns the time of the next PWM output edge after a given time.
+//!
+//! \param ullTime is the time, which must lie within the current period.
+//!
+//! \return The time of the next edge, or the end of the period if there are
+//! no further edges in this period.
+//
+//*****************************************************************************
+tSimTime
+SimPWMNextEdge(tSimTime ullTime)
+{
+    unsigned long ulOffset, ulGen, ulIdx, ulNext;
+    long plEdge[4], lWidth;
+    tSimPWMGen *psGen;
+
+    ulOffset = (unsigned long)(ullTime - g_ullSimPWMStart);
+    ulNext = g_psSimPWMGen[0].ulPeriod;
+    for(ulGen = 0; ulGen < 3; ulGen++)
+    {
+        psGen = &g_psSimPWMGen[ulGen];
+        lWidth = (long)psGen->pulWidth[0];
+        plEdge[0] = ((long)psGen->ulPeriod - lWidth + 1) / 2;
+        plEdge[1] = ((long)psGen->ulPeriod + lWidth + 1) / 2;
+        if(psGen->ulDeadBand)
+        {
+            plEdge[2] = plEdge[0] + (long)psGen->ulRise;
+            plEdge[3] = plEdge[1] + (long)psGen->ulFall;
+        }
+        else
+        {
+            lWidth = (long)psGen->pulWidth[1];
+            plEdge[2] = ((long)psGen->ulPeriod - lWidth + 1) / 2;
+            plEdge[3] = ((long)psGen->ulPeriod + lWidth + 1) / 2;
+        }
+        for(ulIdx = 0; ulIdx < 4; ulIdx++)
+        {
+            if((plEdge[ulIdx] > (long)ulOffset) &&
+               (plEdge[ulIdx] < (long)ulNext))
+            {
+                ulNext = plEdge[ulIdx];
+            }
+        }
+    }
+    return(g_ullSimPWMStart + ulNext);
+}
+
+//*****************************************************************************
+//
+//! Handles the zero event of the PWM time base, at the start of a period.
+//
+//*****************************************************************************
+static void
+SimPWMZero(void)
+{
+    unsigned long ulGen, ulOutputs;
+    tSimPWMGen *psGen;
+
+    //
+    // Latch the new periods and pulse widths.
+    //
+    for(ulGen = 0; ulGen < 3; ulGen++)
+    {
+        psGen = &g_psSimPWMGen[ulGen];
+        psGen->ulPeriod = psGen->ulPeriodNext ? psGen->ulPeriodNext : 2;
+        psGen->pulWidth[0] = psGen->pulWidthNext[0];
+        psGen->pulWidth[1] = psGen->pulWidthNext[1];
+    }
+    g_ullSimPWMStart = g_ullSimTime;
+    g_ulSimPWMLoadDone = 0;
+
+    //
+    // Count periods in which both switches of a leg will be on together.
+    //
+    ulOutputs = 0;
+    for(ulGen = 0; ulGen < 3; ulGen++)
+    {
+        psGen = &g_psSimPWMGen[ulGen];
+        if(!psGen->ulDeadBand &&
+           ((*SimRegCell(PWM_BASE + PWM_O_ENABLE) >> (ulGen * 2)) & 3) == 3 &&
+           psGen->pulWidth[0] && psGen->pulWidth[1])
+        {
+            ulOutputs++;
+        }
+    }
+    if(ulOutputs)
+    {
+        g_ulSimShootThrough++;
+    }
+
+    //
+    // Trigger the ADC sequences that are triggered by generator 0 at zero.
+    //
+    if(g_psSimPWMGen[0].ulIntTrig & PWM_TR_CNT_ZERO)
+    {
+        for(ulGen = 0; ulGen < 4; ulGen++)
+        {
+            if(g_psSimADCSeq[ulGen].ulTrigger == ADC_TRIGGER_PWM0)
+            {
+                SimADCTrigger(ulGen);
+            }
+        }
+    }
+
+    //
+    // Raise the generator 0 zero interrupt.
+    //
+    if((g_psSimPWMGen[0].ulIntTrig & PWM_INT_CNT_ZERO) &&
+       (g_ulSimPWMIntEnable & PWM_INT_GEN_0))
+    {
+        SimIntPend(INT_PWM0);
+    }
+}
+
+//*****************************************************************************
+//
+//! Handles the load event of the PWM time base, at the middle of a period.
+//
+//*****************************************************************************
+static void
+SimPWMLoad(void)
+{
+    unsigned long ulSeq;
+
+    g_ulSimPWMLoadDone = 1;
+
+    //
+    // Trigger the ADC sequences that are triggered by generator 0.
+    //
+    if(g_psSimPWMGen[0].ulIntTrig & PWM_TR_CNT_LOAD)
+    {
+        for(ulSeq = 0; ulSeq < 4; ulSeq++)
+        {
+            if(g_psSimADCSeq[ulSeq].ulTrigger == ADC_TRIGGER_PWM0)
+            {
+                SimADCTrigger(ulSeq);
+            }
+        }
+    }
+}
+
+//*****************************************************************************
+//
+//! Updates the Hall sensor inputs from the plant model.
+//
+//*****************************************************************************
+static void
+SimHallUpdate(void)
+{
+    SimGPIOInput(1, 0x70, SimMotorHall() << 4);
+}
+
+//*****************************************************************************
+//
+//! Runs the simulation up to a given time.
+//!
+//! \param ullUntil is the time at which to stop.
+//!
+//! The plant model is integrated from event to event; at each event the
+//! corresponding interrupts are raised and the pending interrupts are
+//! dispatched.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+SimRun(tSimTime ullUntil)
+{
+    tSimTime ullNext, ullZero, ullLoad;
+    unsigned long ulIdx;
+
+    while(g_ullSimTime < ullUntil)
+    {
+        SimDispatch();
+
+        //
+        // Find the next hardware event.
+        //
+        ullNext = ullUntil;
+        ullZero = g_ullSimPWMStart + g_psSimPWMGen[0].ulPeriod;
+        ullLoad = g_ullSimPWMStart + (g_psSimPWMGen[0].ulPeriod / 2);
+        if(ullZero < ullNext)
+        {
+            ullNext = ullZero;
+        }
+        if(!g_ulSimPWMLoadDone && (ullLoad < ullNext))
+        {
+            ullNext = ullLoad;
+        }
+        for(ulIdx = 0; ulIdx < 4; ulIdx++)
+        {
+            if(g_psSimADCSeq[ulIdx].ullDone &&
+               (g_psSimADCSeq[ulIdx].ullDone < ullNext))
+            {
+                ullNext = g_psSimADCSeq[ulIdx].ullDone;
+            }
+        }
+        for(ulIdx = 0; ulIdx < 2; ulIdx++)
+        {
+            if(g_psSimTimer[ulIdx].ulRunning &&
+               (g_psSimTimer[ulIdx].ullExpire < ullNext))
+            {
+                ullNext = g_psSimTimer[ulIdx].ullExpire;
+            }
+        }
+        if(g_ullSimSysTickExpire && (g_ullSimSysTickExpire < ullNext))
+        {
+            ullNext = g_ullSimSysTickExpire;
+        }
+        if(g_sSimQEI.ulEnabled && g_sSimQEI.ulVelEnabled &&
+           (g_sSimQEI.ullVelExpire < ullNext))
+        {
+            ullNext = g_sSimQEI.ullVelExpire;
+        }
+
+        //
+        // Run the plant up to the event, or to a Hall edge if one comes
+        // first.
+        //
+        if(ullNext > g_ullSimTime)
+        {
+            g_ullSimTime = SimMotorRun(g_ullSimTime, ullNext);
+        }
+        SimHallUpdate();
+        SimQEIUpdate();
+
+        //
+        // Process the events that are due.
+        //
+        if(!g_ulSimPWMLoadDone && (g_ullSimTime >= ullLoad))
+        {
+            SimPWMLoad();
+        }
+        if(g_ullSimTime >= ullZero)
+        {
+            SimPWMZero();
+        }
+        for(ulIdx = 0; ulIdx < 4; ulIdx++)
+        {
+            if(g_psSimADCSeq[ulIdx].ullDone &&
+               (g_ullSimTime >= g_psSimADCSeq[ulIdx].ullDone))
+            {
+                SimADCDone(ulIdx);
+            }
+        }
+        if(g_psSimTimer[0].ulRunning &&
+           (g_ullSimTime >= g_psSimTimer[0].ullExpire))
+        {
+            SimTimerExpire(TIMER0_BASE);
+        }
+        if(g_psSimTimer[1].ulRunning &&
+           (g_ullSimTime >= g_psSimTimer[1].ullExpire))
+        {
+            SimTimerExpire(TIMER1_BASE);
+        }
+        if(g_sSimQEI.ulEnabled && g_sSimQEI.ulVelEnabled &&
+           (g_ullSimTime >= g_sSimQEI.ullVelExpire))
+        {
+            SimQEIVelocityExpire();
+        }
+        if(g_ullSimSysTickExpire && (g_ullSimTime >= g_ullSimSysTickExpire))
+        {
+            g_ullSimSysTickExpire += g_ulSimSysTickPeriod;
+            if(g_iSimSysTickInt)
+            {
+                SimIntPend(FAULT_SYSTICK);
+            }
+        }
+
+        SimDispatch();
+    }
+}
+
+//*****************************************************************************
+//
+//! Advances time for a busy-wait in the application.
+//!
+//! \param ullCycles is the number of system clocks to wait.
+//!
+//! Outside of an interrupt handler the simulation runs (and interrupts are
+//! taken) for the duration of the delay.  Inside a handler time cannot
+//! advance, so the delay takes no time.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+SimDelay(tSimTime ullCycles)
+{
+    if(!g_iSimInISR)
+    {
+        SimRun(g_ullSimTime + ullCycles);
+    }
+}
+
+//*****************************************************************************
+//
+//! Resets the simulated hardware to its power-on state.
+//
+//*****************************************************************************
+void
+SimHwReset(void)
+{
+    unsigned long ulIdx;
+
+    g_ullSimTime = 0;
+    for(ulIdx = 0; ulIdx < SIM_NUM_REGS; ulIdx++)
+    {
+        g_psSimRegs[ulIdx].ulUsed = 0;
+    }
+    for(ulIdx = 0; ulIdx < SIM_NUM_BITS; ulIdx++)
+    {
+        g_psSimBits[ulIdx].ulSize = 0;
+    }
+    g_ulSimTouchedCount = 0;
+    for(ulIdx = 0; ulIdx < 3; ulIdx++)
+    {
+        g_psSimPWMGen[ulIdx].ulPeriod = SIM_PWM_RESET_PERIOD;
+        g_psSimPWMGen[ulIdx].ulPeriodNext = SIM_PWM_RESET_PERIOD;
+        g_psSimPWMGen[ulIdx].pulWidth[0] = 0;
+        g_psSimPWMGen[ulIdx].pulWidth[1] = 0;
+        g_psSimPWMGen[ulIdx].pulWidthNext[0] = 0;
+        g_psSimPWMGen[ulIdx].pulWidthNext[1] = 0;
+        g_psSimPWMGen[ulIdx].ulDeadBand = 0;
+        g_psSimPWMGen[ulIdx].ulIntTrig = 0;
+    }
+    g_ullSimPWMStart = 0;
+    g_ulSimPWMLoadDone = 0;
+    g_ulSimPWMIntEnable = 0;
+    g_ulSimShootThrough = 0;
+    g_sSimQEI.ulEnabled = 0;
+    g_sSimQEI.ulVelEnabled = 0;
+    g_sSimQEI.ulPosition = 0;
+    g_sSimQEI.lDirection = 1;
+    g_sSimQEI.ulIntStatus = 0;
+    g_sSimQEI.ulIntMask = 0;
+    for(ulIdx = 0; ulIdx < SIM_NUM_PORTS; ulIdx++)
+    {
+        g_pulSimGPIOData[ulIdx] = 0;
+        g_pulSimGPIODir[ulIdx] = 0;
+        g_pulSimGPIOIntMask[ulIdx] = 0;
+        g_pulSimGPIOIntStatus[ulIdx] = 0;
+        g_pulSimGPIOIn[ulIdx] = 0;
+    }
+    for(ulIdx = 0; ulIdx < 2; ulIdx++)
+    {
+        g_psSimTimer[ulIdx].ulRunning = 0;
+        g_psSimTimer[ulIdx].ulLoadTouched = 0;
+    }
+    for(ulIdx = 0; ulIdx < 4; ulIdx++)
+    {
+        g_psSimADCSeq[ulIdx].ulTrigger = ADC_TRIGGER_PROCESSOR;
+        g_psSimADCSeq[ulIdx].ulFifoRead = 0;
+        g_psSimADCSeq[ulIdx].ulFifoCount = 0;
+        g_psSimADCSeq[ulIdx].ullDone = 0;
+    }
+    g_ulSimADCRis = 0;
+    for(ulIdx = 0; ulIdx < SIM_NUM_INTS; ulIdx++)
+    {
+        g_pucSimIntPending[ulIdx] = 0;
+        g_pucSimIntEnabled[ulIdx] = 0;
+        g_pucSimIntPriority[ulIdx] = 0;
+    }
+    g_iSimIntMaster = 1;
+    g_iSimInISR = 0;
+    g_ulSimSysTickPeriod = 0;
+    g_iSimSysTickInt = 0;
+    g_ullSimSysTickExpire = 0;
+    g_ulSimUARTRxRead = 0;
+    g_ulSimUARTRxCount = 0;
+    g_ulSimUARTIntMask = 0;
+    for(ulIdx = SIM_FLASH_START; ulIdx < SIM_FLASH_END; ulIdx += 1024)
+    {
+        SimFlashErase(ulIdx);
+    }
+}
+
+// Close the Doxygen group.
+//! @}
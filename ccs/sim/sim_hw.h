@@ -0,0 +1,124 @@
+//*****************************************************************************
+//
+// sim_hw.h - Host replacement for inc/hw_types.h used by the simulation build.
+//
+// This file is force-included (gcc -include) ahead of every source file in
+// the host simulation build.  It claims the inc/hw_types.h include guard so
+// that the target definitions of the register access macros are never seen,
+// and routes every HWREG() and bit-band access through the simulated
+// register file in sim_hw.c instead of dereferencing a peripheral address.
+//
+//*****************************************************************************
+
+#ifndef __SIM_HW_H__
+#define __SIM_HW_H__
+
+//*****************************************************************************
+//
+// The firmware assumes that long is 32 bits wide, as it is on the target; a
+// 64-bit host long changes the result of any arithmetic that relies on
+// unsigned wrap-around.  The C library headers are pulled in first, with
+// the host's definition of long, and long is then made 32 bits for
+// everything that follows (the firmware, the driver library prototypes and
+// the simulator itself, so that they all agree on the calling convention).
+// A 64-bit quantity must therefore be declared with a type from stdint.h.
+//
+//*****************************************************************************
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#define long                    int
+
+//*****************************************************************************
+//
+// The simulated time, in system clocks.
+//
+//*****************************************************************************
+typedef uint64_t tSimTime;
+
+//*****************************************************************************
+//
+// Claim the inc/hw_types.h include guard.
+//
+//*****************************************************************************
+#define __HW_TYPES_H__
+
+//*****************************************************************************
+//
+// Define a boolean type, and values for true and false.
+//
+//*****************************************************************************
+typedef unsigned char tBoolean;
+
+#ifndef true
+#define true 1
+#endif
+
+#ifndef false
+#define false 0
+#endif
+
+//*****************************************************************************
+//
+// Register file accessors, provided by sim_hw.c.  Each returns a pointer to
+// the simulated register (or to a shadow cell for a bit-band access) which
+// stays valid until the next call into the simulated hardware.
+//
+//*****************************************************************************
+extern volatile unsigned long *SimRegW(unsigned long ulAddr);
+extern volatile unsigned short *SimRegH(unsigned long ulAddr);
+extern volatile unsigned char *SimRegB(unsigned long ulAddr);
+extern volatile unsigned long *SimBitW(volatile void *pvAddr,
+                                       unsigned long ulBit);
+extern volatile unsigned short *SimBitH(volatile void *pvAddr,
+                                        unsigned long ulBit);
+extern volatile unsigned char *SimBitB(volatile void *pvAddr,
+                                       unsigned long ulBit);
+
+//*****************************************************************************
+//
+// Macros for hardware access, both direct and via the bit-band region.  The
+// bit-band forms take the address of the variable (or register) and the bit
+// number, exactly as the target macros do; the 0x22000000/0x42000000 alias
+// arithmetic is done by the simulator instead.
+//
+//*****************************************************************************
+#define HWREG(x)                (*SimRegW((unsigned long)(x)))
+#define HWREGH(x)               (*SimRegH((unsigned long)(x)))
+#define HWREGB(x)               (*SimRegB((unsigned long)(x)))
+#define HWREGBITW(x, b)         (*SimBitW((volatile void *)(x), (b)))
+#define HWREGBITH(x, b)         (*SimBitH((volatile void *)(x), (b)))
+#define HWREGBITB(x, b)         (*SimBitB((volatile void *)(x), (b)))
+
+//*****************************************************************************
+//
+// The simulated part is a current (Tempest class, revision C) device, so the
+// silicon workarounds keyed off these macros are never taken.
+//
+//*****************************************************************************
+#define CLASS_IS_SANDSTORM      0
+#define CLASS_IS_FURY           0
+#define CLASS_IS_DUSTDEVIL      0
+#define CLASS_IS_TEMPEST        1
+#define REVISION_IS_A0          0
+#define REVISION_IS_A1          0
+#define REVISION_IS_A2          0
+#define REVISION_IS_B0          0
+#define REVISION_IS_B1          0
+#define REVISION_IS_C0          0
+#define REVISION_IS_C1          0
+#define REVISION_IS_C2          0
+#define REVISION_IS_C3          1
+
+#ifndef DEPRECATED
+#define DEVICE_IS_SANDSTORM     CLASS_IS_SANDSTORM
+#define DEVICE_IS_FURY          CLASS_IS_FURY
+#define DEVICE_IS_REVA2         REVISION_IS_A2
+#define DEVICE_IS_REVC1         REVISION_IS_C1
+#define DEVICE_IS_REVC2         REVISION_IS_C2
+#endif
+
+#endif // __SIM_HW_H__
@@ -0,0 +1,1063 @@
+//*****************************************************************************
+//
+// sim_main.c - Scenario runner for the host simulation of the motor drive.
+//
+//*****************************************************************************
+
+#include "inc/hw_ints.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "driverlib/gpio.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/systick.h"
+#include "driverlib/timer.h"
+#include "utils/flash_pb.h"
+#include "adc_ctrl.h"
+#include "brake.h"
+#include "capture.h"
+#include "faults.h"
+#include "hall_ctrl.h"
+#include "irrigation.h"
+#include "isr_prof.h"
+#include "main.h"
+#include "pins.h"
+#include "pwm_ctrl.h"
+#include "qei_ctrl.h"
+#include "ui.h"
+#include "ui_common.h"
+#include "hp_cal.h"
+#include "sim/sim.h"
+#include "sim/sim_motor.h"
+
+//*****************************************************************************
+//
+//! \page sim_main_intro Introduction
+//!
+//! The host simulation runs the unmodified motor control code (the state
+//! machine in main.c, the ADC, PWM, Hall, trapezoid modulation and brake
+//! modules, and the user interface tick handlers) against the simulated
+//! peripherals in sim_hw.c and the motor plant in sim_motor.c.  Every
+//! interrupt handler runs to completion at the instant its interrupt is
+//! taken, so the simulation is cycle-timed at the peripherals and
+//! zero-time in the firmware.
+//!
+//! A scenario is described on the command line:
+//!
+//! <pre>
+//! bldc_sim [-t seconds] [-r rpm] [-R seconds:rpm] [-l load] [-L seconds:load]
+//!          [-H | -F] [-E] [-k degrees] [-s] [-w watts] [-P degrees]
+//!          [-M seconds:degrees] [-a rpm/s] [-d rpm/s] [-j rpm/s/ms] [-i ms]
+//!          [-e percent] [-c file | -p file] [-q]
+//! bldc_sim -C
+//! </pre>
+//!
+//! - <tt>-t</tt> sets the simulated duration (default 2 s).
+//! - <tt>-r</tt> sets the target speed at start up (default 6000 RPM).
+//! - <tt>-R</tt> changes the target speed at a later time; zero stops the
+//!   motor.  Up to eight events may be given.
+//! - <tt>-l</tt> sets the load torque at start up, in N m.
+//! - <tt>-L</tt> changes the load torque at a later time.
+//! - <tt>-H</tt> runs with Hall sensors instead of sensorless.
+//! - <tt>-F</tt> runs field-oriented control with Hall sensors instead of
+//!   sensorless.
+//! - <tt>-E</tt> measures the rotor speed with the quadrature encoder, and
+//!   commutates with the Hall sensors unless <tt>-F</tt> is also given.
+//! - <tt>-k</tt> moves the Hall B sensor from its ideal position by the given
+//!   number of electrical degrees.
+//! - <tt>-s</tt> gives the motor a sinusoidal rather than trapezoidal Back
+//!   EMF.
+//! - <tt>-w</tt> runs in power control mode with the given target power; the
+//!   speed given by <tt>-r</tt> and <tt>-R</tt> is then the speed limit.
+//! - <tt>-P</tt> runs in position control mode with the given target
+//!   position, in degrees; the speed given by <tt>-r</tt> and <tt>-R</tt> is
+//!   then the speed limit of the move.
+//! - <tt>-M</tt> changes the target position at a later time.  Negative
+//!   positions are measured backward from zero, and positions of a
+//!   revolution or more are wrapped by the drive.
+//! - <tt>-a</tt> and <tt>-d</tt> set the acceleration and deceleration rates
+//!   (default 50000 RPM/s).
+//! - <tt>-j</tt> sets the jerk rate of the S-curve speed trajectory, as the
+//!   change in the acceleration rate each millisecond (default 2500 RPM/s);
+//!   zero ramps the speed at a constant rate.
+//! - <tt>-i</tt> sets the interval between log lines (default 10 ms; zero
+//!   disables logging).
+//! - <tt>-e</tt> sets the final speed error, in percent, that is treated as
+//!   a failure (default 5).  In position control mode it is the position
+//!   error of the plant's rotor instead, in degrees, which must hold for the
+//!   last half second (see SimPositionError()).
+//! - <tt>-c</tt> records the ADC, Hall and handpiece input streams from the
+//!   start of the drive into a file.
+//! - <tt>-p</tt> replays the input streams from a file recorded with
+//!   <tt>-c</tt>, in place of the plant's.  The same scenario must be given
+//!   so that the user interface commands match; the plant keeps running but
+//!   only drives the inputs once the recording runs out.
+//! - <tt>-q</tt> suppresses the summary.
+//! - <tt>-C</tt> checks the handpiece calibration store against the simulated
+//!   flash instead of running the motor (see SimCalCheck()).
+//!
+//! The log is written to standard output as comma separated values.  The
+//! exit status is zero if the drive ended up at the final target speed (or
+//! position) without a fault, one if a fault was latched, and two if the
+//! speed or position was out of tolerance, so that batches of scenarios can be scripted.
+//!
+//! The code for the scenario runner is contained in <tt>sim/sim_main.c</tt>.
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! \defgroup sim_main_api Definitions
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! The maximum number of speed or load events in a scenario.
+//
+//*****************************************************************************
+#define SIM_MAX_EVENTS          8
+
+//*****************************************************************************
+//
+//! A scheduled change to the scenario.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The time of the event, in system clocks.
+    //
+    tSimTime ullTime;
+
+    //
+    //! The new value.
+    //
+    double dValue;
+}
+tSimEvent;
+
+//*****************************************************************************
+//
+//! The scenario.
+//
+//*****************************************************************************
+static tSimEvent g_psSpeedEvents[SIM_MAX_EVENTS];
+static unsigned long g_ulNumSpeedEvents;
+static tSimEvent g_psLoadEvents[SIM_MAX_EVENTS];
+static tSimEvent g_psPositionEvents[SIM_MAX_EVENTS];
+static unsigned long g_ulNumPositionEvents;
+static unsigned long g_ulNumLoadEvents;
+static unsigned long g_ulFinalSpeed;
+
+//*****************************************************************************
+//
+//! The time at the end of a position control scenario over which the rotor
+//! must hold the target position, in seconds.
+//
+//*****************************************************************************
+#define SIM_HOLD_TIME           0.5
+
+//*****************************************************************************
+//
+//! The position of the plant in counts of the drive's position sensor, less
+//! the drive's count, when the scenario starts.
+//
+//*****************************************************************************
+static double g_dSimPositionOffset;
+
+//*****************************************************************************
+//
+//! Parses a <tt>seconds:value</tt> event argument.
+//
+//*****************************************************************************
+static int
+SimParseEvent(const char *pcArg, tSimEvent *psEvents, unsigned long *pulCount)
+{
+    double dTime, dValue;
+
+    if((*pulCount == SIM_MAX_EVENTS) ||
+       (sscanf(pcArg, "%lf:%lf", &dTime, &dValue) != 2) || (dTime < 0))
+    {
+        return(0);
+    }
+    psEvents[*pulCount].ullTime = (tSimTime)(dTime * SYSTEM_CLOCK);
+    psEvents[*pulCount].dValue = dValue;
+    (*pulCount)++;
+    return(1);
+}
+
+//*****************************************************************************
+//
+//! Commands a new target position.  A negative angle is measured backward
+//! from zero, and an angle of a revolution or more is passed on for the drive
+//! to wrap into one revolution.
+//
+//*****************************************************************************
+static void
+SimSetPosition(double dPosition)
+{
+    while(dPosition < 0)
+    {
+        dPosition += 360;
+    }
+    g_usTargetPosition = (unsigned short)((dPosition * 10) + 0.5);
+    MainSetPosition();
+}
+
+//*****************************************************************************
+//
+//! Returns the number of counts of the drive's position sensor per
+//! revolution, which are encoder counts if the encoder is present and Hall
+//! edges otherwise.
+//
+//*****************************************************************************
+static unsigned long
+SimPositionCounts(void)
+{
+    if(HWREGBITH(&(g_sParameters.usFlags), FLAG_ENCODER_BIT) ==
+       FLAG_ENCODER_PRESENT)
+    {
+        return(g_sSimMotorParams.ulEncoderLines * 4);
+    }
+    return(g_sSimMotorParams.ulPolePairs * 6);
+}
+
+//*****************************************************************************
+//
+//! Returns the position of the plant's rotor in counts of the drive's
+//! position sensor, as a real number.  The encoder counts from its index
+//! pulse, and the Hall sensors count the sixty electrical degree sectors from
+//! the rising edge of Hall A; Hall B is taken to be in its ideal position.
+//
+//*****************************************************************************
+static double
+SimPositionPlant(void)
+{
+    tSimMotorState sState;
+
+    SimMotorGetState(&sState);
+    if(HWREGBITH(&(g_sParameters.usFlags), FLAG_ENCODER_BIT) ==
+       FLAG_ENCODER_PRESENT)
+    {
+        return((sState.dRevs - (g_sSimMotorParams.dIndexOffset / 360.0)) *
+               g_sSimMotorParams.ulEncoderLines * 4);
+    }
+    return(((sState.dRevs * 360.0 * g_sSimMotorParams.ulPolePairs) -
+            g_sSimMotorParams.dHallOffset) / 60.0);
+}
+
+//*****************************************************************************
+//
+//! Ties the drive's count of the rotor position to the plant's, which the
+//! drive counts from wherever the rotor is when it starts.
+//
+//*****************************************************************************
+static void
+SimPositionStart(void)
+{
+    if(HWREGBITH(&(g_sParameters.usFlags), FLAG_ENCODER_BIT) ==
+       FLAG_ENCODER_PRESENT)
+    {
+        g_dSimPositionOffset = (floor(SimPositionPlant()) -
+                                (double)g_lEncoderPosition);
+    }
+    else
+    {
+        g_dSimPositionOffset = (floor(SimPositionPlant()) -
+                                (double)g_lHallPosition);
+    }
+}
+
+//*****************************************************************************
+//
+//! Returns the error of the plant's rotor from the target position, in
+//! mechanical degrees.  The error is measured from the span of rotor angles
+//! that the drive's position sensor reports as the target position, since
+//! the drive can not place the rotor more finely than that; it is positive
+//! if the rotor is past the target, and negative if it is short of it.  This
+//! uses the plant's rotor angle rather than the drive's own estimate of it.
+//
+//*****************************************************************************
+static double
+SimPositionError(void)
+{
+    unsigned long ulCounts;
+    double dCounts;
+
+    //
+    // Find the plant's position relative to the target count, in the drive's
+    // count.  Once the encoder has seen its index, the drive counts from the
+    // index as the plant does.
+    //
+    ulCounts = SimPositionCounts();
+    dCounts = SimPositionPlant();
+    if(!((HWREGBITH(&(g_sParameters.usFlags), FLAG_ENCODER_BIT) ==
+          FLAG_ENCODER_PRESENT) && g_ucEncoderIndexed))
+    {
+        dCounts -= g_dSimPositionOffset;
+    }
+    dCounts -= (double)(((g_usTargetPosition * ulCounts) + 1800) / 3600);
+
+    //
+    // Wrap it into one revolution and measure it from the target count.
+    //
+    dCounts = fmod(dCounts, (double)ulCounts);
+    if(dCounts < 0)
+    {
+        dCounts += ulCounts;
+    }
+    if(dCounts < 1)
+    {
+        return(0);
+    }
+    if(dCounts < ((ulCounts + 1) / 2.0))
+    {
+        return(((dCounts - 1) * 360.0) / ulCounts);
+    }
+    return(((dCounts - ulCounts) * 360.0) / ulCounts);
+}
+
+//*****************************************************************************
+//
+//! Commands a new target speed, the way the handpiece user interface does.
+//
+//*****************************************************************************
+static void
+SimSetSpeed(unsigned long ulSpeed)
+{
+    if(ulSpeed == 0)
+    {
+        MainStop();
+        return;
+    }
+
+    if(!MainIsRunning())
+    {
+        MainClearFaults();
+    }
+
+    g_sParameters.ulTargetSpeed = ulSpeed;
+
+    MainRun();
+}
+
+//*****************************************************************************
+//
+//! Initializes the drive, following the sequence in main() and UIInit() but
+//! without the handpiece and Ethernet start up.
+//
+//*****************************************************************************
+static void
+SimDriveInit(void)
+{
+    ISRProfileInit();
+
+    IntPrioritySet(INT_TIMER1A,     0x00);
+    IntPrioritySet(INT_TIMER0A,     0x20);
+    IntPrioritySet(INT_WATCHDOG,    0x40);
+    IntPrioritySet(INT_ADC0SS0,     0x60);
+    IntPrioritySet(INT_PWM0,        0x80);
+    IntPrioritySet(INT_PWM1,        0xa0);
+    IntPrioritySet(INT_QEI0,        0xb0);
+    IntPrioritySet(INT_PWM2,        0xc0);
+    IntPrioritySet(FAULT_SYSTICK,   0xd0);
+    IntPrioritySet(INT_ETH,         0xe0);
+
+    BrakeInit();
+    FlashPBInit(FLASH_PB_START, FLASH_PB_END, FLASH_PB_SIZE);
+    PWMInit();
+    ADCInit();
+    EncoderInit();
+
+    //
+    // The user interface pins.  The enable, override and fault inputs are
+    // left low (no system fault, cutter enabled).
+    //
+    GPIOPinTypeGPIOOutput(GPIO_PORTB_BASE, GPIO_PIN_1);
+    GPIOPinTypeGPIOInput(GPIO_PORTB_BASE, GPIO_PIN_0 | GPIO_PIN_2 |
+                         GPIO_PIN_3);
+    GPIOPinTypeGPIOOutput(PIN_LEDRUN_PORT, PIN_LEDRUN_PIN);
+    GPIOPinTypeGPIOOutput(PIN_LEDFAULT_PORT, PIN_LEDFAULT_PIN);
+    HallInit();
+    IrrInit();
+
+    SysTickPeriodSet(SYSTEM_CLOCK / 200);
+    SysTickIntEnable();
+    SysTickEnable();
+
+    TimerConfigure(TIMER1_BASE, TIMER_CFG_32_BIT_PER);
+    TimerLoadSet(TIMER1_BASE, TIMER_A, SYSTEM_CLOCK / 100);
+    TimerIntEnable(TIMER1_BASE, TIMER_TIMA_TIMEOUT);
+    IntEnable(INT_TIMER1A);
+    TimerEnable(TIMER1_BASE, TIMER_A);
+
+    UIParamLoad();
+
+    MainClearFaults();
+    UIRunLEDBlink(200, 25);
+
+    TimerConfigure(TIMER0_BASE, TIMER_CFG_32_BIT_OS);
+    TimerIntEnable(TIMER0_BASE, TIMER_TIMA_TIMEOUT);
+    IntEnable(INT_TIMER0A);
+}
+
+//*****************************************************************************
+//
+//! Writes one line of the log.
+//
+//*****************************************************************************
+static void
+SimLog(void)
+{
+    tSimMotorState sState;
+
+    SimMotorGetState(&sState);
+    printf("%.4f,%u,%u,%u,%.0f,%u,%.2f,%d,%.3f,%u,%u,%u,%u\n",
+           (double)g_ullSimTime / SYSTEM_CLOCK, g_ulState,
+           g_sParameters.ulTargetSpeed, g_ulMeasuredSpeed, sState.dSpeed,
+           g_ulBusVoltage, sState.dVBus, g_sMotorCurrent,
+           sState.dTorque, g_ulTrapDutyCycle, g_ulFaultFlags,
+           g_ulSimShootThrough, g_ulMotorPower);
+}
+
+//*****************************************************************************
+//
+//! Loads a recorded input stream into the capture buffer for replay.
+//
+//*****************************************************************************
+static int
+SimCaptureLoad(const char *pcFile)
+{
+    unsigned char pucData[256];
+    unsigned long ulOffset;
+    size_t ulCount;
+    FILE *pFile;
+
+    pFile = fopen(pcFile, "rb");
+    if(!pFile)
+    {
+        perror(pcFile);
+        return(0);
+    }
+    ulOffset = 0;
+    while((ulCount = fread(pucData, 1, sizeof(pucData), pFile)) != 0)
+    {
+        if(CaptureWrite(ulOffset, pucData, ulCount) != ulCount)
+        {
+            fprintf(stderr, "%s: too large to replay\n", pcFile);
+            fclose(pFile);
+            return(0);
+        }
+        ulOffset += ulCount;
+    }
+    fclose(pFile);
+    return(1);
+}
+
+//*****************************************************************************
+//
+//! Saves the recorded input stream from the capture buffer.
+//
+//*****************************************************************************
+static int
+SimCaptureSave(const char *pcFile)
+{
+    unsigned char pucData[256];
+    unsigned long ulOffset, ulCount;
+    FILE *pFile;
+
+    pFile = fopen(pcFile, "wb");
+    if(!pFile)
+    {
+        perror(pcFile);
+        return(0);
+    }
+    ulOffset = 0;
+    while((ulCount = CaptureRead(ulOffset, pucData, sizeof(pucData))) != 0)
+    {
+        fwrite(pucData, 1, ulCount, pFile);
+        ulOffset += ulCount;
+    }
+    fclose(pFile);
+    return(1);
+}
+
+//*****************************************************************************
+//
+//! The number of handpieces, and the number of saves, used by SimCalCheck().
+//! There are more handpieces than the store holds, and enough saves to go
+//! around the ring of tables in flash several times.
+//
+//*****************************************************************************
+#define SIM_CAL_HANDPIECES      12
+#define SIM_CAL_SAVES           100
+
+//*****************************************************************************
+//
+//! Makes up the calibration of a handpiece for SimCalCheck().
+//!
+//! \param ulSave is the number of the save, which determines the handpiece,
+//! its calibration and its polarity.
+//! \param psCal is the calibration to fill in.
+//!
+//! \return Returns the serial number of the handpiece.
+//
+//*****************************************************************************
+static unsigned long
+SimCalMake(unsigned long ulSave, tThrottleCal *psCal)
+{
+    unsigned long ulHall;
+
+    for(ulHall = 0; ulHall < UI_NUM_HALLS; ulHall++)
+    {
+        psCal->pusHallRest[ulHall] = 200 + ulSave + ulHall;
+        psCal->pusHallPeak[ulHall] = 20 + (ulSave % 7) + ulHall;
+    }
+    return(0x48500000 + (ulSave % SIM_CAL_HANDPIECES));
+}
+
+//*****************************************************************************
+//
+//! Checks the handpiece calibration store.
+//!
+//! This saves the calibrations of #SIM_CAL_HANDPIECES handpieces in turn,
+//! #SIM_CAL_SAVES times, starting from erased flash.  After each save the
+//! store is started again from the simulated flash, as it is at power up.
+//! The handpieces saved most recently must then load back with the
+//! calibration and polarity that they were last saved with, the one saved
+//! before them must have been dropped, and a handpiece without a serial
+//! number must not have been stored.
+//!
+//! \return Returns zero if the store behaved, or one if it did not.
+//
+//*****************************************************************************
+static int
+SimCalCheck(void)
+{
+    tThrottleCal sCal, sLoad;
+    unsigned long ulSave, ulBack, ulSerial, ulHall, ulErrors;
+    unsigned char ucPolarity;
+    tBoolean bFound;
+
+    ulErrors = 0;
+    HPCalInit();
+    for(ulSave = 0; ulSave < SIM_CAL_SAVES; ulSave++)
+    {
+        //
+        // Save this handpiece, and one with no serial number, and start
+        // the store again from flash.
+        //
+        ulSerial = SimCalMake(ulSave, &sCal);
+        HPCalSave(ulSerial, &sCal, ulSave & 1);
+        HPCalSave(HPCAL_SERIAL_NONE, &sCal, 0);
+        HPCalInit();
+
+        //
+        // Check each of the handpieces saved since the store was last full,
+        // and the one that was dropped from it.
+        //
+        for(ulBack = 0; (ulBack <= (SIM_CAL_HANDPIECES - 2)) &&
+            (ulBack <= ulSave); ulBack++)
+        {
+            ulSerial = SimCalMake(ulSave - ulBack, &sCal);
+            bFound = HPCalLoad(ulSerial, &sLoad, &ucPolarity);
+            if(ulBack == (SIM_CAL_HANDPIECES - 2))
+            {
+                if(bFound)
+                {
+                    fprintf(stderr, "save %u: handpiece %08x was not "
+                            "dropped\n", ulSave, ulSerial);
+                    ulErrors++;
+                }
+                continue;
+            }
+            for(ulHall = 0; bFound && (ulHall < UI_NUM_HALLS); ulHall++)
+            {
+                if((sLoad.pusHallRest[ulHall] != sCal.pusHallRest[ulHall]) ||
+                   (sLoad.pusHallPeak[ulHall] != sCal.pusHallPeak[ulHall]))
+                {
+                    bFound = false;
+                }
+            }
+            if(!bFound || (ucPolarity != ((ulSave - ulBack) & 1)))
+            {
+                fprintf(stderr, "save %u: handpiece %08x did not load "
+                        "back\n", ulSave, ulSerial);
+                ulErrors++;
+            }
+        }
+        if(HPCalLoad(HPCAL_SERIAL_NONE, &sLoad, &ucPolarity))
+        {
+            fprintf(stderr, "save %u: a handpiece without a serial number "
+                    "was stored\n", ulSave);
+            ulErrors++;
+        }
+    }
+
+    fprintf(stderr, "handpiece calibration store: %d saves, %u errors\n",
+            SIM_CAL_SAVES, ulErrors);
+    return(ulErrors ? 1 : 0);
+}
+
+//*****************************************************************************
+//
+//! Prints the command line usage.
+//
+//*****************************************************************************
+static void
+SimUsage(const char *pcName)
+{
+    fprintf(stderr,
+            "Usage: %s [-t seconds] [-r rpm] [-R seconds:rpm] [-l load]\n"
+            "       [-L seconds:load] [-H | -F] [-E] [-k degrees] [-s]\n"
+            "       [-w watts] [-P degrees] [-M seconds:degrees] [-a rpm/s]\n"
+            "       [-d rpm/s] [-j rpm/s/ms] [-i ms] [-e percent]\n"
+            "       [-c file | -p file] [-q]\n"
+            "       %s -C\n",
+            pcName, pcName);
+}
+
+//*****************************************************************************
+//
+//! Runs a scenario.
+//
+//*****************************************************************************
+int
+main(int argc, char *argv[])
+{
+    tSimTime ullEnd, ullNext, ullLog, ullInterval, ullHold;
+    unsigned long ulSpeed, ulSpeedIdx, ulLoadIdx, ulPositionIdx, ulHall;
+    unsigned long ulEncoder, ulQuiet, ulAccel, ulDecel, ulPosition;
+    unsigned long ulCalCheck;
+    const char *pcRecord, *pcReplay;
+    double dDuration, dInterval, dTolerance, dError, dPower, dPowerError;
+    double dPosition, dPositionError;
+    tSimMotorState sState;
+    clock_t sStart;
+    long lJerk;
+    int iArg, iStatus;
+
+    dDuration = 2.0;
+    dInterval = 10.0;
+    dTolerance = 5.0;
+    ulSpeed = 6000;
+    ulHall = 0;
+    ulEncoder = 0;
+    ulQuiet = 0;
+    ulCalCheck = 0;
+    dPower = 0;
+    dPosition = 0;
+    ulPosition = 0;
+    ulAccel = 0;
+    ulDecel = 0;
+    lJerk = -1;
+    pcRecord = 0;
+    pcReplay = 0;
+    g_ulNumSpeedEvents = 0;
+    g_ulNumLoadEvents = 0;
+    g_ulNumPositionEvents = 0;
+
+    for(iArg = 1; iArg < argc; iArg++)
+    {
+        if(!strcmp(argv[iArg], "-H"))
+        {
+            ulHall = 1;
+        }
+        else if(!strcmp(argv[iArg], "-F"))
+        {
+            ulHall = 2;
+        }
+        else if(!strcmp(argv[iArg], "-E"))
+        {
+            ulEncoder = 1;
+        }
+        else if(!strcmp(argv[iArg], "-k"))
+        {
+            g_sSimMotorParams.dHallSkew = atof(argv[++iArg]);
+        }
+        else if(!strcmp(argv[iArg], "-s"))
+        {
+            g_sSimMotorParams.ulSinusoidal = 1;
+        }
+        else if(!strcmp(argv[iArg], "-q"))
+        {
+            ulQuiet = 1;
+        }
+        else if(!strcmp(argv[iArg], "-C"))
+        {
+            ulCalCheck = 1;
+        }
+        else if((iArg + 1) == argc)
+        {
+            SimUsage(argv[0]);
+            return(3);
+        }
+        else if(!strcmp(argv[iArg], "-t"))
+        {
+            dDuration = atof(argv[++iArg]);
+        }
+        else if(!strcmp(argv[iArg], "-r"))
+        {
+            ulSpeed = strtoul(argv[++iArg], 0, 0);
+        }
+        else if(!strcmp(argv[iArg], "-l"))
+        {
+            g_sSimMotorParams.dLoad = atof(argv[++iArg]);
+        }
+        else if(!strcmp(argv[iArg], "-w"))
+        {
+            dPower = atof(argv[++iArg]);
+        }
+        else if(!strcmp(argv[iArg], "-P"))
+        {
+            dPosition = atof(argv[++iArg]);
+            ulPosition = 1;
+            if((dPosition <= -6553) || (dPosition >= 6553))
+            {
+                SimUsage(argv[0]);
+                return(3);
+            }
+        }
+        else if(!strcmp(argv[iArg], "-M"))
+        {
+            if(!SimParseEvent(argv[++iArg], g_psPositionEvents,
+                              &g_ulNumPositionEvents) ||
+               (g_psPositionEvents[g_ulNumPositionEvents - 1].dValue <=
+                -6553) ||
+               (g_psPositionEvents[g_ulNumPositionEvents - 1].dValue >= 6553))
+            {
+                SimUsage(argv[0]);
+                return(3);
+            }
+        }
+        else if(!strcmp(argv[iArg], "-a"))
+        {
+            ulAccel = strtoul(argv[++iArg], 0, 0);
+        }
+        else if(!strcmp(argv[iArg], "-d"))
+        {
+            ulDecel = strtoul(argv[++iArg], 0, 0);
+        }
+        else if(!strcmp(argv[iArg], "-j"))
+        {
+            lJerk = strtol(argv[++iArg], 0, 0);
+        }
+        else if(!strcmp(argv[iArg], "-i"))
+        {
+            dInterval = atof(argv[++iArg]);
+        }
+        else if(!strcmp(argv[iArg], "-e"))
+        {
+            dTolerance = atof(argv[++iArg]);
+        }
+        else if(!strcmp(argv[iArg], "-c") && !pcReplay)
+        {
+            pcRecord = argv[++iArg];
+        }
+        else if(!strcmp(argv[iArg], "-p") && !pcRecord)
+        {
+            pcReplay = argv[++iArg];
+        }
+        else if(!strcmp(argv[iArg], "-R"))
+        {
+            if(!SimParseEvent(argv[++iArg], g_psSpeedEvents,
+                              &g_ulNumSpeedEvents))
+            {
+                SimUsage(argv[0]);
+                return(3);
+            }
+        }
+        else if(!strcmp(argv[iArg], "-L"))
+        {
+            if(!SimParseEvent(argv[++iArg], g_psLoadEvents,
+                              &g_ulNumLoadEvents))
+            {
+                SimUsage(argv[0]);
+                return(3);
+            }
+        }
+        else
+        {
+            SimUsage(argv[0]);
+            return(3);
+        }
+    }
+
+    //
+    // Bring up the hardware, the plant and the drive.
+    //
+    SimHwReset();
+    if(ulCalCheck)
+    {
+        return(SimCalCheck());
+    }
+    SimMotorInit();
+    SimDriveInit();
+    if(ulEncoder && !ulHall)
+    {
+        ulHall = 1;
+    }
+    if(ulHall)
+    {
+        g_sParameters.ucModulationType =
+            (ulHall == 2) ? MOD_TYPE_FOC : MOD_TYPE_TRAPEZOID;
+        HWREGBITH(&(g_sParameters.usFlags), FLAG_SENSOR_TYPE_BIT) =
+            FLAG_SENSOR_TYPE_GPIO;
+        ADCConfigure();
+        HallConfigure();
+    }
+    if(ulEncoder)
+    {
+        HWREGBITH(&(g_sParameters.usFlags), FLAG_ENCODER_BIT) =
+            FLAG_ENCODER_PRESENT;
+        g_sParameters.usEncoderLines = g_sSimMotorParams.ulEncoderLines;
+        EncoderConfigure();
+    }
+    if(dPower > 0)
+    {
+        g_sParameters.ucControlType = CONTROL_TYPE_POWER;
+        g_sParameters.ulTargetPower = (unsigned long)(dPower * 1000);
+        if(g_sParameters.ulMaxPower < g_sParameters.ulTargetPower)
+        {
+            g_sParameters.ulMaxPower = g_sParameters.ulTargetPower;
+        }
+        MainSetPower();
+    }
+    if(ulAccel)
+    {
+        g_sParameters.usAccel = ulAccel;
+    }
+    if(ulDecel)
+    {
+        g_sParameters.usDecel = ulDecel;
+    }
+    if(lJerk >= 0)
+    {
+        g_sParameters.usJerk = lJerk;
+    }
+    if(ulPosition)
+    {
+        g_sParameters.ucControlType = CONTROL_TYPE_POSITION;
+        SimSetPosition(dPosition);
+    }
+
+    //
+    // Record or replay the input streams from here on, so that the ADC
+    // offset calibration is captured as well.
+    //
+    if(pcRecord)
+    {
+        CaptureStart(CAPTURE_MODE_RECORD);
+    }
+    else if(pcReplay)
+    {
+        if(!SimCaptureLoad(pcReplay))
+        {
+            return(3);
+        }
+        CaptureStart(CAPTURE_MODE_REPLAY);
+    }
+
+    //
+    // Let the ADC offsets settle before starting the motor, as the
+    // handpiece start up does.
+    //
+    SimRun(g_ullSimTime + (SYSTEM_CLOCK / 2));
+
+    if(dInterval > 0)
+    {
+        printf("time,state,target,measured,actual,vbus_mv,vbus,current_ma,"
+               "torque,duty,faults,shoot_through,power_mw\n");
+    }
+
+    sStart = clock();
+    ullEnd = g_ullSimTime + (tSimTime)(dDuration * SYSTEM_CLOCK);
+    ullHold = ((dDuration > SIM_HOLD_TIME) ?
+               (ullEnd - (tSimTime)(SIM_HOLD_TIME * SYSTEM_CLOCK)) :
+               g_ullSimTime);
+    dPositionError = 0;
+    ullInterval = (tSimTime)(dInterval * SYSTEM_CLOCK / 1000);
+    ullLog = g_ullSimTime;
+    ulSpeedIdx = 0;
+    ulLoadIdx = 0;
+    ulPositionIdx = 0;
+    g_ulFinalSpeed = ulSpeed;
+    SimPositionStart();
+    SimSetSpeed(ulSpeed);
+
+    //
+    // Event times are relative to the start of the scenario.
+    //
+    for(iArg = 0; iArg < (int)g_ulNumSpeedEvents; iArg++)
+    {
+        g_psSpeedEvents[iArg].ullTime += g_ullSimTime;
+    }
+    for(iArg = 0; iArg < (int)g_ulNumLoadEvents; iArg++)
+    {
+        g_psLoadEvents[iArg].ullTime += g_ullSimTime;
+    }
+    for(iArg = 0; iArg < (int)g_ulNumPositionEvents; iArg++)
+    {
+        g_psPositionEvents[iArg].ullTime += g_ullSimTime;
+    }
+
+    //
+    // Run the scenario, one millisecond (the foreground loop period) at a
+    // time.
+    //
+    while(g_ullSimTime < ullEnd)
+    {
+        ullNext = g_ullSimTime + (SYSTEM_CLOCK / 1000);
+        SimRun((ullNext < ullEnd) ? ullNext : ullEnd);
+
+        while((ulSpeedIdx < g_ulNumSpeedEvents) &&
+              (g_ullSimTime >= g_psSpeedEvents[ulSpeedIdx].ullTime))
+        {
+            g_ulFinalSpeed =
+                (unsigned long)g_psSpeedEvents[ulSpeedIdx++].dValue;
+            SimSetSpeed(g_ulFinalSpeed);
+        }
+        while((ulLoadIdx < g_ulNumLoadEvents) &&
+              (g_ullSimTime >= g_psLoadEvents[ulLoadIdx].ullTime))
+        {
+            SimMotorSetLoad(g_psLoadEvents[ulLoadIdx++].dValue);
+        }
+        while((ulPositionIdx < g_ulNumPositionEvents) &&
+              (g_ullSimTime >= g_psPositionEvents[ulPositionIdx].ullTime))
+        {
+            SimSetPosition(g_psPositionEvents[ulPositionIdx++].dValue);
+        }
+
+        //
+        // Track the worst position error while the rotor should be holding
+        // the target position.
+        //
+        if(ulPosition && (g_ullSimTime >= ullHold))
+        {
+            dError = SimPositionError();
+            if(((dError < 0) ? -dError : dError) >
+               ((dPositionError < 0) ? -dPositionError : dPositionError))
+            {
+                dPositionError = dError;
+            }
+        }
+
+        if(ullInterval && (g_ullSimTime >= ullLog))
+        {
+            SimLog();
+            ullLog += ullInterval;
+        }
+    }
+
+    //
+    // Save the recording.  The capture stops by itself on a fault, so the
+    // stream ends at the fault.
+    //
+    if(pcRecord)
+    {
+        CaptureStop();
+        if(!SimCaptureSave(pcRecord))
+        {
+            return(3);
+        }
+    }
+
+    //
+    // Judge the outcome.
+    //
+    SimMotorGetState(&sState);
+    iStatus = 0;
+    dError = 0;
+    dPowerError = 0;
+    if(g_ulFaultFlags & FAULT_MASK)
+    {
+        iStatus = 1;
+    }
+    else if(g_ulFinalSpeed == 0)
+    {
+        //
+        // A stop is judged by the drive having left the run state; the rotor
+        // may still be coasting down when the scenario ends.
+        //
+        if(MainIsRunning())
+        {
+            iStatus = 2;
+        }
+    }
+    else if(ulPosition)
+    {
+        //
+        // In position control mode the motor ends up stopped at the target
+        // position, with the motor drive still running to hold it there,
+        // and the plant's rotor stays there for the last #SIM_HOLD_TIME
+        // seconds.
+        //
+        if(!MainIsRunning() || (dPositionError > dTolerance) ||
+           (dPositionError < -dTolerance))
+        {
+            iStatus = 2;
+        }
+    }
+    else
+    {
+        dError = sState.dSpeed - (double)g_ulFinalSpeed;
+        dError = (dError * 100.0) / (double)g_ulFinalSpeed;
+        if(dPower > 0)
+        {
+            //
+            // In power control mode the motor runs at the speed limit or
+            // below it at the target power, and never above the target
+            // power.
+            //
+            dPowerError = ((((double)g_ulMotorPower / 1000.0) - dPower) *
+                           100.0) / dPower;
+            if((dPowerError > dTolerance) || (dError > dTolerance) ||
+               ((dError < -dTolerance) && (dPowerError < -dTolerance)))
+            {
+                iStatus = 2;
+            }
+        }
+        else if((dError > dTolerance) || (dError < -dTolerance))
+        {
+            iStatus = 2;
+        }
+    }
+
+    if(!ulQuiet)
+    {
+        fprintf(stderr,
+                "%.3f s simulated in %.3f s; target %u rpm, actual %.0f rpm "
+                "(%+.1f%%), faults 0x%08x, shoot-through %u\n",
+                dDuration, (double)(clock() - sStart) / CLOCKS_PER_SEC,
+                g_ulFinalSpeed, sState.dSpeed, dError, g_ulFaultFlags,
+                g_ulSimShootThrough);
+        if(dPower > 0)
+        {
+            fprintf(stderr, "target power %.1f W, motor power %.1f W "
+                    "(%+.1f%%)\n", dPower, (double)g_ulMotorPower / 1000.0,
+                    dPowerError);
+        }
+        if(ulPosition)
+        {
+            fprintf(stderr, "target position %.1f deg, motor position %.1f "
+                    "deg, plant error %+.1f deg\n",
+                    (double)g_usTargetPosition / 10,
+                    (double)g_usMotorPosition / 10, dPositionError);
+        }
+        if(ulEncoder)
+        {
+            fprintf(stderr, "encoder position %d counts (plant %d), %s, "
+                    "speed %d rpm, phase errors %u\n", g_lEncoderPosition,
+                    SimMotorEncoder(),
+                    g_ucEncoderIndexed ? "indexed" : "not indexed",
+                    g_lEncoderSpeed, g_ulEncoderErrors);
+        }
+    }
+
+    return(iStatus);
+}
+
+// Close the Doxygen group.
+//! @}
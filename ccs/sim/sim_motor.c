@@ -0,0 +1,744 @@
+//*****************************************************************************
+//
+// sim_motor.c - BLDC motor, inverter and DC bus plant model for the host
+//               simulation build.
+//
+//*****************************************************************************
+
+#include "inc/hw_types.h"
+#include "driverlib/adc.h"
+#include "main.h"
+#include "sim/sim.h"
+#include "sim/sim_motor.h"
+
+//*****************************************************************************
+//
+//! \page sim_motor_intro Introduction
+//!
+//! The plant is a wye-connected, three phase BLDC motor with a trapezoidal
+//! Back EMF, driven by a three phase bridge from a DC bus with a bulk
+//! capacitor, a current limited supply and a dynamic brake resistor.
+//!
+//! Each phase of the bridge is classified at every integration step from the
+//! PWM outputs and the direction of its current: a high or low side switch
+//! ties the phase to the bus or to ground; with neither switch on, a phase
+//! that is carrying current is clamped by the free-wheeling diode of the
+//! side that can conduct it, and a phase that is not carrying current floats
+//! at the neutral voltage plus its Back EMF (unless that would forward bias a
+//! diode).  The phase currents are integrated with a forward Euler step that
+//! never crosses a PWM edge.
+//!
+//! The ADC samples the same quantities that the drive board's signal
+//! conditioning presents to the microcontroller: the bus voltage and phase
+//! terminal voltages through the 60 V full scale divider, and the low side
+//! shunt current of each phase offset to mid-scale.
+//!
+//! The code for the plant model is contained in <tt>sim/sim_motor.c</tt>.
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! \defgroup sim_motor_api Definitions
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! The longest integration step, in system clocks.
+//
+//*****************************************************************************
+#define SIM_MOTOR_STEP          50
+
+//*****************************************************************************
+//
+//! The ADC count per volt at the bus and phase voltage dividers.
+//
+//*****************************************************************************
+#define SIM_MOTOR_VOLT_COUNT    (32000.0 / 1875.0)
+
+//*****************************************************************************
+//
+//! The ADC count per ampere of low side shunt current, and the count at zero
+//! current.
+//
+//*****************************************************************************
+#define SIM_MOTOR_AMP_COUNT     (1024.0 * 0.06 / 3.0)
+#define SIM_MOTOR_AMP_ZERO      (1024.0 * 1.2 / 3.0)
+
+//*****************************************************************************
+//
+//! The ADC count of the internal temperature sensor at 25 C.
+//
+//*****************************************************************************
+#define SIM_MOTOR_TEMP_COUNT    511
+
+//*****************************************************************************
+//
+//! The speed, in rad/s, below which a rotor with insufficient torque to
+//! overcome the load is considered to be stalled.
+//
+//*****************************************************************************
+#define SIM_MOTOR_STICTION      0.5
+
+//*****************************************************************************
+//
+//! The connection of a phase of the bridge.
+//
+//*****************************************************************************
+#define SIM_PHASE_OPEN          0
+#define SIM_PHASE_HIGH          1
+#define SIM_PHASE_LOW           2
+#define SIM_PHASE_DIODE_HIGH    3
+#define SIM_PHASE_DIODE_LOW     4
+
+//*****************************************************************************
+//
+//! The default plant parameters, which approximate a 48 V, 4 pole handpiece
+//! motor with a 12000 RPM top speed.
+//
+//*****************************************************************************
+tSimMotorParams g_sSimMotorParams =
+{
+    0.6,                        // dR
+    0.0002,                     // dL
+    3.0,                        // dKe
+    5.0e-6,                     // dJ
+    1.0e-5,                     // dB
+    0.0,                        // dLoad
+    2,                          // ulPolePairs
+    48.0,                       // dVSupply
+    0.1,                        // dRSupply
+    0.001,                      // dCBus
+    10.0,                       // dRBrake
+    210.0,                      // dHallOffset
+    0.0,                        // dHallSkew
+    0,                          // ulSinusoidal
+    1000,                       // ulEncoderLines
+    120.0                       // dIndexOffset
+};
+
+//*****************************************************************************
+//
+//! The state of the plant.
+//
+//*****************************************************************************
+static double g_pdSimCurrent[3];
+static double g_pdSimVoltage[3];
+static unsigned long g_pulSimConnect[3];
+static double g_dSimVBus;
+static double g_dSimOmega;
+static double g_dSimTheta;
+static double g_dSimRevs;
+static double g_dSimTorque;
+static double g_dSimBrakeEnergy;
+
+//*****************************************************************************
+//
+//! Returns the normalized trapezoidal Back EMF shape at an electrical angle.
+//!
+//! \param dAngle is the electrical angle, in degrees (any value).
+//!
+//! The shape rises linearly from zero at 0 degrees to one at 30 degrees, is
+//! flat to 150 degrees, and is odd symmetric about 180 degrees.  For a
+//! sinusoidal motor it is the sine of the angle instead.
+//!
+//! \return The shape, from -1 to 1.
+//
+//*****************************************************************************
+static double
+SimMotorShape(double dAngle)
+{
+    if(g_sSimMotorParams.ulSinusoidal)
+    {
+        return(sin(dAngle * M_PI / 180.0));
+    }
+    dAngle = fmod(dAngle, 360.0);
+    if(dAngle < 0)
+    {
+        dAngle += 360.0;
+    }
+    if(dAngle < 30.0)
+    {
+        return(dAngle / 30.0);
+    }
+    if(dAngle <= 150.0)
+    {
+        return(1.0);
+    }
+    if(dAngle < 210.0)
+    {
+        return((180.0 - dAngle) / 30.0);
+    }
+    if(dAngle <= 330.0)
+    {
+        return(-1.0);
+    }
+    return((dAngle - 360.0) / 30.0);
+}
+
+//*****************************************************************************
+//
+//! Returns the torque (and Back EMF) constant of a single phase, in N m/A
+//! (and V s/rad of mechanical speed).
+//
+//*****************************************************************************
+static double
+SimMotorKPhase(void)
+{
+    return((g_sSimMotorParams.dKe / 2.0) / (1000.0 * 2.0 * M_PI / 60.0));
+}
+
+//*****************************************************************************
+//
+//! Computes the neutral point voltage for the connected phases.
+//
+//*****************************************************************************
+static double
+SimMotorNeutral(const double *pdEMF)
+{
+    double dSum;
+    unsigned long ulIdx, ulCount, ulLast;
+
+    dSum = 0;
+    ulCount = 0;
+    ulLast = 0;
+    for(ulIdx = 0; ulIdx < 3; ulIdx++)
+    {
+        if(g_pulSimConnect[ulIdx] != SIM_PHASE_OPEN)
+        {
+            dSum += g_pdSimVoltage[ulIdx] - pdEMF[ulIdx];
+            ulCount++;
+            ulLast = ulIdx;
+        }
+    }
+
+    //
+    // With no phase connected the motor floats at mid-bus.
+    //
+    if(ulCount == 0)
+    {
+        return((g_dSimVBus / 2.0) - ((pdEMF[0] + pdEMF[1] + pdEMF[2]) / 3.0));
+    }
+
+    //
+    // A single connected phase carries no current, so the neutral follows
+    // it directly.
+    //
+    if(ulCount == 1)
+    {
+        return(g_pdSimVoltage[ulLast] - pdEMF[ulLast]);
+    }
+
+    return(dSum / ulCount);
+}
+
+//*****************************************************************************
+//
+//! Advances the plant by one integration step with fixed bridge outputs.
+//!
+//! \param ulOutputs is the PWM_OUT_n_BIT mask of bridge switches that are on.
+//! \param dT is the length of the step, in seconds.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+SimMotorStep(unsigned long ulOutputs, double dT)
+{
+    double pdEMF[3], pdShape[3], dKPhase, dNeutral, dSum, dIDC, dISupply;
+    double dIBrake, dAccel, dTerminal;
+    unsigned long ulIdx, ulCount, ulChanged, ulBrake;
+
+    dKPhase = SimMotorKPhase();
+
+    //
+    // Compute the phase Back EMF at the present angle.
+    //
+    for(ulIdx = 0; ulIdx < 3; ulIdx++)
+    {
+        pdShape[ulIdx] = SimMotorShape(g_dSimTheta - (120.0 * ulIdx));
+        pdEMF[ulIdx] = dKPhase * g_dSimOmega * pdShape[ulIdx];
+    }
+
+    //
+    // Classify each phase of the bridge.
+    //
+    for(ulIdx = 0; ulIdx < 3; ulIdx++)
+    {
+        if((ulOutputs & (1 << (ulIdx * 2))) &&
+           (ulOutputs & (2 << (ulIdx * 2))))
+        {
+            //
+            // Shoot-through.  The event is counted by the PWM model; treat
+            // the phase as tied to mid-bus.
+            //
+            g_pulSimConnect[ulIdx] = SIM_PHASE_HIGH;
+            g_pdSimVoltage[ulIdx] = g_dSimVBus / 2.0;
+        }
+        else if(ulOutputs & (1 << (ulIdx * 2)))
+        {
+            g_pulSimConnect[ulIdx] = SIM_PHASE_HIGH;
+            g_pdSimVoltage[ulIdx] = g_dSimVBus;
+        }
+        else if(ulOutputs & (2 << (ulIdx * 2)))
+        {
+            g_pulSimConnect[ulIdx] = SIM_PHASE_LOW;
+            g_pdSimVoltage[ulIdx] = 0;
+        }
+        else if(g_pdSimCurrent[ulIdx] > 0)
+        {
+            g_pulSimConnect[ulIdx] = SIM_PHASE_DIODE_LOW;
+            g_pdSimVoltage[ulIdx] = 0;
+        }
+        else if(g_pdSimCurrent[ulIdx] < 0)
+        {
+            g_pulSimConnect[ulIdx] = SIM_PHASE_DIODE_HIGH;
+            g_pdSimVoltage[ulIdx] = g_dSimVBus;
+        }
+        else
+        {
+            g_pulSimConnect[ulIdx] = SIM_PHASE_OPEN;
+        }
+    }
+
+    //
+    // Find the neutral voltage.  A floating phase whose terminal would be
+    // driven outside of the bus is clamped by a diode, which changes the
+    // neutral voltage, so repeat until nothing changes.
+    //
+    do
+    {
+        dNeutral = SimMotorNeutral(pdEMF);
+        ulChanged = 0;
+        for(ulIdx = 0; ulIdx < 3; ulIdx++)
+        {
+            if(g_pulSimConnect[ulIdx] != SIM_PHASE_OPEN)
+            {
+                continue;
+            }
+            dTerminal = dNeutral + pdEMF[ulIdx];
+            if(dTerminal > g_dSimVBus)
+            {
+                g_pulSimConnect[ulIdx] = SIM_PHASE_DIODE_HIGH;
+                g_pdSimVoltage[ulIdx] = g_dSimVBus;
+                ulChanged = 1;
+            }
+            else if(dTerminal < 0)
+            {
+                g_pulSimConnect[ulIdx] = SIM_PHASE_DIODE_LOW;
+                g_pdSimVoltage[ulIdx] = 0;
+                ulChanged = 1;
+            }
+        }
+    }
+    while(ulChanged);
+
+    //
+    // Float the open phases.
+    //
+    for(ulIdx = 0; ulIdx < 3; ulIdx++)
+    {
+        if(g_pulSimConnect[ulIdx] == SIM_PHASE_OPEN)
+        {
+            g_pdSimVoltage[ulIdx] = dNeutral + pdEMF[ulIdx];
+        }
+    }
+
+    //
+    // Integrate the currents of the connected phases.
+    //
+    ulCount = 0;
+    for(ulIdx = 0; ulIdx < 3; ulIdx++)
+    {
+        if(g_pulSimConnect[ulIdx] != SIM_PHASE_OPEN)
+        {
+            ulCount++;
+        }
+    }
+    for(ulIdx = 0; ulIdx < 3; ulIdx++)
+    {
+        if((ulCount < 2) || (g_pulSimConnect[ulIdx] == SIM_PHASE_OPEN))
+        {
+            g_pdSimCurrent[ulIdx] = 0;
+            continue;
+        }
+        g_pdSimCurrent[ulIdx] += ((g_pdSimVoltage[ulIdx] - dNeutral -
+                                   pdEMF[ulIdx] -
+                                   (g_sSimMotorParams.dR *
+                                    g_pdSimCurrent[ulIdx])) * dT /
+                                  g_sSimMotorParams.dL);
+
+        //
+        // A diode cannot conduct in reverse; the current stops at zero.
+        //
+        if(((g_pulSimConnect[ulIdx] == SIM_PHASE_DIODE_LOW) &&
+            (g_pdSimCurrent[ulIdx] < 0)) ||
+           ((g_pulSimConnect[ulIdx] == SIM_PHASE_DIODE_HIGH) &&
+            (g_pdSimCurrent[ulIdx] > 0)))
+        {
+            g_pdSimCurrent[ulIdx] = 0;
+        }
+    }
+
+    //
+    // Keep the currents summing to zero at the neutral after any diode
+    // clamping, by spreading the error over the phases still conducting.
+    //
+    dSum = g_pdSimCurrent[0] + g_pdSimCurrent[1] + g_pdSimCurrent[2];
+    ulCount = 0;
+    for(ulIdx = 0; ulIdx < 3; ulIdx++)
+    {
+        if(g_pdSimCurrent[ulIdx] != 0)
+        {
+            ulCount++;
+        }
+    }
+    for(ulIdx = 0; ulIdx < 3; ulIdx++)
+    {
+        if(ulCount < 2)
+        {
+            g_pdSimCurrent[ulIdx] = 0;
+        }
+        else if(g_pdSimCurrent[ulIdx] != 0)
+        {
+            g_pdSimCurrent[ulIdx] -= dSum / ulCount;
+        }
+    }
+
+    //
+    // Integrate the rotor.
+    //
+    g_dSimTorque = 0;
+    for(ulIdx = 0; ulIdx < 3; ulIdx++)
+    {
+        g_dSimTorque += dKPhase * pdShape[ulIdx] * g_pdSimCurrent[ulIdx];
+    }
+    dAccel = g_dSimTorque - (g_sSimMotorParams.dB * g_dSimOmega);
+    if(g_dSimOmega > 0)
+    {
+        dAccel -= g_sSimMotorParams.dLoad;
+    }
+    else if(g_dSimOmega < 0)
+    {
+        dAccel += g_sSimMotorParams.dLoad;
+    }
+    else if(fabs(g_dSimTorque) <= g_sSimMotorParams.dLoad)
+    {
+        dAccel = 0;
+    }
+    else
+    {
+        dAccel -= ((g_dSimTorque > 0) ? g_sSimMotorParams.dLoad :
+                   -g_sSimMotorParams.dLoad);
+    }
+    dAccel /= g_sSimMotorParams.dJ;
+    if((fabs(g_dSimOmega) < SIM_MOTOR_STICTION) &&
+       (fabs(g_dSimTorque) <= g_sSimMotorParams.dLoad))
+    {
+        g_dSimOmega = 0;
+    }
+    else
+    {
+        g_dSimOmega += dAccel * dT;
+    }
+    g_dSimTheta += (g_dSimOmega * dT * 180.0 / M_PI *
+                    g_sSimMotorParams.ulPolePairs);
+    g_dSimRevs += g_dSimOmega * dT / (2.0 * M_PI);
+    g_dSimTheta = fmod(g_dSimTheta, 360.0);
+    if(g_dSimTheta < 0)
+    {
+        g_dSimTheta += 360.0;
+    }
+
+    //
+    // Integrate the bus capacitor.  The inverter draws the current of every
+    // phase tied to the bus.  The brake output is active low.
+    //
+    dIDC = 0;
+    for(ulIdx = 0; ulIdx < 3; ulIdx++)
+    {
+        if(g_pdSimVoltage[ulIdx] == g_dSimVBus)
+        {
+            dIDC += g_pdSimCurrent[ulIdx];
+        }
+    }
+    dISupply = (g_sSimMotorParams.dVSupply - g_dSimVBus) /
+               g_sSimMotorParams.dRSupply;
+    if(dISupply < 0)
+    {
+        dISupply = 0;
+    }
+    ulBrake = ((g_pulSimGPIODir[2] & 0x40) && !(g_pulSimGPIOData[2] & 0x40));
+    dIBrake = ulBrake ? (g_dSimVBus / g_sSimMotorParams.dRBrake) : 0;
+    g_dSimBrakeEnergy += dIBrake * g_dSimVBus * dT;
+    g_dSimVBus += (dISupply - dIDC - dIBrake) * dT / g_sSimMotorParams.dCBus;
+    if(g_dSimVBus < 0)
+    {
+        g_dSimVBus = 0;
+    }
+}
+
+//*****************************************************************************
+//
+//! Resets the plant to a stopped motor on a charged bus.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+SimMotorInit(void)
+{
+    unsigned long ulIdx;
+
+    for(ulIdx = 0; ulIdx < 3; ulIdx++)
+    {
+        g_pdSimCurrent[ulIdx] = 0;
+        g_pulSimConnect[ulIdx] = SIM_PHASE_OPEN;
+    }
+    g_dSimVBus = g_sSimMotorParams.dVSupply;
+    for(ulIdx = 0; ulIdx < 3; ulIdx++)
+    {
+        g_pdSimVoltage[ulIdx] = g_dSimVBus / 2.0;
+    }
+    g_dSimOmega = 0;
+    g_dSimTheta = 0;
+    g_dSimRevs = 0;
+    g_dSimTorque = 0;
+    g_dSimBrakeEnergy = 0;
+}
+
+//*****************************************************************************
+//
+//! Runs the plant over an interval of time.
+//!
+//! \param ullFrom is the start of the interval, in system clocks.
+//! \param ullTo is the end of the interval, which must not extend past the
+//! end of the current PWM period.
+//!
+//! The interval is cut short at the first change of the Hall sensor outputs
+//! so that the edge interrupt can be taken at the right time.
+//!
+//! \return The time at which the plant stopped.
+//
+//*****************************************************************************
+tSimTime
+SimMotorRun(tSimTime ullFrom, tSimTime ullTo)
+{
+    tSimTime ullEnd, ullEdge;
+    unsigned long ulHall;
+
+    ulHall = SimMotorHall();
+    while(ullFrom < ullTo)
+    {
+        ullEnd = ullTo;
+        if((ullFrom + SIM_MOTOR_STEP) < ullEnd)
+        {
+            ullEnd = ullFrom + SIM_MOTOR_STEP;
+        }
+        ullEdge = SimPWMNextEdge(ullFrom);
+        if((ullEdge > ullFrom) && (ullEdge < ullEnd))
+        {
+            ullEnd = ullEdge;
+        }
+
+        SimMotorStep(SimPWMOutputs(ullFrom),
+                     (double)(ullEnd - ullFrom) / SYSTEM_CLOCK);
+        ullFrom = ullEnd;
+
+        if(SimMotorHall() != ulHall)
+        {
+            break;
+        }
+    }
+    return(ullFrom);
+}
+
+//*****************************************************************************
+//
+//! Returns the Hall sensor outputs.
+//!
+//! \return The Hall state, with Hall A in bit 0, Hall B in bit 1 and Hall C
+//! in bit 2.
+//
+//*****************************************************************************
+unsigned long
+SimMotorHall(void)
+{
+    unsigned long ulIdx, ulHall;
+    double dAngle;
+
+    ulHall = 0;
+    for(ulIdx = 0; ulIdx < 3; ulIdx++)
+    {
+        dAngle = fmod(g_dSimTheta - g_sSimMotorParams.dHallOffset -
+                      (120.0 * ulIdx) -
+                      ((ulIdx == 1) ? g_sSimMotorParams.dHallSkew : 0.0),
+                      360.0);
+        if(dAngle < 0)
+        {
+            dAngle += 360.0;
+        }
+        if(dAngle < 180.0)
+        {
+            ulHall |= (1 << ulIdx);
+        }
+    }
+    return(ulHall);
+}
+
+//*****************************************************************************
+//
+//! Returns the position of the quadrature encoder.
+//!
+//! \return The number of encoder counts (four per line) that the rotor has
+//! turned through since the plant was reset, measured from the index pulse.
+//! The index is crossed whenever the count passes a multiple of the counts
+//! per revolution.
+//
+//*****************************************************************************
+long
+SimMotorEncoder(void)
+{
+    double dRevs;
+
+    dRevs = g_dSimRevs - (g_sSimMotorParams.dIndexOffset / 360.0);
+    return((long)floor(dRevs * g_sSimMotorParams.ulEncoderLines * 4));
+}
+
+//*****************************************************************************
+//
+//! Converts a volt or shunt current reading into an ADC count.
+//
+//*****************************************************************************
+static unsigned long
+SimMotorCount(double dCount)
+{
+    if(dCount < 0)
+    {
+        return(0);
+    }
+    if(dCount > 1023)
+    {
+        return(1023);
+    }
+    return((unsigned long)(dCount + 0.5));
+}
+
+//*****************************************************************************
+//
+//! Samples an ADC input.
+//!
+//! \param ulConfig is the ADC_CTL_* step configuration.
+//!
+//! \return The ADC count.
+//
+//*****************************************************************************
+unsigned long
+SimMotorADC(unsigned long ulConfig)
+{
+    unsigned long ulIdx, ulOutputs;
+    double dCurrent;
+
+    if(ulConfig & ADC_CTL_TS)
+    {
+        return(SIM_MOTOR_TEMP_COUNT);
+    }
+
+    switch(ulConfig & 0xf)
+    {
+        //
+        // The bus voltage.
+        //
+        case 0:
+        {
+            return(SimMotorCount(g_dSimVBus * SIM_MOTOR_VOLT_COUNT));
+        }
+
+        //
+        // The phase terminal voltages.
+        //
+        case 1:
+        case 2:
+        case 3:
+        {
+            ulIdx = (ulConfig & 0xf) - 1;
+            return(SimMotorCount(g_pdSimVoltage[ulIdx] *
+                                 SIM_MOTOR_VOLT_COUNT));
+        }
+
+        //
+        // The low side shunt currents, which only see current while the low
+        // side switch or diode of the phase is conducting.
+        //
+        case 4:
+        case 5:
+        case 6:
+        {
+            ulIdx = (ulConfig & 0xf) - 4;
+            ulOutputs = SimPWMOutputs(g_ullSimTime);
+            dCurrent = 0;
+            if((ulOutputs & (2 << (ulIdx * 2))) ||
+               (g_pulSimConnect[ulIdx] == SIM_PHASE_DIODE_LOW))
+            {
+                dCurrent = -g_pdSimCurrent[ulIdx];
+            }
+            return(SimMotorCount(SIM_MOTOR_AMP_ZERO +
+                                 (dCurrent * SIM_MOTOR_AMP_COUNT)));
+        }
+
+        //
+        // The analog input is not connected.
+        //
+        default:
+        {
+            return(0);
+        }
+    }
+}
+
+//*****************************************************************************
+//
+//! Returns the state of the plant.
+//!
+//! \param psState is the structure to fill in.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+SimMotorGetState(tSimMotorState *psState)
+{
+    unsigned long ulIdx;
+
+    for(ulIdx = 0; ulIdx < 3; ulIdx++)
+    {
+        psState->pdCurrent[ulIdx] = g_pdSimCurrent[ulIdx];
+        psState->pdVoltage[ulIdx] = g_pdSimVoltage[ulIdx];
+    }
+    psState->dVBus = g_dSimVBus;
+    psState->dSpeed = g_dSimOmega * 60.0 / (2.0 * M_PI);
+    psState->dAngle = g_dSimTheta;
+    psState->dRevs = g_dSimRevs;
+    psState->dTorque = g_dSimTorque;
+    psState->dBrakeEnergy = g_dSimBrakeEnergy;
+}
+
+//*****************************************************************************
+//
+//! Changes the load torque.
+//!
+//! \param dLoad is the new load torque, in N m.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+SimMotorSetLoad(double dLoad)
+{
+    g_sSimMotorParams.dLoad = dLoad;
+}
+
+// Close the Doxygen group.
+//! @}
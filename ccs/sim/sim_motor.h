@@ -0,0 +1,181 @@
+//*****************************************************************************
+//
+// sim_motor.h - BLDC motor, inverter and DC bus plant model for the host
+//               simulation build.
+//
+//*****************************************************************************
+
+#ifndef __SIM_MOTOR_H__
+#define __SIM_MOTOR_H__
+
+//*****************************************************************************
+//
+//! \addtogroup sim_motor_api
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! The physical parameters of the simulated motor, inverter and DC bus.  All
+//! values are in SI units unless noted otherwise.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The phase (line to neutral) resistance, in ohms.
+    //
+    double dR;
+
+    //
+    //! The phase (line to neutral) inductance, in henries.
+    //
+    double dL;
+
+    //
+    //! The Back EMF constant, as the line-to-line flat-top voltage per 1000
+    //! RPM.  The phase Back EMF is trapezoidal with a 120 degree flat top.
+    //
+    double dKe;
+
+    //
+    //! The rotor plus load inertia, in kg m^2.
+    //
+    double dJ;
+
+    //
+    //! The viscous friction coefficient, in N m per rad/s.
+    //
+    double dB;
+
+    //
+    //! The load torque (always opposing the direction of rotation), in N m.
+    //
+    double dLoad;
+
+    //
+    //! The number of pole pairs.
+    //
+    unsigned long ulPolePairs;
+
+    //
+    //! The open circuit voltage of the DC supply, in volts.
+    //
+    double dVSupply;
+
+    //
+    //! The series resistance of the DC supply, in ohms.  The supply can only
+    //! source current; regenerated energy goes into the bus capacitor.
+    //
+    double dRSupply;
+
+    //
+    //! The DC bus capacitance, in farads.
+    //
+    double dCBus;
+
+    //
+    //! The dynamic brake resistance, in ohms.
+    //
+    double dRBrake;
+
+    //
+    //! The electrical angle, in degrees, at which the Hall A output rises when
+    //! running forward.
+    //
+    double dHallOffset;
+
+    //
+    //! The placement error, in electrical degrees, of the Hall B sensor.
+    //
+    double dHallSkew;
+
+    //
+    //! Non-zero if the phase Back EMF is sinusoidal, with the same peak as
+    //! the trapezoid, rather than trapezoidal.
+    //
+    unsigned long ulSinusoidal;
+
+    //
+    //! The number of lines of the quadrature encoder on the rotor.
+    //
+    unsigned long ulEncoderLines;
+
+    //
+    //! The mechanical angle, in degrees, of the encoder index pulse.
+    //
+    double dIndexOffset;
+}
+tSimMotorParams;
+
+//*****************************************************************************
+//
+//! The instantaneous state of the simulated plant, for logging.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The phase currents (into the motor), in amperes.
+    //
+    double pdCurrent[3];
+
+    //
+    //! The phase terminal voltages, in volts.
+    //
+    double pdVoltage[3];
+
+    //
+    //! The DC bus voltage, in volts.
+    //
+    double dVBus;
+
+    //
+    //! The mechanical speed, in RPM.
+    //
+    double dSpeed;
+
+    //
+    //! The electrical angle, in degrees (0 to 360).
+    //
+    double dAngle;
+
+    //
+    //! The mechanical position, in revolutions turned since the plant was
+    //! reset.  This is negative once the rotor has turned backward past
+    //! where it started.
+    //
+    double dRevs;
+
+    //
+    //! The electromagnetic torque, in N m.
+    //
+    double dTorque;
+
+    //
+    //! The total energy dissipated in the brake resistor, in joules.
+    //
+    double dBrakeEnergy;
+}
+tSimMotorState;
+
+//*****************************************************************************
+//
+// Prototypes for the plant model.
+//
+//*****************************************************************************
+extern tSimMotorParams g_sSimMotorParams;
+extern void SimMotorInit(void);
+extern tSimTime SimMotorRun(tSimTime ullFrom,
+                                      tSimTime ullTo);
+extern unsigned long SimMotorHall(void);
+extern long SimMotorEncoder(void);
+extern unsigned long SimMotorADC(unsigned long ulConfig);
+extern void SimMotorGetState(tSimMotorState *psState);
+extern void SimMotorSetLoad(double dLoad);
+
+// Close the Doxygen group.
+//! @}
+
+#endif // __SIM_MOTOR_H__
@@ -0,0 +1,88 @@
+//*****************************************************************************
+//
+// sim_stubs.c - Host replacements for the Ethernet user interface, the flash
+//               parameter block and the processor usage modules.
+//
+// These modules are either tied to hardware that is not simulated (the
+// Ethernet controller and the parameter block flash) or add nothing to a control loop
+// simulation, so the simulation build links these minimal versions instead.
+//
+//*****************************************************************************
+
+#include "inc/hw_types.h"
+#include "utils/cpu_usage.h"
+#include "utils/flash_pb.h"
+#include "ui.h"
+#include "ui_ethernet.h"
+
+//*****************************************************************************
+//
+// The Ethernet user interface.  There is never a connection.
+//
+//*****************************************************************************
+volatile unsigned long g_ulEthernetTimer = 0;
+volatile unsigned long g_ulEthernetTXCount = 0;
+volatile unsigned long g_ulEthernetRXCount = 0;
+volatile unsigned long g_ulConnectionTimeoutParameter = 0;
+
+void
+UIEthernetInit(tBoolean bUseDHCP)
+{
+}
+
+void
+UIEthernetTick(unsigned long ulTickMS)
+{
+    g_ulEthernetTimer += ulTickMS;
+}
+
+void
+UIEthernetSendRealTimeData(void)
+{
+}
+
+unsigned long
+UIEthernetGetIPAddress(void)
+{
+    return(0);
+}
+
+//*****************************************************************************
+//
+// The flash parameter block.  No parameter block is ever found, so the
+// drive runs with its default parameters; saves are discarded.
+//
+//*****************************************************************************
+void
+FlashPBInit(unsigned long ulStart, unsigned long ulEnd, unsigned long ulSize)
+{
+}
+
+unsigned char *
+FlashPBGet(void)
+{
+    return(0);
+}
+
+void
+FlashPBSave(unsigned char *pucBuffer)
+{
+}
+
+//*****************************************************************************
+//
+// The processor usage meter.  Time spent in the firmware is not modeled, so
+// the usage is always reported as zero.
+//
+//*****************************************************************************
+void
+CPUUsageInit(unsigned long ulClockRate, unsigned long ulRate,
+             unsigned long ulTimer)
+{
+}
+
+unsigned long
+CPUUsageTick(void)
+{
+    return(0);
+}
@@ -52,7 +52,7 @@ extern unsigned long __STACK_TOP;
 extern void IntDefaultHandler(void);
 extern void ADC0IntHandler(void);
 extern void CANIntHandler(void);
-extern void lwIPEthernetIntHandler(void);
+extern void UIEthernetIntHandler(void);
 extern void GPIOBIntHandler(void);
 //extern void GPIOCIntHandler(void);
 extern void FaultISR(void);
@@ -60,7 +60,7 @@ extern void NmiSR(void);
 extern void PWM0IntHandler(void);
 extern void MainWaveformTick(void);
 extern void MainMillisecondTick(void);
-//extern void QEIIntHandler(void);
+extern void QEIIntHandler(void);
 extern void SysTickIntHandler(void);
 extern void Timer0AIntHandler(void);
 extern void Timer1AIntHandler(void);
@@ -107,7 +107,7 @@ void (* const g_pfnVectors[])(void) =
     PWM0IntHandler,                         // PWM Generator 0
     MainWaveformTick,                       // PWM Generator 1
     MainMillisecondTick,                    // PWM Generator 2
-    IntDefaultHandler,                      // Quadrature Encoder 0
+    QEIIntHandler,                          // Quadrature Encoder 0
     ADC0IntHandler,                         // ADC Sequence 0
     IntDefaultHandler,                      // ADC Sequence 1
     IntDefaultHandler,                      // ADC Sequence 2
@@ -136,7 +136,7 @@ void (* const g_pfnVectors[])(void) =
     IntDefaultHandler,                      // CAN0
     IntDefaultHandler,                      // CAN1
     IntDefaultHandler,                      // CAN2
-    lwIPEthernetIntHandler,                 // Ethernet
+    UIEthernetIntHandler,                   // Ethernet
     IntDefaultHandler                       // Hibernate
 };
 
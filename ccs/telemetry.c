@@ -0,0 +1,414 @@
+//*****************************************************************************
+//
+// telemetry.c - Batched real-time data capture.
+//
+//*****************************************************************************
+
+#include "inc/hw_types.h"
+#include "commands.h"
+#include "telemetry.h"
+#include "ui_common.h"
+
+//*****************************************************************************
+//
+//! \page telemetry_intro Introduction
+//!
+//! The real-time data stream started by #CMD_START_DATA_STREAM sends one
+//! sample of the enabled real-time data items in each #TAG_DATA packet, at
+//! the user interface tick rate.  The batched stream started by
+//! #CMD_START_DATA_BATCH instead samples the enabled items every millisecond,
+//! and sends several consecutive samples in each #TAG_DATA_BATCH packet.
+//!
+//! When the batched stream is started, the enabled real-time data items are
+//! resolved once into a list of the values to sample, so the millisecond
+//! tick does no more than copy those values into a sample.  Each sample is
+//! kept, along with the millisecond at which it was taken, in a ring buffer
+//! in SRAM.  The Ethernet interrupt takes the samples from the ring buffer
+//! and packs them into packets, with the millisecond of the first sample of
+//! each packet; the samples in a packet are always from consecutive
+//! milliseconds.  If the ring buffer is full, the sample is dropped and
+//! counted in #g_ulTelemetryOverflow, and the next packet starts after the
+//! gap.
+//!
+//! The millisecond tick is the only writer of the ring buffer and the
+//! Ethernet interrupt is the only reader, so no locking is needed between
+//! them.
+//!
+//! The code for the batched capture is contained in <tt>telemetry.c</tt>,
+//! with <tt>telemetry.h</tt> containing the definitions for the variables and
+//! functions exported to the remainder of the application.
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! \defgroup telemetry_api Definitions
+//! @{
+//
+//*****************************************************************************
+
+//*****************************************************************************
+//
+//! The size of the #TAG_DATA_BATCH packet header, which is the tag, the
+//! length, the number of samples and the 32-bit millisecond of the first
+//! sample.
+//
+//*****************************************************************************
+#define TELEMETRY_HEADER_SIZE   7
+
+//*****************************************************************************
+//
+//! The largest sample of the real-time data items, which is what fits in a
+//! packet along with its header and checksum.
+//
+//*****************************************************************************
+#define TELEMETRY_SAMPLE_MAX    (TELEMETRY_FRAME_MAX - TELEMETRY_HEADER_SIZE - \
+                                 1)
+
+//*****************************************************************************
+//
+//! The size of the ring buffer of samples, in bytes.
+//
+//*****************************************************************************
+#define TELEMETRY_BUFFER_SIZE   4096
+
+//*****************************************************************************
+//
+//! The number of samples that have been dropped because the ring buffer was
+//! full.
+//
+//*****************************************************************************
+unsigned long g_ulTelemetryOverflow = 0;
+
+//*****************************************************************************
+//
+//! The ring buffer of samples.  Each record is the millisecond at which the
+//! sample was taken, followed by the sample, padded to a whole number of
+//! words.
+//
+//*****************************************************************************
+static unsigned long g_pulTelemetryBuffer[TELEMETRY_BUFFER_SIZE / 4];
+
+//*****************************************************************************
+//
+//! The real-time data items in each sample, in the order they are sampled.
+//
+//*****************************************************************************
+static const tUIRealTimeData *g_ppsTelemetryItem[DATA_NUM_ITEMS];
+
+//*****************************************************************************
+//
+//! The number of real-time data items in each sample.
+//
+//*****************************************************************************
+static unsigned long g_ulTelemetryNumItems;
+
+//*****************************************************************************
+//
+//! The size of each sample, in bytes.
+//
+//*****************************************************************************
+static unsigned long g_ulTelemetrySampleSize;
+
+//*****************************************************************************
+//
+//! The size of each record in the ring buffer, in words, and the number of
+//! records that fit in the ring buffer.
+//
+//*****************************************************************************
+static unsigned long g_ulTelemetryRecordSize;
+static unsigned long g_ulTelemetryNumRecords;
+
+//*****************************************************************************
+//
+//! The number of samples sent in each packet.
+//
+//*****************************************************************************
+static unsigned long g_ulTelemetrySamples;
+
+//*****************************************************************************
+//
+//! The number of records written to and read from the ring buffer since the
+//! batched stream was started.  The difference is the number of records in
+//! the ring buffer.
+//
+//*****************************************************************************
+static volatile unsigned long g_ulTelemetryWrite;
+static volatile unsigned long g_ulTelemetryRead;
+
+//*****************************************************************************
+//
+//! The number of milliseconds since the batched stream was started.
+//
+//*****************************************************************************
+static unsigned long g_ulTelemetryTime;
+
+//*****************************************************************************
+//
+//! A boolean that is true when the batched stream is running.
+//
+//*****************************************************************************
+static volatile tBoolean g_bTelemetryEnabled = false;
+
+//*****************************************************************************
+//
+//! Starts the batched real-time data stream.
+//!
+//! \param pulEnabled is the bit array of the enabled real-time data items,
+//! with a bit for each item ID.
+//! \param ulSamples is the number of samples to send in each packet, or zero
+//! for as many as fit.
+//!
+//! This function resolves the enabled real-time data items into the list
+//! sampled each millisecond, leaving out any that would make a sample too
+//! large for a packet, and empties the ring buffer.  This must be called
+//! from the Ethernet interrupt, or with it disabled.
+//!
+//! \return Returns the number of samples that will be sent in each packet,
+//! which is fewer than requested if they do not fit, or zero if no real-time
+//! data items are enabled.
+//
+//*****************************************************************************
+unsigned long
+TelemetryStart(const unsigned long *pulEnabled, unsigned long ulSamples)
+{
+    unsigned long ulItem, ulIdx, ulMax;
+
+    //
+    // Stop sampling while the sample is being laid out.
+    //
+    g_bTelemetryEnabled = false;
+
+    //
+    // Find the enabled real-time data items, in the same order as they are
+    // sent in a #TAG_DATA packet.
+    //
+    g_ulTelemetryNumItems = 0;
+    g_ulTelemetrySampleSize = 0;
+    for(ulItem = 0; ulItem < g_ulUINumRealTimeData; ulItem++)
+    {
+        ulIdx = g_sUIRealTimeData[ulItem].ucID;
+        if((pulEnabled[ulIdx / 32] & (1 << (ulIdx % 32))) &&
+           ((g_ulTelemetrySampleSize + g_sUIRealTimeData[ulItem].ucSize) <=
+            TELEMETRY_SAMPLE_MAX))
+        {
+            g_ppsTelemetryItem[g_ulTelemetryNumItems++] =
+                &g_sUIRealTimeData[ulItem];
+            g_ulTelemetrySampleSize += g_sUIRealTimeData[ulItem].ucSize;
+        }
+    }
+
+    //
+    // There is nothing to send if no real-time data items are enabled.
+    //
+    if(g_ulTelemetrySampleSize == 0)
+    {
+        return(0);
+    }
+
+    //
+    // Lay out the records of the ring buffer.
+    //
+    g_ulTelemetryRecordSize = 1 + ((g_ulTelemetrySampleSize + 3) / 4);
+    g_ulTelemetryNumRecords = ((TELEMETRY_BUFFER_SIZE / 4) /
+                               g_ulTelemetryRecordSize);
+
+    //
+    // Limit the number of samples in each packet to what fits.
+    //
+    ulMax = TELEMETRY_SAMPLE_MAX / g_ulTelemetrySampleSize;
+    if((ulSamples == 0) || (ulSamples > ulMax))
+    {
+        ulSamples = ulMax;
+    }
+    g_ulTelemetrySamples = ulSamples;
+
+    //
+    // Empty the ring buffer and start sampling.
+    //
+    g_ulTelemetryWrite = 0;
+    g_ulTelemetryRead = 0;
+    g_ulTelemetryTime = 0;
+    g_bTelemetryEnabled = true;
+
+    //
+    // Return the number of samples in each packet.
+    //
+    return(ulSamples);
+}
+
+//*****************************************************************************
+//
+//! Stops the batched real-time data stream.
+//!
+//! This function stops the sampling; any samples not yet sent are dropped.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+TelemetryStop(void)
+{
+    g_bTelemetryEnabled = false;
+}
+
+//*****************************************************************************
+//
+//! Takes a sample of the real-time data items.
+//!
+//! This function is called every millisecond by the millisecond tick, and
+//! copies the value of each of the sampled real-time data items into the
+//! ring buffer.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+TelemetryTick(void)
+{
+    unsigned long ulItem, ulCount, ulValue, *pulRecord;
+    unsigned char *pucSample, *pucValue;
+
+    //
+    // Do nothing if the batched stream is not running.
+    //
+    if(!g_bTelemetryEnabled)
+    {
+        return;
+    }
+
+    //
+    // Drop the sample if the ring buffer is full.
+    //
+    if((g_ulTelemetryWrite - g_ulTelemetryRead) >= g_ulTelemetryNumRecords)
+    {
+        g_ulTelemetryOverflow++;
+        g_ulTelemetryTime++;
+        return;
+    }
+
+    //
+    // Get the next record in the ring buffer, and save the time of the
+    // sample.
+    //
+    pulRecord = (g_pulTelemetryBuffer +
+                 ((g_ulTelemetryWrite % g_ulTelemetryNumRecords) *
+                  g_ulTelemetryRecordSize));
+    pulRecord[0] = g_ulTelemetryTime++;
+    pucSample = (unsigned char *)(pulRecord + 1);
+
+    //
+    // Copy the value of each of the real-time data items.
+    //
+    for(ulItem = 0; ulItem < g_ulTelemetryNumItems; ulItem++)
+    {
+        //
+        // Values of up to four bytes are read in one access so that they
+        // are not changed midway through being copied.
+        //
+        pucValue = g_ppsTelemetryItem[ulItem]->pucValue;
+        if(g_ppsTelemetryItem[ulItem]->ucSize <= 4)
+        {
+            ulValue = *((unsigned long *)pucValue);
+            pucValue = (unsigned char *)&ulValue;
+        }
+        for(ulCount = 0; ulCount < g_ppsTelemetryItem[ulItem]->ucSize;
+            ulCount++)
+        {
+            *pucSample++ = pucValue[ulCount];
+        }
+    }
+
+    //
+    // Add the record to the ring buffer.
+    //
+    g_ulTelemetryWrite++;
+}
+
+//*****************************************************************************
+//
+//! Packs the next packet of samples.
+//!
+//! \param pucFrame is the buffer for the packet, which must hold
+//! #TELEMETRY_FRAME_MAX bytes.
+//!
+//! This function takes the samples for the next #TAG_DATA_BATCH packet from
+//! the ring buffer, once enough have been taken, and builds the packet apart
+//! from its checksum.  A packet has fewer samples than requested when
+//! samples have been dropped, since the samples in a packet are always from
+//! consecutive milliseconds.  This must be called from the Ethernet
+//! interrupt.
+//!
+//! \return Returns the length of the packet, or zero if there is no packet to
+//! send.
+//
+//*****************************************************************************
+unsigned long
+TelemetryFrame(unsigned char *pucFrame)
+{
+    unsigned long ulCount, ulIdx, ulTime, *pulRecord;
+    unsigned char *pucData, *pucSample;
+
+    //
+    // Do nothing until enough samples have been taken.
+    //
+    if(!g_bTelemetryEnabled ||
+       ((g_ulTelemetryWrite - g_ulTelemetryRead) < g_ulTelemetrySamples))
+    {
+        return(0);
+    }
+
+    //
+    // Copy the samples into the packet, stopping at a dropped sample.  The
+    // time of the packet is that of its first sample.
+    //
+    pucData = pucFrame + TELEMETRY_HEADER_SIZE;
+    ulTime = 0;
+    for(ulCount = 0; ulCount < g_ulTelemetrySamples; ulCount++)
+    {
+        pulRecord = (g_pulTelemetryBuffer +
+                     (((g_ulTelemetryRead + ulCount) %
+                       g_ulTelemetryNumRecords) * g_ulTelemetryRecordSize));
+        if(ulCount == 0)
+        {
+            ulTime = pulRecord[0];
+        }
+        else if(pulRecord[0] != (ulTime + ulCount))
+        {
+            break;
+        }
+        pucSample = (unsigned char *)(pulRecord + 1);
+        for(ulIdx = 0; ulIdx < g_ulTelemetrySampleSize; ulIdx++)
+        {
+            *pucData++ = pucSample[ulIdx];
+        }
+    }
+
+    //
+    // Release the samples in the packet.
+    //
+    g_ulTelemetryRead += ulCount;
+
+    //
+    // Put the header on the packet, leaving room for the checksum.
+    //
+    pucFrame[0] = TAG_DATA_BATCH;
+    pucFrame[1] = (pucData - pucFrame) + 1;
+    pucFrame[2] = ulCount;
+    pucFrame[3] = ulTime & 0xff;
+    pucFrame[4] = (ulTime >> 8) & 0xff;
+    pucFrame[5] = (ulTime >> 16) & 0xff;
+    pucFrame[6] = (ulTime >> 24) & 0xff;
+
+    //
+    // Return the length of the packet.
+    //
+    return(pucFrame[1]);
+}
+
+//*****************************************************************************
+//
+// Close the Doxygen group.
+//! @}
+//
+//*****************************************************************************
@@ -0,0 +1,30 @@
+//*****************************************************************************
+//
+// telemetry.h - Prototypes for the batched real-time data capture.
+//
+//*****************************************************************************
+
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+//*****************************************************************************
+//
+//! The largest #TAG_DATA_BATCH packet, which is limited by its one byte
+//! length.
+//
+//*****************************************************************************
+#define TELEMETRY_FRAME_MAX     255
+
+//*****************************************************************************
+//
+// Prototypes for the exported variables and functions.
+//
+//*****************************************************************************
+extern unsigned long g_ulTelemetryOverflow;
+extern unsigned long TelemetryStart(const unsigned long *pulEnabled,
+                                    unsigned long ulSamples);
+extern void TelemetryStop(void);
+extern void TelemetryTick(void);
+extern unsigned long TelemetryFrame(unsigned char *pucFrame);
+
+#endif // __TELEMETRY_H__
@@ -67,6 +67,26 @@
 //*****************************************************************************
 #define PHASE_C         (PWM_PHASEC_HIGH | PWM_PHASEC_LOW)
 
+//*****************************************************************************
+//
+//! The sense in which the motor is driven: positive to drive the phases for
+//! the direction of rotation, negative to drive them in the opposite sense
+//! (producing torque against the direction of rotation), or zero to let the
+//! motor coast with all of the PWM outputs turned off regardless of the Hall
+//! state.
+//
+//*****************************************************************************
+static long g_lTrapDrive = 1;
+
+//*****************************************************************************
+//
+//! A boolean that is true if the low side of every phase is turned on while
+//! the motor is not driven, shorting the windings to brake it, rather than
+//! letting it coast.
+//
+//*****************************************************************************
+static tBoolean g_bTrapBrake = false;
+
 //*****************************************************************************
 //
 //! Mapping from Hall States to Phase Drive states (120 degree spacing).
@@ -188,9 +208,20 @@ TrapModulate(unsigned long ulHall)
     }
 
     //
-    // If running in reverse, invert the PWM phases.
+    // Turn off all of the PWM outputs if the motor is coasting, or turn on
+    // just the low sides if it is braking.
+    //
+    if(g_lTrapDrive == 0)
+    {
+        ulEnable = (g_bTrapBrake ?
+                    (PWM_PHASEA_LOW | PWM_PHASEB_LOW | PWM_PHASEC_LOW) : 0);
+    }
+
+    //
+    // If running in reverse, or driving against the direction of rotation
+    // (but not both), invert the PWM phases.
     //
-    if(MainIsReverse())
+    else if(MainIsReverse() != (g_lTrapDrive < 0))
     {
         if(ulEnable & PHASE_A)
         {
@@ -212,6 +243,83 @@ TrapModulate(unsigned long ulHall)
     PWMOutputTrapezoid(ulEnable);
 }
 
+//*****************************************************************************
+//
+//! Sets the sense in which the motor is driven.
+//!
+//! \param lDrive is the sign of the torque to produce: positive to drive the
+//! motor in the direction of rotation, negative to drive it against the
+//! direction of rotation, or zero to let the motor coast.
+//! \param ulHall is the present Hall state.
+//!
+//! This function lets position control mode brake the motor and hold it
+//! against a load.  Driving against the direction of rotation inverts the
+//! PWM phases for each Hall state.  While the motor coasts all of the PWM
+//! outputs are turned off, so that the motor is not driven at the minimum
+//! pulse width when no torque is demanded.  When the sense changes, the
+//! outputs are switched for the present Hall state straight away, without
+//! waiting for the next Hall edge.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+TrapDrive(long lDrive, unsigned long ulHall)
+{
+    //
+    // Reduce the drive to its sign.
+    //
+    lDrive = (lDrive > 0) ? 1 : ((lDrive < 0) ? -1 : 0);
+
+    //
+    // There is nothing to do if the sense is unchanged.
+    //
+    if((lDrive == g_lTrapDrive) && !g_bTrapBrake)
+    {
+        return;
+    }
+
+    //
+    // Save the new sense and switch the PWM outputs to match it.
+    //
+    g_lTrapDrive = lDrive;
+    g_bTrapBrake = false;
+    TrapModulate(ulHall);
+}
+
+//*****************************************************************************
+//
+//! Brakes the motor.
+//!
+//! \param ulHall is the present Hall state.
+//!
+//! This function turns on the low side of every phase, shorting the motor
+//! windings so that the Back EMF drives a current that brakes the motor.
+//! This is not regulated, so it must only be used at low speed.  The motor
+//! is braked until the next call to TrapDrive().
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+TrapBrake(unsigned long ulHall)
+{
+    //
+    // There is nothing to do if the motor is already being braked.
+    //
+    if(g_bTrapBrake)
+    {
+        return;
+    }
+
+    //
+    // Stop driving the motor and switch the PWM outputs to brake it.
+    //
+    g_lTrapDrive = 0;
+    g_bTrapBrake = true;
+    TrapModulate(ulHall);
+}
+
 //*****************************************************************************
 //
 // Close the Doxygen group.
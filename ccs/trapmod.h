@@ -27,9 +27,11 @@
 
 //*****************************************************************************
 //
-// Prototype for the trapezoid modulation routine.
+// Prototypes for the trapezoid modulation routines.
 //
 //*****************************************************************************
 extern void TrapModulate(unsigned long ulHall);
+extern void TrapDrive(long lDrive, unsigned long ulHall);
+extern void TrapBrake(unsigned long ulHall);
 
 #endif // __TRAPMOD_H__
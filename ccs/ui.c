@@ -34,13 +34,18 @@
 #include "utils/cpu_usage.h"
 #include "utils/flash_pb.h"
 #include "adc_ctrl.h"
+#include "bemf_pll.h"
 #include "commands.h"
 #include "faults.h"
+#include "foc.h"
 #include "hall_ctrl.h"
+#include "isr_prof.h"
 #include "main.h"
 #include "pins.h"
 #include "pwm_ctrl.h"
+#include "qei_ctrl.h"
 #include "ui.h"
+#include "hp_cal.h"
 #include "ui_common.h"
 #include "ui_ethernet.h"
 #include "ui_onboard.h"
@@ -122,8 +127,6 @@
 #define UI_NUM_SPEED 128
 #define UI_BASE_SPEED 0
 #define UI_MAX_SPEED 12000
-#define UI_NUM_HALLS 4
-#define UI_GAIN_SWITCH_SPEED 3600
 
 //limit for handpiece hall sensors
 #define LIMIT_HALL_INDEX_MISSING  10
@@ -135,6 +138,25 @@
 #define LIMIT_HP_VOLTAGE1_COUNT 256
 #define LIMIT_HP_VOLTAGE2_COUNT 426
 
+// the reading of a trigger hall sensor with no magnet nearby
+#define HALL_REST_READING 255
+
+// the full scale of the continuous throttle position, the position of each
+// trigger hall sensor along it, and the hysteresis applied to it
+#define THROTTLE_FULL_SCALE 65535
+#define THROTTLE_HALL_SPACING (THROTTLE_FULL_SCALE / (UI_NUM_HALLS - 1))
+#define THROTTLE_HYSTERESIS 512
+
+// the throttle positions below which the trigger is released while stopped
+// and while running, and above which it gives full speed
+#define THROTTLE_START (THROTTLE_HALL_SPACING / 2)
+#define THROTTLE_STOP (THROTTLE_HALL_SPACING / 4)
+#define THROTTLE_FULL (THROTTLE_FULL_SCALE - (THROTTLE_HALL_SPACING / 2))
+
+// the minimum time between writes of the trigger calibration to flash, in
+// milliseconds, which bounds the flash wear as each use refines it
+#define THROTTLE_CAL_SAVE_MS 60000
+
 // the count limit for consecutive phase short check
 #define LIMIT_PHASE_SHORT_CNT 30
 
@@ -144,6 +166,14 @@
 // delay for hand piece reset
 #define HP_RESET_CNT 100
 
+// time without a stream frame before the handpiece is lost, in milliseconds
+#define HP_STREAM_TIMEOUT_MS 100
+
+// length of the data of a stream frame that carries a sequence number and a
+// handpiece timestamp, and the units of the timestamp in microseconds
+#define HP_STREAM_SEQ_LENGTH 17
+#define HP_STREAM_TIME_US 100
+
 // irrigation current high limit, about 2.5 Amps, the motor has a resistance of 19.9 Ohms
 // if 48 volts fully applied, the current is about 2.4 Amps, this check is
 // only check for short, which usally has much higher current reading.
@@ -160,12 +190,20 @@
 //*****************************************************************************
 static void UIConnectionTimeout(void);
 static void UIControlType(void);
+static void UIModulationType(void);
+static void UICurrentGains(void);
 static void UIDirectionSet(void);
 static void UIPWMFrequencySet(void);
 static void UIUpdateRate(void);
 static void UISetIrrigationLevel(void);
 static void UIFAdjI(void);
+static void UIPAdjI(void);
+static void UIGainIndex(void);
+static void UIGainPoint(void);
 static void UIDynamicBrake(void);
+static void UIBusComp(void);
+static void UIEncoderPresent(void);
+static void UIEncoderLines(void);
 void UIButtonPress(void);
 static void UIButtonHold(void);
 static void UIDecayMode(void);
@@ -174,6 +212,7 @@ static void UISetEEAxis(void);
 static void UISetEENormal(void);
 static void UISetEESerialNumber(void);
 static void UIResetHandPiece(void);
+static void UIHPLinkUpdate(void);
 
 //*****************************************************************************
 //
@@ -292,23 +331,38 @@ static unsigned char g_ucUpdateRate = 0;
 //! the parameter block by UIFAdjI().
 //
 //*****************************************************************************
-long g_lFAdjI = 0;
+static long g_lFAdjI = 0;
 
 //*****************************************************************************
 //
-//! The I coefficient of the frequency PI controller for a previous cycle.
+//! The I coefficient of the power PI controller.  This variable is used by
+//! the serial interface as a staging area before the value gets placed into
+//! the parameter block by UIPAdjI().
 //
 //*****************************************************************************
-long g_lFAdjIPrev = 0;
+static long g_lPAdjI = 0;
 
 //*****************************************************************************
 //
-//! The I coefficient of the power PI controller.  This variable is used by
-//! the serial interface as a staging area before the value gets placed into
-//! the parameter block by UIPAdjI().
+//! The breakpoint of the speed controller gain schedule that is accessed by
+//! the serial interface through #g_usGainSpeed, #g_lGainP, #g_lGainI and
+//! #g_lGainAW.
 //
 //*****************************************************************************
-static long g_lPAdjI = 0;
+static unsigned char g_ucGainIndex = 0;
+
+//*****************************************************************************
+//
+//! The speed and the P, I and anti-windup coefficients of the selected gain
+//! schedule breakpoint.  These variables are used by the serial interface as
+//! a staging area before the values get placed into the parameter block by
+//! UIGainPoint().
+//
+//*****************************************************************************
+static unsigned short g_usGainSpeed = 0;
+static long g_lGainP = 0;
+static long g_lGainI = 0;
+static long g_lGainAW = 0;
 
 //*****************************************************************************
 //
@@ -327,6 +381,35 @@ static unsigned long g_ulUIUseOnboard = 1;
 //*****************************************************************************
 static unsigned char g_ucDynamicBrake = 0;
 
+//*****************************************************************************
+//
+//! A boolean that is true when the speed controller feed-forward terms and DC
+//! bus voltage compensation should be utilized.  This variable is used by the
+//! serial interface as a staging area before the value gets placed into the
+//! flags in the parameter block by UIBusComp().
+//
+//*****************************************************************************
+static unsigned char g_ucBusComp = 0;
+
+//*****************************************************************************
+//
+//! A boolean that is true when an encoder is present on the motor.  This
+//! variable is used by the serial interface as a staging area before the
+//! value gets placed into the flags in the parameter block by
+//! UIEncoderPresent().
+//
+//*****************************************************************************
+static unsigned char g_ucEncoder = 0;
+
+//*****************************************************************************
+//
+//! The number of lines of the encoder.  This variable is used by the serial
+//! interface as a staging area before the value gets placed into the
+//! parameter block by UIEncoderLines().
+//
+//*****************************************************************************
+static unsigned short g_usEncoderLines = 0;
+
 //*****************************************************************************
 //
 //! The processor usage for the most recent measurement period.  This is a
@@ -380,11 +463,94 @@ unsigned char g_ucTriggerHallStatus = 0x00;
 
 //*****************************************************************************
 //
-//! The flag for integral gain change
+//! The calibration of the trigger hall sensors of the connected handpiece,
+//! learned from the range of readings seen while it has been used.
+//
+//*****************************************************************************
+static tThrottleCal g_sThrottleCal;
+
+//*****************************************************************************
+//
+//! The serial number of the connected handpiece, which is the key of its
+//! calibration in the flash store, or #HPCAL_SERIAL_NONE if its serial number
+//! could not be read.
+//
+//*****************************************************************************
+static unsigned long g_ulThrottleCalSerial = HPCAL_SERIAL_NONE;
+
+//*****************************************************************************
+//
+//! A boolean that is true when the calibration and sensor polarity of the
+//! connected handpiece are known from the flash store, rather than having to
+//! be found from the trigger being released at connection.
+//
+//*****************************************************************************
+static tBoolean g_bThrottleCalStored = false;
+
+//*****************************************************************************
+//
+//! The calibration, sensor polarity and serial number of the handpiece that
+//! are waiting to be written to the flash store, and a boolean that is true
+//! while they are.  Programming the flash stalls the processor, so the write
+//! is put off until UIThrottleCalUpdate() finds the drive quiet.
+//
+//*****************************************************************************
+static tThrottleCal g_sThrottleCalSave;
+static unsigned long g_ulThrottleCalSaveSerial;
+static unsigned char g_ucThrottleCalSavePolarity;
+static tBoolean g_bThrottleCalSavePending = false;
+
+//*****************************************************************************
+//
+//! The number of milliseconds left before the trigger calibration may be
+//! written to the flash store again.
+//
+//*****************************************************************************
+static volatile unsigned long g_ulThrottleCalSaveHoldoff = 0;
+
+//*****************************************************************************
+//
+//! The continuous position of the trigger, from zero when released to
+//! #THROTTLE_FULL_SCALE when fully pressed.  This follows the decoded
+//! position with a hysteresis of #THROTTLE_HYSTERESIS.
+//
+//*****************************************************************************
+unsigned short g_usThrottlePosition = 0;
+
+//*****************************************************************************
+//
+//! The age of the latest trigger reading when it was taken to set the motor
+//! speed, in microseconds, from when the handpiece started to send it.
+//
+//*****************************************************************************
+unsigned long g_ulHPStreamAge = 0;
+
+//*****************************************************************************
+//
+//! The number of stream frames sent by the handpiece but not used, whether
+//! lost on the link or replaced by a newer frame before being taken, as
+//! counted from the sequence numbers of the frames.
+//
+//*****************************************************************************
+unsigned long g_ulHPStreamDrops = 0;
+
+//*****************************************************************************
+//
+//! The time between the handpiece readings in consecutive stream frames, in
+//! microseconds, as timed by the handpiece.
 //
 //*****************************************************************************
+unsigned long g_ulHPStreamPeriod = 0;
 
-volatile unsigned char g_ucIntegralGainChanged = 0x00;
+//*****************************************************************************
+//
+//! The sequence number and handpiece timestamp of the previous stream frame,
+//! which are only valid when #g_bHPStreamSeq is true.
+//
+//*****************************************************************************
+static unsigned char g_ucHPStreamSeq;
+static unsigned short g_usHPStreamTime;
+static tBoolean g_bHPStreamSeq = false;
 
 //*****************************************************************************
 //
@@ -408,7 +574,7 @@ tDriveParameters g_sParameters =
     //
     // The parameter block version number (ucVersion).
     //
-    5,
+    10,
 
     //
     // The minimum pulse width (ucMinPulseWidth).
@@ -469,6 +635,7 @@ tDriveParameters g_sParameters =
     // The flags (usFlags).
     //
     (FLAG_PWM_FREQUENCY_25K |
+     (FLAG_BUS_COMP_ON << FLAG_BUS_COMP_BIT) |
      (FLAG_DIR_FORWARD << FLAG_DIR_BIT) |
      (FLAG_ENCODER_ABSENT << FLAG_ENCODER_BIT) |
      (FLAG_BRAKE_ON << FLAG_BRAKE_BIT) |
@@ -527,17 +694,17 @@ tDriveParameters g_sParameters =
     //
     // The frequency adjust P coefficient (lFAdjP).
     //
-    (unsigned long)(40000),
+    (unsigned long)(315000),
 
     //
     // The frequency adjust I coefficient (lFAdjI).
     //
-    (unsigned long)(600),
+    (unsigned long)(1000),
 
     //
     // The power adjust P coefficient (lPAdjP).
     //
-    (unsigned long)(20000),
+    (unsigned long)(500),
 
     //
     // The brake maximum time (ulBrakeMax).
@@ -646,7 +813,79 @@ tDriveParameters g_sParameters =
     //
     // The power adjust I coefficient (lPAdjI).
     //
-    (unsigned long)(2500),
+    (unsigned long)(1000),
+
+    //
+    // The number of breakpoints in the speed controller gain schedule
+    // (ucGainPoints).
+    //
+    4,
+
+    //
+    // Padding (3 Bytes)
+    //
+    {0, 0, 0},
+
+    //
+    // The speed at each gain schedule breakpoint (pusGainSpeed).
+    //
+    {2000, 4000, 8000, 15000},
+
+    //
+    // The speed controller P coefficient at each breakpoint (plGainP).
+    //
+    {315000, 600000, 1000000, 2000000},
+
+    //
+    // The speed controller I coefficient at each breakpoint (plGainI).
+    //
+    {4000, 8000, 12000, 20000},
+
+    //
+    // The speed controller anti-windup coefficient at each breakpoint
+    // (plGainAW).
+    //
+    {10000, 10000, 10000, 10000},
+
+    //
+    // The motor speed constant (usMotorKv).
+    //
+    333,
+
+    //
+    // The acceleration feed-forward gain (usAccelFF).
+    //
+    0,
+
+    //
+    // The number of encoder lines (usEncoderLines).
+    //
+    1000,
+
+    //
+    // The jerk rate of the speed trajectory (usJerk).
+    //
+    2500,
+
+    //
+    // The handpiece stream rate (usHPStreamRate).
+    //
+    0,
+
+    //
+    // The handpiece link baud rate (ucHPBaud).
+    //
+    HP_BAUD_115200,
+
+    //
+    // Padding (1 Byte)
+    //
+    {0},
+
+    //
+    // Reserved (56 Bytes)
+    //
+    {0},
 };
 
 //*****************************************************************************
@@ -725,17 +964,38 @@ volatile char g_ucHPInitStart =0x00;
 
 //*****************************************************************************
 //
-//! The current speed of the motor's rotor.
+//! The reset flag of handpiece.
+//
+//*****************************************************************************
+unsigned char g_ucHPReset = 1;
+
+//*****************************************************************************
+//
+//! The baud rates of the handpiece link, indexed by the values of ucHPBaud.
+//
+//*****************************************************************************
+static const unsigned long g_pulHPBaud[] =
+{
+    115200,
+    460800,
+    921600
+};
+
+//*****************************************************************************
+//
+//! The value of ucHPBaud for the baud rate that the handpiece has agreed to
+//! use.
 //
 //*****************************************************************************
-unsigned long g_ulRotorSpeed = 0;
+static unsigned char g_ucHPLinkBaud = HP_BAUD_115200;
 
 //*****************************************************************************
 //
-//! The reset flag of handpiece.
+//! A boolean that is true when the handpiece was lost after its baud rate
+//! was changed, so that it is left at 115,200 baud.
 //
 //*****************************************************************************
-unsigned char g_ucHPReset = 1;
+static tBoolean g_bHPLinkFallback = false;
 
 //*****************************************************************************
 //
@@ -855,6 +1115,35 @@ const tUIParameter g_sUIParameters[] =
         0
     },
 
+    //
+    // The target position for the motor drive in position control mode.
+    // This is specified in tenths of a degree of mechanical rotation, ranging
+    // from 0 to 3599.
+    //
+    {
+        PARAM_TARGET_POS,
+        2,
+        0,
+        3599,
+        1,
+        (unsigned char *)&g_usTargetPosition,
+        MainSetPosition
+    },
+
+    //
+    // The current motor position.  This is specified in tenths of a degree of
+    // mechanical rotation, ranging from 0 to 3599.
+    //
+    {
+        PARAM_CURRENT_POS,
+        2,
+        0,
+        3599,
+        0,
+        (unsigned char *)&g_usMotorPosition,
+        0
+    },
+
     //
     // The type of modulation to be used to drive the motor.  The following
     // values are defined.
@@ -864,15 +1153,17 @@ const tUIParameter g_sUIParameters[] =
     //                        Back EMF for position/commutation.
     // MOD_TYPE_SINE        - Sinusoid modulation, using Hall sensors for
     //                        position.
+    // MOD_TYPE_FOC         - Field-oriented control of the phase currents,
+    //                        using Hall sensors for position.
     //
     {
         PARAM_MODULATION,
         1,
         0,
-        2,
+        3,
         1,
         &g_ucModulationType,
-        0
+        UIModulationType
     },
 
     //
@@ -1151,6 +1442,35 @@ const tUIParameter g_sUIParameters[] =
         UIDynamicBrake
     },
 
+    //
+    // This indicates if the speed controller feed-forward terms and DC bus
+    // voltage compensation should be utilized.  When one, they are active,
+    // and when zero they are not.
+    //
+    {
+        PARAM_USE_BUS_COMP,
+        1,
+        0,
+        1,
+        1,
+        &g_ucBusComp,
+        UIBusComp
+    },
+
+    //
+    // This indicates if an encoder is present on the motor.  When one, the
+    // rotor speed is measured by the encoder, and when zero it is not.
+    //
+    {
+        PARAM_ENCODER_PRESENT,
+        1,
+        0,
+        1,
+        1,
+        &g_ucEncoder,
+        UIEncoderPresent
+    },
+
     //
     // The maximum amount of time to apply dynamic braking, specified in
     // milliseconds.
@@ -1402,6 +1722,20 @@ const tUIParameter g_sUIParameters[] =
         360000,
         1,
         (unsigned char *)&(g_sParameters.ulTargetPower),
+        MainSetPower
+    },
+
+    //
+    // The current motor power.  This is specified in milliwatts, ranging
+    // from 0 to 360 W.  This is a read-only parameter.
+    //
+    {
+        PARAM_CURRENT_POWER,
+        4,
+        0,
+        360000,
+        0,
+        (unsigned char *)&g_ulMotorPower,
         0
     },
     
@@ -1456,7 +1790,7 @@ const tUIParameter g_sUIParameters[] =
         0x7fffffff,
         1,
         (unsigned char *)&g_lPAdjI,
-        0
+        UIPAdjI
     },
 
     //
@@ -1488,13 +1822,13 @@ const tUIParameter g_sUIParameters[] =
     },
 
     //
-    // The control mode for the motor (speed/power).
+    // The control mode for the motor (speed/power/position).
     //
     {
         PARAM_CONTROL_MODE,
         1,
         0,
-        1,
+        3,
         1,
         &g_ucControlType,
         UIControlType
@@ -1595,78 +1929,344 @@ const tUIParameter g_sUIParameters[] =
         (unsigned char *)&g_ucHPReset,
         UIResetHandPiece,
     },
-};
 
-//*****************************************************************************
-//
-//! The number of motor drive parameters.  This is used by the user
-//! interface module.
-//
-//*****************************************************************************
-const unsigned long g_ulUINumParameters = (sizeof(g_sUIParameters) /
-                                           sizeof(g_sUIParameters[0]));
+    //
+    // The P coefficient for the field-oriented current PI controllers.
+    //
+    {
+        PARAM_FOC_CURRENT_P,
+        4,
+        0,
+        0x7fffffff,
+        1,
+        (unsigned char *)&g_lFOCCurrentP,
+        0
+    },
 
-//*****************************************************************************
-//
-//! An array of structures describing the Brushless DC motor drive real-time
-//! data items to the serial user interface module.
-//
-//*****************************************************************************
-const tUIRealTimeData g_sUIRealTimeData[] =
-{
     //
-    // The current through phase A of the motor.  This is a signed 16-bit
-    // value providing the current in milli-amperes.
+    // The I coefficient for the field-oriented current PI controllers.
     //
     {
-        DATA_PHASE_A_CURRENT,
-        2,
-        (unsigned char *)&(g_psPhaseCurrent[0])
+        PARAM_FOC_CURRENT_I,
+        4,
+        0,
+        0x7fffffff,
+        1,
+        (unsigned char *)&g_lFOCCurrentI,
+        0
     },
 
     //
-    // The current through phase B of the motor.  This is a signed 16-bit
-    // value providing the current in milli-amperes.
+    // The closed-loop bandwidth of the motor current controller, specified in
+    // Hz.
     //
     {
-        DATA_PHASE_B_CURRENT,
+        PARAM_CURRENT_BW,
         2,
-        (unsigned char *)&(g_psPhaseCurrent[1])
+        0,
+        5000,
+        10,
+        (unsigned char *)&g_usCurrentBandwidth,
+        UICurrentGains
     },
 
     //
-    // The current through phase C of the motor.  This is a signed 16-bit
-    // value providing the current in milli-amperes.
+    // The line-to-line resistance of the motor, specified in milliohms.
     //
     {
-        DATA_PHASE_C_CURRENT,
+        PARAM_MOTOR_RESISTANCE,
         2,
-        (unsigned char *)&(g_psPhaseCurrent[2])
+        0,
+        65535,
+        1,
+        (unsigned char *)&g_usMotorResistance,
+        UICurrentGains
     },
 
     //
-    // The current through the entire motor.  This is a signed 16-bit
-    // value providing the current in milli-amperes.
+    // The line-to-line inductance of the motor, specified in microhenries.
     //
     {
-        DATA_MOTOR_CURRENT,
+        PARAM_MOTOR_INDUCTANCE,
         2,
-        (unsigned char *)&g_sMotorCurrent
+        0,
+        65535,
+        1,
+        (unsigned char *)&g_usMotorInductance,
+        UICurrentGains
     },
 
     //
-    // The voltage of the DC bus.  This is a 32-bit value providing the voltage
-    // in milli-volts.
+    // The hysteresis of the Back EMF zero-crossing threshold, specified in
+    // ADC counts.
     //
     {
-        DATA_BUS_VOLTAGE,
-        4,
-        (unsigned char *)&g_ulBusVoltage
+        PARAM_BEMF_HYSTERESIS,
+        2,
+        0,
+        511,
+        1,
+        (unsigned char *)&g_usBEMFHysteresis,
+        0
     },
 
     //
-    // The frequency of the rotor.  This is a 16-bit value providing the
-    // motor speed in RPM.
+    // The latency from the Back EMF sample to the ADC interrupt, specified in
+    // system clocks.
+    //
+    {
+        PARAM_BEMF_LATENCY,
+        2,
+        0,
+        65535,
+        1,
+        (unsigned char *)&g_usBEMFLatency,
+        0
+    },
+
+    //
+    // The number of breakpoints in use in the speed controller gain
+    // schedule.
+    //
+    {
+        PARAM_GAIN_POINTS,
+        1,
+        0,
+        NUM_GAIN_POINTS,
+        1,
+        (unsigned char *)&(g_sParameters.ucGainPoints),
+        0
+    },
+
+    //
+    // The gain schedule breakpoint accessed by the following parameters.
+    //
+    {
+        PARAM_GAIN_INDEX,
+        1,
+        0,
+        NUM_GAIN_POINTS - 1,
+        1,
+        &g_ucGainIndex,
+        UIGainIndex
+    },
+
+    //
+    // The speed of the selected gain schedule breakpoint, specified in RPM.
+    //
+    {
+        PARAM_GAIN_SPEED,
+        2,
+        0,
+        65535,
+        1,
+        (unsigned char *)&g_usGainSpeed,
+        UIGainPoint
+    },
+
+    //
+    // The speed controller P coefficient at the selected breakpoint.
+    //
+    {
+        PARAM_GAIN_P,
+        4,
+        0x80000000,
+        0x7fffffff,
+        1,
+        (unsigned char *)&g_lGainP,
+        UIGainPoint
+    },
+
+    //
+    // The speed controller I coefficient at the selected breakpoint.
+    //
+    {
+        PARAM_GAIN_I,
+        4,
+        0x80000000,
+        0x7fffffff,
+        1,
+        (unsigned char *)&g_lGainI,
+        UIGainPoint
+    },
+
+    //
+    // The speed controller anti-windup coefficient at the selected
+    // breakpoint.
+    //
+    {
+        PARAM_GAIN_AW,
+        4,
+        0,
+        65536,
+        1,
+        (unsigned char *)&g_lGainAW,
+        UIGainPoint
+    },
+
+    //
+    // The motor speed constant, specified in RPM per volt.
+    //
+    {
+        PARAM_MOTOR_KV,
+        2,
+        0,
+        10000,
+        1,
+        (unsigned char *)&(g_sParameters.usMotorKv),
+        0
+    },
+
+    //
+    // The acceleration feed-forward gain, specified in milliamperes per 1000
+    // RPM per second.
+    //
+    {
+        PARAM_SPEED_FF_ACCEL,
+        2,
+        0,
+        10000,
+        1,
+        (unsigned char *)&(g_sParameters.usAccelFF),
+        0
+    },
+
+    //
+    // The number of lines of the encoder.
+    //
+    {
+        PARAM_ENCODER_LINES,
+        2,
+        1,
+        8192,
+        1,
+        (unsigned char *)&g_usEncoderLines,
+        UIEncoderLines
+    },
+
+    //
+    // The jerk rate of the speed trajectory, specified as the change in the
+    // acceleration rate, in RPM per second, each millisecond.
+    //
+    {
+        PARAM_SPEED_JERK,
+        2,
+        0,
+        65535,
+        1,
+        (unsigned char *)&(g_sParameters.usJerk),
+        0
+    },
+
+    //
+    // The baud rate that the handpiece link is moved to, when the handpiece
+    // supports it.
+    //
+    {
+        PARAM_HP_BAUD,
+        1,
+        HP_BAUD_115200,
+        HP_BAUD_921600,
+        1,
+        (unsigned char *)&(g_sParameters.ucHPBaud),
+        UIHPLinkUpdate
+    },
+
+    //
+    // The rate at which the handpiece streams the trigger, specified in
+    // frames per second.
+    //
+    {
+        PARAM_HP_STREAM_RATE,
+        2,
+        0,
+        1000,
+        1,
+        (unsigned char *)&(g_sParameters.usHPStreamRate),
+        UIHPLinkUpdate
+    },
+};
+
+//*****************************************************************************
+//
+//! The number of motor drive parameters.  This is used by the user
+//! interface module.
+//
+//*****************************************************************************
+const unsigned long g_ulUINumParameters = (sizeof(g_sUIParameters) /
+                                           sizeof(g_sUIParameters[0]));
+
+//*****************************************************************************
+//
+//! An array of structures describing the Brushless DC motor drive real-time
+//! data items to the serial user interface module.
+//
+//*****************************************************************************
+const tUIRealTimeData g_sUIRealTimeData[] =
+{
+    //
+    // The current through phase A of the motor.  This is a signed 16-bit
+    // value providing the current in milli-amperes.
+    //
+    {
+        DATA_PHASE_A_CURRENT,
+        2,
+        (unsigned char *)&(g_psPhaseCurrent[0])
+    },
+
+    //
+    // The current through phase B of the motor.  This is a signed 16-bit
+    // value providing the current in milli-amperes.
+    //
+    {
+        DATA_PHASE_B_CURRENT,
+        2,
+        (unsigned char *)&(g_psPhaseCurrent[1])
+    },
+
+    //
+    // The current through phase C of the motor.  This is a signed 16-bit
+    // value providing the current in milli-amperes.
+    //
+    {
+        DATA_PHASE_C_CURRENT,
+        2,
+        (unsigned char *)&(g_psPhaseCurrent[2])
+    },
+
+    //
+    // The current through the entire motor.  This is a signed 16-bit
+    // value providing the current in milli-amperes.
+    //
+    {
+        DATA_MOTOR_CURRENT,
+        2,
+        (unsigned char *)&g_sMotorCurrent
+    },
+
+    //
+    // The voltage of the DC bus.  This is a 32-bit value providing the voltage
+    // in milli-volts.
+    //
+    {
+        DATA_BUS_VOLTAGE,
+        4,
+        (unsigned char *)&g_ulBusVoltage
+    },
+
+    //
+    // The position of the rotor.  This is a 16-bit value providing the
+    // mechanical angle in tenths of a degree.
+    //
+    {
+        DATA_MOTOR_POSITION,
+        2,
+        (unsigned char *)&g_usMotorPosition
+    },
+
+    //
+    // The frequency of the rotor.  This is a 16-bit value providing the
+    // motor speed in RPM.
     //
     {
         DATA_ROTOR_SPEED,
@@ -1766,66 +2366,235 @@ const tUIRealTimeData g_sUIRealTimeData[] =
         4,
         (unsigned char *)&(g_sParameters.ulTargetSpeed)
     },
-};
 
-//*****************************************************************************
-//
-//! The number of motor drive real-time data items.  This is used by the serial
-//! user interface module.
-//
-//*****************************************************************************
-const unsigned long g_ulUINumRealTimeData = (sizeof(g_sUIRealTimeData) /
-                                             sizeof(g_sUIRealTimeData[0]));
+    //
+    // The execution profiles of the interrupt handlers.  Each is four 32-bit
+    // values providing the minimum, maximum and mean time in system clocks,
+    // and the number of calls.
+    //
+    // The ADC sequence zero interrupt handler.
+    //
+    {
+        DATA_ISR_PROFILE_ADC,
+        16,
+        (unsigned char *)&(g_psISRProfile[ISR_PROFILE_ADC])
+    },
 
-//*****************************************************************************
-//
-//! An array of structures describing the on-board switches.
-//
-//*****************************************************************************
-const tUIOnboardSwitch g_sUISwitches[] =
-{
     //
-    // The run/stop/mode button.  Pressing the button will cycle between
-    // stopped and running, and holding the switch for five seconds will toggle
-    // between sine wave and space vector modulation.
+    // The PWM generator zero interrupt handler.
     //
     {
-        PIN_SWITCH_PIN_BIT,
-        UI_INT_RATE * 5,
-        UIButtonPress,
-        0,
-        UIButtonHold
-    }
-};
+        DATA_ISR_PROFILE_PWM,
+        16,
+        (unsigned char *)&(g_psISRProfile[ISR_PROFILE_PWM])
+    },
 
-//*****************************************************************************
-//
-//! The number of switches in the g_sUISwitches array.  This value is
-//! automatically computed based on the number of entries in the array.
-//
-//*****************************************************************************
-#define NUM_SWITCHES            (sizeof(g_sUISwitches) /   \
-                                 sizeof(g_sUISwitches[0]))
+    //
+    // The millisecond tick interrupt handler.
+    //
+    {
+        DATA_ISR_PROFILE_MS_TICK,
+        16,
+        (unsigned char *)&(g_psISRProfile[ISR_PROFILE_MS_TICK])
+    },
 
-//*****************************************************************************
-//
-//! The number of switches on this target.  This value is used by the on-board
-//! user interface module.
-//
-//*****************************************************************************
-const unsigned long g_ulUINumButtons = NUM_SWITCHES;
+    //
+    // The Hall sensor interrupt handler.
+    //
+    {
+        DATA_ISR_PROFILE_HALL,
+        16,
+        (unsigned char *)&(g_psISRProfile[ISR_PROFILE_HALL])
+    },
 
-//*****************************************************************************
-//
-//! This is the count of the number of samples during which the switches have
-//! been pressed; it is used to distinguish a switch press from a switch
-//! hold.  This array is used by the on-board user interface module.
-//
-//*****************************************************************************
-unsigned long g_pulUIHoldCount[NUM_SWITCHES];
+    //
+    // The Ethernet interrupt handler.
+    //
+    {
+        DATA_ISR_PROFILE_ETHERNET,
+        16,
+        (unsigned char *)&(g_psISRProfile[ISR_PROFILE_ETHERNET])
+    },
 
-//*****************************************************************************
-//
+    //
+    // The d axis (flux producing) motor current when using field-oriented
+    // control.  This is a signed 16-bit value providing the current in
+    // milli-amperes.
+    //
+    {
+        DATA_CURRENT_D,
+        2,
+        (unsigned char *)&g_sFOCCurrentD
+    },
+
+    //
+    // The q axis (torque producing) motor current when using field-oriented
+    // control.  This is a signed 16-bit value providing the current in
+    // milli-amperes.
+    //
+    {
+        DATA_CURRENT_Q,
+        2,
+        (unsigned char *)&g_sFOCCurrentQ
+    },
+
+    //
+    // The motor current reference produced by the speed controller for the
+    // current controller.  This is a signed 32-bit value providing the
+    // current in milli-amperes.
+    //
+    {
+        DATA_CURRENT_REF,
+        4,
+        (unsigned char *)&g_lCurrentRef
+    },
+
+    //
+    // The phase error of the sensorless phase-locked loop.  This is a signed
+    // 16-bit value providing the error in tenths of an electrical degree.
+    //
+    {
+        DATA_BEMF_PLL_ERROR,
+        2,
+        (unsigned char *)&g_sBEMFPLLError
+    },
+
+    //
+    // The lock status of the sensorless phase-locked loop.
+    //
+    {
+        DATA_BEMF_PLL_LOCK,
+        1,
+        (unsigned char *)&g_ucBEMFPLLLock
+    },
+
+    //
+    // The average motor input power.  This is specified in milliwatts.
+    //
+    {
+        DATA_MOTOR_POWER,
+        4,
+        (unsigned char *)&g_ulMotorPower
+    },
+
+    //
+    // The position of the rotor, as measured by the encoder.  This is
+    // specified in encoder counts.
+    //
+    {
+        DATA_ENCODER_POSITION,
+        4,
+        (unsigned char *)&g_lEncoderPosition
+    },
+
+    //
+    // The signed speed of the rotor, as measured by the encoder.  This is
+    // specified in RPM.
+    //
+    {
+        DATA_ENCODER_SPEED,
+        4,
+        (unsigned char *)&g_lEncoderSpeed
+    },
+
+    //
+    // The position of the trigger.  This is a 16-bit value from zero when
+    // released to 65535 when fully pressed.
+    //
+    {
+        DATA_THROTTLE_POSITION,
+        2,
+        (unsigned char *)&g_usThrottlePosition
+    },
+
+    //
+    // The age of the latest trigger reading when it was used.  This is
+    // specified in microseconds.
+    //
+    {
+        DATA_HP_STREAM_AGE,
+        4,
+        (unsigned char *)&g_ulHPStreamAge
+    },
+
+    //
+    // The number of handpiece stream frames sent but not used.
+    //
+    {
+        DATA_HP_STREAM_DROPS,
+        4,
+        (unsigned char *)&g_ulHPStreamDrops
+    },
+
+    //
+    // The time between the handpiece readings in consecutive stream frames.
+    // This is specified in microseconds.
+    //
+    {
+        DATA_HP_STREAM_PERIOD,
+        4,
+        (unsigned char *)&g_ulHPStreamPeriod
+    },
+};
+
+//*****************************************************************************
+//
+//! The number of motor drive real-time data items.  This is used by the serial
+//! user interface module.
+//
+//*****************************************************************************
+const unsigned long g_ulUINumRealTimeData = (sizeof(g_sUIRealTimeData) /
+                                             sizeof(g_sUIRealTimeData[0]));
+
+//*****************************************************************************
+//
+//! An array of structures describing the on-board switches.
+//
+//*****************************************************************************
+const tUIOnboardSwitch g_sUISwitches[] =
+{
+    //
+    // The run/stop/mode button.  Pressing the button will cycle between
+    // stopped and running, and holding the switch for five seconds will toggle
+    // between sine wave and space vector modulation.
+    //
+    {
+        PIN_SWITCH_PIN_BIT,
+        UI_INT_RATE * 5,
+        UIButtonPress,
+        0,
+        UIButtonHold
+    }
+};
+
+//*****************************************************************************
+//
+//! The number of switches in the g_sUISwitches array.  This value is
+//! automatically computed based on the number of entries in the array.
+//
+//*****************************************************************************
+#define NUM_SWITCHES            (sizeof(g_sUISwitches) /   \
+                                 sizeof(g_sUISwitches[0]))
+
+//*****************************************************************************
+//
+//! The number of switches on this target.  This value is used by the on-board
+//! user interface module.
+//
+//*****************************************************************************
+const unsigned long g_ulUINumButtons = NUM_SWITCHES;
+
+//*****************************************************************************
+//
+//! This is the count of the number of samples during which the switches have
+//! been pressed; it is used to distinguish a switch press from a switch
+//! hold.  This array is used by the on-board user interface module.
+//
+//*****************************************************************************
+unsigned long g_pulUIHoldCount[NUM_SWITCHES];
+
+//*****************************************************************************
+//
 //! This is the board id, read once from the configuration switches at startup.
 //
 //*****************************************************************************
@@ -1838,15 +2607,11 @@ unsigned char g_ucBoardID = 0;
 //*****************************************************************************
 static unsigned long g_ulUITickCount = 0;
 
-char rxData[64];
 unsigned short g_ulRxDataInt[7];
 static int g_ucSpeedThrottle = 0;
 static int g_triggerInfo=0;
 static int g_ucTIndexPrev = 0;
 unsigned long g_ucInitHallReading[6];
-unsigned int g_ucHallMin[UI_NUM_HALLS];
-unsigned int g_ucHallMax[UI_NUM_HALLS];
-unsigned long hallReadingSum;
 unsigned int handHallSpdPole;
 char tStr[32];
 volatile char g_ucHPInitDone = 0x00;
@@ -1911,6 +2676,34 @@ UIResetHandPiece(void)
    // a place holder
 }
 
+//*****************************************************************************
+//
+//! Updates the handpiece link settings.
+//!
+//! This function is called when the handpiece baud rate or stream rate is
+//! updated.  The new settings are sent to the handpiece when it is next
+//! initialized, which is done at once unless the motor is running.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIHPLinkUpdate(void)
+{
+    //
+    // Allow the new baud rate to be tried, even if a previous one failed.
+    //
+    g_bHPLinkFallback = false;
+
+    //
+    // Initialize the handpiece again if the motor is stopped.
+    //
+    if(!MainIsRunning())
+    {
+        g_ucHPInitDone = 0x00;
+    }
+}
+
 
 
 //*****************************************************************************
@@ -1918,8 +2711,9 @@ UIResetHandPiece(void)
 //! Updates the control mode bit for the motor dive.
 //!
 //! This function is called when the variable controlling the motor control
-//! variable (speed/power) is updated.  The value is then reflected into the
-//! usFlags member of #g_sParameters.
+//! variable (speed/power/position) is updated.  The value is then reflected
+//! into the ucControlType member of #g_sParameters.  Position control is
+//! refused if there is no position sensor.
 //!
 //! \return None.
 //
@@ -1944,11 +2738,85 @@ UIControlType(void)
     }
 
     //
-    // Update the encoder presence flag in the flags variable.
+    // Position control needs a position sensor, which is the encoder or the
+    // digital Hall sensors with trapezoid modulation or field-oriented
+    // control.  Refuse it without one.
+    //
+    if((g_ucControlType == CONTROL_TYPE_POSITION) &&
+       (MainPositionCounts() == 0))
+    {
+        g_ucControlType = g_sParameters.ucControlType;
+        return;
+    }
+
+    //
+    // Update the control type in the parameter block.
     //
     g_sParameters.ucControlType = g_ucControlType;
 }
 
+//*****************************************************************************
+//
+//! Updates the modulation type of the motor drive.
+//!
+//! This function is called when the variable controlling the modulation type
+//! of the motor drive is updated.  The value is then reflected into
+//! #g_sParameters, and the ADC sequence and Hall sensor interrupts are
+//! reconfigured for the new modulation type.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIModulationType(void)
+{
+    //
+    // See if the motor drive is running.
+    //
+    if(MainIsRunning())
+    {
+        //
+        // Not allowed to change modulation type while motor is running.
+        //
+        g_ucModulationType = g_sParameters.ucModulationType;
+
+        //
+        // There is nothing further to do.
+        //
+        return;
+    }
+
+    //
+    // Update the modulation type in the parameter block.
+    //
+    g_sParameters.ucModulationType = g_ucModulationType;
+
+    //
+    // Reconfigure the ADC and Hall sensor processing for the new modulation
+    // type.
+    //
+    ADCConfigure();
+    HallInit();
+    HallConfigure();
+}
+
+//*****************************************************************************
+//
+//! Updates the gains of the motor current controller.
+//!
+//! This function is called when the current loop bandwidth or the motor
+//! resistance or inductance is updated.  The current controller gains are
+//! recomputed from the new values.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UICurrentGains(void)
+{
+    MainSetCurrentGains();
+}
+
 //*****************************************************************************
 //
 //! Updates the motor drive direction bit.
@@ -2112,6 +2980,68 @@ UIFAdjI(void)
     MainUpdateFAdjI(g_lFAdjI);
 }
 
+//*****************************************************************************
+//
+//! Updates the I coefficient of the power PI controller.
+//!
+//! This function is called when the variable containing the I coefficient of
+//! the power PI controller is updated.  The value is then reflected into the
+//! parameter block.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIPAdjI(void)
+{
+    //
+    // Update the power PI controller.
+    //
+    g_sParameters.lPAdjI = g_lPAdjI;
+}
+
+//*****************************************************************************
+//
+//! Selects a breakpoint of the speed controller gain schedule.
+//!
+//! This function is called when the variable selecting the gain schedule
+//! breakpoint is updated.  The speed and coefficients of the newly selected
+//! breakpoint are copied from the parameter block into the staging area used
+//! by the serial interface.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIGainIndex(void)
+{
+    g_usGainSpeed = g_sParameters.pusGainSpeed[g_ucGainIndex];
+    g_lGainP = g_sParameters.plGainP[g_ucGainIndex];
+    g_lGainI = g_sParameters.plGainI[g_ucGainIndex];
+    g_lGainAW = g_sParameters.plGainAW[g_ucGainIndex];
+}
+
+//*****************************************************************************
+//
+//! Updates a breakpoint of the speed controller gain schedule.
+//!
+//! This function is called when the speed or a coefficient of the selected
+//! gain schedule breakpoint is updated.  The values are then reflected into
+//! the parameter block, and take effect (bumplessly) on the next speed
+//! controller update.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIGainPoint(void)
+{
+    g_sParameters.pusGainSpeed[g_ucGainIndex] = g_usGainSpeed;
+    g_sParameters.plGainP[g_ucGainIndex] = g_lGainP;
+    g_sParameters.plGainI[g_ucGainIndex] = g_lGainI;
+    g_sParameters.plGainAW[g_ucGainIndex] = g_lGainAW;
+}
+
 //*****************************************************************************
 //
 //! Updates the dynamic brake bit of the motor drive.
@@ -2134,37 +3064,162 @@ UIDynamicBrake(void)
 
 //*****************************************************************************
 //
-//! Updates the decay mode bit of the motor drive.
+//! Updates the bus compensation bit of the motor drive.
 //!
-//! This function is called when the variable controlling the decay mode
-//! is updated.  The value is then reflected into the usFlags member of
-//! #g_sParameters.
+//! This function is called when the variable controlling the speed controller
+//! feed-forward terms and DC bus voltage compensation is updated.  The value
+//! is then reflected into the usFlags member of #g_sParameters.
 //!
 //! \return None.
 //
 //*****************************************************************************
 static void
-UIDecayMode(void)
+UIBusComp(void)
 {
     //
-    // Update the decay mode flag in the flags variable.
+    // Update the bus compensation flag in the flags variable.
     //
-    HWREGBITH(&(g_sParameters.usFlags), FLAG_DECAY_BIT) = g_ucDecayMode;
+    HWREGBITH(&(g_sParameters.usFlags), FLAG_BUS_COMP_BIT) = g_ucBusComp;
 }
 
 //*****************************************************************************
 //
-//! Updates the ee serial number to the handpiece eeprom.
+//! Updates the encoder presence bit of the motor drive.
 //!
-//! This function is called when ee serial number is updated.
+//! This function is called when the variable controlling the presence of an
+//! encoder is updated.  The value is then reflected into the usFlags member
+//! of #g_sParameters, and the quadrature encoder is reconfigured.
 //!
 //! \return None.
 //
 //*****************************************************************************
-static void UISetEESerialNumber(void)
+static void
+UIEncoderPresent(void)
 {
-	int i;
-	unsigned char crc=0;
+    //
+    // See if the motor drive is running.
+    //
+    if(MainIsRunning())
+    {
+        //
+        // Not allowed to change the speed feedback while motor is running.
+        //
+        g_ucEncoder = HWREGBITH(&(g_sParameters.usFlags), FLAG_ENCODER_BIT);
+
+        //
+        // There is nothing further to do.
+        //
+        return;
+    }
+
+    //
+    // Update the encoder presence flag in the flags variable.
+    //
+    HWREGBITH(&(g_sParameters.usFlags), FLAG_ENCODER_BIT) = g_ucEncoder;
+
+    //
+    // Reconfigure the quadrature encoder.
+    //
+    EncoderConfigure();
+}
+
+//*****************************************************************************
+//
+//! Updates the number of lines of the encoder.
+//!
+//! This function is called when the variable controlling the number of lines
+//! of the encoder is updated.  The value is then reflected into
+//! #g_sParameters, and the quadrature encoder is reconfigured.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIEncoderLines(void)
+{
+    //
+    // See if the motor drive is running.
+    //
+    if(MainIsRunning())
+    {
+        //
+        // Not allowed to change the encoder while motor is running.
+        //
+        g_usEncoderLines = g_sParameters.usEncoderLines;
+
+        //
+        // There is nothing further to do.
+        //
+        return;
+    }
+
+    //
+    // Update the number of encoder lines in the parameter block.
+    //
+    g_sParameters.usEncoderLines = g_usEncoderLines;
+
+    //
+    // Reconfigure the quadrature encoder.
+    //
+    EncoderConfigure();
+}
+
+//*****************************************************************************
+//
+//! Updates the decay mode bit of the motor drive.
+//!
+//! This function is called when the variable controlling the decay mode
+//! is updated.  The value is then reflected into the usFlags member of
+//! #g_sParameters.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIDecayMode(void)
+{
+    //
+    // Update the decay mode flag in the flags variable.
+    //
+    HWREGBITH(&(g_sParameters.usFlags), FLAG_DECAY_BIT) = g_ucDecayMode;
+}
+
+//*****************************************************************************
+//
+//! Completes a write to the handpiece eeprom.
+//!
+//! This function is called when the handpiece has answered a write to its
+//! eeprom, or has failed to.  The handpiece is initialized again after a
+//! write, so that the new contents are read back.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void UIEEWritten(void *pvCBData, int iLength)
+{
+	if(iLength == -1)
+	{
+		MainSetFault(FAULT_HP_COMM);
+		return;
+	}
+
+	//reset initialization done flag
+	g_ucHPInitDone = 0x00;
+}
+
+//*****************************************************************************
+//
+//! Updates the ee serial number to the handpiece eeprom.
+//!
+//! This function is called when ee serial number is updated.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void UISetEESerialNumber(void)
+{
+	int i;
+	unsigned char crc=0;
 
 	//while motor is running, do not change
 	if(MainIsRunning())
@@ -2190,16 +3245,13 @@ static void UISetEESerialNumber(void)
 	//copy the data over
 	memcpy(&(tStr[4]),g_usEESerialNumber, UI_EE_DEFAULT_SIZE);
 
-	//save the constants to eeprom in handpiece
-	if(ui_uart_ucmd(tStr, UI_EE_DEFAULT_SIZE + 4) ==-1)
+	//save the constants to eeprom in handpiece, it is initialized again
+	//once the write is done
+	if(ui_uart_request(tStr, UI_EE_DEFAULT_SIZE + 4, NULL, 0, UIEEWritten, NULL) ==-1)
     {
 		MainSetFault(FAULT_HP_COMM);
-		return;
     }
 
-	//reset initialization done flag
-	g_ucHPInitDone = 0x00;
-
 }
 
 //*****************************************************************************
@@ -2240,16 +3292,13 @@ static void UISetEEOrigin(void)
 	//copy the data over
 	memcpy(&(tStr[4]),g_usEEOrigin, UI_EE_CONST_SIZE);
 
-	//save the constants to eeprom in handpiece
-	if(ui_uart_ucmd(tStr, UI_EE_CONST_SIZE + 4) ==-1)
+	//save the constants to eeprom in handpiece, it is initialized again
+	//once the write is done
+	if(ui_uart_request(tStr, UI_EE_CONST_SIZE + 4, NULL, 0, UIEEWritten, NULL) ==-1)
     {
 		MainSetFault(FAULT_HP_COMM);
-		return;
     }
 
-	//reset initialization done flag
-	g_ucHPInitDone = 0x00;
-
 }
 
 //*****************************************************************************
@@ -2291,15 +3340,12 @@ static void UISetEEAxis(void)
 	//copy the data over
 	memcpy(&(tStr[4]), g_usEEAxis, UI_EE_CONST_SIZE);
 
-	//save the constants to eeprom in handpiece
-	if(ui_uart_ucmd(tStr, UI_EE_CONST_SIZE + 4) ==-1)
+	//save the constants to eeprom in handpiece, it is initialized again
+	//once the write is done
+	if(ui_uart_request(tStr, UI_EE_CONST_SIZE + 4, NULL, 0, UIEEWritten, NULL) ==-1)
     {
 		MainSetFault(FAULT_HP_COMM);
-		return;
     }
-
-	//reset initialization done flag
-	g_ucHPInitDone = 0x00;
 }
 
 //*****************************************************************************
@@ -2341,15 +3387,12 @@ static void UISetEENormal(void)
 	//copy the data over
 	memcpy(&(tStr[4]), g_usEENormal, UI_EE_CONST_SIZE);
 
-	//save the constants to eeprom in handpiece
-	if(ui_uart_ucmd(tStr, UI_EE_CONST_SIZE + 4) ==-1)
+	//save the constants to eeprom in handpiece, it is initialized again
+	//once the write is done
+	if(ui_uart_request(tStr, UI_EE_CONST_SIZE + 4, NULL, 0, UIEEWritten, NULL) ==-1)
     {
 		MainSetFault(FAULT_HP_COMM);
-		return;
     }
-
-	//reset initialization done flag
-	g_ucHPInitDone = 0x00;
 }
 
 //*****************************************************************************
@@ -2476,9 +3519,12 @@ UIParamLoad(void)
     }
     g_ucUpdateRate = g_sParameters.ucUpdateRate;
     g_lFAdjI = g_sParameters.lFAdjI;
-	g_lFAdjIPrev = g_lFAdjI;
     g_lPAdjI = g_sParameters.lPAdjI;
+    UIGainIndex();
     g_ucDynamicBrake = HWREGBITH(&(g_sParameters.usFlags), FLAG_BRAKE_BIT);
+    g_ucBusComp = HWREGBITH(&(g_sParameters.usFlags), FLAG_BUS_COMP_BIT);
+    g_ucEncoder = HWREGBITH(&(g_sParameters.usFlags), FLAG_ENCODER_BIT);
+    g_usEncoderLines = g_sParameters.usEncoderLines;
     g_ucSensorType = HWREGBITH(&(g_sParameters.usFlags), FLAG_SENSOR_TYPE_BIT);
     g_ucSensorType |= (HWREGBITH(&(g_sParameters.usFlags),
                                  FLAG_SENSOR_SPACE_BIT) << 1);
@@ -2740,10 +3786,19 @@ UIGetTicks(void)
     // counting regardless of whether or not the wrap interrupt has been
     // serviced.
     //
+    // The Hall edge interrupt runs at the same priority as the timer
+    // interrupt, so it can see a wrap whose interrupt is still pending.  The
+    // raw interrupt status is read along with the tick count so that such a
+    // wrap is still counted.
+    //
     do
     {
         ulTime1 = TimerValueGet(TIMER1_BASE, TIMER_A);
         ulTicks = g_ulUITickCount;
+        if(TimerIntStatus(TIMER1_BASE, false) & TIMER_TIMA_TIMEOUT)
+        {
+            ulTicks += (SYSTEM_CLOCK / TIMER1A_INT_RATE);
+        }
         ulTime2 = TimerValueGet(TIMER1_BASE, TIMER_A);
     }
     while(ulTime2 > ulTime1);
@@ -2808,11 +3863,6 @@ SysTickIntHandler(void)
     static int watchDogState = 0;
     static short adcCount;
 
-    //
-    // Run the Hall module tick handler.
-    //
-    HallTickHandler();
-
     //
     // Run the ADC module tick handler.
     //
@@ -2823,6 +3873,23 @@ SysTickIntHandler(void)
     //
     UIEthernetTick(UI_TICK_US);
 
+    //
+    // Run the handpiece request timeouts.
+    //
+    ui_uart_tick(UI_TICK_MS);
+
+    //
+    // Count down the hold off between writes of the trigger calibration.
+    //
+    if(g_ulThrottleCalSaveHoldoff > UI_TICK_MS)
+    {
+        g_ulThrottleCalSaveHoldoff -= UI_TICK_MS;
+    }
+    else
+    {
+        g_ulThrottleCalSaveHoldoff = 0;
+    }
+
     //
     // Convert the ADC Analog Input reading to milli-volts.  Each volt at the
     // ADC input corresponds to ~20 volts at the Analog Input.
@@ -2901,264 +3968,734 @@ SysTickIntHandler(void)
         }
     }
 
-    
-    
-    // toggle the watch dog to keep main relay alive
-    watchDogState ^= 1;
-    if(watchDogState)
+    
+    
+    // toggle the watch dog to keep main relay alive
+    watchDogState ^= 1;
+    if(watchDogState)
+    {
+    	GPIOPinWrite(GPIO_PORTB_BASE, GPIO_PIN_5, 0);
+    }
+    else
+    {
+    	GPIOPinWrite(GPIO_PORTB_BASE, GPIO_PIN_5, GPIO_PIN_5);
+    }
+
+    //
+    // Update the mean execution time of the profiled interrupt handlers.
+    //
+    ISRProfileTick();
+
+    //
+    // Send real-time data, if appropriate.
+    //
+    if(g_ucDataComplete)
+    {
+        UIEthernetSendRealTimeData();
+    }
+
+    // incremment the operation if motor is running
+    if(g_ulMeasuredSpeed != 0)
+    	g_ulHPOpTicks++;
+}
+
+//
+//
+//
+//
+
+int UIGetHandPieceData()
+{
+	int i, iLength;
+	const unsigned char *rxData;
+	unsigned long ulTime;
+	unsigned short usTime;
+	unsigned char ucLost;
+
+	//take the latest stream frame, without waiting for one
+	iLength = ui_uart_stream(&rxData, &ulTime);
+	if(iLength == -1)
+	{
+		//time out in ~ 0.1 seconds, not counting while the handpiece
+		//is answering commands
+		if(ui_uart_stream_age() > HP_STREAM_TIMEOUT_MS)
+		{
+			g_ucHPInitDone = 0x00;
+			MainSetFault(FAULT_HP_COMM);
+			g_ucDataComplete = 1;
+		}
+		return(-1);
+	}
+
+	//the age of the reading, from when the handpiece started sending it
+	g_ulHPStreamAge = (UIGetTicks() - ulTime) / (SYSTEM_CLOCK / 1000000);
+
+	//count the frames lost since the previous one, and time the readings
+	//by the handpiece clock, if the handpiece numbers its frames
+	if(iLength >= HP_STREAM_SEQ_LENGTH)
+	{
+		usTime = rxData[15] | (rxData[16] << 8);
+		if(g_bHPStreamSeq)
+		{
+			ucLost = rxData[14] - g_ucHPStreamSeq - 1;
+			g_ulHPStreamDrops += ucLost;
+			g_ulHPStreamPeriod = (((unsigned short)(usTime - g_usHPStreamTime) *
+			                       HP_STREAM_TIME_US) / (ucLost + 1));
+		}
+		g_ucHPStreamSeq = rxData[14];
+		g_usHPStreamTime = usTime;
+		g_bHPStreamSeq = true;
+	}
+
+    for (i =0; i< 5; i++)
+    {
+    	g_ulRxDataInt[i] = rxData[i*2] | (rxData[i*2+1] << 8);
+
+    	//check for open or short reading, the maximum value of hall reading is 0x200
+    	if((g_ulRxDataInt[i] == 0))
+    	{
+    		g_ucDataComplete = 1;
+    		MainSetFault(FAULT_HP_A2D);
+    		return -1;
+    	}
+    }
+    
+    //swap 1.5 and 2.5 volts for backward compatibility
+    g_ulRxDataInt[6] = rxData[10] | (rxData[11] << 8);
+    g_ulRxDataInt[5] = rxData[12] | (rxData[13] << 8);
+
+	// added check polarity for the initial reading, unless it is already
+	// known for this handpiece
+	if(!initReadingDone && !g_bThrottleCalStored)
+	{
+		//initialize the polarity to default
+		handHallSpdPole = 0;
+
+		//reverse the polarity
+		for(i=0; i<UI_NUM_HALLS; i++)
+	    {
+		    if(g_ulRxDataInt[i+1] > HALL_POLARITY_THRD)
+		    {
+		    	handHallSpdPole = 1;
+		    	break;
+		    }
+	    }
+	}
+
+	// convert data
+	g_ucDataComplete = 0;
+	//check polarity
+	if(	handHallSpdPole == 1)
+	{
+		for( i = 0; i < UI_NUM_HALLS; i++)
+		{
+
+			if(g_ulRxDataInt[i+1] > 512 ) g_ulRxDataInt[i+1] = 512;
+			g_ulRxDataInt[i+1] = 512 - g_ulRxDataInt[i+1];
+
+		}
+	}
+
+    g_ucDataComplete = 1;
+
+    return 1;
+}
+
+
+//*****************************************************************************
+//
+//! Resets the calibration of the trigger hall sensors.
+//!
+//! This function starts the calibration of the trigger hall sensors over from
+//! the nominal sensor response, with the rest reading at #HALL_REST_READING
+//! and the peak reading #LIMIT_HALL_SPEED_RANGE below it.  The calibration is
+//! then refined by UIThrottleLearn() as the trigger is used.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIThrottleCalReset(void)
+{
+    unsigned long ulIdx;
+
+    //
+    // Set each sensor to the nominal response.
+    //
+    for(ulIdx = 0; ulIdx < UI_NUM_HALLS; ulIdx++)
+    {
+        g_sThrottleCal.pusHallRest[ulIdx] = HALL_REST_READING;
+        g_sThrottleCal.pusHallPeak[ulIdx] = (HALL_REST_READING -
+                                             LIMIT_HALL_SPEED_RANGE);
+    }
+
+    //
+    // The trigger is released.
+    //
+    g_usThrottlePosition = 0;
+}
+
+//*****************************************************************************
+//
+//! Refines the calibration of the trigger hall sensors.
+//!
+//! This function widens the rest and peak readings of each trigger hall
+//! sensor to include the latest reading from the handpiece.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIThrottleLearn(void)
+{
+    unsigned long ulIdx;
+
+    //
+    // Widen the range of each sensor to include its latest reading.
+    //
+    for(ulIdx = 0; ulIdx < UI_NUM_HALLS; ulIdx++)
+    {
+        if(g_ulRxDataInt[ulIdx + 1] > g_sThrottleCal.pusHallRest[ulIdx])
+        {
+            g_sThrottleCal.pusHallRest[ulIdx] = g_ulRxDataInt[ulIdx + 1];
+        }
+        if(g_ulRxDataInt[ulIdx + 1] < g_sThrottleCal.pusHallPeak[ulIdx])
+        {
+            g_sThrottleCal.pusHallPeak[ulIdx] = g_ulRxDataInt[ulIdx + 1];
+        }
+    }
+}
+
+//*****************************************************************************
+//
+//! Loads the calibration of the trigger hall sensors of a new handpiece.
+//!
+//! This function is called when a handpiece has been connected and its serial
+//! number read from its EEPROM.  If the calibration of the handpiece is in
+//! the flash store, it and the polarity of the sensors are used from the
+//! start; otherwise the calibration is reset to the nominal sensor response,
+//! and the polarity is found from the initial reading.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIThrottleCalLoad(void)
+{
+    unsigned long ulIdx;
+    unsigned char ucCrc, ucPolarity;
+
+    //
+    // Start from the nominal sensor response.
+    //
+    UIThrottleCalReset();
+    g_bThrottleCalStored = false;
+
+    //
+    // The serial number is only a usable key if its checksum is correct.
+    //
+    for(ulIdx = 0, ucCrc = 0; ulIdx < (UI_EE_DEFAULT_SIZE - 1); ulIdx++)
+    {
+        ucCrc = crc8_add(g_usEESerialNumber[ulIdx], ucCrc);
+    }
+    if(ucCrc != (unsigned char)g_usEESerialNumber[UI_EE_DEFAULT_SIZE - 1])
+    {
+        g_ulThrottleCalSerial = HPCAL_SERIAL_NONE;
+        return;
+    }
+    g_ulThrottleCalSerial = ((unsigned char)g_usEESerialNumber[0] |
+                             ((unsigned char)g_usEESerialNumber[1] << 8) |
+                             ((unsigned char)g_usEESerialNumber[2] << 16) |
+                             ((unsigned long)(unsigned char)
+                              g_usEESerialNumber[3] << 24));
+
+    //
+    // Use the stored calibration and polarity of this handpiece if there are
+    // any.
+    //
+    if(HPCalLoad(g_ulThrottleCalSerial, &g_sThrottleCal, &ucPolarity))
+    {
+        handHallSpdPole = ucPolarity;
+        g_bThrottleCalStored = true;
+    }
+}
+
+//*****************************************************************************
+//
+//! Stores the calibration of the trigger hall sensors of the handpiece.
+//!
+//! This function takes a copy of the calibration and sensor polarity of the
+//! connected handpiece to be saved in the flash store, so that they are used
+//! the next time it is connected.  The copy is written to flash later by
+//! UIThrottleCalUpdate(), replacing any copy that is still waiting.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIThrottleCalStore(void)
+{
+    //
+    // A handpiece with no usable serial number can not be stored.
+    //
+    if(g_ulThrottleCalSerial == HPCAL_SERIAL_NONE)
+    {
+        return;
+    }
+
+    //
+    // Queue the calibration to be saved.  From here on the polarity of this
+    // handpiece is known.
+    //
+    g_sThrottleCalSave = g_sThrottleCal;
+    g_ulThrottleCalSaveSerial = g_ulThrottleCalSerial;
+    g_ucThrottleCalSavePolarity = handHallSpdPole;
+    g_bThrottleCalSavePending = true;
+    g_bThrottleCalStored = true;
+}
+
+//*****************************************************************************
+//
+//! Writes the queued trigger calibration to the flash store.
+//!
+//! This function is called from the main loop.  The calibration queued by
+//! UIThrottleCalStore() is only written once the motor has stopped turning
+//! and the handpiece link is idle, since programming the flash stalls the
+//! processor, and no more than once every #THROTTLE_CAL_SAVE_MS
+//! milliseconds.  The store does not write to flash if the calibration has
+//! not changed.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+UIThrottleCalUpdate(void)
+{
+    //
+    // Wait for a queued calibration, a stopped motor, an idle handpiece link
+    // and the end of the hold off from the last write.
+    //
+    if(!g_bThrottleCalSavePending || MainIsRunning() ||
+       (g_ulMeasuredSpeed != 0) || !ui_uart_idle() ||
+       (g_ulThrottleCalSaveHoldoff != 0))
+    {
+        return;
+    }
+
+    //
+    // Write the calibration, and hold off the next write.
+    //
+    HPCalSave(g_ulThrottleCalSaveSerial, &g_sThrottleCalSave,
+              g_ucThrottleCalSavePolarity);
+    g_bThrottleCalSavePending = false;
+    g_ulThrottleCalSaveHoldoff = THROTTLE_CAL_SAVE_MS;
+}
+
+//*****************************************************************************
+//
+//! Decodes the position of the trigger from the trigger hall sensors.
+//!
+//! This function converts the latest reading of each trigger hall sensor
+//! into the strength of the magnet at that sensor, from zero at its rest
+//! reading to 4096 at its peak reading.  The sensors lie
+//! #THROTTLE_HALL_SPACING apart along the travel of the trigger, and the
+//! magnet lies between the strongest sensor and the stronger of its
+//! neighbors, at a position given by interpolating between the two sensors
+//! weighted by their strengths.  #g_usThrottlePosition then follows this
+//! position with a hysteresis of #THROTTLE_HYSTERESIS, so that the noise of
+//! the sensors does not move the speed of the motor.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIThrottleDecode(void)
+{
+    unsigned long ulIdx, ulNear, ulNext, ulSpan, pulStrength[UI_NUM_HALLS];
+    long lPos;
+
+    //
+    // Find the strength of the magnet at each sensor, and the strongest
+    // sensor.
+    //
+    ulNear = 0;
+    for(ulIdx = 0; ulIdx < UI_NUM_HALLS; ulIdx++)
+    {
+        ulSpan = (g_sThrottleCal.pusHallRest[ulIdx] -
+                  g_sThrottleCal.pusHallPeak[ulIdx]);
+        if(ulSpan < LIMIT_HALL_SPEED_RANGE)
+        {
+            ulSpan = LIMIT_HALL_SPEED_RANGE;
+        }
+        if(g_ulRxDataInt[ulIdx + 1] >= g_sThrottleCal.pusHallRest[ulIdx])
+        {
+            pulStrength[ulIdx] = 0;
+        }
+        else
+        {
+            pulStrength[ulIdx] = (((g_sThrottleCal.pusHallRest[ulIdx] -
+                                    g_ulRxDataInt[ulIdx + 1]) * 4096) /
+                                  ulSpan);
+            if(pulStrength[ulIdx] > 4096)
+            {
+                pulStrength[ulIdx] = 4096;
+            }
+        }
+        if(pulStrength[ulIdx] > pulStrength[ulNear])
+        {
+            ulNear = ulIdx;
+        }
+    }
+
+    //
+    // Find the stronger neighbor of the strongest sensor.
+    //
+    if(ulNear == 0)
+    {
+        ulNext = 1;
+    }
+    else if((ulNear == (UI_NUM_HALLS - 1)) ||
+            (pulStrength[ulNear - 1] > pulStrength[ulNear + 1]))
+    {
+        ulNext = ulNear - 1;
+    }
+    else
+    {
+        ulNext = ulNear + 1;
+    }
+
+    //
+    // Leave the position unchanged if no sensor sees the magnet.
+    //
+    if((pulStrength[ulNear] + pulStrength[ulNext]) == 0)
+    {
+        return;
+    }
+
+    //
+    // Interpolate between the two sensors, weighted by their strengths.
+    //
+    lPos = ulNear * THROTTLE_HALL_SPACING;
+    lPos += ((((long)ulNext - (long)ulNear) * THROTTLE_HALL_SPACING *
+              (long)pulStrength[ulNext]) /
+             (long)(pulStrength[ulNear] + pulStrength[ulNext]));
+
+    //
+    // Move the throttle position to within the hysteresis of the decoded
+    // position.
+    //
+    if(lPos > ((long)g_usThrottlePosition + THROTTLE_HYSTERESIS))
+    {
+        g_usThrottlePosition = lPos - THROTTLE_HYSTERESIS;
+    }
+    else if((lPos + THROTTLE_HYSTERESIS) < (long)g_usThrottlePosition)
+    {
+        g_usThrottlePosition = lPos + THROTTLE_HYSTERESIS;
+    }
+}
+
+//*****************************************************************************
+//
+//! Computes the target speed from the trigger position.
+//!
+//! \param iThrottle is the speed step of the trigger, from zero when released
+//! to #UI_NUM_SPEED when fully pressed.
+//!
+//! This function scales the continuous trigger position between
+//! #THROTTLE_STOP and #THROTTLE_FULL into a target speed between
+//! #UI_BASE_SPEED and #UI_MAX_SPEED, limited to the minimum and maximum
+//! speed parameters.  The speed step decides whether the trigger is
+//! released or fully pressed, so that the fall back used when trigger hall
+//! sensors have failed (and the foot pedal) still work.
+//!
+//! \return Returns the target speed, specified in RPM.
+//
+//*****************************************************************************
+static unsigned long
+UIThrottleSpeed(int iThrottle)
+{
+    unsigned long ulPos, ulSpeed;
+
+    //
+    // The motor is stopped if the trigger is released.
+    //
+    if(iThrottle == 0)
+    {
+        return(0);
+    }
+
+    //
+    // Scale the trigger position into the speed range, giving full speed if
+    // the trigger is fully pressed.
+    //
+    ulPos = g_usThrottlePosition;
+    if((iThrottle >= UI_NUM_SPEED) || (ulPos > THROTTLE_FULL))
     {
-    	GPIOPinWrite(GPIO_PORTB_BASE, GPIO_PIN_5, 0);
+        ulPos = THROTTLE_FULL;
     }
-    else
+    if(ulPos < THROTTLE_STOP)
     {
-    	GPIOPinWrite(GPIO_PORTB_BASE, GPIO_PIN_5, GPIO_PIN_5);
+        ulPos = THROTTLE_STOP;
     }
+    ulSpeed = (UI_BASE_SPEED +
+               (((ulPos - THROTTLE_STOP) * (UI_MAX_SPEED - UI_BASE_SPEED)) /
+                (THROTTLE_FULL - THROTTLE_STOP)));
 
     //
-    // Send real-time data, if appropriate.
+    // Limit the speed to the minimum and maximum speeds.
     //
-    if(g_ucDataComplete)
+    if(ulSpeed < g_sParameters.ulMinSpeed)
     {
-        UIEthernetSendRealTimeData();
+        ulSpeed = g_sParameters.ulMinSpeed;
     }
-
-    // incremment the operation if motor is running
-    if(g_ulMeasuredSpeed != 0)
-    	g_ulHPOpTicks++;
+    if(ulSpeed > g_sParameters.ulMaxSpeed)
+    {
+        ulSpeed = g_sParameters.ulMaxSpeed;
+    }
+    return(ulSpeed);
 }
 
+//*****************************************************************************
 //
+//! The commands sent to a handpiece when it is connected, in the order that
+//! they are sent, and where each reply is kept.  The serial number is read
+//! first, as that also puts the handpiece into host command mode.  The eeprom
+//! locations are read next, then the link settings are sent if any have been
+//! set, and last the handpiece is put back in streaming mode.
 //
-//
-//
-
-int UIGetHandPieceData()
+//*****************************************************************************
+typedef struct
 {
-	int i,rLen;
-	unsigned long tStart = UIGetTicks();
+	unsigned char ucCmd;
+	unsigned char ucAddr;
+	char *pcData;
+	int iSize;
+}
+tHPInitStep;
 
-	//wait for reply
-	do
-	{
-		//time out in ~ 0.1 seconds
-		if(UIGetTicks() - tStart > 5000000)
-		{
-			g_ucHPInitDone = 0x00;
-			MainSetFault(FAULT_HP_COMM);
-			g_ucDataComplete = 1;
-			return(-1);
-		}
-		rLen = ui_uart_receive(rxData,NULL);
+//the handpiece commands used to initialize it
+#define HP_CMD_STREAM 0x00
+#define HP_CMD_READ 0x81
+#define HP_CMD_LINK 0x85
 
-		// give a little delay ~1 ms
-		SysCtlDelay(20000);
+//the reply to the link command, which is the baud rate (as a value of
+//ucHPBaud) and the stream rate that the handpiece will use
+#define HP_LINK_SIZE 3
+static char g_pcHPLink[HP_LINK_SIZE];
 
-	}while(rLen ==-1);
+static const tHPInitStep g_psHPInitStep[] =
+{
+	{ HP_CMD_READ, 0x00, g_usEESerialNumber, UI_EE_DEFAULT_SIZE },
+	{ HP_CMD_READ, 0x01, g_usEEOrigin, UI_EE_CONST_SIZE },
+	{ HP_CMD_READ, 0x02, g_usEEAxis, UI_EE_CONST_SIZE },
+	{ HP_CMD_READ, 0x15, g_usEENormal, UI_EE_CONST_SIZE },
+	{ HP_CMD_READ, 0x03, g_usHPOpTimeStr, UI_EE_DEFAULT_SIZE },
+	{ HP_CMD_READ, 0x04, g_usHPError, UI_EE_DEFAULT_SIZE },
+	{ HP_CMD_READ, 0x16, g_usFirmwareVersionH, FIRMWARE_VER_LENGTH },
+	{ HP_CMD_LINK, 0x00, g_pcHPLink, HP_LINK_SIZE },
+	{ HP_CMD_STREAM, 0x00, NULL, 0 }
+};
+#define HP_INIT_NUM_STEPS (sizeof(g_psHPInitStep) / sizeof(g_psHPInitStep[0]))
 
-    for (i =0; i< 5; i++)
-    {
-    	g_ulRxDataInt[i] = *((unsigned short*)rxData+i);
+//the handpiece initialization step that sends the link settings, which is
+//only taken if a baud rate or stream rate has been set, or the link has to
+//be moved back to 115,200 baud, since a handpiece that does not know the
+//link command only fails it by timing out
+#define HP_INIT_LINK (HP_INIT_NUM_STEPS - 2)
+#define HP_INIT_LINK_WANTED() ((g_sParameters.ucHPBaud != HP_BAUD_115200) || \
+                               (g_sParameters.usHPStreamRate != 0) ||       \
+                               (g_ucHPLinkBaud != HP_BAUD_115200))
 
-    	//check for open or short reading, the maximum value of hall reading is 0x200
-    	if((g_ulRxDataInt[i] == 0))
-    	{
-    		g_ucDataComplete = 1;
-    		MainSetFault(FAULT_HP_A2D);
-    		return -1;
-    	}
-    }
-    
-    //swap 1.5 and 2.5 volts for backward compatibility
-    g_ulRxDataInt[6] = *((unsigned short*)rxData+5);
-    g_ulRxDataInt[5] = *((unsigned short*)rxData+6);
+//the handpiece initialization step that puts it back in streaming mode
+#define HP_INIT_STREAM (HP_INIT_NUM_STEPS - 1)
 
-	// added check polarity for the initial reading
-	if(!initReadingDone)
-	{
-		//initialize the polarity to default
-		handHallSpdPole = 0;
+//set when a step of the handpiece initialization has failed
+static char g_ucHPInitFailed = 0x00;
 
-		//reverse the polarity
-		for(i=0; i<UI_NUM_HALLS; i++)
-	    {
-		    if(g_ulRxDataInt[i+1] > HALL_POLARITY_THRD)
-		    {
-		    	handHallSpdPole = 1;
-		    	break;
-		    }
-	    }
-	}
+//the number of attempts to read the serial number of the handpiece
+static int g_iHPInitRetry = 0;
 
-	// convert data
-	g_ucDataComplete = 0;
-	//check polarity
-	if(	handHallSpdPole == 1)
-	{
-		for( i = 0; i < UI_NUM_HALLS; i++)
-		{
+static void UIHPInitReply(void *pvCBData, int iLength);
 
-			if(g_ulRxDataInt[i+1] > 512 ) g_ulRxDataInt[i+1] = 512;
-			g_ulRxDataInt[i+1] = 512 - g_ulRxDataInt[i+1];
+//*****************************************************************************
+//
+//! Queues a step of the handpiece initialization.
+//!
+//! \param ulStep is the step, which is an index into g_psHPInitStep[].  The
+//! address of its entry is the callback data of the request.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void UIHPInitRead(unsigned long ulStep)
+{
+	unsigned char pucCmd[6];
+	int iLength;
 
-		}
+	pucCmd[0] = 0xFF;
+	pucCmd[2] = g_psHPInitStep[ulStep].ucCmd;
+	if(pucCmd[2] == HP_CMD_LINK)
+	{
+		//ask for the baud rate, unless a change of baud rate has already
+		//lost this handpiece, and for the stream rate
+		pucCmd[1] = 0x07;
+		pucCmd[3] = (g_bHPLinkFallback ? HP_BAUD_115200 :
+		            g_sParameters.ucHPBaud);
+		pucCmd[4] = g_sParameters.usHPStreamRate & 0xff;
+		pucCmd[5] = g_sParameters.usHPStreamRate >> 8;
+		iLength = 6;
+	}
+	else
+	{
+		//read the eeprom location, or set handpiece in streaming mode
+		pucCmd[1] = 0x05;
+		pucCmd[3] = g_psHPInitStep[ulStep].ucAddr;
+		iLength = 4;
+	}
+	if(ui_uart_request((const char *)pucCmd, iLength,
+	                   g_psHPInitStep[ulStep].pcData,
+	                   g_psHPInitStep[ulStep].iSize, UIHPInitReply,
+	                   (void *)&g_psHPInitStep[ulStep]) == -1)
+	{
+		UIHPInitReply((void *)&g_psHPInitStep[ulStep], -1);
 	}
-
-    g_ucDataComplete = 1;
-
-    return 1;
 }
 
-
-void initHandPiece(void)
+//*****************************************************************************
+//
+//! Moves the handpiece link to one of the baud rates of ucHPBaud.
+//!
+//! \param ucBaud is the baud rate, as a value of ucHPBaud.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void UIHPLinkBaud(unsigned char ucBaud)
 {
-	int i;
-	int cnt = 0;
-	char EECmdBuf[UI_EE_CONST_SIZE];
+	//if the link is still sending, the baud rate is left as it is, so the
+	//handpiece is lost and is then reset to bring it back
+	g_ucHPLinkBaud = ucBaud;
+	ui_uart_set_baud(g_pulHPBaud[ucBaud]);
+}
 
-	//first, check if this function is already called
-	if(g_ucHPInitStart) return;
+//*****************************************************************************
+//
+//! Completes a step of the handpiece initialization.
+//!
+//! This function is called when the handpiece replies to one of the commands
+//! queued by UIHPInitRead(), or fails to.  When the serial number has been
+//! read, the rest of the eeprom locations are read and the link settings, if
+//! any, are sent; once the handpiece has replied to those, it is put back in
+//! streaming mode, which completes the initialization.
+//!
+//! \param pvCBData is the entry of g_psHPInitStep[] for the step.
+//! \param iLength is the length of the reply, or -1 if there was none.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void UIHPInitReply(void *pvCBData, int iLength)
+{
+	unsigned long ulStep, ulIdx;
 
+	//the callback data is the entry of g_psHPInitStep[] for the step
+	ulStep = (const tHPInitStep *)pvCBData - g_psHPInitStep;
 
-	//check if user reset command is received, if so start rest sequence
+	//a reset of the handpiece abandons this initialization
+	if(!g_ucHPInitStart)
+	{
+		return;
+	}
 
-	if(g_ucHPReset != 0)
+	if(iLength == -1)
 	{
-		if(g_ucHPReset++ == 1)
+		// loop here until there is a connection, which for a new
+		// handpiece is at the default baud rate
+		if(ulStep == 0)
 		{
-			ExpandedIOUpdate(EXPANDEDIO_PORTB,EXPANDEDIO_HOLD_HANDPIECE);
+			if(g_iHPInitRetry++ > 5)
+				MainSetFault(FAULT_HP_COMM);
+			UIHPLinkBaud(HP_BAUD_115200);
+			UIHPInitRead(0);
 			return;
 		}
 
-		if(g_ucHPReset == HP_RESET_CNT)
+		//a handpiece that does not know the link command keeps its
+		//default settings
+		if(ulStep == HP_INIT_LINK)
 		{
-			ExpandedIOUpdate(EXPANDEDIO_PORTB,EXPANDEDIO_RELEASE_HANDPIECE);
-			ExpandedIOUpdate(EXPANDEDIO_PORTA,EXPANDEDIO_RELAY_ENABLE | EXPANDEDIO_IRRIGATION_DISABLE | EXPANDEDIO_CUTTER_DISABLED);
-			g_ucHPReset = 0;
-			initReadingDone = 0x00;
-			g_ucHPInitDone = 0x00;
+			UIHPInitRead(HP_INIT_STREAM);
+			return;
 		}
-		else
+
+		//if the handpiece was lost when its baud rate was changed, reset
+		//it to bring it back at the default baud rate, and leave it there
+		if((ulStep == HP_INIT_STREAM) && (g_ucHPLinkBaud != HP_BAUD_115200))
 		{
+			UIHPLinkBaud(HP_BAUD_115200);
+			g_bHPLinkFallback = true;
+			g_ucHPReset = 1;
+			g_ucHPInitStart = 0x00;
 			return;
 		}
-	}
-
-	//fisrt set start flag
-	g_ucHPInitStart = 0x01;
-
-	//
-	// now start reading handpiece information,
-	// handpiece start in host command mode,
-	//
-
-	//read serial number, this is a fixed number once it is set during production
-	EECmdBuf[0]=0xFF;
-	EECmdBuf[1]=0x05;
-	EECmdBuf[2]=0x81;
-	EECmdBuf[3]=0x00;
-	// loop here until there is a connection
-	while (ui_uart_ucmd(EECmdBuf, 4)==-1)
-	{
-	    if(cnt ++ > 5)
-	        MainSetFault(FAULT_HP_COMM);
-	}
 
-	memcpy(g_usEESerialNumber, EECmdBuf, UI_EE_DEFAULT_SIZE);
-
-	//read ee origin
-	EECmdBuf[0]=0xFF;
-	EECmdBuf[1]=0x05;
-	EECmdBuf[2]=0x81;
-	EECmdBuf[3]=0x01;
-	if(ui_uart_ucmd(EECmdBuf, 4)==-1)
-	{
-		MainSetFault(FAULT_HP_COMM);
+		//the rest of the steps are ignored
+		if(!g_ucHPInitFailed)
+		{
+			g_ucHPInitFailed = 0x01;
+			MainSetFault(FAULT_HP_COMM);
+		}
 		return;
 	}
-
-	memcpy(g_usEEOrigin, EECmdBuf, UI_EE_CONST_SIZE);
-
-	//read ee axis
-	EECmdBuf[0]=0xFF;
-	EECmdBuf[1]=0x05;
-	EECmdBuf[2]=0x81;
-	EECmdBuf[3]=0x02;
-	if(ui_uart_ucmd(EECmdBuf, 4)==-1)
+	if(g_ucHPInitFailed)
 	{
-		MainSetFault(FAULT_HP_COMM);
 		return;
 	}
 
-	memcpy(g_usEEAxis, EECmdBuf, UI_EE_CONST_SIZE);
-
-	//read ee normal
-	EECmdBuf[0]=0xFF;
-	EECmdBuf[1]=0x05;
-	EECmdBuf[2]=0x81;
-	EECmdBuf[3]=0x15;
-	if(ui_uart_ucmd(EECmdBuf, 4)==-1)
+	//there is a handpiece, read the rest and send the link settings, if
+	//there are any, or else put it back in streaming mode
+	if(ulStep == 0)
 	{
-		MainSetFault(FAULT_HP_COMM);
+		for(ulIdx = 1; ulIdx < HP_INIT_LINK; ulIdx++)
+		{
+			UIHPInitRead(ulIdx);
+		}
+		UIHPInitRead(HP_INIT_LINK_WANTED() ? HP_INIT_LINK : HP_INIT_STREAM);
 		return;
 	}
 
-	memcpy(g_usEENormal, EECmdBuf, UI_EE_CONST_SIZE);
-
-	//read operating time, this is used as an initial value to calculate
-	// the operating time, it is written to handpiece every time the burr is stopping
-	g_usHPOpTimeStr[0]=0xFF;
-	g_usHPOpTimeStr[1]=0x05;
-	g_usHPOpTimeStr[2]=0x81;
-	g_usHPOpTimeStr[3]=0x03;
-	if(ui_uart_ucmd(g_usHPOpTimeStr, 4)==-1)
-	{
-		MainSetFault(FAULT_HP_COMM);
-		return;
-	}
-	g_ulHPOpTime = *(unsigned long *)g_usHPOpTimeStr;
-
-	//read error code, it is a four byte code,
-	//each byte represent a indivisual error,
-	//so there are four error code history can be
-	//saved
-	g_usHPError[0]=0xFF;
-	g_usHPError[1]=0x05;
-	g_usHPError[2]=0x81;
-	g_usHPError[3]=0x04;
-	if(ui_uart_ucmd(g_usHPError, 4)==-1)
+	//the handpiece replies to the link command at the old baud rate, then
+	//changes to the one in the reply, and then it is set in streaming mode
+	if(ulStep == HP_INIT_LINK)
 	{
-		MainSetFault(FAULT_HP_COMM);
+		if((iLength >= HP_LINK_SIZE) &&
+		   ((unsigned char)g_pcHPLink[0] <= HP_BAUD_921600))
+		{
+			UIHPLinkBaud(g_pcHPLink[0]);
+		}
+		UIHPInitRead(HP_INIT_STREAM);
 		return;
 	}
 
-	//read handpiece firmware version
-	g_usFirmwareVersionH[0]=0xFF;
-	g_usFirmwareVersionH[1]=0x05;
-	g_usFirmwareVersionH[2]=0x81;
-	g_usFirmwareVersionH[3]=0x16;
-	if(ui_uart_ucmd(g_usFirmwareVersionH, 4) ==-1)
+	if(ulStep != HP_INIT_STREAM)
 	{
-		MainSetFault(FAULT_HP_COMM);
+		//the operating time is used as an initial value to calculate the
+		//operating time, it is written to handpiece every time the burr is
+		//stopping
+		if(g_psHPInitStep[ulStep].pcData == g_usHPOpTimeStr)
+		{
+			g_ulHPOpTime = *(unsigned long *)g_usHPOpTimeStr;
+		}
 		return;
 	}
 
-	//Now we finished all intial reading, set handpiece in streaming mode
-	tStr[0]=0xFF;
-	tStr[1]=0x05;
-	tStr[2]=0x00;
-	tStr[3]=0x00;
-	if(ui_uart_ucmd(tStr, 4)==-1)
-	{
-		MainSetFault(FAULT_HP_COMM);
-		return;
-	}
+	//the handpiece numbers its stream frames afresh
+	g_bHPStreamSeq = false;
 
-	//intiailize some intital min and max value
-	for (i =0; i< UI_NUM_HALLS; i++)
-	{
-		g_ucHallMin[i] = 999;
-		g_ucHallMax[i] = 0;
-	}
+	//Now we finished all intial reading, start the trigger calibration from
+	//the stored calibration of this handpiece, or from the nominal sensor
+	//response if it is a new one
+	UIThrottleCalLoad();
 
 	//clear the communication error
 	if(g_ulFaultFlags == FAULT_HP_COMM)
@@ -3173,6 +4710,52 @@ void initHandPiece(void)
 	initReadingDone = 0;
 }
 
+void initHandPiece(void)
+{
+	//first, check if this function is already called
+	if(g_ucHPInitStart) return;
+
+
+	//check if user reset command is received, if so start rest sequence
+
+	if(g_ucHPReset != 0)
+	{
+		if(g_ucHPReset++ == 1)
+		{
+			ExpandedIOUpdate(EXPANDEDIO_PORTB,EXPANDEDIO_HOLD_HANDPIECE);
+			return;
+		}
+
+		if(g_ucHPReset == HP_RESET_CNT)
+		{
+			ExpandedIOUpdate(EXPANDEDIO_PORTB,EXPANDEDIO_RELEASE_HANDPIECE);
+			ExpandedIOUpdate(EXPANDEDIO_PORTA,EXPANDEDIO_RELAY_ENABLE | EXPANDEDIO_IRRIGATION_DISABLE | EXPANDEDIO_CUTTER_DISABLED);
+			g_ucHPReset = 0;
+			initReadingDone = 0x00;
+			g_ucHPInitDone = 0x00;
+
+			//the handpiece comes out of reset at the default baud rate
+			UIHPLinkBaud(HP_BAUD_115200);
+		}
+		else
+		{
+			return;
+		}
+	}
+
+	//fisrt set start flag
+	g_ucHPInitStart = 0x01;
+	g_ucHPInitFailed = 0x00;
+	g_iHPInitRetry = 0;
+
+	//
+	// now start reading handpiece information, the reads are queued and
+	// completed by UIHPInitReply(), so the main loop carries on meanwhile.
+	// handpiece start in host command mode,
+	//
+	UIHPInitRead(0);
+}
+
 //*****************************************************************************
 //
 //! Initializes the user interface.
@@ -3273,34 +4856,30 @@ UIInit(void)
 
 //*****************************************************************************
 //
-//! Get speed throttle position from the hand piece, it is in a discrete step format.
+//! Get speed throttle position from the hand piece.
 //!
-//! This function calculate speed from speed hall sensors, it is used when there is no fault
-//! on the hall sensor.
+//! This function decodes the continuous trigger position into
+//! #g_usThrottlePosition from the speed hall sensors, and returns it as a
+//! speed step for the start and stop decisions.  When hall sensors have
+//! failed, the speed step falls back to released or fully pressed.
 //!
-//! \return None.
+//! \return Returns the speed step, from zero to #UI_NUM_SPEED.
 //
 //*****************************************************************************
 
 int getThrottleSpeed(unsigned long *initHallReading)
 {
-	//unsigned long hallReadingSum;
 	int tSpeedThrottle =0;
 	int tHallMin =9999;
 	int tIndex = 0;
-	unsigned int tHall;
 	int hallSpacing = 0;
 	static int hallMissCnt = 0;
 	int i;
 	int lInt,lZeroIndex,lFullSpeedIndex;
-	
-	hallReadingSum = 0;
 
 	//check halllsensors for error
 	for( i =0; i<UI_NUM_HALLS; i++)
 	{
-		tHall = 0;
-
 		// if the hall reading is too large or too small return error
 		if(g_ulRxDataInt[i+1] > LIMIT_HALL_SPEED_HIGH)
 		{
@@ -3402,60 +4981,52 @@ int getThrottleSpeed(unsigned long *initHallReading)
 	{
 		for( i =0; i<UI_NUM_HALLS; i++)
 		{
-			tHall = 0;
-
 			//find the hall number which has the smallest reading
 			if(g_ulRxDataInt[i+1] < tHallMin )
 			{
 				tHallMin = g_ulRxDataInt[i+1];
 				tIndex = i;
 			}
-
-			//update hall min/max if neccessary
-			if(g_ulRxDataInt[i+1] < g_ucHallMin[i])
-			{
-				g_ucHallMin[i] = g_ulRxDataInt[i+1];
-			}
-			if(g_ulRxDataInt[i+1] > g_ucHallMax[i])
-			{
-				g_ucHallMax[i] = g_ulRxDataInt[i+1];
-			}
-
-			// calculate the sum of halls
-			if(g_ulRxDataInt[i+1] > g_ucHallMin[i])
-			{
-				tHall = g_ulRxDataInt[i+1] - g_ucHallMin[i];
-			}
-			hallReadingSum |=  tHall << ((3-i)*7);
-
 		}
 
 		//update minimum hall reading index
 		g_ucInitHallReading[5] = tIndex;
 
-		//calculate speed
-		hallReadingSum = hallReadingSum - initHallReading[2];
-		tSpeedThrottle = hallReadingSum / initHallReading[4];
+		//refine the sensor calibration and decode the trigger position
+		UIThrottleLearn();
+		UIThrottleDecode();
 
+		//convert the trigger position into a speed step
+		if(g_usThrottlePosition < THROTTLE_STOP)
+		{
+			tSpeedThrottle = 0;
+		}
+		else
+		{
+			tSpeedThrottle = 1 + ((g_usThrottlePosition - THROTTLE_STOP) *
+			                      (UI_NUM_SPEED - 1)) /
+			                     (THROTTLE_FULL - THROTTLE_STOP);
+		}
 
-		//check zero speed
+		//check zero speed, which needs the trigger pressed further to
+		//start the motor than to keep it running
 		if( MainIsRunning())
 		{
-			if( ((g_ulRxDataInt[2] -  g_ulRxDataInt[1]) > 20 ) && (tIndex == 0) )
+			if(g_usThrottlePosition < THROTTLE_STOP)
 			{
 				tSpeedThrottle = 0;
 			}
 		}
 		else
 		{
-			if (tIndex ==0)
+			if(g_usThrottlePosition < THROTTLE_START)
 			{
 				tSpeedThrottle = 0;
 			}
 		}
 
-		//maintain maximum speed wheen the magnet is no top of last hall
-		if(tIndex ==3)
+		//maintain maximum speed when the magnet is near the last hall
+		if(g_usThrottlePosition >= THROTTLE_FULL)
 		{
 			tSpeedThrottle = UI_NUM_SPEED;
 		}
@@ -3516,8 +5087,6 @@ int getInitHallReading()
 	int tempMin= 9999, tempMax= 0;
 	int tempIndex= 0;
 	
-	g_ucInitHallReading[2] = 0;
-	
 	// do not proceed all hall reading are zeros, just wait for next cycle
 	if(g_ulRxDataInt[0] ==0) {return -1;}
 	
@@ -3540,7 +5109,7 @@ int getInitHallReading()
 	//get min/max
 	for(i=0; i<UI_NUM_HALLS; i++)
 	{
-	    if(!(g_ucTriggerHallStatus && (0x01 << i)))
+	    if(!(g_ucTriggerHallStatus & (0x01 << i)))
 	    {
 	        if(g_ulRxDataInt[i+1] < tempMin)
 	        {
@@ -3557,8 +5126,15 @@ int getInitHallReading()
 	
 	if (g_sParameters.usCutType==0 )
 	{
-	//add a check to insure the trigger is fully released to start
-    if(tempIndex != 0)
+	//add a check to insure the trigger is fully released to start, a
+	//handpiece with a stored calibration can decode a held trigger, so
+	//it just waits for the trigger to be released
+	if(g_bThrottleCalStored)
+	{
+		UIThrottleDecode();
+		if(g_usThrottlePosition >= THROTTLE_START) return -1;
+	}
+    else if(tempIndex != 0)
     {
     	MainSetFault(FAULT_HALL_INIT);
     	return -1;
@@ -3585,20 +5161,9 @@ int getInitHallReading()
 		}
 	}
 	
-	//get total hall reading range by forming two 28 bit intergers, every hall takes 7 bits,
-	//It is assume that the low/high readings of all the hall sensors are close to each other
-	g_ucInitHallReading[2] = 0;
-	g_ucInitHallReading[3] = 0;
-	
-	for(i=0; i<UI_NUM_HALLS; i++)
-	{
-		g_ucInitHallReading[2] |= (g_ulRxDataInt[i+1] - g_ucInitHallReading[0]) << ((3-i)*7); 	
-		g_ucInitHallReading[3] |= (g_ulRxDataInt[i+1] - g_ucInitHallReading[0]) << (i*7);
-	}
-	
-	
-	// get hall spacing
-	g_ucInitHallReading[4] = (g_ucInitHallReading[3] - g_ucInitHallReading[2])/ UI_NUM_SPEED;
+	//the trigger position is decoded from the calibration of each sensor
+	//by getThrottleSpeed(), so fold this reading into the calibration
+	UIThrottleLearn();
 	
 	g_ucInitHallReading[5] = tempIndex;
 	
@@ -3633,6 +5198,8 @@ void UICheckAndSetSpeed(void)
     {
         if(getInitHallReading() == -1) return;
     	initReadingDone =1;
+    	//keep the calibration of a new handpiece for its next connection
+    	UIThrottleCalStore();
     	return;
     }
     
@@ -3651,34 +5218,8 @@ void UICheckAndSetSpeed(void)
 	{
 		cutterOverrideStatus = 0; //clear status bit once override is cleared
 		g_ucSpeedThrottle = getThrottleSpeed(g_ucInitHallReading);
-		// set speed
-			if(g_ucSpeedThrottle ==0)
-			{
-				 g_sParameters.ulTargetSpeed = 0;
-			}
-			else
-			{
-				 g_sParameters.ulTargetSpeed = UI_BASE_SPEED + (g_ucSpeedThrottle-1) *
-											   (UI_MAX_SPEED- UI_BASE_SPEED)/(UI_NUM_SPEED-1);
-				 //set to minimum speed if the commanded speed is too low
-				 if(g_sParameters.ulTargetSpeed < g_sParameters.ulMinSpeed)
-				 {
-					 g_sParameters.ulTargetSpeed = g_sParameters.ulMinSpeed;
-				 }
-				 //also clip on the maximum speed as well
-				 if(g_sParameters.ulTargetSpeed > g_sParameters.ulMaxSpeed)
-				 {
-					 g_sParameters.ulTargetSpeed = g_sParameters.ulMaxSpeed;
-				 }
-			}
-
-			//change the integral when the command speed is above the switch speed
-			if((g_sParameters.ulTargetSpeed  > UI_GAIN_SWITCH_SPEED) &&
-					(g_ucIntegralGainChanged == 0x00))
-			{
-				g_lFAdjI = g_sParameters.lPAdjI;
-				g_ucIntegralGainChanged = 0x01;
-			}
+		// set speed from the continuous trigger position
+		g_sParameters.ulTargetSpeed = UIThrottleSpeed(g_ucSpeedThrottle);
 
 			//check handpiece trigger board for voltage errors
 			if(g_ulRxDataInt[5] > LIMIT_HP_VOLTAGE1_COUNT + LIMIT_HP_VOLTAGE_NOISE ||
@@ -3720,34 +5261,8 @@ void UICheckAndSetSpeed(void)
 
     	if (cutterOverrideStatus==1){
     		g_ucSpeedThrottle=g_triggerInfo;
-    		// set speed
-    		    if(g_ucSpeedThrottle ==0)
-    		    {
-    		         g_sParameters.ulTargetSpeed = 0;
-    		    }
-    		    else
-    		    {
-    		    	 g_sParameters.ulTargetSpeed = UI_BASE_SPEED + (g_ucSpeedThrottle-1) *
-    		    	                               (UI_MAX_SPEED- UI_BASE_SPEED)/(UI_NUM_SPEED-1);
-    		    	 //set to minimum speed if the commanded speed is too low
-    		    	 if(g_sParameters.ulTargetSpeed < g_sParameters.ulMinSpeed)
-    		    	 {
-    		    		 g_sParameters.ulTargetSpeed = g_sParameters.ulMinSpeed;
-    		    	 }
-    		    	 //also clip on the maximum speed as well
-    		    	 if(g_sParameters.ulTargetSpeed > g_sParameters.ulMaxSpeed)
-    		    	 {
-    		    		 g_sParameters.ulTargetSpeed = g_sParameters.ulMaxSpeed;
-    		    	 }
-    		    }
-
-    		    //change the integral when the command speed is above the switch speed
-    		    if((g_sParameters.ulTargetSpeed  > UI_GAIN_SWITCH_SPEED) &&
-    		    		(g_ucIntegralGainChanged == 0x00))
-    		    {
-    		    	g_lFAdjI = g_sParameters.lPAdjI;
-    		    	g_ucIntegralGainChanged = 0x01;
-    		    }
+    		// set speed from the continuous trigger position
+    		g_sParameters.ulTargetSpeed = UIThrottleSpeed(g_ucSpeedThrottle);
 
     		    //check handpiece trigger board for voltage errors
     			if(g_ulRxDataInt[5] > LIMIT_HP_VOLTAGE1_COUNT + LIMIT_HP_VOLTAGE_NOISE ||
@@ -3781,7 +5296,9 @@ void UICheckAndSetSpeed(void)
     			{
     			    //do not report error is cutter is disabled
     			    if( GPIOPinRead(GPIO_PORTB_BASE, CUTTER_ENABLE_BIT) )
+    			    {
     			        MainSetFault(FAULT_MOTOR_SHORT);
+    			    }
     				phaseShortCnt = 0;
     			}
     			return;
@@ -3803,15 +5320,10 @@ void UICheckAndSetSpeed(void)
     		g_ucMotorStarted = 1;
 
 
-    	// check and run the motor if trigger is pressed
-    	if(((g_ucSpeedThrottle > 0 && MainIsRunning() == 0)))
+    	// check and run the motor if trigger is pressed, but not while
+    	// the handpiece is answering commands and has stopped streaming
+    	if(((g_ucSpeedThrottle > 0 && MainIsRunning() == 0)) && !ui_uart_busy())
     	{
-    		//reset the integral gain and flag
-        	g_lFAdjI = g_sParameters.lFAdjI;
-        	g_ucIntegralGainChanged = 0x00;
-        	g_lSpeedIntegratorOffset = 0;
-        	g_ucIntegralOffsetUpdated = 0x00;
-
     		//clear fault first
     		MainClearFaults();
 
@@ -3863,6 +5375,8 @@ void UICheckAndSetSpeed(void)
     		MainEmergencyStop();
     		g_ucMotorStarted = 0;
     		g_ucUpdateOpTime = 0x01;
+    		//keep what was learned of the trigger while running
+    		UIThrottleCalStore();
     	}
 
     }
@@ -32,6 +32,13 @@
 //
 //*****************************************************************************
 
+//*****************************************************************************
+//
+//! The number of speed breakpoints in the speed controller gain schedule.
+//
+//*****************************************************************************
+#define NUM_GAIN_POINTS         4
+
 //*****************************************************************************
 //
 //! This structure contains the Brushless DC motor parameters that are saved to
@@ -132,8 +139,8 @@ typedef struct
 
     //
     //! A set of flags, enumerated by FLAG_PWM_FREQUENCY_MASK,
-    //! FLAG_DECAY_BIT, FLAG_DIR_BIT, FLAG_ENCODER_BIT, FLAG_BRAKE_BIT,
-    //! FLAG_SENSOR_TYPE_BIT, and FLAG_SENSOR_POLARITY_BIT.
+    //! FLAG_DECAY_BIT, FLAG_BUS_COMP_BIT, FLAG_DIR_BIT, FLAG_ENCODER_BIT,
+    //! FLAG_BRAKE_BIT, FLAG_SENSOR_TYPE_BIT, and FLAG_SENSOR_POLARITY_BIT.
     //
     unsigned short usFlags;
 
@@ -311,6 +318,100 @@ typedef struct
     //
     long lPAdjI;
 
+    //
+    //! The number of breakpoints in use in the speed controller gain
+    //! schedule.  When zero, the speed controller uses lFAdjP and lFAdjI at
+    //! all speeds.  This is only present in version six and later of the
+    //! parameter block.
+    //
+    unsigned char ucGainPoints;
+
+    //
+    //! Padding to ensure consistent parameter block alignment.
+    //
+    unsigned char ucPad3[3];
+
+    //
+    //! The rotor speed at each breakpoint of the gain schedule, in ascending
+    //! order, specified in RPM.
+    //
+    unsigned short pusGainSpeed[NUM_GAIN_POINTS];
+
+    //
+    //! The P coefficient of the speed controller at each breakpoint.
+    //
+    long plGainP[NUM_GAIN_POINTS];
+
+    //
+    //! The I coefficient of the speed controller at each breakpoint.
+    //
+    long plGainI[NUM_GAIN_POINTS];
+
+    //
+    //! The anti-windup coefficient of the speed controller at each
+    //! breakpoint.
+    //
+    long plGainAW[NUM_GAIN_POINTS];
+
+    //
+    //! The speed constant of the motor, specified in RPM per volt, used by
+    //! the velocity feed-forward term of the speed controller.  When zero,
+    //! the velocity feed-forward term is disabled.  This is only present in
+    //! version seven and later of the parameter block.
+    //
+    unsigned short usMotorKv;
+
+    //
+    //! The acceleration feed-forward gain of the speed controller, specified
+    //! in milliamperes per 1000 RPM per second of commanded acceleration.
+    //! When zero, the acceleration feed-forward term is disabled.
+    //
+    unsigned short usAccelFF;
+
+    //
+    //! The number of lines of the quadrature encoder, which counts four
+    //! times per line.  This is only present in version eight and later of
+    //! the parameter block.
+    //
+    unsigned short usEncoderLines;
+
+    //
+    //! The jerk rate of the S-curve speed trajectory, specified as the change
+    //! in the acceleration rate, in RPM per second, each millisecond.  When
+    //! zero, the target speed is followed at a constant acceleration or
+    //! deceleration rate.  This is only present in version nine and later of
+    //! the parameter block.
+    //
+    unsigned short usJerk;
+
+    //
+    //! The rate at which the handpiece is asked to stream the trigger,
+    //! specified in frames per second.  When zero, the handpiece streams at
+    //! its own default rate, which is the default.  This is only present in
+    //! version ten and later of the parameter block.
+    //
+    unsigned short usHPStreamRate;
+
+    //
+    //! The baud rate that the handpiece link is moved to once the handpiece
+    //! has been read, if the handpiece supports it.  This is one of
+    //! #HP_BAUD_115200, #HP_BAUD_460800, or #HP_BAUD_921600, and defaults to
+    //! #HP_BAUD_115200.  The link settings are only sent to the handpiece if
+    //! this or usHPStreamRate has been changed from its default, as a
+    //! handpiece without the link command holds up its initialization until
+    //! the command times out.
+    //
+    unsigned char ucHPBaud;
+
+    //
+    //! Padding to ensure consistent parameter block alignment.
+    //
+    unsigned char ucPad4[1];
+
+    //
+    //! Reserved space, to pad the parameter block to its size in flash.
+    //
+    unsigned char ucReserved[56];
 }
 tDriveParameters;
 
@@ -413,6 +514,32 @@ tDriveParameters;
 //*****************************************************************************
 #define FLAG_DECAY_SLOW         0
 
+//*****************************************************************************
+//
+//! The bit number of the flag in the usFlags member of #tDriveParameters that
+//! enables compensation of the PWM duty cycle for changes in the DC bus
+//! voltage.  This field will be one of #FLAG_BUS_COMP_OFF or
+//! #FLAG_BUS_COMP_ON.
+//
+//*****************************************************************************
+#define FLAG_BUS_COMP_BIT       3
+
+//*****************************************************************************
+//
+//! The value of the #FLAG_BUS_COMP_BIT flag that indicates that the duty cycle
+//! is computed at the DC bus voltage when the motor drive started.
+//
+//*****************************************************************************
+#define FLAG_BUS_COMP_OFF       0
+
+//*****************************************************************************
+//
+//! The value of the #FLAG_BUS_COMP_BIT flag that indicates that the duty cycle
+//! is computed at the measured DC bus voltage.
+//
+//*****************************************************************************
+#define FLAG_BUS_COMP_ON        1
+
 //*****************************************************************************
 //
 //! The bit number of the flag in the usFlags member of #tDriveParameters that
@@ -589,6 +716,15 @@ tDriveParameters;
 //*****************************************************************************
 #define MOD_TYPE_SINE               2
 
+//*****************************************************************************
+//
+//! The value for ucModulationType that indicates that the motor is being
+//! driven with field-oriented control of the phase currents, using hall
+//! sensors for position sensing.
+//
+//*****************************************************************************
+#define MOD_TYPE_FOC                3
+
 //*****************************************************************************
 //
 //! The value for ucControlType that indicates that the motor is being
@@ -605,6 +741,52 @@ tDriveParameters;
 //*****************************************************************************
 #define CONTROL_TYPE_OVERRIDE       1
 
+//*****************************************************************************
+//
+//! The value for ucControlType that indicates that the motor power is being
+//! regulated.  The motor runs at the target speed unless that would take more
+//! than the target power, in which case the speed is reduced to hold the
+//! motor power at the target power.
+//
+//*****************************************************************************
+#define CONTROL_TYPE_POWER          2
+
+//*****************************************************************************
+//
+//! The value for ucControlType that indicates that the motor position is
+//! being controlled.  Each start of the motor drive, and each change of the
+//! target position, moves the motor to the target position, at up to the
+//! target speed, and then holds it there.  The target is an angle within one
+//! revolution, so the motor takes the shorter way round to it, forward or
+//! backward by no more than half a revolution.  A position sensor (the
+//! encoder, or digital Hall sensors with trapezoid modulation or
+//! field-oriented control) is required; position control is refused without
+//! one.
+//
+//*****************************************************************************
+#define CONTROL_TYPE_POSITION       3
+
+//*****************************************************************************
+//
+//! The value for ucHPBaud that leaves the handpiece link at 115,200 baud.
+//
+//*****************************************************************************
+#define HP_BAUD_115200              0
+
+//*****************************************************************************
+//
+//! The value for ucHPBaud that moves the handpiece link to 460,800 baud.
+//
+//*****************************************************************************
+#define HP_BAUD_460800              1
+
+//*****************************************************************************
+//
+//! The value for ucHPBaud that moves the handpiece link to 921,600 baud.
+//
+//*****************************************************************************
+#define HP_BAUD_921600              2
+
 #define FIRMWARE_VER_LENGTH         20
 
 //*****************************************************************************
@@ -631,6 +813,36 @@ tDriveParameters;
 // define ee default data size, 4 bytes of data, the last byte is checksum
 #define UI_EE_DEFAULT_SIZE 5
 
+//*****************************************************************************
+//
+//! The number of trigger hall sensors in the handpiece.
+//
+//*****************************************************************************
+#define UI_NUM_HALLS            4
+
+//*****************************************************************************
+//
+//! The calibration of the trigger hall sensors of a handpiece.  Each sensor
+//! is modeled as giving its rest reading with the magnet far away, falling
+//! linearly to its peak reading with the magnet over it.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The reading of each trigger hall sensor with the magnet far away,
+    //! which is the highest reading seen.
+    //
+    unsigned short pusHallRest[UI_NUM_HALLS];
+
+    //
+    //! The reading of each trigger hall sensor with the magnet over it,
+    //! which is the lowest reading seen.
+    //
+    unsigned short pusHallPeak[UI_NUM_HALLS];
+}
+tThrottleCal;
+
 //*****************************************************************************
 //
 // Close the Doxygen group.
@@ -645,15 +857,15 @@ tDriveParameters;
 //*****************************************************************************
 extern volatile char g_ucHPInitDone;
 extern tDriveParameters g_sParameters;
-extern unsigned long g_ulRotorSpeed;
 extern unsigned long g_ulHPOpTicks;
 extern unsigned short  g_ulRxDataInt[];
+extern unsigned short g_usThrottlePosition;
+extern unsigned long g_ulHPStreamAge;
+extern unsigned long g_ulHPStreamDrops;
+extern unsigned long g_ulHPStreamPeriod;
 extern unsigned long g_ulCPUUsage;
 extern unsigned long g_ulHPOpTime;
 extern volatile char g_ucUpdateOpTime;
-volatile extern unsigned char g_ucIntegralGainChanged;
-extern long g_lFAdjIPrev;
-extern long g_lFAdjI;
 extern char g_usHPError[];
 extern char g_usEESerialNumber[];
 extern char g_usEEOrigin[];
@@ -668,5 +880,6 @@ extern void UIInit(void);
 extern unsigned long UIGetTicks(void);
 extern void initHandPiece(void);
 void UICheckAndSetSpeed(void);
+extern void UIThrottleCalUpdate(void);
 
 #endif // __UI_H__
@@ -32,7 +32,11 @@
 #include "driverlib/gpio.h"
 #include "driverlib/sysctl.h"
 #include "utils/lwiplib.h"
+#include "capture.h"
 #include "commands.h"
+#include "isr_prof.h"
+#include "scope.h"
+#include "telemetry.h"
 #include "ui_common.h"
 #include "ui_ethernet.h"
 
@@ -176,25 +180,27 @@
 //
 //*****************************************************************************
 #ifndef UIETHERNET_MAX_XMIT
-#define UIETHERNET_MAX_XMIT     64
+#define UIETHERNET_MAX_XMIT     128
 #endif
 
 //*****************************************************************************
 //
-//! The size of the UART receive buffer.  This should be appropriately sized
-//! such that the maximum size command packet can be contained in this buffer.
-//! This value should be a power of two in order to make the modulo arithmetic
-//! be fast (that is, an AND instead of a divide).
+//! The size of the Ethernet receive buffer.  This must be larger than the
+//! largest command packet, whose length is given in one byte, so that any
+//! partial packet left in the buffer always has room to be completed.
 //
 //*****************************************************************************
 #ifndef UIETHERNET_MAX_RECV
-#define UIETHERNET_MAX_RECV     64
+#define UIETHERNET_MAX_RECV     256
 #endif
 
 //*****************************************************************************
 //
-//! A buffer to contain data received from the UART.  A packet is processed out
-//! of this buffer once the entire packet is contained within the buffer.
+//! A buffer to contain data received from Ethernet.  A packet is processed in
+//! place in this buffer once the entire packet is contained within the
+//! buffer.  The buffer is linear rather than circular: the packets are
+//! scanned from the read offset, and once scanning stops, the partial packet
+//! that remains, if any, is moved to the start of the buffer.
 //
 //*****************************************************************************
 static unsigned char g_pucUIEthernetReceive[UIETHERNET_MAX_RECV];
@@ -215,11 +221,95 @@ static unsigned long g_ulUIEthernetReceiveWrite;
 
 //*****************************************************************************
 //
-//! A buffer used to construct status packets before they are written to the
-//! UART and/or g_pucUIEthernetTransmit.
+//! The index in g_sUIParameters of the parameter with each ID, or 0xff for an
+//! ID that has no parameter.  This is filled in by UIEthernetInit(), so that
+//! a parameter is found by its ID without searching the parameter list.
+//
+//*****************************************************************************
+static unsigned char g_pucUIEthernetParameterIndex[256];
+
+//*****************************************************************************
+//
+//! The number of buffers in the pool that status packets are built in.
+//
+//*****************************************************************************
+#ifndef UIETHERNET_NUM_XMIT
+#define UIETHERNET_NUM_XMIT     8
+#endif
+
+//*****************************************************************************
+//
+//! A buffer in the pool that status packets are built in.  A status packet
+//! is handed to TCP by reference, so its buffer is kept until the packet has
+//! been acknowledged.
+//
+//*****************************************************************************
+typedef struct
+{
+    //
+    //! The status packet.
+    //
+    unsigned char pucData[UIETHERNET_MAX_XMIT];
+
+    //
+    //! The count of bytes written to TCP, up to and including this packet,
+    //! that must be acknowledged before the buffer can be used again.
+    //
+    unsigned long ulEnd;
+
+    //
+    //! A flag that is true while the packet is waiting to be acknowledged.
+    //
+    tBoolean bBusy;
+}
+tUIEthernetXmit;
+
+//*****************************************************************************
+//
+//! The pool of buffers that status packets are built in, which are used in
+//! turn, and the index of the next one to use.  Since TCP acknowledges the
+//! packets in the order that they were written, the next buffer is also the
+//! one that has waited longest.
+//
+//*****************************************************************************
+static tUIEthernetXmit g_psUIEthernetXmit[UIETHERNET_NUM_XMIT];
+static unsigned long g_ulUIEthernetXmitNext;
+
+//*****************************************************************************
+//
+//! The buffer that status packets are built in when all of the pool is
+//! waiting to be acknowledged.  A packet in this buffer is copied by TCP.
+//
+//*****************************************************************************
+static unsigned char g_pucUIEthernetScratch[UIETHERNET_MAX_XMIT];
+
+//*****************************************************************************
+//
+//! The count of bytes written to TCP on this connection, and the count of
+//! them that have been acknowledged.
+//
+//*****************************************************************************
+static unsigned long g_ulUIEthernetXmitWritten;
+static unsigned long g_ulUIEthernetXmitAcked;
+
+//*****************************************************************************
+//
+//! A flag that is true while the received data is being processed, during
+//! which the packets written to TCP are held for one TCP output at the end,
+//! and a flag that is set when a packet has been held.
+//
+//*****************************************************************************
+static tBoolean g_bUIEthernetXmitHold;
+static tBoolean g_bUIEthernetXmitHeld;
+
+//*****************************************************************************
+//
+//! A pointer to the buffer used to construct the next status packet, which
+//! is the next buffer in the pool, or g_pucUIEthernetScratch if that is still
+//! waiting to be acknowledged.
 //
 //*****************************************************************************
-static unsigned char g_pucUIEthernetResponse[UIETHERNET_MAX_XMIT];
+static unsigned char *g_pucUIEthernetResponse = g_pucUIEthernetScratch;
 
 //*****************************************************************************
 //
@@ -313,6 +403,40 @@ volatile unsigned long g_ulEthernetTimer = 0;
 //*****************************************************************************
 static tBoolean g_bSendRealTimeData = false;
 
+//*****************************************************************************
+//
+//! A buffer used to construct batched real-time data packets, and a flag to
+//! indicate that the packet in it could not be sent and is to be sent again.
+//
+//*****************************************************************************
+static unsigned char g_pucUIEthernetBatch[TELEMETRY_FRAME_MAX];
+static tBoolean g_bSendBatchData = false;
+
+//*****************************************************************************
+//
+//! The UDP PCB used to send the batched real-time data packets when they are
+//! streamed over UDP, and the host and port to send them to.
+//
+//*****************************************************************************
+static struct udp_pcb *g_psTelemetryPCB = NULL;
+static struct ip_addr g_sTelemetryAddr;
+static unsigned short g_usTelemetryPort;
+
+//*****************************************************************************
+//
+//! Flag to indicate that the batched real-time data packets are sent over
+//! UDP instead of on the TCP connection.
+//
+//*****************************************************************************
+static tBoolean g_bTelemetryUDP = false;
+
+//*****************************************************************************
+//
+//! The sequence number of the next UDP real-time data datagram.
+//
+//*****************************************************************************
+static unsigned long g_ulTelemetrySequence;
+
 //*****************************************************************************
 //
 //! This global is used to store the number of Ethernet messages that have been
@@ -350,6 +474,9 @@ volatile unsigned long g_ulConnectionTimeoutParameter = 0;
 //! \param pcb is the pointer to the TCP control structure.
 //! 
 //! This function is called when the the TCP connection should be closed.
+//! None of the status packet buffers may be waiting to be acknowledged on
+//! the connection (see UIEthernetXmitBusy()), since TCP keeps sending the
+//! packets of a closed connection and then frees it without any callback.
 //!
 //! \return None.
 //
@@ -378,6 +505,153 @@ UIEthernetClose(struct tcp_pcb *pcb)
     tcp_close(pcb);
 }
 
+//*****************************************************************************
+//
+//! Abort an existing Ethernet connection.
+//!
+//! \param pcb is the pointer to the TCP control structure.
+//!
+//! This function is called when the TCP connection should be dropped at once.
+//! Unlike a close, the abort frees the segments that are waiting to be sent
+//! or acknowledged, so that none of them still refer to the status packet
+//! buffers.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIEthernetAbort(struct tcp_pcb *pcb)
+{
+    //
+    // Clear out all of the TCP callbacks, so that the error callback is not
+    // called by the abort.
+    //
+    tcp_arg(pcb, NULL);
+    tcp_sent(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_err(pcb, NULL);
+    tcp_poll(pcb, NULL, 1);
+
+    //
+    // Clear the telnet data structure pointer, to indicate that
+    // we are no longer connected.
+    //
+    g_psTelnetPCB = NULL;
+
+    //
+    // Abort the TCP connection.
+    //
+    tcp_abort(pcb);
+}
+
+//*****************************************************************************
+//
+//! Selects the buffer for the next status packet.
+//!
+//! This function points g_pucUIEthernetResponse at the next buffer in the
+//! pool, or at g_pucUIEthernetScratch if that buffer is still waiting to be
+//! acknowledged.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIEthernetXmitSelect(void)
+{
+    if(g_psUIEthernetXmit[g_ulUIEthernetXmitNext].bBusy)
+    {
+        g_pucUIEthernetResponse = g_pucUIEthernetScratch;
+    }
+    else
+    {
+        g_pucUIEthernetResponse =
+            g_psUIEthernetXmit[g_ulUIEthernetXmitNext].pucData;
+    }
+}
+
+//*****************************************************************************
+//
+//! Releases the status packet buffers.
+//!
+//! \param ulAcked is the number of bytes that TCP has newly acknowledged.
+//!
+//! This function frees the pool buffers whose packets have been acknowledged.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIEthernetXmitRelease(unsigned long ulAcked)
+{
+    unsigned long ulIdx;
+
+    //
+    // Free each buffer whose packet is now wholly acknowledged.
+    //
+    g_ulUIEthernetXmitAcked += ulAcked;
+    for(ulIdx = 0; ulIdx < UIETHERNET_NUM_XMIT; ulIdx++)
+    {
+        if(g_psUIEthernetXmit[ulIdx].bBusy &&
+           ((long)(g_ulUIEthernetXmitAcked -
+                   g_psUIEthernetXmit[ulIdx].ulEnd) >= 0))
+        {
+            g_psUIEthernetXmit[ulIdx].bBusy = false;
+        }
+    }
+
+    //
+    // Move the next status packet back into the pool if it had to use the
+    // scratch buffer.
+    //
+    UIEthernetXmitSelect();
+}
+
+//*****************************************************************************
+//
+//! Determines if any status packet buffer is waiting to be acknowledged.
+//!
+//! This function is used before closing a connection, since TCP would still
+//! refer to such a buffer until the packet in it is acknowledged.
+//!
+//! \return Returns \b true if any of the buffers is in use by TCP.
+//
+//*****************************************************************************
+static tBoolean
+UIEthernetXmitBusy(void)
+{
+    unsigned long ulIdx;
+
+    for(ulIdx = 0; ulIdx < UIETHERNET_NUM_XMIT; ulIdx++)
+    {
+        if(g_psUIEthernetXmit[ulIdx].bBusy)
+        {
+            return(true);
+        }
+    }
+    return(false);
+}
+
+//*****************************************************************************
+//
+//! Releases all of the status packet buffers.
+//!
+//! This function is called when a connection is accepted, since a previous
+//! connection no longer reports the acknowledgement of its packets.  Any
+//! previous connection must have been aborted first, or closed with none of
+//! the buffers in use, so that TCP no longer refers to the buffers.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIEthernetXmitReset(void)
+{
+    UIEthernetXmitRelease(g_ulUIEthernetXmitWritten - g_ulUIEthernetXmitAcked);
+    g_ulUIEthernetXmitWritten = 0;
+    g_ulUIEthernetXmitAcked = 0;
+    g_bUIEthernetXmitHeld = false;
+}
+
 //*****************************************************************************
 //
 //! Transmits a packet to the Ethernet controller.
@@ -388,6 +662,13 @@ UIEthernetClose(struct tcp_pcb *pcb)
 //! checksum of the packet (based on the length in the second byte) and place
 //! it at the end of the packet before sending the packet.
 //!
+//! A status packet built in g_pucUIEthernetResponse is handed to TCP by
+//! reference when it is in a pool buffer, and the next status packet is then
+//! built in the following buffer; any other packet is copied by TCP.  While
+//! the received data is being processed the packet is held, so that all of
+//! the responses go out together in one TCP output, and otherwise it is sent
+//! immediately.
+//!
 //! \return Returns \b true if the entire packet was transmitted and \b false
 //! if not.
 //
@@ -398,6 +679,7 @@ static tBoolean
 UIEthernetTransmit(unsigned char *pucBuffer)
 {
     unsigned long ulIdx, ulSum, ulLength;
+    tUIEthernetXmit *psXmit;
     err_t err;
 
     //
@@ -411,24 +693,58 @@ UIEthernetTransmit(unsigned char *pucBuffer)
     pucBuffer[ulLength - 1] = ulSum;
 
     //
-    // Transmit the packet and flush the buffer to get the packet out
-    // immediately.
+    // Write the packet to TCP, by reference if it is in a pool buffer, which
+    // is then kept until the packet is acknowledged.
+    //
+    psXmit = &g_psUIEthernetXmit[g_ulUIEthernetXmitNext];
+    if(pucBuffer == psXmit->pucData)
+    {
+        err = tcp_write(g_psTelnetPCB, pucBuffer, ulLength, 0);
+        if(err == ERR_OK)
+        {
+            psXmit->ulEnd = g_ulUIEthernetXmitWritten + ulLength;
+            psXmit->bBusy = true;
+            g_ulUIEthernetXmitNext =
+                (g_ulUIEthernetXmitNext + 1) % UIETHERNET_NUM_XMIT;
+        }
+    }
+    else
+    {
+        err = tcp_write(g_psTelnetPCB, pucBuffer, ulLength,
+                        TCP_WRITE_FLAG_COPY);
+    }
+
+    //
+    // Flush the packet out immediately, unless it is being held for the
+    // responses to the received data.
     //
-    err = tcp_write(g_psTelnetPCB, pucBuffer, ulLength, 1);
     if(err == ERR_OK)
     {
         g_ulEthernetTXCount++;
-        err = tcp_output(g_psTelnetPCB);
-        if(err != ERR_OK)
+        g_ulUIEthernetXmitWritten += ulLength;
+        if(g_bUIEthernetXmitHold)
+        {
+            g_bUIEthernetXmitHeld = true;
+        }
+        else
         {
-            g_ulTxOutError++;
+            err = tcp_output(g_psTelnetPCB);
+            if(err != ERR_OK)
+            {
+                g_ulTxOutError++;
+            }
         }
     }
     else
     {
         g_ulTxWriteError++;
     }
-    
+
+    //
+    // Select the buffer for the next status packet.
+    //
+    UIEthernetXmitSelect();
+
     //
     // Return an error if there are characters to be sent that would not fit
     // into the transmit buffer.
@@ -443,14 +759,90 @@ UIEthernetTransmit(unsigned char *pucBuffer)
     }
 }
 
+//*****************************************************************************
+//
+//! Transmits a batched real-time data packet in a UDP datagram.
+//!
+//! \param pucBuffer is a pointer to the packet to be transmitted.
+//!
+//! This function will send a packet, preceded by the next sequence number,
+//! to the host and port given to #CMD_START_DATA_UDP.  It will compute the
+//! checksum of the packet (based on the length in the second byte) as it is
+//! copied into the datagram.  The sequence number is used up even if the
+//! datagram can not be sent, so that the host sees the gap; the datagram is
+//! never sent again.
+//!
+//! \return None.
+//
+//*****************************************************************************
+unsigned long g_ulTxUDPError = 0;
+static void
+UIEthernetTransmitUDP(unsigned char *pucBuffer)
+{
+    unsigned long ulIdx, ulSum, ulLength;
+    unsigned char *pucData;
+    struct pbuf *p;
+
+    //
+    // Take the sequence number for this datagram.
+    //
+    ulSum = g_ulTelemetrySequence++;
+
+    //
+    // Allocate the datagram, counting it as lost if there is no memory.
+    //
+    ulLength = pucBuffer[1];
+    p = pbuf_alloc(PBUF_TRANSPORT, ulLength + 4, PBUF_RAM);
+    if(p == NULL)
+    {
+        g_ulTxUDPError++;
+        return;
+    }
+
+    //
+    // Put the sequence number at the start of the datagram.
+    //
+    pucData = p->payload;
+    pucData[0] = ulSum & 0xff;
+    pucData[1] = (ulSum >> 8) & 0xff;
+    pucData[2] = (ulSum >> 16) & 0xff;
+    pucData[3] = (ulSum >> 24) & 0xff;
+    pucData += 4;
+
+    //
+    // Copy the packet into the datagram, computing its checksum and putting
+    // it at the end.
+    //
+    for(ulIdx = 0, ulSum = 0; ulIdx < (ulLength - 1); ulIdx++)
+    {
+        pucData[ulIdx] = pucBuffer[ulIdx];
+        ulSum -= pucBuffer[ulIdx];
+    }
+    pucData[ulLength - 1] = ulSum;
+
+    //
+    // Send the datagram.
+    //
+    if(udp_sendto(g_psTelemetryPCB, p, &g_sTelemetryAddr,
+                  g_usTelemetryPort) == ERR_OK)
+    {
+        g_ulEthernetTXCount++;
+    }
+    else
+    {
+        g_ulTxUDPError++;
+    }
+    pbuf_free(p);
+}
+
 //*****************************************************************************
 //
 //! Finds a parameter by ID.
 //!
 //! \param ucID is the ID of the parameter to locate.
 //!
-//! This function searches the list of parameters looking for one that matches
-//! the provided ID.
+//! This function looks up the parameter with the provided ID in
+//! g_pucUIEthernetParameterIndex.
 //!
 //! \return Returns the index of the parameter found, or 0xffff.ffff if the
 //! parameter does not exist in the parameter list.
@@ -462,26 +854,22 @@ UIEthernetFindParameter(unsigned char ucID)
     unsigned long ulIdx;
 
     //
-    // Loop through the parameters.
+    // Look up the index of the parameter.
+    //
+    ulIdx = g_pucUIEthernetParameterIndex[ucID];
+
+    //
+    // Return a failure if there is no parameter with this ID.
     //
-    for(ulIdx = 0; ulIdx < g_ulUINumParameters; ulIdx++)
+    if(ulIdx == 0xff)
     {
-        //
-        // See if this parameter matches the search ID.
-        //
-        if(g_sUIParameters[ulIdx].ucID == ucID)
-        {
-            //
-            // Since this parameter matches, return its index.
-            //
-            return(ulIdx);
-        }
+        return(0xffffffff);
     }
 
     //
-    // The parameter could not be located, so return a failure.
+    // Return the index of the parameter.
     //
-    return(0xffffffff);
+    return(ulIdx);
 }
 
 //*****************************************************************************
@@ -737,16 +1125,266 @@ UIEthernetRangeCheck(unsigned long ulIdx)
                 //
                 if(*pulValue > g_sUIParameters[ulIdx].ulMax)
                 {
-                    *pulValue = g_sUIParameters[ulIdx].ulMax;
+                    *pulValue = g_sUIParameters[ulIdx].ulMax;
+                }
+
+                //
+                // This parameter value has been handled.
+                //
+                break;
+            }
+        }
+    }
+}
+
+//*****************************************************************************
+//
+//! Handles the capture command.
+//!
+//! \param ucSize is the size of the command packet.
+//!
+//! This function performs the capture operation requested by the command
+//! packet at the read position of g_pucUIEthernetReceive, and sends the
+//! response.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIEthernetCapture(unsigned char ucSize)
+{
+    unsigned char *pucPacket, *pucData;
+    unsigned long ulOffset, ulCount;
+
+    //
+    // Find the command data, following the command and operation bytes, in
+    // the receive buffer.
+    //
+    pucPacket = g_pucUIEthernetReceive + g_ulUIEthernetReceiveRead;
+    pucData = pucPacket + 4;
+    ulCount = (ucSize > 5) ? (ucSize - 5) : 0;
+
+    //
+    // Get the offset for the read and write operations.
+    //
+    ulOffset = 0;
+    if(ulCount >= 4)
+    {
+        ulOffset = (pucData[0] | (pucData[1] << 8) | (pucData[2] << 16) |
+                    (pucData[3] << 24));
+    }
+
+    //
+    // Fill in the response header, with no data.
+    //
+    g_pucUIEthernetResponse[0] = TAG_STATUS;
+    g_pucUIEthernetResponse[1] = 0x04;
+    g_pucUIEthernetResponse[2] = CMD_CAPTURE;
+
+    //
+    // Perform the requested operation.
+    //
+    switch(pucPacket[3])
+    {
+        //
+        // Return the capture mode and stream length.
+        //
+        case CAPTURE_OP_STATUS:
+        {
+            ulCount = CaptureLength();
+            g_pucUIEthernetResponse[1] = 0x09;
+            g_pucUIEthernetResponse[3] = g_ulCaptureMode;
+            g_pucUIEthernetResponse[4] = ulCount & 0xff;
+            g_pucUIEthernetResponse[5] = (ulCount >> 8) & 0xff;
+            g_pucUIEthernetResponse[6] = (ulCount >> 16) & 0xff;
+            g_pucUIEthernetResponse[7] = (ulCount >> 24) & 0xff;
+            break;
+        }
+
+        //
+        // Start recording.
+        //
+        case CAPTURE_OP_RECORD:
+        {
+            CaptureStart(CAPTURE_MODE_RECORD);
+            break;
+        }
+
+        //
+        // Start replaying.
+        //
+        case CAPTURE_OP_REPLAY:
+        {
+            CaptureStart(CAPTURE_MODE_REPLAY);
+            break;
+        }
+
+        //
+        // Stop recording or replaying.
+        //
+        case CAPTURE_OP_STOP:
+        {
+            CaptureStop();
+            break;
+        }
+
+        //
+        // Read from the capture stream, limited to what fits in the response.
+        //
+        case CAPTURE_OP_READ:
+        {
+            if(ulCount == 5)
+            {
+                ulCount = pucData[4];
+                if(ulCount > (UIETHERNET_MAX_XMIT - 4))
+                {
+                    ulCount = UIETHERNET_MAX_XMIT - 4;
+                }
+                ulCount = CaptureRead(ulOffset, g_pucUIEthernetResponse + 3,
+                                      ulCount);
+                g_pucUIEthernetResponse[1] = ulCount + 4;
+            }
+            break;
+        }
+
+        //
+        // Write to the capture stream.
+        //
+        case CAPTURE_OP_WRITE:
+        {
+            if(ulCount > 4)
+            {
+                g_pucUIEthernetResponse[1] = 0x05;
+                g_pucUIEthernetResponse[3] =
+                    CaptureWrite(ulOffset, pucData + 4, ulCount - 4);
+            }
+            break;
+        }
+    }
+
+    //
+    // Send the response.
+    //
+    UIEthernetTransmit(g_pucUIEthernetResponse);
+}
+
+//*****************************************************************************
+//
+//! Handles the scope command.
+//!
+//! \param ucSize is the size of the command packet.
+//!
+//! This function performs the scope operation requested by the command packet
+//! at the read position of g_pucUIEthernetReceive, and sends the response.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIEthernetScope(unsigned char ucSize)
+{
+    unsigned char *pucPacket, *pucData;
+    unsigned long ulIdx, ulCount;
+
+    //
+    // Find the command data, following the command and operation bytes, in
+    // the receive buffer.
+    //
+    pucPacket = g_pucUIEthernetReceive + g_ulUIEthernetReceiveRead;
+    pucData = pucPacket + 4;
+    ulCount = (ucSize > 5) ? (ucSize - 5) : 0;
+
+    //
+    // Fill in the response header, with no data.
+    //
+    g_pucUIEthernetResponse[0] = TAG_STATUS;
+    g_pucUIEthernetResponse[1] = 0x04;
+    g_pucUIEthernetResponse[2] = CMD_SCOPE;
+
+    //
+    // Perform the requested operation.
+    //
+    switch(pucPacket[3])
+    {
+        //
+        // Return the scope state and the size of the capture.
+        //
+        case SCOPE_OP_STATUS:
+        {
+            ulCount = ScopeRecords();
+            ulIdx = ScopePreTrigger();
+            g_pucUIEthernetResponse[1] = 0x0a;
+            g_pucUIEthernetResponse[3] = g_ulScopeState;
+            g_pucUIEthernetResponse[4] = ScopeChannels();
+            g_pucUIEthernetResponse[5] = ulCount & 0xff;
+            g_pucUIEthernetResponse[6] = (ulCount >> 8) & 0xff;
+            g_pucUIEthernetResponse[7] = ulIdx & 0xff;
+            g_pucUIEthernetResponse[8] = (ulIdx >> 8) & 0xff;
+            break;
+        }
+
+        //
+        // Arm the scope.
+        //
+        case SCOPE_OP_ARM:
+        {
+            if(ulCount == 10)
+            {
+                ulCount = ScopeArm(pucData[0], pucData[1], pucData[2],
+                                   pucData[3],
+                                   (pucData[4] | (pucData[5] << 8) |
+                                    (pucData[6] << 16) | (pucData[7] << 24)),
+                                   pucData[8] | (pucData[9] << 8));
+                g_pucUIEthernetResponse[1] = 0x06;
+                g_pucUIEthernetResponse[3] = ulCount & 0xff;
+                g_pucUIEthernetResponse[4] = (ulCount >> 8) & 0xff;
+            }
+            break;
+        }
+
+        //
+        // Trigger the scope by hand.
+        //
+        case SCOPE_OP_TRIGGER:
+        {
+            ScopeTrigger();
+            break;
+        }
+
+        //
+        // Stop the scope.
+        //
+        case SCOPE_OP_STOP:
+        {
+            ScopeStop();
+            break;
+        }
+
+        //
+        // Read from the capture, limited to what fits in the response.
+        //
+        case SCOPE_OP_READ:
+        {
+            if(ulCount == 5)
+            {
+                ulCount = pucData[4];
+                if(ulCount > (UIETHERNET_MAX_XMIT - 4))
+                {
+                    ulCount = UIETHERNET_MAX_XMIT - 4;
                 }
-
-                //
-                // This parameter value has been handled.
-                //
-                break;
+                ulCount = ScopeRead((pucData[0] | (pucData[1] << 8) |
+                                     (pucData[2] << 16) | (pucData[3] << 24)),
+                                    g_pucUIEthernetResponse + 3, ulCount);
+                g_pucUIEthernetResponse[1] = ulCount + 4;
             }
+            break;
         }
     }
+
+    //
+    // Send the response.
+    //
+    UIEthernetTransmit(g_pucUIEthernetResponse);
 }
 
 //*****************************************************************************
@@ -762,7 +1400,7 @@ UIEthernetRangeCheck(unsigned long ulIdx)
 static void
 UIEthernetScanReceive(void)
 {
-    unsigned char ucSum, ucSize;
+    unsigned char ucSum, ucSize, *pucPacket;
     unsigned long ulIdx;
 
     //
@@ -770,16 +1408,21 @@ UIEthernetScanReceive(void)
     //
     while(g_ulUIEthernetReceiveRead != g_ulUIEthernetReceiveWrite)
     {
+        //
+        // The packet, if there is one, starts at the read position and is
+        // contiguous in the receive buffer.
+        //
+        pucPacket = g_pucUIEthernetReceive + g_ulUIEthernetReceiveRead;
+
         //
         // See if this character is the tag for the start of a command packet.
         //
-        if(g_pucUIEthernetReceive[g_ulUIEthernetReceiveRead] != TAG_CMD)
+        if(pucPacket[0] != TAG_CMD)
         {
             //
             // Skip this character.
             //
-            g_ulUIEthernetReceiveRead =
-                (g_ulUIEthernetReceiveRead + 1) % UIETHERNET_MAX_RECV;
+            g_ulUIEthernetReceiveRead++;
 
             //
             // Keep scanning for a start of command packet tag.
@@ -790,8 +1433,8 @@ UIEthernetScanReceive(void)
         //
         // See if there are additional characters in the receive buffer.
         //
-        if(((g_ulUIEthernetReceiveRead + 1) % UIETHERNET_MAX_RECV) ==
-           g_ulUIEthernetReceiveWrite)
+        ulIdx = g_ulUIEthernetReceiveWrite - g_ulUIEthernetReceiveRead;
+        if(ulIdx == 1)
         {
             //
             // There are no additional characters in the receive buffer after
@@ -802,19 +1445,17 @@ UIEthernetScanReceive(void)
 
         //
         // See if the packet size byte is valid.  A command packet must be at
-        // least four bytes and can not be larger than the receive buffer size.
+        // least four bytes, and always fits in the receive buffer.
         //
-        ucSize = g_pucUIEthernetReceive[(g_ulUIEthernetReceiveRead + 1) %
-                                      UIETHERNET_MAX_RECV];
-        if((ucSize < 4) || (ucSize > (UIETHERNET_MAX_RECV - 1)))
+        ucSize = pucPacket[1];
+        if(ucSize < 4)
         {
             //
-            // The packet size is too large, so either this is not the start of
-            // a packet or an invalid packet was received.  Skip this start of
-            // command packet tag.
+            // The packet size is too small, so either this is not the start
+            // of a packet or an invalid packet was received.  Skip this start
+            // of command packet tag.
             //
-            g_ulUIEthernetReceiveRead =
-                (g_ulUIEthernetReceiveRead + 1) % UIETHERNET_MAX_RECV;
+            g_ulUIEthernetReceiveRead++;
 
             //
             // Keep scanning for a start of command packet tag.
@@ -822,15 +1463,6 @@ UIEthernetScanReceive(void)
             continue;
         }
 
-        //
-        // Determine the number of bytes in the receive buffer.
-        //
-        ulIdx = g_ulUIEthernetReceiveWrite - g_ulUIEthernetReceiveRead;
-        if(g_ulUIEthernetReceiveRead > g_ulUIEthernetReceiveWrite)
-        {
-            ulIdx += UIETHERNET_MAX_RECV;
-        }
-
         //
         // If the entire command packet is not in the receive buffer then stop
         // scanning for now.
@@ -846,8 +1478,7 @@ UIEthernetScanReceive(void)
         //
         for(ulIdx = 0, ucSum = 0; ulIdx < ucSize; ulIdx++)
         {
-            ucSum += g_pucUIEthernetReceive[
-                (g_ulUIEthernetReceiveRead + ulIdx) % UIETHERNET_MAX_RECV];
+            ucSum += pucPacket[ulIdx];
         }
 
         //
@@ -870,8 +1501,7 @@ UIEthernetScanReceive(void)
 
             // Skip this character.
             //
-            g_ulUIEthernetReceiveRead =
-                (g_ulUIEthernetReceiveRead + 1) % UIETHERNET_MAX_RECV;
+            g_ulUIEthernetReceiveRead++;
 
             //
             // Keep scanning for a start of command packet tag.
@@ -882,8 +1512,7 @@ UIEthernetScanReceive(void)
         //
         // A valid command packet was received, so process it now.
         //
-        switch(g_pucUIEthernetReceive[(g_ulUIEthernetReceiveRead + 2) %
-                                    UIETHERNET_MAX_RECV])
+        switch(pucPacket[2])
         {
             //
             // The command to get the target type.
@@ -964,9 +1593,7 @@ UIEthernetScanReceive(void)
                 //
                 // Find the parameter.
                 //
-                ucSum =
-                    g_pucUIEthernetReceive[(g_ulUIEthernetReceiveRead + 3) %
-                                         UIETHERNET_MAX_RECV];
+                ucSum = pucPacket[3];
                 ulIdx = UIEthernetFindParameter(ucSum);
 
                 //
@@ -1060,9 +1687,7 @@ UIEthernetScanReceive(void)
                 //
                 // Find the parameter.
                 //
-                ucSum =
-                    g_pucUIEthernetReceive[(g_ulUIEthernetReceiveRead + 3) %
-                                         UIETHERNET_MAX_RECV];
+                ucSum = pucPacket[3];
                 ulIdx = UIEthernetFindParameter(ucSum);
 
                 //
@@ -1122,9 +1747,7 @@ UIEthernetScanReceive(void)
                 //
                 // Find the parameter.
                 //
-                ucSum =
-                    g_pucUIEthernetReceive[(g_ulUIEthernetReceiveRead + 3) %
-                                         UIETHERNET_MAX_RECV];
+                ucSum = pucPacket[3];
                 ulIdx = UIEthernetFindParameter(ucSum);
 
                 //
@@ -1160,9 +1783,7 @@ UIEthernetScanReceive(void)
                             // the supplied byte.
                             //
                             g_sUIParameters[ulIdx].pucValue[ucSum] =
-                                g_pucUIEthernetReceive[
-                                (g_ulUIEthernetReceiveRead + ucSum + 4) %
-                                UIETHERNET_MAX_RECV];
+                                pucPacket[ucSum + 4];
                         }
                         else
                         {
@@ -1301,8 +1922,7 @@ UIEthernetScanReceive(void)
                 //
                 // Enable the data item if it is was validly specified.
                 //
-                ucSum = g_pucUIEthernetReceive[(g_ulUIEthernetReceiveRead + 3) %
-                                                        UIETHERNET_MAX_RECV];
+                ucSum = pucPacket[3];
                 if((ucSize == 5) && (ucSum < DATA_NUM_ITEMS))
                 {
                     g_pulUIRealTimeData[ucSum / 32] |= 1 << (ucSum % 32);
@@ -1334,8 +1954,7 @@ UIEthernetScanReceive(void)
                 //
                 // Disable the data item if it is was validly specified.
                 //
-                ucSum = g_pucUIEthernetReceive[(g_ulUIEthernetReceiveRead + 3) %
-                                                        UIETHERNET_MAX_RECV];
+                ucSum = pucPacket[3];
                 if((ucSize == 5) && (ucSum < DATA_NUM_ITEMS))
                 {
                     g_pulUIRealTimeData[ucSum / 32] &= ~(1 << (ucSum % 32));
@@ -1370,8 +1989,12 @@ UIEthernetScanReceive(void)
                 UIEthernetTransmit(g_pucUIEthernetResponse);
 
                 //
-                // Enable the real-time data stream.
+                // Enable the real-time data stream, in place of the batched
+                // stream.
                 //
+                TelemetryStop();
+                g_bSendBatchData = false;
+                g_bTelemetryUDP = false;
                 g_bEnableRealTimeData = true;
 
                 //
@@ -1393,9 +2016,148 @@ UIEthernetScanReceive(void)
                 g_pucUIEthernetResponse[2] = CMD_STOP_DATA_STREAM;
 
                 //
-                // Disable the real-time data stream.
+                // Disable the real-time data stream, and the batched stream.
+                //
+                g_bEnableRealTimeData = false;
+                TelemetryStop();
+                g_bSendBatchData = false;
+                g_bTelemetryUDP = false;
+
+                //
+                // Send the response.
+                //
+                UIEthernetTransmit(g_pucUIEthernetResponse);
+
+                //
+                // Done with this command.
+                //
+                break;
+            }
+
+            //
+            // The command to reset the interrupt handler profile.
+            //
+            case CMD_RESET_ISR_PROFILE:
+            {
+                //
+                // Clear the profile of each interrupt handler.
+                //
+                ISRProfileReset();
+
+                //
+                // Fill in the response.
+                //
+                g_pucUIEthernetResponse[0] = TAG_STATUS;
+                g_pucUIEthernetResponse[1] = 0x04;
+                g_pucUIEthernetResponse[2] = CMD_RESET_ISR_PROFILE;
+
+                //
+                // Send the response.
+                //
+                UIEthernetTransmit(g_pucUIEthernetResponse);
+
+                //
+                // Done with this command.
+                //
+                break;
+            }
+
+            //
+            // The command to start the batched real-time data stream.
+            //
+            case CMD_START_DATA_BATCH:
+            {
+                //
+                // Get the number of samples in each packet.
+                //
+                ucSum = pucPacket[3];
+                if(ucSize != 5)
+                {
+                    ucSum = 0;
+                }
+
+                //
+                // Start the batched stream in place of the real-time data
+                // stream.
+                //
+                g_bEnableRealTimeData = false;
+                g_bSendBatchData = false;
+                g_bTelemetryUDP = false;
+                ucSum = TelemetryStart(g_pulUIRealTimeData, ucSum);
+
+                //
+                // Fill in the response.
+                //
+                g_pucUIEthernetResponse[0] = TAG_STATUS;
+                g_pucUIEthernetResponse[1] = 0x05;
+                g_pucUIEthernetResponse[2] = CMD_START_DATA_BATCH;
+                g_pucUIEthernetResponse[3] = ucSum;
+
+                //
+                // Send the response.
+                //
+                UIEthernetTransmit(g_pucUIEthernetResponse);
+
+                //
+                // Done with this command.
+                //
+                break;
+            }
+
+            //
+            // The command to start the batched real-time data stream over
+            // UDP.
+            //
+            case CMD_START_DATA_UDP:
+            {
+                //
+                // Get the number of samples in each packet, and the port and
+                // host to send them to.  A zero host is the host of this
+                // connection.
+                //
+                if(ucSize == 11)
+                {
+                    ucSum = pucPacket[3];
+                    g_usTelemetryPort = pucPacket[4] | (pucPacket[5] << 8);
+                    IP4_ADDR(&g_sTelemetryAddr, pucPacket[6], pucPacket[7],
+                             pucPacket[8], pucPacket[9]);
+                    if(ip_addr_isany(&g_sTelemetryAddr) && g_psTelnetPCB)
+                    {
+                        g_sTelemetryAddr = g_psTelnetPCB->remote_ip;
+                    }
+                }
+                else
+                {
+                    g_usTelemetryPort = 0;
+                }
+
+                //
+                // Start the batched stream over UDP in place of the other
+                // streams, provided that there is somewhere to send it.
                 //
                 g_bEnableRealTimeData = false;
+                g_bSendBatchData = false;
+                g_bTelemetryUDP = false;
+                if(g_psTelemetryPCB && g_usTelemetryPort &&
+                   !ip_addr_isany(&g_sTelemetryAddr))
+                {
+                    g_ulTelemetrySequence = 0;
+                    g_bTelemetryUDP = true;
+                    ucSum = TelemetryStart(g_pulUIRealTimeData, ucSum);
+                }
+                else
+                {
+                    TelemetryStop();
+                    ucSum = 0;
+                }
+
+                //
+                // Fill in the response.
+                //
+                g_pucUIEthernetResponse[0] = TAG_STATUS;
+                g_pucUIEthernetResponse[1] = 0x05;
+                g_pucUIEthernetResponse[2] = CMD_START_DATA_UDP;
+                g_pucUIEthernetResponse[3] = ucSum;
 
                 //
                 // Send the response.
@@ -1408,6 +2170,44 @@ UIEthernetScanReceive(void)
                 break;
             }
 
+            //
+            // The command to control the input capture.
+            //
+            case CMD_CAPTURE:
+            {
+                //
+                // Perform the capture operation and send the response.
+                //
+                if(ucSize > 4)
+                {
+                    UIEthernetCapture(ucSize);
+                }
+
+                //
+                // Done with this command.
+                //
+                break;
+            }
+
+            //
+            // The command to control the scope.
+            //
+            case CMD_SCOPE:
+            {
+                //
+                // Perform the scope operation and send the response.
+                //
+                if(ucSize > 4)
+                {
+                    UIEthernetScope(ucSize);
+                }
+
+                //
+                // Done with this command.
+                //
+                break;
+            }
+
             //
             // The command to start the motor drive.
             //
@@ -1507,9 +2307,21 @@ UIEthernetScanReceive(void)
         //
         // Skip this command packet.
         //
-        g_ulUIEthernetReceiveRead =
-            (g_ulUIEthernetReceiveRead + ucSize) % UIETHERNET_MAX_RECV;
+        g_ulUIEthernetReceiveRead += ucSize;
+    }
+
+    //
+    // Move any partial packet that remains to the start of the receive
+    // buffer, so that the rest of it can follow.
+    //
+    for(ulIdx = 0; g_ulUIEthernetReceiveRead != g_ulUIEthernetReceiveWrite;
+        ulIdx++)
+    {
+        g_pucUIEthernetReceive[ulIdx] =
+            g_pucUIEthernetReceive[g_ulUIEthernetReceiveRead++];
     }
+    g_ulUIEthernetReceiveRead = 0;
+    g_ulUIEthernetReceiveWrite = ulIdx;
 }
 
 //*****************************************************************************
@@ -1534,6 +2346,11 @@ UIEthernetSent(void *arg, struct tcp_pcb *pcb, u16_t len)
     //
     g_ulConnectionTimeout = 0;
 
+    //
+    // Free the status packet buffers that have been acknowledged.
+    //
+    UIEthernetXmitRelease(len);
+
     //
     // Return OK.
     //
@@ -1711,33 +2528,32 @@ UIEthernetReceive(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
         // 
         tcp_recved(pcb, p->tot_len);
 
+        //
+        // Hold the responses to the packet, to send them together.
+        //
+        g_bUIEthernetXmitHold = true;
+
         //
         // Process the packet.
         //
-        for(q = p, pucData = q->payload; q != NULL; q = q->next)
+        for(q = p; q != NULL; q = q->next)
         {
-            for(ulIdx = 0; ulIdx < q->len; ulIdx++)
+            for(ulIdx = 0, pucData = q->payload; ulIdx < q->len; ulIdx++)
             {
                 //
-                // Copy the next character into the receive buffer.
-                //
-                g_pucUIEthernetReceive[g_ulUIEthernetReceiveWrite] =
-                    pucData[ulIdx];
-
-                //
-                // Increment the receive buffer write pointer.
+                // Scan the receive buffer for command packets if it is full,
+                // which always makes room for more characters.
                 //
-                g_ulUIEthernetReceiveWrite =
-                    (g_ulUIEthernetReceiveWrite + 1) % UIETHERNET_MAX_RECV;
-
-                //
-                // Scan the receive buffer for command packets if it is full.
-                //
-                if(((g_ulUIEthernetReceiveWrite + 1) % UIETHERNET_MAX_RECV) ==
-                    g_ulUIEthernetReceiveRead)
+                if(g_ulUIEthernetReceiveWrite == UIETHERNET_MAX_RECV)
                 {
                     UIEthernetScanReceive();
                 }
+
+                //
+                // Copy the next character into the receive buffer.
+                //
+                g_pucUIEthernetReceive[g_ulUIEthernetReceiveWrite++] =
+                    pucData[ulIdx];
             }
         }
 
@@ -1746,6 +2562,19 @@ UIEthernetReceive(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
         //
         UIEthernetScanReceive();
 
+        //
+        // Send the responses to the packet in one TCP output.
+        //
+        g_bUIEthernetXmitHold = false;
+        if(g_bUIEthernetXmitHeld)
+        {
+            g_bUIEthernetXmitHeld = false;
+            if(tcp_output(pcb) != ERR_OK)
+            {
+                g_ulTxOutError++;
+            }
+        }
+
         //
         // Free the pbuf.
         //
@@ -1753,10 +2582,19 @@ UIEthernetReceive(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
     }
 
     //
-    // If a null packet is passed in, close the connection.
+    // If a null packet is passed in, the remote end has closed the
+    // connection, so close it too.  A closed connection keeps sending its
+    // unacknowledged packets, and is freed by TCP without telling us, so if
+    // any of them are still in the status packet buffers it is aborted
+    // instead, so that the buffers can be reused by the next connection.
     //
     else if((err == ERR_OK) && (p == NULL))
     {
+        if(UIEthernetXmitBusy())
+        {
+            UIEthernetAbort(pcb);
+            return(ERR_ABRT);
+        }
         UIEthernetClose(pcb);
     }
 
@@ -1791,6 +2629,12 @@ UIEthernetPoll(void *arg, struct tcp_pcb *pcb)
     {
         tcp_abort(g_psTelnetPCB);
         g_psTelnetPCB = NULL;
+
+        //
+        // Tell TCP that the connection has been aborted, so that it does not
+        // use it again.
+        //
+        return ERR_ABRT;
     }
     return ERR_OK;
 }
@@ -1840,11 +2684,21 @@ UIEthernetAccept(void *arg, struct tcp_pcb *pcb, err_t err)
     if(g_psTelnetPCB)
     {
         //
-        // If we already have a connection, kill it and start over.
+        // If we already have a connection, kill it and start over.  It is
+        // aborted rather than closed, since a closing connection would keep
+        // sending its unacknowledged packets from the status packet buffers
+        // that are about to be reused.
         //
-        UIEthernetClose(g_psTelnetPCB);
+        UIEthernetAbort(g_psTelnetPCB);
     }
 
+    //
+    // Start the new connection with all of the status packet buffers free.
+    // The previous connection, if any, has been aborted, so none of its
+    // packets still refer to them.
+    //
+    UIEthernetXmitReset();
+
     //
     // Set the connection timeout to 0.
     //
@@ -1911,7 +2765,7 @@ void
 UIEthernetSendRealTimeData(void)
 {
     unsigned long ulIdx, ulPos, ulItem, ulCount;
-    unsigned char pucValue[4];
+    unsigned char pucValue[16];
     static tBoolean bReady = true;
 
     //
@@ -1954,6 +2808,16 @@ UIEthernetSendRealTimeData(void)
         //
         if(g_pulUIRealTimeData[ulIdx / 32] & (1 << (ulIdx % 32)))
         {
+            //
+            // Stop adding items if this one, and the checksum, will not fit
+            // in the packet.
+            //
+            if((ulPos + g_sUIRealTimeData[ulItem].ucSize + 1) >
+               UIETHERNET_MAX_XMIT)
+            {
+                break;
+            }
+
             //
             // Perform an atomic copy of the value to a local variable.  This
             // prevents the value from being changed midway through adding it
@@ -2014,6 +2878,42 @@ UIEthernetGetIPAddress(void)
     return(lwIPLocalIPAddrGet());
 }
 
+//*****************************************************************************
+//
+//! Fills in the table of parameter indices.
+//!
+//! This function fills in g_pucUIEthernetParameterIndex from the parameter
+//! list.  If two parameters have the same ID, the first one in the list is
+//! found, as it was when the list was searched.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void
+UIEthernetInitParameters(void)
+{
+    unsigned long ulIdx;
+
+    //
+    // Start with no parameter for any ID.
+    //
+    for(ulIdx = 0; ulIdx < 256; ulIdx++)
+    {
+        g_pucUIEthernetParameterIndex[ulIdx] = 0xff;
+    }
+
+    //
+    // Enter each parameter, working back from the end of the list so that the
+    // first parameter with a given ID is the one that is kept.  Only the
+    // first 255 parameters can be entered, since 0xff marks an empty entry.
+    //
+    ulIdx = (g_ulUINumParameters < 0xff) ? g_ulUINumParameters : 0xff;
+    while(ulIdx--)
+    {
+        g_pucUIEthernetParameterIndex[g_sUIParameters[ulIdx].ucID] = ulIdx;
+    }
+}
+
 //*****************************************************************************
 //
 //! Initialize the real time data.
@@ -2085,6 +2985,11 @@ UIEthernetInit(tBoolean bUseDHCP)
     pucMACArray[4] = 0x7a;
     pucMACArray[5] = 0x47;
 
+    //
+    // Fill in the table of parameter indices before any command can arrive.
+    //
+    UIEthernetInitParameters();
+
     //
     // Initialize lwIP
     //
@@ -2107,6 +3012,12 @@ UIEthernetInit(tBoolean bUseDHCP)
     udp_bind(pcb, IP_ADDR_ANY, UI_QUERY_PORT);
     udp_connect(pcb, IP_ADDR_ANY, UI_QUERY_PORT);
 
+    //
+    // Create the UDP PCB for the real-time data stream, which is sent from
+    // an ephemeral port to the host given to CMD_START_DATA_UDP.
+    //
+    g_psTelemetryPCB = udp_new();
+
     //
     // Initialize the real time stream data
     //
@@ -2136,6 +3047,37 @@ UIEthernetTick(unsigned long ulTickMS)
     lwIPTimer(ulTickMS);
 }
 
+//*****************************************************************************
+//
+//! Handles the Ethernet interrupt.
+//!
+//! This function is called when the Ethernet controller asserts its
+//! interrupt, and when the lwIP timer triggers it from software.  It runs the
+//! lwIP interrupt handler, which performs all of the TCP/IP processing,
+//! under the interrupt handler profiler.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void
+UIEthernetIntHandler(void)
+{
+    //
+    // Mark the start of this handler for the profiler.
+    //
+    ISRProfileStart(ISR_PROFILE_ETHERNET);
+
+    //
+    // Redirect to the lwIP interrupt handler.
+    //
+    lwIPEthernetIntHandler();
+
+    //
+    // Mark the end of this handler for the profiler.
+    //
+    ISRProfileEnd(ISR_PROFILE_ETHERNET);
+}
+
 //*****************************************************************************
 //
 //! Handles the Ethernet interrupt hooks for the client software.
@@ -2157,6 +3099,35 @@ lwIPHostTimerHandler(void)
         UIEthernetTransmit(g_pucUIEthernetData);
         g_bSendRealTimeData = false;
     }
+
+    //
+    // Send the batched real-time data packets that are ready over UDP, if
+    // that is where they go.  A datagram is never sent again; the host finds
+    // the loss from the sequence numbers instead.
+    //
+    if(g_bTelemetryUDP)
+    {
+        while(TelemetryFrame(g_pucUIEthernetBatch))
+        {
+            UIEthernetTransmitUDP(g_pucUIEthernetBatch);
+        }
+        return;
+    }
+
+    //
+    // Otherwise send them on the TCP connection.  A packet that could not be
+    // sent is kept and sent again next time, while without a connection the
+    // packets are dropped.
+    //
+    while(g_bSendBatchData || TelemetryFrame(g_pucUIEthernetBatch))
+    {
+        if(g_psTelnetPCB && !UIEthernetTransmit(g_pucUIEthernetBatch))
+        {
+            g_bSendBatchData = true;
+            break;
+        }
+        g_bSendBatchData = false;
+    }
 }
 
 //*****************************************************************************
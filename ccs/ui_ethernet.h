@@ -38,6 +38,7 @@ extern volatile unsigned long g_ulConnectionTimeoutParameter;
 extern void UIEthernetSendRealTimeData(void);
 extern void UIEthernetInit(tBoolean bUseDHCP);
 extern void UIEthernetTick(unsigned long ulTickMS);
+extern void UIEthernetIntHandler(void);
 extern unsigned long UIEthernetGetIPAddress(void);
 
 #endif // __UI_ETHERNET_H__
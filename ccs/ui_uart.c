@@ -7,9 +7,11 @@
 #include "driverlib/sysctl.h"
 #include "driverlib/uart.h"
 #include "string.h"
+#include "capture.h"
 #include "faults.h"
 #include "main.h"
 #include "ui.h"
+#include "ui_uart.h"
 #include "stdio.h"
 
 #define UART_IDLE  0
@@ -17,176 +19,450 @@
 #define UART_WRITE 2
 
 
-//header length = 1(0xff) + header string length + 1(number of byte)
+//header length = 1(0xfe) + header string length + 1(number of byte)
 #define UART_HEADER_LENGTH 9
 #define UART_HEADER_STRING_LENGTH 7
 #define UART_WREAD_LENGTH 7
 #define UART_SREAD_LENGTH 24
+#define UART_SREAD_SEQ_LENGTH 27
 #define UART_CREAD_LENGTH 64
 #define UART_MAX_WRITE_LENGTH 128
-#define UART_MAX_RECV_LENGTH 128
+
+//the byte that starts every frame from the handpiece
+#define UART_FRAME_START 0xfe
+
+//the size of the receive ring buffer, which must be 256 so that it wraps
+//with its unsigned char index
+#define UART_RX_BUF_SIZE 256
+
+//the size of the transmit ring buffer, which must be a power of two
+#define UART_TX_BUF_SIZE 128
+
+//the baud rate of the handpiece link when the handpiece is connected or reset
+#define UART_BAUD_DEFAULT 115200
+
+//the frame types, which are also the bits of the header match mask
+#define UART_FRAME_CMD  0
+#define UART_FRAME_STRM 1
+#define UART_NUM_FRAME_TYPES 2
+
+//the framer states
+#define UART_RX_HUNT   0
+#define UART_RX_HEADER 1
+#define UART_RX_LENGTH 2
+#define UART_RX_DATA   3
 
 volatile int uartState = UART_IDLE;
 
-char uartCmdHeader[] = "CommRpl";
-char uartStrmHeader[]= "StrmRpl";
+//*****************************************************************************
+//
+// The number of received frames that were lost, either because the previous
+// frame of the same type had not yet been taken, because the receive ring
+// had nearly wrapped over a frame before it was taken, or because the UART
+// receive FIFO overran.
+//
+//*****************************************************************************
+volatile unsigned long g_ulUARTRxOverflow = 0;
+
+//*****************************************************************************
+//
+// The number of times the framer lost a frame and went back to hunting for
+// the start of the next one, because of a header that matched no frame type,
+// a length that is not valid for the frame type, or a bad checksum.
+//
+//*****************************************************************************
+volatile unsigned long g_ulUARTRxResync = 0;
 
+//*****************************************************************************
+//
+// The CRC-8 (polynomial 0x07) of each byte value, as computed by crc8_add()
+// with an initial value of zero.
+//
+//*****************************************************************************
+static const unsigned char uartCrcTable[256] =
+{
+    0x00, 0x07, 0x0e, 0x09, 0x1c, 0x1b, 0x12, 0x15,
+    0x38, 0x3f, 0x36, 0x31, 0x24, 0x23, 0x2a, 0x2d,
+    0x70, 0x77, 0x7e, 0x79, 0x6c, 0x6b, 0x62, 0x65,
+    0x48, 0x4f, 0x46, 0x41, 0x54, 0x53, 0x5a, 0x5d,
+    0xe0, 0xe7, 0xee, 0xe9, 0xfc, 0xfb, 0xf2, 0xf5,
+    0xd8, 0xdf, 0xd6, 0xd1, 0xc4, 0xc3, 0xca, 0xcd,
+    0x90, 0x97, 0x9e, 0x99, 0x8c, 0x8b, 0x82, 0x85,
+    0xa8, 0xaf, 0xa6, 0xa1, 0xb4, 0xb3, 0xba, 0xbd,
+    0xc7, 0xc0, 0xc9, 0xce, 0xdb, 0xdc, 0xd5, 0xd2,
+    0xff, 0xf8, 0xf1, 0xf6, 0xe3, 0xe4, 0xed, 0xea,
+    0xb7, 0xb0, 0xb9, 0xbe, 0xab, 0xac, 0xa5, 0xa2,
+    0x8f, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9d, 0x9a,
+    0x27, 0x20, 0x29, 0x2e, 0x3b, 0x3c, 0x35, 0x32,
+    0x1f, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0d, 0x0a,
+    0x57, 0x50, 0x59, 0x5e, 0x4b, 0x4c, 0x45, 0x42,
+    0x6f, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7d, 0x7a,
+    0x89, 0x8e, 0x87, 0x80, 0x95, 0x92, 0x9b, 0x9c,
+    0xb1, 0xb6, 0xbf, 0xb8, 0xad, 0xaa, 0xa3, 0xa4,
+    0xf9, 0xfe, 0xf7, 0xf0, 0xe5, 0xe2, 0xeb, 0xec,
+    0xc1, 0xc6, 0xcf, 0xc8, 0xdd, 0xda, 0xd3, 0xd4,
+    0x69, 0x6e, 0x67, 0x60, 0x75, 0x72, 0x7b, 0x7c,
+    0x51, 0x56, 0x5f, 0x58, 0x4d, 0x4a, 0x43, 0x44,
+    0x19, 0x1e, 0x17, 0x10, 0x05, 0x02, 0x0b, 0x0c,
+    0x21, 0x26, 0x2f, 0x28, 0x3d, 0x3a, 0x33, 0x34,
+    0x4e, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5c, 0x5b,
+    0x76, 0x71, 0x78, 0x7f, 0x6a, 0x6d, 0x64, 0x63,
+    0x3e, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2c, 0x2b,
+    0x06, 0x01, 0x08, 0x0f, 0x1a, 0x1d, 0x14, 0x13,
+    0xae, 0xa9, 0xa0, 0xa7, 0xb2, 0xb5, 0xbc, 0xbb,
+    0x96, 0x91, 0x98, 0x9f, 0x8a, 0x8d, 0x84, 0x83,
+    0xde, 0xd9, 0xd0, 0xd7, 0xc2, 0xc5, 0xcc, 0xcb,
+    0xe6, 0xe1, 0xe8, 0xef, 0xfa, 0xfd, 0xf4, 0xf3
+};
+
+//*****************************************************************************
+//
+// The frame types, giving the header string that identifies each and the
+// range of total frame lengths that are accepted for it.  The header strings
+// differ in their first character, so only one type is left matching by the
+// time the length byte arrives.
+//
+//*****************************************************************************
 typedef struct
 {
-	char rcvBuff[UART_MAX_RECV_LENGTH];
-	char rcvBuffStrm[UART_SREAD_LENGTH];
-    char rcvBuffCmd[UART_CREAD_LENGTH];
-    char rcvBuffHeader[UART_HEADER_LENGTH];
-    char hTop;     //header string current position
-    char sPos;     //stream receive data current postion
-    char cPos;     //command receive buffer current position
-    char slength;  //stream receive data section length
-    char clength;  //command receive data section length
-    char hType;    //hearder type
-    volatile char sReadDone;//flag for completed stream read
-    volatile char cReadDone;//flag for compeleted command read
-    char needNewHeader;
-    char head;
-    char tail;
-}uartRecvBufStruct;
+    char header[UART_HEADER_STRING_LENGTH]; //the header string, unterminated
+    unsigned char minLength;    //the shortest frame, with no data
+    unsigned char maxLength;    //the longest frame
+}uartFrameTypeStruct;
 
-uartRecvBufStruct uartRecvBuf;
+static const uartFrameTypeStruct uartFrameType[UART_NUM_FRAME_TYPES] =
+{
+    { "CommRpl", UART_HEADER_LENGTH + 1, UART_CREAD_LENGTH },
+    { "StrmRpl", UART_SREAD_LENGTH, UART_SREAD_SEQ_LENGTH }
+};
 
 //*****************************************************************************
 //
-// The UART receiving processor.
+// The receive ring buffer.  Each byte is parsed by uart_rx_byte() as it is
+// taken from the receive FIFO, in the UART interrupt, and is stored in the
+// ring.  The first UART_CREAD_LENGTH bytes of the ring are mirrored past its
+// end, so that every frame is contiguous in the ring wherever it starts;
+// a completed frame is handed on by a descriptor pointing at it in the ring
+// rather than by a copy.  The frame stays valid until the ring wraps back
+// over it, which is at least 192 bytes later; that is over 16ms at 115,200
+// baud but only 2ms at 921,600 baud, less than the 5ms user interface tick
+// that takes the stream frames.  A newer frame of the same type replaces the
+// descriptor as it completes, so only the bytes that are not such a frame
+// count against the ring, but uart_frame_take() also counts the bytes that
+// have been received since the frame, and drops it if the ring has come
+// within UART_RX_HEADROOM bytes of it.  The consumers are done with a frame
+// well within that headroom (0.7ms at 921,600 baud) of taking it;
+// ui_uart_process() copies a reply as soon as it is taken, and
+// UIGetHandPieceData() reads the stream data in the same call that takes it.
 //
 //*****************************************************************************
-int uart_process_rcv(void)
+static unsigned char uartRxBuf[UART_RX_BUF_SIZE + UART_CREAD_LENGTH];
+
+//the bytes of the ring left to a consumer once it has taken a frame
+#define UART_RX_HEADROOM UART_CREAD_LENGTH
+
+typedef struct
 {
-	char tChar;
+    unsigned char state;        //the framer state
+    unsigned char write;        //where the next byte is stored in the ring
+    unsigned char start;        //where the current frame starts in the ring
+    unsigned char pos;          //the number of bytes of the frame received
+    unsigned char length;       //the total length of the frame
+    unsigned char type;         //the type of the frame
+    unsigned char match;        //the types still matching the header
+    unsigned char crc;          //the checksum of the bytes received so far
+    unsigned long count;        //the number of bytes received
+}uartFramerStruct;
+
+static uartFramerStruct uartFramer;
 
-    //check if buffer is empty
+//*****************************************************************************
+//
+// The latest completed frame of each type, which is set by the UART interrupt
+// and taken by uart_frame_take().
+//
+//*****************************************************************************
+typedef struct
+{
+    const unsigned char *frame; //the frame, in the receive ring
+    unsigned char length;       //the total length of the frame
+    volatile unsigned char ready; //the frame has not yet been taken
+    unsigned long time;         //when the last byte was received
+    unsigned long end;          //the byte count after the last byte
+}uartFrameStruct;
 
-    while (uartRecvBuf.head != uartRecvBuf.tail)
-    {
+static uartFrameStruct uartFrame[UART_NUM_FRAME_TYPES];
 
-    	if(uartRecvBuf.head >= UART_MAX_RECV_LENGTH)
-    	{
-    		uartRecvBuf.head -= UART_MAX_RECV_LENGTH;
-    	}
+//*****************************************************************************
+//
+// A stream frame replayed from the capture buffer, which does not come
+// through the receive ring.
+//
+//*****************************************************************************
+static unsigned char uartReplayFrame[UART_SREAD_SEQ_LENGTH];
 
-    	// get one byte from the buffer
-    	tChar = uartRecvBuf.rcvBuff[uartRecvBuf.head++];
+//the baud rate of the handpiece link
+static unsigned long uartBaud = UART_BAUD_DEFAULT;
 
-    	// shift the char to appropriate buffer
-    	if(uartRecvBuf.hType ==1)
-    	{
-    		//copy over the last byte
-    		uartRecvBuf.rcvBuffCmd[uartRecvBuf.cPos] = tChar;
-
-    		if(uartRecvBuf.cPos == uartRecvBuf.clength -1)
-    		{
-    			// done reading, reset flags
-    			uartRecvBuf.cReadDone =1;
-    			uartRecvBuf.cPos =0;
-    			uartRecvBuf.hTop =0;
-    			uartRecvBuf.hType =0;
-    			uartRecvBuf.needNewHeader =1;
-    			break;
-    		}
-    		else
-    		{
-    			uartRecvBuf.cPos++;
-
-    		}
-    	}
-    	else if(uartRecvBuf.hType ==2)
-    	{
-    		//copy over the last byte
-    		uartRecvBuf.rcvBuffStrm[uartRecvBuf.sPos] = tChar;
-
-    		if(uartRecvBuf.sPos == uartRecvBuf.slength-1)
-    		{
-    			// done reading, reset flags
-    			uartRecvBuf.sReadDone =1;
-    			uartRecvBuf.sPos =0;
-    			uartRecvBuf.hTop =0;
-    			uartRecvBuf.hType =0;
-    			uartRecvBuf.needNewHeader =1;
-    			break;
-    		}
-    		else
-    		{
-    			uartRecvBuf.sPos++;
-    		}
-    	}
+//*****************************************************************************
+//
+// The transmit ring buffer.  ui_uart_send() places a whole frame in the ring
+// and returns; the frame is moved into the UART transmit FIFO by
+// uart_tx_fill(), first when it is queued and then from the transmit
+// interrupt each time the FIFO drains below its trigger level.  The head is
+// only advanced by uart_tx_fill(), and the tail only by ui_uart_send().
+//
+//*****************************************************************************
+static char uartTxBuf[UART_TX_BUF_SIZE];
+static volatile unsigned long uartTxHead = 0;
+static volatile unsigned long uartTxTail = 0;
 
-    	// start accumulate the header by reset header top position.
-    	if( uartRecvBuf.needNewHeader )
-    	{
-    		if(tChar == 0xfe)
-    		{
-    			uartRecvBuf.hTop =0;
-    		}
-
-    		if(uartRecvBuf.hTop < UART_HEADER_LENGTH)
-    		{
-
-    			// collect header
-    			uartRecvBuf.rcvBuffHeader[uartRecvBuf.hTop] = tChar;
-
-    		}
-
-    		if(uartRecvBuf.hTop == UART_HEADER_LENGTH -1)
-    		{
-    			//decide which buffer to use
-    			if(strncmp((char *)(&uartRecvBuf.rcvBuffHeader[1]),uartCmdHeader,7)==0)
-    			{
-    				//last byte in the header is the data length
-    				uartRecvBuf.clength = (int)uartRecvBuf.rcvBuffHeader[uartRecvBuf.hTop];
-    				uartRecvBuf.hType =1;
-    				memcpy(uartRecvBuf.rcvBuffCmd,uartRecvBuf.rcvBuffHeader,UART_HEADER_LENGTH);
-    				uartRecvBuf.cPos = UART_HEADER_LENGTH;
-    				uartRecvBuf.needNewHeader =0;
-    			}
-    			else if(strncmp((char *)(&uartRecvBuf.rcvBuffHeader[1]),uartStrmHeader,7)==0)
-    			{
-    				uartRecvBuf.slength = (int)uartRecvBuf.rcvBuffHeader[uartRecvBuf.hTop];
-    				if(uartRecvBuf.slength != UART_SREAD_LENGTH)
-    				{
-    					uartRecvBuf.hTop =0;
-    					uartRecvBuf.slength = 0;
-    				}
-    				else
-    				{
-    					uartRecvBuf.hType =2;
-    					memcpy(uartRecvBuf.rcvBuffStrm,uartRecvBuf.rcvBuffHeader,UART_HEADER_LENGTH);
-    					uartRecvBuf.sPos = UART_HEADER_LENGTH;
-    					uartRecvBuf.needNewHeader =0;
-    				}
-    			}
-    			else //wrong header, keep collecting
-    			{
-    				uartRecvBuf.hTop =0;
-    			}
-
-    		}
-    		else
-    		{
-    			uartRecvBuf.hTop++;
-    		}
-    	}
+//*****************************************************************************
+//
+// The handpiece request queue.  Commands to the handpiece are queued by
+// ui_uart_request() and are sent one at a time by ui_uart_process(), which is
+// run from the main loop; each request is queued, then sent, then completed
+// by its reply or by a timeout, at which point its callback is called.  The
+// timeout of the request in flight is counted down by ui_uart_tick(), which
+// is run from the user interface tick.  The stream frames from the handpiece
+// are taken by ui_uart_stream() and never wait for a request.
+//
+//*****************************************************************************
+#define UART_NUM_REQUESTS 16
+#define UART_MAX_CMD_LENGTH 24
 
-    }
+//the time to wait for the reply to a command, in milliseconds
+#define UART_REQ_TIMEOUT_MS 500
 
-    //check if a read is complete, and return accordingly
-    if(uartRecvBuf.cReadDone || uartRecvBuf.sReadDone)
-    {
-    	return 1;
-    }
-    else
-    {
-    	return -1;
-    }
+//the limit of the stream frame age, in milliseconds
+#define UART_STREAM_AGE_MAX 60000
+
+//the states of a request
+#define UART_REQ_FREE   0
+#define UART_REQ_QUEUED 1
+#define UART_REQ_SENT   2
+
+typedef struct
+{
+    volatile char state;        //the state of the request
+    char cmd[UART_MAX_CMD_LENGTH]; //the command, without the checksum
+    int cmdLength;              //the length of the command
+    char *reply;                //where the reply data is copied to
+    int replySize;              //the size of the reply buffer
+    tUARTCallback pfnCallback;  //called when the request completes
+    void *pvCBData;             //passed to the callback
+}uartRequestStruct;
+
+static uartRequestStruct uartRequest[UART_NUM_REQUESTS];
+
+//the request in flight or next to be sent, and the next free request
+static volatile unsigned char uartReqHead = 0;
+static volatile unsigned char uartReqTail = 0;
+
+//the milliseconds left to wait for the reply to the request in flight
+static volatile unsigned long uartReqTimeout = 0;
+
+//the milliseconds since the last stream frame
+static volatile unsigned long uartStreamAge = 0;
+
+//*****************************************************************************
+//
+// Starts hunting for the next frame, beginning with the given byte if it is
+// the start of a frame.
+//
+//*****************************************************************************
+static void uart_rx_hunt(unsigned char ch)
+{
+	if(ch == UART_FRAME_START)
+	{
+		uartFramer.state = UART_RX_HEADER;
+		uartFramer.start = uartFramer.write;
+		uartFramer.pos = 1;
+		uartFramer.match = (1 << UART_NUM_FRAME_TYPES) - 1;
+		uartFramer.crc = uartCrcTable[ch];
+	}
+	else
+	{
+		uartFramer.state = UART_RX_HUNT;
+	}
+}
+
+//*****************************************************************************
+//
+// The UART receive framer.  This is called from the UART interrupt with each
+// received byte, and runs the frame state machine a single byte at a time:
+// the header is matched against all of the frame types at once, the length
+// is checked against the frame type, and the checksum is accumulated as the
+// bytes arrive, so a frame is complete and checked as soon as its last byte
+// has been received.
+//
+//*****************************************************************************
+static void uart_rx_byte(unsigned char ch)
+{
+	uartFrameStruct *frame;
+	int i;
+
+	//store the byte, and its mirror past the end of the ring
+	uartRxBuf[uartFramer.write] = ch;
+	if(uartFramer.write < UART_CREAD_LENGTH)
+	{
+		uartRxBuf[UART_RX_BUF_SIZE + uartFramer.write] = ch;
+	}
+
+	switch(uartFramer.state)
+	{
+		case UART_RX_HUNT:
+		{
+			uart_rx_hunt(ch);
+			break;
+		}
+
+		case UART_RX_HEADER:
+		{
+			//drop the types whose header does not match this byte
+			for(i = 0; i < UART_NUM_FRAME_TYPES; i++)
+			{
+				if(uartFrameType[i].header[uartFramer.pos - 1] != ch)
+				{
+					uartFramer.match &= ~(1 << i);
+				}
+			}
+			if(!uartFramer.match)
+			{
+				g_ulUARTRxResync++;
+				uart_rx_hunt(ch);
+				break;
+			}
+			uartFramer.crc = uartCrcTable[uartFramer.crc ^ ch];
+			if(++uartFramer.pos == UART_HEADER_LENGTH - 1)
+			{
+				uartFramer.state = UART_RX_LENGTH;
+			}
+			break;
+		}
+
+		case UART_RX_LENGTH:
+		{
+			//last byte in the header is the total frame length
+			uartFramer.type = (uartFramer.match & (1 << UART_FRAME_CMD)) ?
+			                  UART_FRAME_CMD : UART_FRAME_STRM;
+			if((ch < uartFrameType[uartFramer.type].minLength) ||
+			   (ch > uartFrameType[uartFramer.type].maxLength))
+			{
+				g_ulUARTRxResync++;
+				uart_rx_hunt(ch);
+				break;
+			}
+			uartFramer.length = ch;
+			uartFramer.crc = uartCrcTable[uartFramer.crc ^ ch];
+			uartFramer.pos++;
+			uartFramer.state = UART_RX_DATA;
+			break;
+		}
+
+		case UART_RX_DATA:
+		{
+			//accumulate the checksum until the last byte, which is the checksum
+			if(++uartFramer.pos < uartFramer.length)
+			{
+				uartFramer.crc = uartCrcTable[uartFramer.crc ^ ch];
+				break;
+			}
+			if(ch != uartFramer.crc)
+			{
+				g_ulUARTRxResync++;
+				uart_rx_hunt(ch);
+				break;
+			}
+
+			//hand on the frame, losing the previous one if it was not taken
+			frame = &uartFrame[uartFramer.type];
+			if(frame->ready)
+			{
+				g_ulUARTRxOverflow++;
+			}
+			frame->frame = &uartRxBuf[uartFramer.start];
+			frame->length = uartFramer.length;
+			frame->time = UIGetTicks();
+			frame->end = uartFramer.count + 1;
+			frame->ready = 1;
+			uartFramer.state = UART_RX_HUNT;
+			break;
+		}
+	}
+
+	uartFramer.write++;
+	uartFramer.count++;
+}
+
+//*****************************************************************************
+//
+// Takes the latest completed frame of the given type, if there is one.  The
+// frame is left in the receive ring, and is returned with its header and
+// checksum, along with the time its last byte was received if time is not
+// NULL.  A frame that the ring has come within UART_RX_HEADROOM bytes of
+// overwriting is dropped, and counted as lost.
+//
+//*****************************************************************************
+static int uart_frame_take(int type, const unsigned char **frame,
+                           unsigned long *time)
+{
+	int len;
+	tBoolean bDisabled;
+
+	len = -1;
+	bDisabled = IntMasterDisable();
+	if(uartFrame[type].ready &&
+	   ((uartFramer.count - uartFrame[type].end) >
+	    (UART_RX_BUF_SIZE - uartFrame[type].length - UART_RX_HEADROOM)))
+	{
+		g_ulUARTRxOverflow++;
+		uartFrame[type].ready = 0;
+	}
+	if(uartFrame[type].ready)
+	{
+		*frame = uartFrame[type].frame;
+		len = uartFrame[type].length;
+		if(time != NULL)
+		{
+			*time = uartFrame[type].time;
+		}
+		uartFrame[type].ready = 0;
+	}
+	if(!bDisabled)
+	{
+		IntMasterEnable();
+	}
+
+	return len;
+}
+
+//*****************************************************************************
+//
+// Moves bytes from the transmit ring buffer into the UART transmit FIFO,
+// until the FIFO is full or the ring is empty.  The transmit interrupt is
+// left enabled while there are bytes still to go, and is disabled once the
+// ring is empty.  This must be called with the UART interrupt unable to run.
+//
+//*****************************************************************************
+static void uart_tx_fill(void)
+{
+	while((uartTxHead != uartTxTail) && UARTSpaceAvail(UART0_BASE))
+	{
+		UARTCharPutNonBlocking(UART0_BASE, uartTxBuf[uartTxHead]);
+		uartTxHead = (uartTxHead + 1) & (UART_TX_BUF_SIZE - 1);
+	}
+
+	if(uartTxHead != uartTxTail)
+	{
+		UARTIntEnable(UART0_BASE, UART_INT_TX);
+	}
+	else
+	{
+		UARTIntDisable(UART0_BASE, UART_INT_TX);
+	}
 }
 
-	
 //*****************************************************************************
 //
 // The UART interrupt handler.
@@ -196,7 +472,6 @@ void
 UARTIntHandler(void)
 {
     unsigned long ulStatus;
-    char tempChar;
 
     uartState = UART_READ;
 
@@ -210,6 +485,14 @@ UARTIntHandler(void)
     //
     UARTIntClear(UART0_BASE, ulStatus);
 
+    //
+    // Refill the transmit FIFO from the ring buffer.
+    //
+    if(ulStatus & UART_INT_TX)
+    {
+    	uart_tx_fill();
+    }
+
     //
     // Check interrupt type and process accordingly
     //
@@ -220,19 +503,17 @@ UARTIntHandler(void)
     	//
     	while(UARTCharsAvail(UART0_BASE))
     	{
-    		tempChar = UARTCharGetNonBlocking(UART0_BASE);
-
-    		if(uartRecvBuf.tail >= UART_MAX_RECV_LENGTH)
-    		{
-    			uartRecvBuf.tail = uartRecvBuf.tail - UART_MAX_RECV_LENGTH;
-    		}
-
-    		uartRecvBuf.rcvBuff[uartRecvBuf.tail++] = tempChar;
-
+    		uart_rx_byte(UARTCharGetNonBlocking(UART0_BASE));
     	}
     }
-    else if(ulStatus)
+    else if(ulStatus & ~UART_INT_TX)
     {
+    	//count an overrun, since bytes have been lost
+    	if(ulStatus & UART_INT_OE)
+    	{
+    		g_ulUARTRxOverflow++;
+    	}
+
     	//clear the error
     	UARTRxErrorClear(UART0_BASE);
     }
@@ -248,15 +529,16 @@ void ui_uart_init_buffer(void)
     //
     // Init Receive buffer
     //
-    uartRecvBuf.hTop = 0;
-    uartRecvBuf.hType =0; //default is streaming
-    uartRecvBuf.sReadDone =0;
-    uartRecvBuf.cReadDone =0;
-    uartRecvBuf.needNewHeader =1;
-    uartRecvBuf.slength =0;
-    uartRecvBuf.clength =0;
-    uartRecvBuf.head =0;
-    uartRecvBuf.tail =0;
+    uartFramer.state = UART_RX_HUNT;
+    uartFramer.write = 0;
+    uartFrame[UART_FRAME_CMD].ready = 0;
+    uartFrame[UART_FRAME_STRM].ready = 0;
+
+    //
+    // Init Transmit buffer
+    //
+    uartTxHead = 0;
+    uartTxTail = 0;
 }
 /*
  * Function to initialize uart
@@ -293,12 +575,14 @@ int ui_uart_init(void)
     IntMasterEnable();
 
     //
-    // Configure the UART for 115,200, 8-N-1 operation.
+    // Configure the UART for 115,200, 8-N-1 operation, which is what the
+    // handpiece uses until it is told otherwise.
     // This function uses SysCtlClockGet() to get the system clock
     // frequency.  This could be also be a variable or hard coded value
     // instead of a function call.
     //
-    UARTConfigSetExpClk(UART0_BASE, SysCtlClockGet(), 115200,
+    uartBaud = UART_BAUD_DEFAULT;
+    UARTConfigSetExpClk(UART0_BASE, SysCtlClockGet(), uartBaud,
                         (UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE |
                          UART_CONFIG_PAR_NONE));
 
@@ -334,161 +618,375 @@ int ui_uart_init(void)
  */
 unsigned char crc8_add( unsigned char inCrc, unsigned char inData )
 {
-    int i;
-    unsigned int  data;
-
-    data = (unsigned int)inCrc ^ (unsigned int)inData;
-    data = data<<8;
-  
-    for ( i = 0; i < 8; i++ ) 
-    {
-        if (( data & 0x8000 ) != 0 )
-        {
-            data = data ^ (0x1070U << 3);
-        }
-        data = data << 1;
-    }
-    return (unsigned char)( data >> 8 );
+    return uartCrcTable[inCrc ^ inData];
 
 } // Crc8
 
 /*
- * function to send uart command,
+ * function to send uart command, the command and its checksum are placed in
+ * the transmit ring buffer and sent by the transmit interrupt, so this
+ * returns at once.  The command buffer is not modified.
  */
 
 int ui_uart_send( char *charCmd, int length)
 {
 	int i;
-	unsigned char crc;	
-	
+	unsigned char crc;
+	unsigned long tail;
+	tBoolean bDisabled;
+
 	//update state
 	uartState = UART_WRITE;
-	
-	//check length
-	if(length > UART_MAX_WRITE_LENGTH)
-	{ 
+
+	//check length, the ring must have room for the command and checksum
+	if((length > UART_MAX_WRITE_LENGTH) ||
+	   (((uartTxHead - uartTxTail - 1) & (UART_TX_BUF_SIZE - 1)) <
+	    (unsigned long)(length + 1)))
+	{
 	    return(-1);
 	}
-	
-	//calculate and append checksum
+
+	//copy the command to the ring, calculating the checksum as it goes
 	crc = 0;
-    for (i =0; i< length; i++)
-    {
-        crc = crc8_add(crc, charCmd[i]);
-    }
-    
-    //append crc and add proper termination
-    charCmd[length]= crc;
-	
-	//now start writing
-	for(i=0; i<= length; i++)
+	tail = uartTxTail;
+	for (i =0; i< length; i++)
 	{
-		UARTCharPutNonBlocking(UART0_BASE, charCmd[i]);
-		// give a little delay ~ 3 us
-		SysCtlDelay(500);
+		crc = crc8_add(crc, charCmd[i]);
+		uartTxBuf[tail] = charCmd[i];
+		tail = (tail + 1) & (UART_TX_BUF_SIZE - 1);
+	}
+
+	//append crc
+	uartTxBuf[tail] = crc;
+	tail = (tail + 1) & (UART_TX_BUF_SIZE - 1);
+
+	//queue the frame and start it off
+	bDisabled = IntMasterDisable();
+	uartTxTail = tail;
+	uart_tx_fill();
+	if(!bDisabled)
+	{
+		IntMasterEnable();
 	}
 
     return(1);
 }
-/*
- * Function to receive uart reply
- */
 
-int ui_uart_receive(char *rxData, char *cmdData)
+//*****************************************************************************
+//
+// Takes the latest stream frame from the handpiece.
+//
+// This never waits; it returns the length of the stream data and points
+// *ppucData at it, or returns -1 if no new stream frame has been received.
+// The data is not copied; it is left in the receive ring, so it must be read
+// at once, and is not valid after the next call.  *pulTime is set
+// to the time, in UIGetTicks() clocks, at which the handpiece started to send
+// the frame.
+//
+//*****************************************************************************
+int ui_uart_stream(const unsigned char **ppucData, unsigned long *pulTime)
 {
-	//unsigned short crc;
-	int i;
-	unsigned char crc;	
+	const unsigned char *frame;
+	unsigned long ulLength, ulTime;
+	unsigned char crc;
+	unsigned long i;
 	int len;
-	char *rcvPnt = NULL;
-	char *uBufPnt = NULL;
-	
-	// this is a blocking call;
-	if(uart_process_rcv() ==-1)
+
+	// take the stream frame, which the framer has already checked; the
+	// time is only set if there is one
+	frame = uartReplayFrame;
+	ulTime = 0;
+	len = uart_frame_take(UART_FRAME_STRM, &frame, &ulTime);
+	ulLength = (len == -1) ? 0 : len;
+
+	// replace it with a recorded one, which is checked here
+	if(g_ulCaptureMode == CAPTURE_MODE_REPLAY)
+	{
+		if(!CaptureFrame(uartReplayFrame, &ulLength, UART_SREAD_SEQ_LENGTH,
+		                 len != -1) ||
+		   (ulLength < UART_SREAD_LENGTH))
+		{
+			return -1;
+		}
+		crc = 0;
+		for (i = 0; i < ulLength - 1; i++)
+		{
+			crc = uartCrcTable[crc ^ uartReplayFrame[i]];
+		}
+		if(crc != uartReplayFrame[ulLength-1])
+		{
+			return -1;
+		}
+		frame = uartReplayFrame;
+		ulTime = UIGetTicks();
+	}
+
+	// or record it
+	else if(!CaptureFrame((unsigned char *)frame, &ulLength, ulLength,
+	                      len != -1))
 	{
 		return -1;
-    }
-	
-	//now copy the data over
-	if(uartRecvBuf.sReadDone)
+	}
+
+	uartStreamAge = 0;
+	*ppucData = frame + UART_HEADER_LENGTH;
+
+	// take off the time taken to send the frame, at ten bits per byte
+	*pulTime = ulTime - (ulLength * 10 * (SYSTEM_CLOCK / uartBaud));
+	return ulLength - UART_HEADER_LENGTH - 1;
+}
+
+//*****************************************************************************
+//
+// Changes the baud rate of the handpiece link.
+//
+// This is used once the handpiece has agreed to change its baud rate, and
+// must not be used while a command is being sent.  Any partly received frame
+// is dropped.  Returns 1 if the baud rate was changed, or -1 if the transmit
+// ring buffer or the UART transmitter is still busy.
+//
+//*****************************************************************************
+int ui_uart_set_baud(unsigned long ulBaud)
+{
+	tBoolean bDisabled;
+
+	if(ulBaud == uartBaud)
 	{
-		len = uartRecvBuf.slength;
-        uartRecvBuf.sReadDone =0;
-        uartRecvBuf.sPos =0;
-        //check if this is a stream read
-        if(rxData != NULL)
-        {
-        	//copy data over
-        	rcvPnt = uartRecvBuf.rcvBuffStrm;
-        	uBufPnt = rxData;
-        }
+		return(1);
 	}
 
-	if(uartRecvBuf.cReadDone)
-    {   
-    	len =uartRecvBuf.clength;
-        uartRecvBuf.cReadDone =0;
-        uartRecvBuf.cPos =0;
-        //check if this is a user read
-        if(cmdData != NULL)
-        {
-        	//copy data over
-        	rcvPnt = uartRecvBuf.rcvBuffCmd;
-        	uBufPnt = cmdData;
-        }
-    }    
-
-	//this should not happen, just to make sure
-	if(rcvPnt == NULL) return (-1);
-    
-	//check sum
-	crc = 0;
-    for (i =0; i< len-1; i++)
-    {
-        crc = crc8_add(crc, rcvPnt[i]);
-    }
-    
-    //compare checksum
-    if(crc != rcvPnt[len-1])
-    {
-    	return(-1);
-    }
-    
-    //only return the data
-    memcpy(uBufPnt, &rcvPnt[UART_HEADER_LENGTH], len-UART_HEADER_LENGTH);
+	bDisabled = IntMasterDisable();
+	if((uartTxHead != uartTxTail) || UARTBusy(UART0_BASE))
+	{
+		if(!bDisabled)
+		{
+			IntMasterEnable();
+		}
+		return(-1);
+	}
+
+	//the UART is disabled while it is reconfigured, which empties the FIFOs
+	uartBaud = ulBaud;
+	UARTConfigSetExpClk(UART0_BASE, SysCtlClockGet(), uartBaud,
+	                    (UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE |
+	                     UART_CONFIG_PAR_NONE));
+	uartFramer.state = UART_RX_HUNT;
 
-	return(len-UART_HEADER_LENGTH);
+	if(!bDisabled)
+	{
+		IntMasterEnable();
+	}
+
+	return(1);
 }
 
-/*
- * Function to process user command
- */
+//*****************************************************************************
+//
+// Returns the baud rate of the handpiece link.
+//
+//*****************************************************************************
+unsigned long ui_uart_get_baud(void)
+{
+	return uartBaud;
+}
 
-int ui_uart_ucmd(char *buf, int len)
+//*****************************************************************************
+//
+// Returns the time since the last stream frame, in milliseconds.  This does
+// not advance while handpiece requests are pending, since the handpiece does
+// not stream while it is answering commands.
+//
+//*****************************************************************************
+unsigned long ui_uart_stream_age(void)
 {
-	int rLen;
-    unsigned long tStart = UIGetTicks();
+	return uartStreamAge;
+}
 
+//*****************************************************************************
+//
+// Queues a command to the handpiece.
+//
+// The command is copied, so the caller's buffer may be reused at once.  When
+// the reply arrives, its data is copied to reply (up to replySize bytes) and
+// pfnCallback is called with pvCBData and the reply length; if there is no
+// reply within UART_REQ_TIMEOUT_MS, pfnCallback is called with a length of
+// -1.  Either of reply and pfnCallback may be NULL.  This may be called from
+// an interrupt handler, and from a callback.
+//
+// Returns 1 if the command was queued, or -1 if it is too long or the queue
+// is full.
+//
+//*****************************************************************************
+int ui_uart_request(const char *cmd, int length, char *reply, int replySize,
+                    tUARTCallback pfnCallback, void *pvCBData)
+{
+	uartRequestStruct *req;
+	unsigned char next;
+	tBoolean bDisabled;
 
-	//send command
-    if(ui_uart_send(buf,len) ==-1) return -1;
+	//check length
+	if(length > UART_MAX_CMD_LENGTH)
+	{
+		return(-1);
+	}
 
-    //wait for reply
-    do
-    {
-    	//time out in ~0.5 seconds
-    	if(UIGetTicks() - tStart > 25000000)
-    	{
-			g_ucHPInitDone = 0x00;
-    		return(-1);
-    	}
-    	rLen = ui_uart_receive(NULL,buf);
+	bDisabled = IntMasterDisable();
+
+	//check for a free request
+	next = (uartReqTail + 1) % UART_NUM_REQUESTS;
+	if(next == uartReqHead)
+	{
+		if(!bDisabled)
+		{
+			IntMasterEnable();
+		}
+		return(-1);
+	}
+
+	//fill in the request and queue it
+	req = &uartRequest[uartReqTail];
+	memcpy(req->cmd, cmd, length);
+	req->cmdLength = length;
+	req->reply = reply;
+	req->replySize = replySize;
+	req->pfnCallback = pfnCallback;
+	req->pvCBData = pvCBData;
+	req->state = UART_REQ_QUEUED;
+	uartReqTail = next;
+
+	if(!bDisabled)
+	{
+		IntMasterEnable();
+	}
+
+	return(1);
+}
+
+//*****************************************************************************
+//
+// Returns 1 if there are handpiece requests queued or in flight.
+//
+//*****************************************************************************
+int ui_uart_busy(void)
+{
+	return((uartReqHead != uartReqTail) ? 1 : 0);
+}
+
+//*****************************************************************************
+//
+// Returns 1 if the handpiece link is idle: no requests are queued or in
+// flight, nothing is left to send, and no frame is partly received.  This is
+// when a stall of the processor (such as programming the flash) is least
+// likely to lose any of the link traffic.
+//
+//*****************************************************************************
+int ui_uart_idle(void)
+{
+	return(((uartReqHead == uartReqTail) && (uartTxHead == uartTxTail) &&
+	        !UARTBusy(UART0_BASE) && (uartFramer.state == UART_RX_HUNT)) ?
+	       1 : 0);
+}
 
-    	// give a little delay ~1 ms
-    	SysCtlDelay(20000);
+//*****************************************************************************
+//
+// Runs the handpiece request queue.
+//
+// This is called from the main loop, and never waits.  It sends the next
+// queued request once the previous one has completed, and completes the
+// request in flight when its reply has been received or it has timed out.
+// A request is not sent while the motor is running, since the handpiece
+// stops streaming the trigger while it answers commands.
+//
+//*****************************************************************************
+void ui_uart_process(void)
+{
+	uartRequestStruct *req;
+	tUARTCallback pfnCallback;
+	void *pvCBData;
+	const unsigned char *frame;
+	int len;
 
-    }while(rLen ==-1);
+	//a reply with no request in flight is discarded
+	len = uart_frame_take(UART_FRAME_CMD, &frame, NULL);
+	if(uartReqHead == uartReqTail)
+	{
+		return;
+	}
+	req = &uartRequest[uartReqHead];
+
+	//send the next request
+	if(req->state == UART_REQ_QUEUED)
+	{
+		if(MainIsRunning())
+		{
+			return;
+		}
+		uartReqTimeout = UART_REQ_TIMEOUT_MS;
+		req->state = UART_REQ_SENT;
+		if(ui_uart_send(req->cmd, req->cmdLength) == -1)
+		{
+			uartReqTimeout = 0;
+		}
+		return;
+	}
+
+	//wait for the reply, which the framer has already checked, or the timeout
+	if(len != -1)
+	{
+		//only return the data, as much as fits
+		len -= UART_HEADER_LENGTH + 1;
+		if(req->reply != NULL)
+		{
+			memcpy(req->reply, &frame[UART_HEADER_LENGTH],
+			       (len < req->replySize) ? len : req->replySize);
+		}
+	}
+	else
+	{
+		if(uartReqTimeout != 0)
+		{
+			return;
+		}
+		g_ucHPInitDone = 0x00;
+	}
 
-	return rLen;
+	//complete the request, freeing it before the callback so that the
+	//callback can queue another
+	pfnCallback = req->pfnCallback;
+	pvCBData = req->pvCBData;
+	req->state = UART_REQ_FREE;
+	uartReqHead = (uartReqHead + 1) % UART_NUM_REQUESTS;
+	if(pfnCallback)
+	{
+		pfnCallback(pvCBData, len);
+	}
 }
 
+//*****************************************************************************
+//
+// Advances the handpiece request timeout and the stream frame age.  This is
+// called from the user interface tick.
+//
+//*****************************************************************************
+void ui_uart_tick(unsigned long ulTickMS)
+{
+	//count down the timeout of the request in flight
+	if(uartReqTimeout > ulTickMS)
+	{
+		uartReqTimeout -= ulTickMS;
+	}
+	else
+	{
+		uartReqTimeout = 0;
+	}
+
+	//the handpiece does not stream while requests are pending
+	if(uartReqHead != uartReqTail)
+	{
+		uartStreamAge = 0;
+	}
+	else if(uartStreamAge < UART_STREAM_AGE_MAX)
+	{
+		uartStreamAge += ulTickMS;
+	}
+}
@@ -1,10 +1,26 @@
 #ifndef __UI_UART_H__
 #define __UI_UART_H__
 
+//*****************************************************************************
+//
+// The function called when a handpiece request completes.  pvCBData is the
+// pointer given when the request was queued, and iLength is the number of
+// bytes of reply data, or -1 if the handpiece did not reply.
+//
+//*****************************************************************************
+typedef void (*tUARTCallback)(void *pvCBData, int iLength);
+
 int ui_uart_init(void);
-int ui_uart_receive(char *, char *);
 int ui_uart_send(char *,int);
-int ui_uart_ucmd(char *, int );
+int ui_uart_stream(const unsigned char **, unsigned long *);
+unsigned long ui_uart_stream_age(void);
+int ui_uart_set_baud(unsigned long);
+unsigned long ui_uart_get_baud(void);
+int ui_uart_request(const char *, int, char *, int, tUARTCallback, void *);
+int ui_uart_busy(void);
+int ui_uart_idle(void);
+void ui_uart_process(void);
+void ui_uart_tick(unsigned long);
 unsigned char crc8_add( unsigned char, unsigned char );
 
 #endif /*__UI_UART_H__*/